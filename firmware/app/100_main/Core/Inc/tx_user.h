@@ -288,6 +288,9 @@ unsigned long App_ThreadX_LowPower_Timer_Adjust(void);
 
 /* USER CODE BEGIN 2 */
 
+/* Context switch hooks for the per-thread CPU time in fmx_stats.c.  */
+#define TX_ENABLE_EXECUTION_CHANGE_NOTIFY
+
 /* USER CODE END 2 */
 
 #endif
@@ -235,6 +235,9 @@ void HAL_LPTIM_MspInit(LPTIM_HandleTypeDef* lptimHandle)
     HAL_GPIO_Init(GPIOD, &GPIO_InitStruct);
 
   /* USER CODE BEGIN LPTIM4_MspInit 1 */
+    // El ARRM de LPTIM4 extiende el conteo de pulsos a 32 bits.
+    HAL_NVIC_SetPriority(LPTIM4_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(LPTIM4_IRQn);
 
   /* USER CODE END LPTIM4_MspInit 1 */
   }
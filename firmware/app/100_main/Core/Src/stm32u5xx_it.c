@@ -22,6 +22,7 @@
 #include "stm32u5xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "fm_flash.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -63,6 +64,9 @@ extern UART_HandleTypeDef huart3;
 extern TIM_HandleTypeDef htim6;
 
 /* USER CODE BEGIN EV */
+extern LPTIM_HandleTypeDef hlptim4;
+extern DMA_HandleTypeDef pcf8553_dma;
+extern SPI_HandleTypeDef h_spi1;
 
 /* USER CODE END EV */
 
@@ -75,7 +79,11 @@ extern TIM_HandleTypeDef htim6;
 void NMI_Handler(void)
 {
   /* USER CODE BEGIN NonMaskableInt_IRQn 0 */
-
+  // Doble error de ECC en el log, de un quad-word cortado: la lectura sigue.
+  if (FM_FLASH_EccNmi())
+  {
+    return;
+  }
   /* USER CODE END NonMaskableInt_IRQn 0 */
   /* USER CODE BEGIN NonMaskableInt_IRQn 1 */
    while (1)
@@ -334,4 +342,32 @@ void LPTIM3_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles LPTIM4 global interrupt.
+  * @note  ARRM extiende el contador de pulsos a 32 bits (fmx_capture.c) y el
+  *        compare CC1 corta el batch en el pulso objetivo (fmx_batch.c).
+  */
+void LPTIM4_IRQHandler(void)
+{
+  HAL_LPTIM_IRQHandler(&hlptim4);
+}
+
+/**
+  * @brief This function handles GPDMA1 Channel 2 global interrupt.
+  * @note  SPI1 TX del volcado al PCF8553, ver fm_pcf8553.c.
+  */
+void GPDMA1_Channel2_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&pcf8553_dma);
+}
+
+/**
+  * @brief This function handles SPI1 global interrupt.
+  * @note  EOT cierra el volcado por DMA al PCF8553.
+  */
+void SPI1_IRQHandler(void)
+{
+  HAL_SPI_IRQHandler(&h_spi1);
+}
+
 /* USER CODE END 1 */
@@ -35,15 +35,15 @@ static uint8_t *__sbrk_heap_end = NULL;
  *
  * @verbatim
  * ############################################################################
- * #  .data  #  .bss  #       newlib heap       #          MSP stack          #
- * #         #        #                         # Reserved by _Min_Stack_Size #
+ * #  .data  #  .bss  #          MSP stack          #       newlib heap       #
+ * #         #        # Reserved by _Min_Stack_Size #                         #
  * ############################################################################
- * ^-- RAM start      ^-- _end                             _estack, RAM end --^
+ * ^-- RAM start                            _estack, _end --^    _heap_limit --^
  * @endverbatim
  *
  * This implementation starts allocating at the '_end' linker symbol
- * The '_Min_Stack_Size' linker symbol reserves a memory for the MSP stack
- * The implementation considers '_estack' linker symbol to be RAM end
+ * The '_heap_limit' linker symbol is the heap end: with STM32U575VITXQ_FLASH.ld
+ * it is the end of the last SRAM1 page retained in stop 2, see FM_INIT_Init
  * NOTE: If the MSP stack, at any point during execution, grows larger than the
  * reserved size, please increase the '_Min_Stack_Size'.
  *
@@ -53,10 +53,8 @@ static uint8_t *__sbrk_heap_end = NULL;
 void *_sbrk(ptrdiff_t incr)
 {
   extern uint8_t _end; /* Symbol defined in the linker script */
-  extern uint8_t _estack; /* Symbol defined in the linker script */
-  extern uint32_t _Min_Stack_Size; /* Symbol defined in the linker script */
-  const uint32_t stack_limit = (uint32_t)&_estack - (uint32_t)&_Min_Stack_Size;
-  const uint8_t *max_heap = (uint8_t *)stack_limit;
+  extern uint8_t _heap_limit; /* Symbol defined in the linker script */
+  const uint8_t *max_heap = &_heap_limit;
   uint8_t *prev_heap_end;
 
   /* Initialize heap end at first call */
@@ -65,7 +63,7 @@ void *_sbrk(ptrdiff_t incr)
     __sbrk_heap_end = &_end;
   }
 
-  /* Protect heap from growing into the reserved MSP stack */
+  /* Keep the heap inside the retained SRAM1 pages */
   if (__sbrk_heap_end + incr > max_heap)
   {
     errno = ENOMEM;
@@ -18,6 +18,8 @@
 #include "fm_rtc.h"
 #include "main.h"
 #include "fm_mxc.h"
+#include "fmx_capture.h"
+#include "fmx_trace.h"
 
 
 // Typedef.
@@ -25,12 +27,16 @@
 // Const data.
 
 // Defines.
+#define SRAM1_PAGE_SIZE     (64u * 1024u)
+#define SRAM1_PAGES         (3u)
 
 // Debug.
 
 // Project variables, non-static, at least used in other file.
 
 // External variables.
+extern uint8_t _heap_limit; // Fin del estado retenido, ver STM32U575VITXQ_FLASH.ld.
+extern uint8_t _estack;     // Tope del stack MSP; en STM32U575VITXQ_RAM.ld, fin de SRAM3.
 extern RTC_HandleTypeDef hrtc;
 extern LPTIM_HandleTypeDef hlptim1;
 extern LPTIM_HandleTypeDef hlptim3;
@@ -39,9 +45,51 @@ extern LPTIM_HandleTypeDef hlptim4;
 // Global variables, statics.
 
 // Private function prototypes.
+static void RetentionSet(void);
 
 // Private function bodies.
 
+/*
+ * El linker junta .data, .bss, el pool de ThreadX (hilos, stacks, colas), la
+ * memoria shadow del LCD, el stack MSP y el heap de newlib al inicio de la
+ * SRAM1; el heap termina en _heap_limit, fin de la ultima pagina usada. En
+ * stop 2 se retienen solo esas paginas de 64 KB, la SRAM4 (anillo del
+ * LPDMA) y el ICACHE; SRAM2 y SRAM3 no se usan y se apagan tambien en run.
+ * Con STM32U575VITXQ_RAM.ld (depuracion en RAM) el programa y el stack llegan
+ * a SRAM3: si _estack queda por encima de SRAM1 no se apaga ninguna.
+ */
+static void RetentionSet(void)
+{
+    static const uint32_t sram1_page[SRAM1_PAGES] =
+    { PWR_SRAM1_PAGE1_STOP, PWR_SRAM1_PAGE2_STOP, PWR_SRAM1_PAGE3_STOP };
+    uint32_t used;
+
+    used = (uint32_t)&_heap_limit - SRAM1_BASE;
+    for (uint32_t i = 0; i < SRAM1_PAGES; i++)
+    {
+        if ((i * SRAM1_PAGE_SIZE) >= used)
+        {
+            HAL_PWREx_DisableRAMsContentStopRetention(sram1_page[i]);
+        }
+    }
+
+    if ((uint32_t)&_estack <= (SRAM1_BASE + SRAM1_SIZE))
+    {
+        HAL_PWREx_DisableRAMsContentStopRetention(PWR_SRAM2_FULL_STOP);
+        HAL_PWREx_DisableRAMsContentStopRetention(PWR_SRAM3_FULL_STOP);
+        HAL_PWREx_DisableRAMsContentRunRetention(PWR_SRAM2_FULL_RUN);
+        HAL_PWREx_DisableRAMsContentRunRetention(PWR_SRAM3_FULL_RUN);
+    }
+
+    // RAM de perifericos sin uso: DCACHE (no habilitado), FMAC/FDCAN/USB y PKA.
+    HAL_PWREx_DisableRAMsContentStopRetention(PWR_DCACHE1_FULL_STOP);
+    HAL_PWREx_DisableRAMsContentStopRetention(PWR_PERIPHRAM_FULL_STOP);
+    HAL_PWREx_DisableRAMsContentStopRetention(PWR_PKA32RAM_FULL_STOP);
+#if defined (PWR_CR2_DMA2DRAMPDS)
+    HAL_PWREx_DisableRAMsContentStopRetention(PWR_DMA2DRAM_FULL_STOP);
+#endif
+}
+
 // Public function bodies.
 
 /*
@@ -56,9 +104,6 @@ void FM_INIT_Init()
     RTC_TimeTypeDef time;
     RTC_DateTypeDef date;
 
-
-    FM_LOG_Init();
-
     /*
      * El computador usa la backup ram, mantenida por la backup battery, para mantener datos importantes.
      * Ejemplo de estos datos son los pulsos acumulados. El Computador puede hacer reset por diferentes motivos,
@@ -90,18 +135,15 @@ void FM_INIT_Init()
         FM_DEBUG_LedError(1);
     }
 
-    // El CubeMX configura el LPTIM pero es mi responsabilidad que arranque
-    if (HAL_LPTIM_IC_Start_IT(&hlptim3, LPTIM_CHANNEL_1) != HAL_OK)
-    {
-        FM_DEBUG_LedError(1);
-    }
-
     // El CubeMX configura el LPTIM pero es mi responsabilidad que arranque
     if (HAL_LPTIM_Counter_Start(&hlptim4) != HAL_OK)
     {
         FM_DEBUG_LedError(1);
     }
 
+    // LPTIM3 captura cada flanco por LPDMA; requiere LPTIM4 ya contando.
+    FMX_CAPTURE_Init();
+
     // Por  Por defecto el LPTIM se apaga en stop mode, lo habilito al bajo consumo.
     __HAL_RCC_LPTIM1_CLKAM_ENABLE();
     __HAL_RCC_LPTIM3_CLKAM_ENABLE();
@@ -110,6 +152,12 @@ void FM_INIT_Init()
     // Habilito la RAM BACKUP antes de usar.
     FM_BACKUP_Init();
 
+    // Registros del log en espera en la RAM BACKUP y head del log en la flash.
+    FM_LOG_Init();
+
+    // Solo se retienen en stop 2 las paginas de SRAM con estado en uso.
+    RetentionSet();
+
     chip_info = FM_FLASH_ChipInfoRead();
 
     if (chip_info.reset_counter == 0) // ¿Es la primera vez que se enciende el chip?
@@ -135,6 +183,9 @@ void FM_INIT_Init()
     }
     FM_DEBUG_UartUint32(chip_info.reset_counter);
 
+    // La traza de despertares esta en la RAM BACKUP; marca este arranque.
+    FMX_TRACE_Init(FM_RTC_GetUnixTime());
+
     FM_FLASH_NewReset();  // Registra un nuevo reset, por cualquier motivo.
 }
 
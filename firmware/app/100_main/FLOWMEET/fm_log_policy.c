@@ -77,6 +77,9 @@ uint32_t FM_LOG_POLICY_Step(fmx_ack_t ack) {
 	case FMX_ACK_RATE_STOPED:
 		credits--;
 		break;
+	case FMX_ACK_BATCH_DONE:
+		credits--;
+		break;
 	default:
 		break;
 	}
@@ -95,23 +98,24 @@ uint32_t FM_LOG_POLICY_Step(fmx_ack_t ack) {
 
 
 /**
- * @brief	Evalúa la política y determina si se debe registrar un evento.
- * 			Se llama a esta funcion cada un segundo.
- * @param in Puntero a la estructura de entrada con el estado actual.
- * @return Acción a realizar (ver fm_log_action_t).
+ * @brief	Recarga un credito cada CREDIT_NEW_MIN segundos, hasta CREDITS_MAX.
+ * 			La llama el hilo de medicion, el mismo que consume los creditos, con el
+ * 			tiempo transcurrido desde la llamada anterior (FMX_WAKE_LOG_CREDIT).
+ * @param seconds Segundos transcurridos desde la llamada anterior.
+ * @return 0.
  */
-uint32_t FM_LOG_POLICY_Timer() {
+uint32_t FM_LOG_POLICY_Timer(uint32_t seconds) {
 	static uint32_t credit_timer = CREDIT_NEW_MIN;
 
-
-	// TODO, aun no tengo una llamada a esta funcion cada un segundo, hay que implementar.
-
-	if(credit_timer)
-	{
-		credit_timer--;
-	}
-	else
+	while (seconds)
 	{
+		if (seconds < credit_timer)
+		{
+			credit_timer -= seconds;
+			break;
+		}
+
+		seconds -= credit_timer;
 		credit_timer = CREDIT_NEW_MIN;
 		if(global_credits < CREDITS_MAX)
 		{
@@ -22,6 +22,7 @@ typedef struct {
 // --- API pública ---
 
 uint32_t FM_LOG_POLICY_Step(fmx_ack_t ack);
+uint32_t FM_LOG_POLICY_Timer(uint32_t seconds);
 
 
 #endif // FM_LOG_POLICY_H
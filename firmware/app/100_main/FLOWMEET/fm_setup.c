@@ -15,6 +15,7 @@
 #include "fm_debug.h"
 #include "fm_factory.h"
 #include "fm_fmc.h"
+#include "fm_ktable.h"
 #include "fm_lcd.h"
 #include "fm_rtc.h"
 #include "fm_setup.h"
@@ -30,6 +31,7 @@ typedef enum
     MENU_SETUP_INIT = 0,
     MENU_SETUP_PASSWORD,
     MENU_SETUP_FACTOR_C,
+    MENU_SETUP_K_TABLE,
     MENU_SETUP_VOL_UNIT,
     MENU_SETUP_TIME_UNIT,
     MENU_SETUP_DATE,
@@ -62,7 +64,6 @@ typedef enum
 
 // External variables.
 extern RTC_HandleTypeDef hrtc;
-extern ULONG global_menu_refresh;
 
 // Global variables, statics.
 
@@ -83,6 +84,8 @@ void MenuSetupPasswordEntry(uint8_t pass_len);
 void MenuSetupPasswordEnter(menu_mode_t mode);
 void MenuSetupFactorCalEntry();
 ufp3_t MenuSetupFactorCalEdit(menu_mode_t mode);
+void MenuSetupKTableEntry();
+void MenuSetupKTableEdit(menu_mode_t mode);
 void MenuSetupTimeUnitEntry();
 void MenuSetupTimeUnitEdit(menu_mode_t mode);
 void MenuSetupVolUnitEntry();
@@ -259,6 +262,46 @@ uint8_t FM_SETUP_MenuNav(fmx_events_t this_event)
             break;
         }
         break;
+    case MENU_SETUP_K_TABLE:
+        if (!entry_counter)
+        {
+            MenuSetupKTableEntry();
+            entry_counter++;
+        }
+        switch (this_event)
+        {
+        case FMX_EVENT_MENU_REFRESH:
+            MenuSetupKTableEdit(MENU_MODE_REFRESH);
+            break;
+        case FMX_EVENT_KEY_DOWN:
+            MenuSetupKTableEdit(MENU_MODE_DEC);
+            FMX_RefreshEventTrue();
+            break;
+        case FMX_EVENT_KEY_UP:
+            MenuSetupKTableEdit(MENU_MODE_INC);
+            FMX_RefreshEventTrue();
+            break;
+        case FMX_EVENT_KEY_ESC:
+            MenuSetupKTableEdit(MENU_MODE_EXIT);
+            entry_counter = 0;
+            menu_index++;
+            FMX_RefreshEventTrue();
+            break;
+        case FMX_EVENT_KEY_ENTER:
+            break;
+        case FMX_EVENT_KEY_DOWN_LONG:
+            break;
+        case FMX_EVENT_KEY_UP_LONG:
+            break;
+        case FMX_EVENT_KEY_ESC_LONG:
+            break;
+        case FMX_EVENT_KEY_ENTER_LONG:
+            break;
+        default:
+            FM_DEBUG_LedError(1);
+            break;
+        }
+        break;
     case MENU_SETUP_VOL_UNIT:
         if (!entry_counter)
         {
@@ -333,7 +376,9 @@ uint8_t FM_SETUP_MenuNav(fmx_events_t this_event)
         case FMX_EVENT_KEY_ESC_LONG:
             break;
         case FMX_EVENT_KEY_ENTER_LONG:
+            FMX_MeasureLock();
             FM_FMC_TtlReset();
+            FMX_MeasureUnlock();
             break;
         default:
             FM_DEBUG_LedError(1);
@@ -390,7 +435,9 @@ uint8_t FM_SETUP_MenuNav(fmx_events_t this_event)
         break;
     case MENU_SETUP_END:
         FMX_RefreshEventTrue();
+        FMX_MeasureLock();
         FM_FMC_Init(FM_FACTORY_RAM_BACKUP); // Necesario para calcular factores con nueva configuración.
+        FMX_MeasureUnlock();
         menu_index = MENU_SETUP_INIT; // El indice ajustado para la próxima entrada al menu de configuración.
         menu_user = TRUE;  // Retorna al menu de usuario.
         FM_DEBUG_Init(); // Le los jumper de configuración y ajusta comportamiento UART y LEDs de debug.
@@ -547,7 +594,9 @@ ufp3_t MenuSetupFactorCalEdit(menu_mode_t mode)
         }
         break;
     case MENU_MODE_EXIT: // Guarda el valor editado en en la variable de entorno.
+        FMX_MeasureLock();
         FM_FMC_FactorCalSet(factor_cal);
+        FMX_MeasureUnlock();
         break;
     case MENU_MODE_REFRESH:
         break;
@@ -559,12 +608,73 @@ ufp3_t MenuSetupFactorCalEdit(menu_mode_t mode)
             factor_cal % 1000);
     FM_LCD_PutString(setup_line_1, FM_LCD_LL_ROW_1_COLS + 1, FM_LCD_LL_ROW_1);
 
-    if (FM_LCD_LL_BlinkRefresh(0))
+    return factor_cal;
+}
+
+/*
+ * @brief	función llamada al ingresar al menu de la tabla de linealización del factor K.
+ * @note	Los puntos (frecuencia, K) se cargan con FM+KTAB=; aquí solo se elige cuantos se usan.
+ * @param	ninguno.
+ * retval	ninguno.
+ */
+void MenuSetupKTableEntry()
+{
+    const char msg_lin[] = "LIN_PT";
+
+    FM_LCD_LL_Clear();
+    FM_LCD_LL_BlinkClear();
+
+    FM_LCD_PutString(msg_lin, strlen(msg_lin), FM_LCD_LL_ROW_2);
+
+    // Activa parpadeo del digito menos significativo.
+    FM_LCD_LL_BlinkNumber(FM_LCD_LL_ROW_1, FM_LCD_LL_ROW_1_COLS - 1, FM_LCD_LL_BLINK_ON_ON);
+
+    MenuSetupKTableEdit(MENU_MODE_INIT);
+}
+
+/*
+ * @brief	Edita la cantidad de puntos activos de la tabla de linealización.
+ * @param	mode MENU_MODE_INIT lee la cantidad actual.
+ * 			mode MENU_MODE_INC / MENU_MODE_DEC cambian la cantidad, hasta los puntos válidos guardados.
+ * 			mode MENU_MODE_EXIT guarda en flash si hubo cambios; 0 desactiva la linealización.
+ * @retval	ninguno.
+ */
+void MenuSetupKTableEdit(menu_mode_t mode)
+{
+    static uint8_t count = 0; // Se usa una copia hasta terminar la edición.
+
+    switch (mode)
     {
-        global_menu_refresh = 150;
+    case MENU_MODE_INIT:
+        count = FM_KTABLE_CountGet();
+        break;
+    case MENU_MODE_INC:
+        if (count < FM_KTABLE_CountMaxGet())
+        {
+            count++;
+        }
+        break;
+    case MENU_MODE_DEC:
+        if (count > 0)
+        {
+            count--;
+        }
+        break;
+    case MENU_MODE_EXIT:
+        if ((count != FM_KTABLE_CountGet()) && (FM_KTABLE_CountSet(count) != FMX_STATUS_OK))
+        {
+            FM_DEBUG_LedError(1);
+        }
+        break;
+    case MENU_MODE_REFRESH:
+        break;
+    default:
+        FM_DEBUG_LedError(1);
+        break;
     }
 
-    return factor_cal;
+    snprintf(setup_line_1, sizeof(setup_line_1), "%08u", count);
+    FM_LCD_PutString(setup_line_1, FM_LCD_LL_ROW_1_COLS + 1, FM_LCD_LL_ROW_1);
 }
 
 /*
@@ -621,9 +731,11 @@ void MenuSetupVolUnitEdit(menu_mode_t mode)
         }
         break;
     case MENU_MODE_EXIT:
+        FMX_MeasureLock();
         FM_FMC_TotalizerVolUnitSet(vol_unit);
         factor_k = FM_FMC_FactorKCalc(factor_cal, vol_unit);
         FM_FMC_FactorKSet(factor_k);
+        FMX_MeasureUnlock();
         break;
     case MENU_MODE_REFRESH:
         break;
@@ -640,11 +752,6 @@ void MenuSetupVolUnitEdit(menu_mode_t mode)
     // Muestro la unidad de volumen
     FM_FMC_TotalizerStrUnitGet(&ptr, vol_unit);
     FM_LCD_PutChar(ptr);
-
-    if (FM_LCD_LL_BlinkRefresh(0))
-    {
-        global_menu_refresh = 150;
-    }
 }
 
 /*
@@ -694,6 +801,7 @@ void MenuSetupTimeUnitEdit(menu_mode_t mode)
     static fm_fmc_time_unit_t time_unit = TIME_UNIT_SECOND;
     static double factor_k;
     uint32_t pulse_ttl;
+    fm_fmc_snapshot_t snapshot;
 
     switch (mode)
     {
@@ -714,6 +822,7 @@ void MenuSetupTimeUnitEdit(menu_mode_t mode)
         }
         break;
     case MENU_MODE_EXIT:
+        FMX_MeasureLock();
         if (FM_FMC_TotalizerTimeUnitSet(time_unit) == FMX_STATUS_OK)
         {
             // Si se cambio la unidad exitosamente se recalcula el factor de caudal.
@@ -728,6 +837,7 @@ void MenuSetupTimeUnitEdit(menu_mode_t mode)
             // No se pudo cambiar la unidad de tiempo.
             FM_DEBUG_LedError(1);
         }
+        FMX_MeasureUnlock();
         break;
     case MENU_MODE_REFRESH:
         break;
@@ -737,7 +847,8 @@ void MenuSetupTimeUnitEdit(menu_mode_t mode)
     }
 
     // Muestro pulsos acumulados
-    pulse_ttl = (uint32_t) FM_FMC_TtlPulseGet();
+    FM_FMC_SnapshotGet(&snapshot);
+    pulse_ttl = (uint32_t) snapshot.pulse_ttl;
 
     // Cantidad de pulsos acumulados.
     snprintf(setup_line_2, sizeof(setup_line_2), "%07lu", pulse_ttl);
@@ -748,12 +859,6 @@ void MenuSetupTimeUnitEdit(menu_mode_t mode)
 
     // Refresco la unidad de tiempo mostrada en pantalla.
     FM_FMC_TotalizerTimeUnitSel(time_unit);
-
-    if (FM_LCD_LL_BlinkRefresh(0))
-    {
-        global_menu_refresh = 150;
-    }
-
 }
 
 /*
@@ -855,11 +960,6 @@ void MenuSetupDateEdit(menu_mode_t sel)
 
     FM_LCD_PutString(setup_line_1, FM_LCD_LL_ROW_1_COLS, FM_LCD_LL_ROW_1);
     FM_LCD_PutString(setup_line_2, FM_LCD_LL_ROW_2_COLS, FM_LCD_LL_ROW_2);
-
-    if (FM_LCD_LL_BlinkRefresh(0))
-    {
-        global_menu_refresh = 150;
-    }
 }
 
 // Interrupts
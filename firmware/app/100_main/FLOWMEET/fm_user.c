@@ -157,39 +157,10 @@ void MenuUserTtlRateEntry()
  */
 void MenuUserTtlRateRefresh()
 {
-    uint32_t p_integer;
-    uint32_t p_frac;
-    int sel;
+    fm_fmc_snapshot_t snapshot;
 
-    p_integer = FM_FMC_TtlGet();
-    p_integer /= 1000;
-
-    p_frac = FM_FMC_TtlGet();
-    p_frac %= 1000;
-
-    sel = FM_FMC_TotalizerFpSelGet();
-
-    switch (sel)
-    {
-    case FM_FMC_FP_SEL_0:
-        snprintf(user_line_1, sizeof(user_line_1), "%8lu", p_integer);
-        break;
-    case FM_FMC_FP_SEL_1:
-        p_frac /= 100;
-        snprintf(user_line_1, sizeof(user_line_1), "%7lu.%1lu", p_integer, p_frac);
-        break;
-    case FM_FMC_FP_SEL_2:
-        p_frac /= 10;
-        snprintf(user_line_1, sizeof(user_line_1), "%6lu.%02lu", p_integer, p_frac);
-        break;
-    case FM_FMC_FP_SEL_3:
-        snprintf(user_line_1, sizeof(user_line_1), "%5lu.%03lu", p_integer, p_frac);
-        break;
-    default:
-        FM_DEBUG_LedError(1);
-        break;
-    }
-    FM_LCD_PutString(user_line_1, FM_LCD_LL_ROW_1_COLS, FM_LCD_LL_ROW_1);
+    FM_FMC_SnapshotGet(&snapshot);
+    FM_LCD_PutUfp3(snapshot.ttl, FM_FMC_TotalizerFpSelGet(), ' ', FM_LCD_LL_ROW_1);
     MenuUserRateRefresh();
 }
 
@@ -230,41 +201,10 @@ void MenuUserAcmRateEntry()
  */
 void MenuUserAcmRateRefresh()
 {
-    ufp3_t acm;
-    uint32_t p_integer;  // parte entera
-    uint32_t p_frac;  // parte fracional
-    int sel;
-
-    //
-    acm = FM_FMC_AcmGet();
-    sel = FM_FMC_TotalizerFpSelGet();
-
-    p_integer = acm / 1000;
-    p_frac = acm % 1000;
-
-    switch (sel)
-    {
-    case FM_FMC_FP_SEL_0:
-        snprintf(user_line_1, sizeof(user_line_1), "%8lu", p_integer);
-        break;
-    case FM_FMC_FP_SEL_1:
-        p_frac /= 100;
-        snprintf(user_line_1, sizeof(user_line_1), "%7lu.%1lu", p_integer, p_frac);
-        break;
-    case FM_FMC_FP_SEL_2:
-        p_frac /= 10;
-        snprintf(user_line_1, sizeof(user_line_1), "%6lu.%02lu", p_integer, p_frac);
-        break;
-    case FM_FMC_FP_SEL_3:
-        snprintf(user_line_1, sizeof(user_line_1), "%5lu.%03lu", p_integer, p_frac);
-        break;
-    default:
-        FM_DEBUG_LedError(1);
-        break;
-    }
-
-    FM_LCD_PutString(user_line_1, FM_LCD_LL_ROW_1_COLS, FM_LCD_LL_ROW_1);
+    fm_fmc_snapshot_t snapshot;
 
+    FM_FMC_SnapshotGet(&snapshot);
+    FM_LCD_PutUfp3(snapshot.acm, FM_FMC_TotalizerFpSelGet(), ' ', FM_LCD_LL_ROW_1);
     MenuUserRateRefresh();
 }
 
@@ -276,42 +216,11 @@ void MenuUserAcmRateRefresh()
  */
 void MenuUserRateRefresh()
 {
-    ufp3_t rate;
-    uint32_t p_integer;  // parte entera
-    uint32_t p_frac;  // parte fracional
-    int sel;
-
-    //
-    rate = FM_FMC_RateCalc();
-    sel = FM_FMC_RateFpSelGet();
+    fm_fmc_snapshot_t snapshot;
 
-    p_integer = rate / 1000;
-
-    switch (sel)
-    {
-    case FM_FMC_FP_SEL_0:
-        snprintf(user_line_2, sizeof(user_line_2), "%07lu", p_integer);
-        break;
-    case FM_FMC_FP_SEL_1:
-        p_frac = rate % 1000;
-        p_frac /= 100;
-        snprintf(user_line_2, sizeof(user_line_2), "%06lu.%01lu", p_integer, p_frac);
-        break;
-    case FM_FMC_FP_SEL_2:
-        p_frac = rate % 1000;
-        p_frac /= 10;
-        snprintf(user_line_2, sizeof(user_line_2), "%05lu.%02lu", p_integer, p_frac);
-        break;
-    case FM_FMC_FP_SEL_3:
-        p_frac = rate % 1000;
-        snprintf(user_line_2, sizeof(user_line_2), "%04lu.%03lu", p_integer, p_frac);
-        break;
-    default:
-        FM_DEBUG_LedError(1);
-        break;
-    }
-
-    FM_LCD_PutString(user_line_2, FM_LCD_LL_ROW_2_COLS, FM_LCD_LL_ROW_2);
+    // Caudal ya filtrado en PulseUpdate; recalcularlo aqui duplicaria la muestra.
+    FM_FMC_SnapshotGet(&snapshot);
+    FM_LCD_PutUfp3(snapshot.rate, FM_FMC_RateFpSelGet(), '0', FM_LCD_LL_ROW_2);
 }
 
 /*
@@ -355,39 +264,10 @@ void MenuUserPrintAcmStatus(print_status_t sel)
  */
 void MenuUserPrintAcmRefresh()
 {
-    ufp3_t acm;
-    uint32_t p_integer;  // parte entera
-    uint32_t p_frac;  // parte fracional
-    int sel;
-
-    //
-    acm = FM_FMC_AcmGet();
-    sel = FM_FMC_TotalizerFpSelGet();
-
-    p_integer = acm / 1000;
-    p_frac = acm % 1000;
+    fm_fmc_snapshot_t snapshot;
 
-    switch (sel)
-    {
-    case FM_FMC_FP_SEL_0:
-        snprintf(user_line_1, sizeof(user_line_1), "%8lu", p_integer);
-        break;
-    case FM_FMC_FP_SEL_1:
-        p_frac /= 100;
-        snprintf(user_line_1, sizeof(user_line_1), "%7lu.%1lu", p_integer, p_frac);
-        break;
-    case FM_FMC_FP_SEL_2:
-        p_frac /= 10;
-        snprintf(user_line_1, sizeof(user_line_1), "%6lu.%02lu", p_integer, p_frac);
-        break;
-    case FM_FMC_FP_SEL_3:
-        snprintf(user_line_1, sizeof(user_line_1), "%5lu.%03lu", p_integer, p_frac);
-        break;
-    default:
-        FM_DEBUG_LedError(1);
-        break;
-    }
-    FM_LCD_PutString(user_line_1, FM_LCD_LL_ROW_1_COLS, FM_LCD_LL_ROW_1);
+    FM_FMC_SnapshotGet(&snapshot);
+    FM_LCD_PutUfp3(snapshot.acm, FM_FMC_TotalizerFpSelGet(), ' ', FM_LCD_LL_ROW_1);
 }
 
 /*
@@ -599,7 +479,9 @@ uint8_t FM_USER_MenuNav(fmx_events_t this_event)
             break;
         case FMX_EVENT_KEY_ENTER_LONG:
         case FMX_EVENT_KEY_EXT_2:
+            FMX_MeasureLock();
             FM_FMC_AcmReset();
+            FMX_MeasureUnlock();
             MenuUserAcmRateRefresh();
             break;
         default:
@@ -790,23 +672,27 @@ void FM_USER_ThreadEntryBluetoothSlave(ULONG input)
         // Espera que el usuario inicia connexion desde MENU_USER_BLUETOOTH.
         tx_semaphore_get(sem_bluetooth_slave_ptr, TX_WAIT_FOREVER);
 
-        //
-        count_down_connect = SLAVE_TIME_CONNECTED;
-        MenuUserBluetoothRefresh();
-        FM_LCD_LL_Refresh();
-
         /*
-         *  La siguiente función bloquea el refresco de la pantalla, esto explica las instrucciones
-         *  anteriores. Enciende modulo bluetooth en modo esclavo.
+         * La pantalla la dibuja solo el hilo principal: aca se pide el redibujo y,
+         * como tiene la misma prioridad, se le cede el turno para que muestre la
+         * cuenta antes de que SendAt ocupe este hilo con el modulo.
          */
+        count_down_connect = SLAVE_TIME_CONNECTED;
+        FMX_RefreshEventTrue();
+        tx_thread_relinquish();
+
+        // Enciende modulo bluetooth en modo esclavo.
         FM_MXC_ConnectSlave();
 
+        // Los segundos llegan por el mismo semaforo, desde el planificador de despertares.
+        FMX_BluetoothTickSet(1);
         while (count_down_connect > 0)
         {
             count_down_connect--;
             FMX_RefreshEventTrue();
-            tx_thread_sleep(100);
+            tx_semaphore_get(sem_bluetooth_slave_ptr, TX_WAIT_FOREVER);
         }
+        FMX_BluetoothTickSet(0);
         FM_MXC_PowerOff();
     }
 }
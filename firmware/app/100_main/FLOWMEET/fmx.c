@@ -10,18 +10,23 @@
 
 // --- Includes ---
 #include "fmx.h"
-#include "lptim.h"
 #include "fm_debug.h"
 #include "fm_fmc.h"
 #include "fmx_lp.h"
+#include "fmx_capture.h"
+#include "fmx_batch.h"
+#include "fmx_wake.h"
 #include "fm_lcd.h"
 #include "fm_user.h"
 #include "fm_setup.h"
 #include "fm_log.h"
+#include "fm_log_policy.h"
+#include "fm_rtc.h"
 #include "fm_mxc.h"
 #include "fm_cmd.h"
 #include "fm_usart.h"
 #include "tx_api.h"
+#include <string.h>
 
 // --- Defines ---
 // Temporizadores y limites se alinean con REQ-FMX-TIMER-001.
@@ -36,6 +41,35 @@
 #define FMX_DEBUG_LOCAL
 #define TICKS_PER_SECOND   TX_TIMER_TICKS_PER_SECOND
 
+// Ventana de medicion (gate) adaptiva, en ticks de ThreadX.
+// Con conteo reciproco (flanco a flanco) no hay error de +-1 pulso, solo de
+// +-1 tick LSE en cada captura; el largo minimo sale de GATE_RESOLUTION_PPM.
+// La regresion sobre todos los flancos mejora ese peor caso, ver fmx_capture.c.
+#define LSE_HZ                (32768u)
+#define GATE_RESOLUTION_PPM   (100u)    // 0.01 %, requiere ~610 ms de ventana.
+#define GATE_RESOLUTION_LSE   (2u * 1000000u / GATE_RESOLUTION_PPM)
+#define GATE_TICKS_MIN        (TICKS_PER_SECOND / 10u)  // 100 ms.
+#define GATE_TICKS_IDLE       (TICKS_PER_SECOND)        // Sin caudal.
+#define GATE_TICKS_MAX        (TICKS_PER_SECOND * 8u)   // Hasta 0.25 Hz.
+
+// El anillo de captura se drena antes de que LPTIM3 de la vuelta (2 s), y a
+// caudal alto antes de llenarse, ver FMX_CAPTURE_DrainTimeGet.
+#define MEASURE_WAKE_MAX      (TICKS_PER_SECOND)
+// Flags de tx_event_flags: cerrar la ventana en curso sin esperar el gate,
+// vencimiento del planificador y recarga de creditos de log.
+#define MEASURE_FLAG_CLOSE    (0x00000001u)
+#define MEASURE_FLAG_TIMER    (0x00000002u)
+#define MEASURE_FLAG_CREDIT   (0x00000004u)
+#define MEASURE_FLAGS_ALL     (MEASURE_FLAG_CLOSE | MEASURE_FLAG_TIMER | MEASURE_FLAG_CREDIT)
+// Holgura del cierre de ventana: 1/8 de la espera, 12 ticks con el gate de 1 s.
+#define MEASURE_SLACK_DIV     (8u)
+
+// Recarga de creditos de log cada minuto; puede correrse hasta medio minuto.
+#define LOG_CREDIT_PERIOD     (TICKS_PER_SECOND * 60u)
+#define LOG_CREDIT_SLACK      (LOG_CREDIT_PERIOD / 2u)
+// Holgura del redibujo periodico de la UI, 1/4 del periodo.
+#define LCD_SLACK_DIV         (4u)
+
 // --- Globals ---
 // Contador global mantiene vivo el refresco de la UI.
 // Los modulos piden refrescos en ms (1000 ms equivale a 1 Hz).
@@ -46,8 +80,6 @@ ULONG global_menu_refresh = 0;
 
 // Mantiene el aislamiento de rebotes.
 static uint8_t key_ext_debounce_flag = 0;
-static uint16_t lptim3_last_capture;
-static uint16_t lptim4_last_capture;
 static TX_QUEUE event_queue;
 // Buffer dimensionado en ULONG simplifica conversiones y mantiene la latencia.
 static uint32_t queue_storage_event[QUEUE_EVENT_SIZE];
@@ -58,6 +90,10 @@ static TX_TIMER key_long_timer;
 static TX_TIMER backlight_off_timer;
 static TX_TIMER debounce_timer;
 static TX_THREAD bluetooth_slave_thread;
+// Hilo de medicion: drena la captura y corre FM_FMC_* sin depender de la UI.
+static TX_THREAD measure_thread;
+static TX_EVENT_FLAGS_GROUP measure_flags;
+static TX_MUTEX measure_mutex;
 // El keypad dispara la accion primaria al liberar la tecla.
 // Las variantes long press ejecutan una accion secundaria tras 3 s.
 // Las flags evitan repetir la accion primaria cuando ya hubo long press.
@@ -68,20 +104,36 @@ uint8_t key_esc_skip_next = FALSE;
 
 fmx_ack_t fmx_rate_status = FMX_ACK_RATE_OFF;
 
-static uint16_t rate_tick_new;
+static ULONG gate_ticks = GATE_TICKS_IDLE;
+
+// Linea de tiempo LSE del ultimo FMX_MeasureWake, origen de la latencia.
+static volatile uint32_t wake_lse;
+static fmx_latency_t latency;
 
 
 // --- Static Prototypes ---
-// Normaliza contadores de caudal antes de refrescar la GUI.
-static void PulseUpdate(void);
+// Normaliza contadores de caudal y publica la medicion de la ventana.
+static ULONG PulseUpdate(uint8_t close_now);
+// Suma una demora al histograma de latencia.
+static void LatencyAdd(int32_t lse_ticks);
+// Simbolos POINT y BATCH segun la ultima medicion publicada.
+static void SymbolsRefresh(void);
+// Elige la proxima ventana segun la frecuencia medida.
+static ULONG GateTicksSelect(uint32_t pulses, uint32_t lse_ticks);
 // Temporizador de backlight evita parpadeos notables.
 static void TimerEntryBackLightOff(ULONG timer_key);
 // Temporizador de rebote cumple REQ-FMX-DEBOUNCE-003.
 static void TimerEntryDebounce(ULONG timer_key);
 // Temporizador de long press evita bloquear otras tareas.
 static void TimerEntryKeyThreeSeconds(ULONG timer_key);
-// Hilo principal coordina el estado de caudal y las colas ThreadX.
+// Hilo principal coordina menus, teclas y la cola de eventos.
 static void ThreadEntryMain(ULONG thread_input);
+// Hilo de medicion, despertado por gate o por FMX_MeasureWake.
+static void ThreadEntryMeasure(ULONG thread_input);
+// Avisos del planificador de despertares.
+static void WakeMeasure(void);
+static void WakeLogCredit(void);
+static void WakeBluetooth(void);
 
 // --- Public API ---
 
@@ -126,6 +178,44 @@ UINT FMX_Init(VOID *memory_ptr)
         while (1);
     }
 
+    ret_status = tx_mutex_create(&measure_mutex, "MEASURE_MUTEX", TX_INHERIT);
+    if (ret_status != TX_SUCCESS) {
+        FM_DEBUG_LedError(1);
+        while (1);
+    }
+
+    ret_status = tx_event_flags_create(&measure_flags, "MEASURE_FLAGS");
+    if (ret_status != TX_SUCCESS) {
+        FM_DEBUG_LedError(1);
+        while (1);
+    }
+
+    ret_status = tx_byte_allocate(byte_pool,
+                                (VOID**)&pointer,
+                                FMX_MEASURE_STACK_SIZE,
+                                TX_NO_WAIT);
+    if (ret_status != TX_SUCCESS) {
+        __disable_irq();
+        FM_DEBUG_LedError(1);
+        while (1);
+    }
+
+    ret_status = tx_thread_create(&measure_thread,
+                                  "MEASURE_THREAD",
+                                  ThreadEntryMeasure,
+                                  0,
+                                  pointer,
+                                  FMX_MEASURE_STACK_SIZE,
+                                  FMX_THREAD_PRIORITY_5,
+                                  FMX_THRESHOLD_5,
+                                  FMX_SLICE_0,
+                                  TX_AUTO_START);
+    if (ret_status != TX_SUCCESS) {
+        __disable_irq();
+        FM_DEBUG_LedError(1);
+        while (1);
+    }
+
     ret_status = tx_queue_create(&event_queue,
                                  "EVENT_QUEUE",
                                  1,
@@ -178,8 +268,22 @@ UINT FMX_Init(VOID *memory_ptr)
     ret_status = tx_semaphore_create(&bluetooth_slave_semaphore,
                                      "BT_SLAVE_SEMAPHORE",
                                      0);
+
+    // Todo el trabajo periodico despierta por un unico timer, ver fmx_wake.c.
+    ret_status = FMX_WAKE_Init();
+    if (ret_status != TX_SUCCESS) {
+        FM_DEBUG_LedError(1);
+        return TX_TIMER_ERROR;
+    }
+    FMX_WAKE_Register(FMX_WAKE_MEASURE, WakeMeasure);
+    FMX_WAKE_Register(FMX_WAKE_LCD, FMX_RefreshEventTrue);
+    FMX_WAKE_Register(FMX_WAKE_LOG_CREDIT, WakeLogCredit);
+    FMX_WAKE_Register(FMX_WAKE_BT, WakeBluetooth);
+    FMX_WAKE_Schedule(FMX_WAKE_LOG_CREDIT, LOG_CREDIT_PERIOD, LOG_CREDIT_PERIOD, LOG_CREDIT_SLACK);
+
     FM_CMD_RtosInit(memory_ptr);
     FM_USART_RtosInit(memory_ptr);
+    FM_PCF8553_RtosInit();
 
     ret_status = tx_byte_allocate(byte_pool,
                                 (VOID**)&pointer,
@@ -250,44 +354,195 @@ void FMX_Trigger_BluetoothSlave(void)
     tx_semaphore_put(&bluetooth_slave_semaphore);
 }
 
+/**
+ * @brief Marca el segundo de la cuenta regresiva Bluetooth.
+ * @details Arranca o detiene el aviso de FMX_WAKE_BT, que comparte el
+ * despertar del segundo del RTC con el resto del trabajo periodico.
+ * @param enable 1 para avisar cada segundo, 0 para detener.
+ */
+void FMX_BluetoothTickSet(uint8_t enable)
+{
+    if (enable) {
+        FMX_WAKE_Schedule(FMX_WAKE_BT, TICKS_PER_SECOND, TICKS_PER_SECOND, TICKS_PER_SECOND / 2u);
+    } else {
+        FMX_WAKE_Cancel(FMX_WAKE_BT);
+        // Un aviso ya entregado no debe arrancar otra conexion.
+        while (tx_semaphore_get(&bluetooth_slave_semaphore, TX_NO_WAIT) == TX_SUCCESS);
+    }
+}
+
+/**
+ * @brief Despierta al hilo de medicion para cerrar la ventana en curso.
+ * @details Se puede llamar desde una ISR. La demora hasta publicar la
+ * medicion se registra en el histograma de latencia.
+ */
+void FMX_MeasureWake(void)
+{
+    wake_lse = FMX_CAPTURE_TimeGet();
+    tx_event_flags_set(&measure_flags, MEASURE_FLAG_CLOSE, TX_OR);
+}
+
+/**
+ * @brief Toma el mutex del pipeline de medicion.
+ * @details Los menus lo toman para resetear ACM/TTL o cambiar factores y
+ * unidades sin mezclarse con un FM_FMC_PulseAdd del hilo de medicion.
+ */
+void FMX_MeasureLock(void)
+{
+    tx_mutex_get(&measure_mutex, TX_WAIT_FOREVER);
+}
+
+/**
+ * @brief Libera el mutex del pipeline de medicion.
+ */
+void FMX_MeasureUnlock(void)
+{
+    tx_mutex_put(&measure_mutex);
+}
+
+/**
+ * @brief Copia el histograma de latencia de las ventanas de medicion.
+ * @param dst Destino de la copia.
+ */
+void FMX_LatencyGet(fmx_latency_t *dst)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    *dst = latency;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Limpia el histograma de latencia, por ejemplo antes de un ensayo.
+ */
+void FMX_LatencyReset(void)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    memset(&latency, 0, sizeof(latency));
+    __set_PRIMASK(primask);
+}
+
 // --- Static Functions ---
 
+/**
+ * @brief Calcula la proxima ventana de medicion.
+ * @param pulses Periodos del sensor en la ultima ventana.
+ * @param lse_ticks Duracion de esos periodos en ticks LSE, con la misma escala.
+ * @return Ventana en ticks de ThreadX entre GATE_TICKS_MIN y GATE_TICKS_MAX.
+ * @details
+ * La ventana debe cubrir GATE_RESOLUTION_LSE ticks para la resolucion pedida y
+ * un periodo del sensor mas 25 % de margen, asi cada ventana cierra con una
+ * captura. A caudal alto gana la resolucion, a caudal bajo el periodo.
+ */
+static ULONG GateTicksSelect(uint32_t pulses, uint32_t lse_ticks)
+{
+    uint32_t gate_lse;
+    uint32_t period_lse;
+    ULONG gate;
+
+    if ((pulses == 0) || (lse_ticks == 0))
+    {
+        return GATE_TICKS_IDLE;
+    }
+
+    period_lse = lse_ticks / pulses;
+    gate_lse = GATE_RESOLUTION_LSE;
+    if ((period_lse + period_lse / 4u) > gate_lse)
+    {
+        gate_lse = period_lse + period_lse / 4u;
+    }
+
+    gate = (ULONG)(((uint64_t)gate_lse * TICKS_PER_SECOND + LSE_HZ - 1u) / LSE_HZ);
+    if (gate < GATE_TICKS_MIN)
+    {
+        gate = GATE_TICKS_MIN;
+    }
+    else if (gate > GATE_TICKS_MAX)
+    {
+        gate = GATE_TICKS_MAX;
+    }
+
+    return gate;
+}
+
 /**
  * @brief Actualiza pulsos y caudal antes de ejecutar los calculos.
+ * @param close_now Cierra la ventana antes del gate, pedido por FMX_MeasureWake.
+ * @return Ticks de ThreadX que faltan para cerrar la ventana actual.
+ * @details
+ * La ventana (gate_ticks) se adapta a la frecuencia de pulsos, ver
+ * GateTicksSelect. El LPDMA registra cada flanco en fmx_capture.c; aqui se
+ * drena el anillo en cada llamada y al cerrar la ventana se toma la
+ * regresion para el caudal y LPTIM4 para el volumen.
+ * Un cierre anticipado respeta GATE_TICKS_MIN; la regresion usa la duracion
+ * real de la ventana, por lo que el caudal no se sesga.
+ * Corre en el hilo de medicion con measure_mutex tomado.
  */
-static void PulseUpdate(void)
+static ULONG PulseUpdate(uint8_t close_now)
 {
-    static uint8_t blink = 1;
     // Variables para calcular de pulsos del sensor primario acumulados en ultimo intervalo.
-    static uint16_t vol_pulse_old;
-    static uint16_t vol_pulse_new;
-    static uint16_t vol_pulse_delta;
-    // Variables para calcular los pulsos del LSE acumulados en ultimo intervalo.
-    static uint16_t rate_tick_old;
-    static uint16_t rate_tick_delta;
+    static uint32_t vol_pulse_old;
+    static uint32_t vol_pulse_new;
+    static uint32_t vol_pulse_delta;
+    // Periodos y ticks LSE de la ultima ventana, escalados para el caudal.
+    fmx_capture_window_t window;
     //
     static ULONG time_last;
     static ULONG time_now;
+    // Linea de tiempo LSE al abrir la ventana, para medir la latencia.
+    static uint32_t window_lse;
+    static uint8_t window_lse_valid;
+    uint32_t window_lse_prev;
+    uint32_t deadline_lse;
+    ULONG elapsed;
+
+    FMX_CAPTURE_Drain();
 
-  	// Si no paso un segundo no se calcula nuevo caudal o volumen.
+  	// Si no cerro la ventana no se calcula nuevo caudal o volumen.
 	time_now = tx_time_get();
-  	if ((time_now - time_last) < TICKS_PER_SECOND)
+	elapsed = time_now - time_last;
+  	if ((elapsed < gate_ticks) && !(close_now && (elapsed >= GATE_TICKS_MIN)))
     {
-    	return;
+    	return (gate_ticks - elapsed);
     }
 	time_last = time_now;
 
+	// La latencia se cuenta desde el cierre programado o desde el pedido.
+	if (elapsed >= gate_ticks)
+	{
+		deadline_lse = window_lse + (uint32_t)((gate_ticks * LSE_HZ) / TICKS_PER_SECOND);
+	}
+	else
+	{
+		deadline_lse = wake_lse;
+	}
+	window_lse_prev = window_lse;
+	window_lse = FMX_CAPTURE_TimeGet();
+
+    // Pulsos del sensor primario para el volumen, contados por LPTIM4.
+    vol_pulse_old = vol_pulse_new;
+    vol_pulse_new = FMX_CAPTURE_PulseCountGet();
+    vol_pulse_delta = (vol_pulse_new - vol_pulse_old);
+
+    // Periodos y duracion para el caudal, por regresion sobre los flancos.
+    window = FMX_CAPTURE_WindowClose();
+
+    // Sin regresion pero con pulsos (anillo desbordado o ancla perdida): caudal
+    // punto a punto con LPTIM4 y la duracion de la ventana.
+    if ((window.pulses == 0) && (vol_pulse_delta != 0) && window_lse_valid &&
+        (vol_pulse_delta < (UINT32_MAX >> FMX_CAPTURE_SCALE_SHIFT)) &&
+        ((window_lse - window_lse_prev) < (UINT32_MAX >> FMX_CAPTURE_SCALE_SHIFT)))
+    {
+        window.pulses = vol_pulse_delta << FMX_CAPTURE_SCALE_SHIFT;
+        window.ticks = (window_lse - window_lse_prev) << FMX_CAPTURE_SCALE_SHIFT;
+    }
 
-    // Pulsos del sensor primario para calcular el rate.
-  	vol_pulse_old = vol_pulse_new;
-  	vol_pulse_new = lptim4_last_capture;
-  	vol_pulse_delta = (vol_pulse_new - vol_pulse_old);
-
-
-	// Pulsos de clock LSE para calcular el rate. Medidos en la ventana de tiempo vol_pulse_delta.
-	rate_tick_old = rate_tick_new;
-	rate_tick_new = lptim3_last_capture;
-	rate_tick_delta = (rate_tick_new - rate_tick_old);
+    gate_ticks = GateTicksSelect(window.pulses, window.ticks);
 
     switch(fmx_rate_status)
     {
@@ -331,33 +586,123 @@ static void PulseUpdate(void)
     	break;
     }
 
-    if (vol_pulse_delta) {
-        FM_LCD_LL_SymbolWrite(FM_LCD_LL_SYM_POINT, blink);
-        blink ^= 1;
-    } else {
-        FM_LCD_LL_SymbolWrite(FM_LCD_LL_SYM_POINT, 0);
+    // Un nuevo arranque de caudal no debe promediarse con el historial previo.
+    if (fmx_rate_status == FMX_ACK_RATE_STARTED)
+    {
+        FM_FMC_RateFilterReset();
     }
 
-    // Estrategia de medicion en bajo consumo:
-    // - LPTIM3 captura flancos con clock LSE de 32.768 kHz en modo continuo.
-    // - LPTIM4 acumula los pulsos que llegan mientras el MCU esta en stop.
-    // Se detecto un bug del STM32U575: LPTIM3 omite la ultima captura tras un
-    // numero par de flancos si el MCU esta en stop.
-    // Mitigacion: habilitar la interrupcion CC1 durante la ventana activa,
-    // copiar LPTIM3/LPTIM4 en el callback y luego deshabilitarla.
-    // Impacto: puede anticipar un wake-up y la lectura de caudal refleja el
-    // ciclo anterior cuando el flujo se detiene.
-    __HAL_LPTIM_ENABLE_IT(&hlptim3, LPTIM_IT_CC1);
-
-
-    FM_LOG_NewEvent(fmx_rate_status);
-
+    FM_FMC_CaptureSet(window.pulses, window.ticks);
     FM_FMC_PulseAdd(vol_pulse_delta);
-    FM_FMC_CaptureSet(vol_pulse_delta, rate_tick_delta);
     FM_FMC_TtlCalc();
     FM_FMC_AcmCalc();
     FM_FMC_RateCalc();
 
+    // Una sola publicacion por ventana; log, LCD, impresora y comandos la leen.
+    FM_FMC_SnapshotPublish(fmx_rate_status, FM_RTC_GetUnixTime());
+
+    FM_LOG_NewEvent(fmx_rate_status);
+    FMX_BATCH_Update(vol_pulse_delta);
+
+    if (window_lse_valid)
+    {
+        LatencyAdd((int32_t)(FMX_CAPTURE_TimeGet() - deadline_lse));
+    }
+    window_lse_valid = 1;
+
+    // La UI solo consume: se le avisa que hay una medicion nueva.
+    FMX_RefreshEventTrue();
+
+    return gate_ticks;
+}
+
+/**
+ * @brief Suma una demora al histograma de latencia.
+ * @param lse_ticks Demora en ticks LSE; 0 o negativa cuenta como a tiempo.
+ * @details El tick de ThreadX (10 ms) puede despertar antes del cierre
+ * calculado en LSE, de ahi las demoras negativas.
+ */
+static void LatencyAdd(int32_t lse_ticks)
+{
+    uint32_t bucket = 0;
+    uint32_t primask;
+
+    if (lse_ticks > 0)
+    {
+        bucket = 32u - __CLZ((uint32_t)lse_ticks);
+        if (bucket >= FMX_LATENCY_BUCKETS)
+        {
+            bucket = FMX_LATENCY_BUCKETS - 1u;
+        }
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    latency.count++;
+    latency.bucket[bucket]++;
+    if ((lse_ticks > 0) && ((uint32_t)lse_ticks > latency.max))
+    {
+        latency.max = (uint32_t)lse_ticks;
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Actualiza los simbolos que dependen de la medicion.
+ * @details
+ * POINT parpadea una vez por ventana con pulsos y BATCH sigue al batch en
+ * curso. Solo el hilo de la UI escribe el buffer del LCD.
+ */
+static void SymbolsRefresh(void)
+{
+    static uint8_t blink = 1;
+    static uint32_t sequence;
+    fm_fmc_snapshot_t snapshot;
+    fmx_batch_state_t batch_state;
+
+    FM_FMC_SnapshotGet(&snapshot);
+    if (snapshot.sequence != sequence)
+    {
+        sequence = snapshot.sequence;
+        // STARTED y ON implican pulsos en la ventana, ver PulseUpdate.
+        if ((snapshot.status == FMX_ACK_RATE_STARTED) || (snapshot.status == FMX_ACK_RATE_ON)) {
+            FM_LCD_LL_SymbolWrite(FM_LCD_LL_SYM_POINT, blink);
+            blink ^= 1;
+        } else {
+            FM_LCD_LL_SymbolWrite(FM_LCD_LL_SYM_POINT, 0);
+        }
+    }
+
+    batch_state = FMX_BATCH_StatusGet().state;
+    FM_LCD_LL_SymbolWrite(FM_LCD_LL_SYM_BATCH,
+                          (batch_state != FMX_BATCH_IDLE) && (batch_state != FMX_BATCH_DONE));
+}
+
+/**
+ * @brief Aviso del planificador: vence la ventana o el drenado de la captura.
+ */
+static void WakeMeasure(void)
+{
+    tx_event_flags_set(&measure_flags, MEASURE_FLAG_TIMER, TX_OR);
+}
+
+/**
+ * @brief Aviso del planificador: recarga de creditos de log.
+ * @details Se resuelve en el hilo de medicion, el mismo que consume los
+ * creditos en FM_LOG_POLICY_Step.
+ */
+static void WakeLogCredit(void)
+{
+    tx_event_flags_set(&measure_flags, MEASURE_FLAG_CREDIT, TX_OR);
+}
+
+/**
+ * @brief Aviso del planificador: un segundo de la cuenta regresiva Bluetooth.
+ * @details El techo de 1 evita acumular segundos si el hilo se demora.
+ */
+static void WakeBluetooth(void)
+{
+    tx_semaphore_ceiling_put(&bluetooth_slave_semaphore, 1);
 }
 
 /**
@@ -432,6 +777,11 @@ static void ThreadEntryMain(ULONG thread_input)
     uint8_t 	menu_change;
     UINT 		tx_status;
     ULONG 		sleep_time = 1000;
+    ULONG 		refresh_ticks = 0;
+    uint32_t 	blink_ms;
+
+    // Este hilo es el unico que dibuja; los demas le mandan FMX_EVENT_MENU_REFRESH.
+    FM_PCF8553_OwnerSet();
 
     HAL_GPIO_WritePin(LED_BACKLIGHT_GPIO_Port,
                           LED_BACKLIGHT_Pin,
@@ -446,7 +796,6 @@ static void ThreadEntryMain(ULONG thread_input)
 
     for (;;) {
         sleep_time = 1000;
-        PulseUpdate();
 
         if ((received_event >= FMX_EVENT_MENU_REFRESH) &&
             (received_event < FMX_EVENT_TIME_OUT)) {
@@ -480,11 +829,27 @@ static void ThreadEntryMain(ULONG thread_input)
             sleep_time = global_menu_refresh;
         }
 
+        SymbolsRefresh();
         FM_LCD_LL_Refresh();
 
+        // El redibujo periodico lo despierta el planificador, junto al resto.
+        // Con parpadeo por software se despierta justo en el borde de fase.
+        blink_ms = FM_LCD_LL_BlinkWait();
+        if (blink_ms != 0) {
+            if (blink_ms < sleep_time) {
+                sleep_time = blink_ms;
+            }
+            refresh_ticks = 0;
+            FMX_WAKE_Schedule(FMX_WAKE_LCD, (sleep_time + 9) / 10, 0, 0);
+        } else if ((sleep_time / 10) != refresh_ticks) {
+            refresh_ticks = sleep_time / 10;
+            FMX_WAKE_Schedule(FMX_WAKE_LCD, refresh_ticks, refresh_ticks,
+                              refresh_ticks / LCD_SLACK_DIV);
+        }
+
         tx_status = tx_queue_receive(&event_queue,
                                      &received_event,
-                                     sleep_time / 10);
+                                     TX_WAIT_FOREVER);
 
         if (tx_status != TX_SUCCESS) {
             received_event = FMX_EVENT_MENU_REFRESH;
@@ -499,6 +864,50 @@ static void ThreadEntryMain(ULONG thread_input)
     }
 }
 
+/**
+ * @brief Punto de entrada del hilo de medicion.
+ * @param thread_input Parametro del hilo sin uso.
+ * @details
+ * Duerme hasta el cierre de la ventana, o como maximo MEASURE_WAKE_MAX (menos
+ * a caudal alto) para drenar el anillo de captura, o hasta un FMX_MeasureWake. El cierre lo
+ * programa en el planificador con holgura, para compartir el despertar con
+ * la UI y el resto del trabajo periodico. Tiene mas prioridad que la UI:
+ * menus, teclas o una transferencia SPI del LCD no demoran la medicion.
+ */
+static void ThreadEntryMeasure(ULONG thread_input)
+{
+    ULONG flags = 0;
+    ULONG wait;
+    uint64_t drain;
+
+    for (;;) {
+        // Creditos de log en el mismo hilo que los consume.
+        if (flags & MEASURE_FLAG_CREDIT) {
+            FM_LOG_POLICY_Timer(LOG_CREDIT_PERIOD / TICKS_PER_SECOND);
+        }
+
+        FMX_MeasureLock();
+        wait = PulseUpdate((flags & MEASURE_FLAG_CLOSE) != 0);
+        FMX_MeasureUnlock();
+
+        if (wait > MEASURE_WAKE_MAX) {
+            wait = MEASURE_WAKE_MAX;
+        }
+        drain = ((uint64_t)FMX_CAPTURE_DrainTimeGet() * TICKS_PER_SECOND) / LSE_HZ;
+        if (wait > drain) {
+            wait = (drain != 0) ? (ULONG)drain : 1u;
+        }
+        FMX_WAKE_Schedule(FMX_WAKE_MEASURE, wait, 0, wait / MEASURE_SLACK_DIV);
+
+        flags = 0;
+        tx_event_flags_get(&measure_flags,
+                           MEASURE_FLAGS_ALL,
+                           TX_OR_CLEAR,
+                           &flags,
+                           TX_WAIT_FOREVER);
+    }
+}
+
 // --- Interrupts ---
 
 /**
@@ -597,24 +1006,6 @@ void HAL_GPIO_EXTI_Rising_Callback(uint16_t GPIO_Pin)
     tx_timer_activate(&key_long_timer);
 }
 
-/**
- * @brief Callback de captura de LPTIM para medir caudal.
- * @param hlptim Puntero al handle de LPTIM.
- * @details
- * El front-end del pickup conecta al canal 1 de LPTIM3 en modo captura.
- * El modulo se habilita ~cada segundo para esperar el siguiente flanco.
- * Cada captura entrega:
- * - los ticks del LPTIM3 (32.768 kHz) transcurridos durante la ventana.
- * - los pulsos acumulados en LPTIM4 para caudal y volumen.
- * Esta combinacion mantiene la precision (<0.01%) sin sacrificar bajo consumo.
- */
-void HAL_LPTIM_IC_CaptureCallback(LPTIM_HandleTypeDef *hlptim)
-{
-	__HAL_LPTIM_DISABLE_IT(hlptim, LPTIM_IT_CC1);
-    lptim3_last_capture = LPTIM3->CCR1;
-    lptim4_last_capture = LPTIM4->CNT;
-}
-
 /*** END OF FILE ***/
 
 
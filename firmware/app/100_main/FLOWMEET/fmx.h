@@ -52,6 +52,14 @@ typedef ULONG fmx_events_t;
 #define FMX_THRESHOLD_10            (10u)
 // No time slice to avoid menu jitter.
 #define FMX_SLICE_0                 (0u)
+// The measurement thread only drains the capture ring and runs FM_FMC_*.
+#define FMX_MEASURE_STACK_SIZE      (1024u * 4u)
+// Measurement preempts the UI, command and BT threads.
+#define FMX_THREAD_PRIORITY_5       (5u)
+#define FMX_THRESHOLD_5             (5u)
+
+// Latency histogram: bucket 0 is on time, bucket k counts [2^(k-1), 2^k) LSE ticks.
+#define FMX_LATENCY_BUCKETS         (16u)
 
 // --- Public Types ---
 
@@ -94,8 +102,19 @@ typedef enum {
 	FMX_ACK_RATE_STOPED,
 	FMX_ACK_RATE_CHANGE,
 	FMX_ACK_TICKET,
+	FMX_ACK_BATCH_DONE,
 }fmx_ack_t;
 
+/**
+ * Delay between the scheduled close of a measurement window and the moment
+ * its snapshot is published, in LSE ticks (30.5 us).
+ */
+typedef struct {
+    uint32_t count;                          ///< Windows measured.
+    uint32_t max;                            ///< Worst latency seen.
+    uint32_t bucket[FMX_LATENCY_BUCKETS];    ///< Log2 histogram, last bucket open ended.
+} fmx_latency_t;
+
 
 
 
@@ -133,6 +152,32 @@ void FMX_RefreshEventTrue(void);
  */
 void FMX_Trigger_BluetoothSlave(void);
 
+/**
+ * Starts (1) or stops (0) the one-second Bluetooth countdown tick.
+ * @details Ticks arrive on the BT semaphore, aligned with the other periodic
+ * work by the wake scheduler.
+ */
+void FMX_BluetoothTickSet(uint8_t enable);
+
+/**
+ * Wakes the measurement thread ahead of its next window deadline.
+ * @details Safe to call from ISRs; sets an event flag.
+ */
+void FMX_MeasureWake(void);
+
+/**
+ * Serializes changes to the FM_FMC totalizer against the measurement thread.
+ * @details Other threads hold it around resets and configuration setters.
+ */
+void FMX_MeasureLock(void);
+void FMX_MeasureUnlock(void);
+
+/**
+ * Copies or clears the window latency histogram.
+ */
+void FMX_LatencyGet(fmx_latency_t *latency);
+void FMX_LatencyReset(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,270 @@
+/**
+ * @file fmx_batch.c
+ * @brief Batch de volumen con corte exacto por compare-match de LPTIM4.
+ *
+ * El operador programa un volumen; se convierte a pulsos del sensor y el
+ * compare de LPTIM4 (CCR1) interrumpe en el pulso exacto del objetivo, en
+ * lugar de esperar al cierre de la ventana de medicion (hasta 8 s).
+ * @details
+ * - LPTIM4 cuenta los pulsos del sensor con el LSE como reloj de kernel, por
+ *   lo que el compare funciona y despierta al MCU en stop 2.
+ * - CCR1 tiene 16 bits: el match se repite en cada vuelta del contador y la
+ *   ISR compara contra el conteo de 32 bits de fmx_capture.
+ * - Con pre-cierre hay dos etapas: el primer match llama a
+ *   FMX_BATCH_PreCloseCallback y rearma CCR1 con el objetivo final.
+ * - Las valvulas se accionan desde la ISR, que tambien cierra la ventana de
+ *   medicion con FMX_MeasureWake; log y sobrepaso se resuelven en
+ *   FMX_BATCH_Update desde el hilo de medicion. El simbolo BATCH lo escribe
+ *   la UI a partir de FMX_BATCH_StatusGet.
+ * - El sobrepaso es la cantidad de pulsos despues del objetivo hasta que una
+ *   ventana completa no registra pulsos (valvula cerrada).
+ */
+
+// --- Includes ---
+#include "fmx_batch.h"
+#include "fmx_capture.h"
+#include "fm_debug.h"
+#include "fm_log.h"
+#include "lptim.h"
+#include <string.h>
+
+// --- Static Data ---
+static volatile fmx_batch_state_t state = FMX_BATCH_IDLE;
+static uint32_t start;          // Conteo de LPTIM4 al iniciar el batch.
+static uint32_t pre_close_at;   // Conteo absoluto del pre-cierre.
+static uint32_t target_at;      // Conteo absoluto del objetivo.
+static uint32_t target_read;    // Conteo leido en la ISR al llegar al objetivo.
+static fmx_batch_status_t status;
+
+// --- Static Prototypes ---
+static void    CompareArm(uint32_t count);
+static void    CompareIrqSet(uint8_t enable);
+static void    StageCheck(void);
+static uint8_t Reached(uint32_t now, uint32_t at);
+static void    WaitFlag(uint32_t flag);
+
+// --- Public API ---
+
+/**
+ * @brief Programa un batch y abre la primera etapa.
+ * @param volume Volumen a despachar en la unidad activa (x1000).
+ * @param pre_close Volumen restante al pasar a la segunda etapa; 0 sin pre-cierre.
+ * @return FMX_STATUS_OK, FMX_STATUS_BUSY con un batch en curso, o
+ *         FMX_STATUS_INVALIDA_PARAM si el volumen no llega a un pulso.
+ */
+fmx_status_t FMX_BATCH_Start(ufp3_t volume, ufp3_t pre_close)
+{
+    uint32_t target;
+    uint32_t margin = 0;
+    uint32_t primask;
+
+    if ((state == FMX_BATCH_RUNNING) || (state == FMX_BATCH_PRE_CLOSED))
+    {
+        return FMX_STATUS_BUSY;
+    }
+
+    target = FM_FMC_VolumeToPulses(volume);
+    if (pre_close != 0)
+    {
+        margin = FM_FMC_VolumeToPulses(pre_close);
+    }
+    if ((target == 0) || (margin >= target))
+    {
+        return FMX_STATUS_INVALIDA_PARAM;
+    }
+
+    memset(&status, 0, sizeof(status));
+    status.target = target;
+    status.pre_close = (margin != 0) ? (target - margin) : 0;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    start = FMX_CAPTURE_PulseCountGet();
+    target_at = start + target;
+    pre_close_at = start + status.pre_close;
+    state = FMX_BATCH_RUNNING;
+
+    __HAL_LPTIM_CLEAR_FLAG(&hlptim4, LPTIM_FLAG_CC1);
+    CompareArm((status.pre_close != 0) ? pre_close_at : target_at);
+    CompareIrqSet(1);
+
+    // Si el objetivo paso mientras se sincronizaba CCR1 no habra match.
+    StageCheck();
+
+    __set_PRIMASK(primask);
+
+    return FMX_STATUS_OK;
+}
+
+/**
+ * @brief Cancela el batch en curso y cierra la valvula.
+ */
+void FMX_BATCH_Stop(void)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if ((state == FMX_BATCH_RUNNING) || (state == FMX_BATCH_PRE_CLOSED))
+    {
+        CompareIrqSet(0);
+        FMX_BATCH_CloseCallback();
+    }
+    state = FMX_BATCH_IDLE;
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Seguimiento del batch en cada ventana de medicion.
+ * @param pulse_delta Pulsos de LPTIM4 en la ventana que cerro.
+ * @details
+ * Mantiene el conteo parcial. Tras el corte espera una ventana sin pulsos
+ * para medir el sobrepaso y registrar el evento.
+ */
+void FMX_BATCH_Update(uint32_t pulse_delta)
+{
+    uint32_t now;
+
+    if ((state == FMX_BATCH_IDLE) || (state == FMX_BATCH_DONE))
+    {
+        return;
+    }
+
+    now = FMX_CAPTURE_PulseCountGet();
+    status.count = now - start;
+
+    if ((state == FMX_BATCH_SETTLING) && (pulse_delta == 0))
+    {
+        status.isr_overshoot = target_read - target_at;
+        status.overshoot = now - target_at;
+        status.overshoot_volume = FM_FMC_PulsesToVolume(status.overshoot);
+        state = FMX_BATCH_DONE;
+        FM_LOG_NewEvent(FMX_ACK_BATCH_DONE);
+    }
+}
+
+/**
+ * @brief Devuelve una copia del estado del batch.
+ */
+fmx_batch_status_t FMX_BATCH_StatusGet(void)
+{
+    status.state = state;
+    return status;
+}
+
+/**
+ * @brief Cierra la primera etapa de una valvula de dos etapas.
+ * @note Se ejecuta en la ISR de LPTIM4. La placa no tiene salidas de valvula
+ *       asignadas: redefinir para accionarlas.
+ */
+__weak void FMX_BATCH_PreCloseCallback(void)
+{
+}
+
+/**
+ * @brief Cierra la valvula al llegar al objetivo o al cancelar.
+ * @note Se ejecuta en la ISR de LPTIM4 o con interrupciones deshabilitadas.
+ */
+__weak void FMX_BATCH_CloseCallback(void)
+{
+}
+
+// --- Static Functions ---
+
+/*
+ * Carga los 16 bits bajos del conteo en CCR1 y espera CMP1OK (2 a 3 ciclos
+ * del LSE). Hasta ese momento el compare anterior sigue vigente.
+ */
+static void CompareArm(uint32_t count)
+{
+    __HAL_LPTIM_CLEAR_FLAG(&hlptim4, LPTIM_FLAG_CMP1OK);
+    __HAL_LPTIM_COMPARE_SET(&hlptim4, LPTIM_CHANNEL_1, (uint16_t)count);
+    WaitFlag(LPTIM_FLAG_CMP1OK);
+}
+
+// Habilita o deshabilita la interrupcion CC1; DIER se sincroniza con el LSE.
+static void CompareIrqSet(uint8_t enable)
+{
+    __HAL_LPTIM_CLEAR_FLAG(&hlptim4, LPTIM_FLAG_DIEROK);
+    if (enable)
+    {
+        __HAL_LPTIM_ENABLE_IT(&hlptim4, LPTIM_IT_CC1);
+    }
+    else
+    {
+        __HAL_LPTIM_DISABLE_IT(&hlptim4, LPTIM_IT_CC1);
+    }
+    WaitFlag(LPTIM_FLAG_DIEROK);
+}
+
+/*
+ * Avanza las etapas alcanzadas por el conteo actual. Corre en la ISR o con
+ * interrupciones deshabilitadas. Tras rearmar CCR1 vuelve a leer el conteo,
+ * por si el objetivo llego durante la sincronizacion.
+ */
+static void StageCheck(void)
+{
+    uint32_t now;
+
+    now = FMX_CAPTURE_PulseCountGet();
+
+    if ((state == FMX_BATCH_RUNNING) && (status.pre_close != 0) && Reached(now, pre_close_at))
+    {
+        FMX_BATCH_PreCloseCallback();
+        state = FMX_BATCH_PRE_CLOSED;
+        CompareArm(target_at);
+        now = FMX_CAPTURE_PulseCountGet();
+    }
+
+    if (((state == FMX_BATCH_RUNNING) || (state == FMX_BATCH_PRE_CLOSED)) && Reached(now, target_at))
+    {
+        FMX_BATCH_CloseCallback();
+        target_read = now;
+        state = FMX_BATCH_SETTLING;
+        CompareIrqSet(0);
+        FMX_MeasureWake();
+    }
+}
+
+// El conteo de 32 bits da la vuelta: se compara la diferencia con signo.
+static uint8_t Reached(uint32_t now, uint32_t at)
+{
+    return ((int32_t)(now - at) >= 0);
+}
+
+// Espera acotada a ~1 ms de un flag de sincronizacion de LPTIM4.
+static void WaitFlag(uint32_t flag)
+{
+    uint32_t count = SystemCoreClock / 1000u;
+
+    while (!__HAL_LPTIM_GET_FLAG(&hlptim4, flag))
+    {
+        if (--count == 0u)
+        {
+            FM_DEBUG_LedError(1);
+            return;
+        }
+    }
+}
+
+// --- Interrupts ---
+
+/**
+ * @brief Callback de compare-match de los LPTIM.
+ * @param hlptim Puntero al handle de LPTIM.
+ * @details
+ * El match de CCR1 se repite cada 65536 pulsos; StageCheck descarta los que
+ * no corresponden al conteo de 32 bits programado.
+ */
+void HAL_LPTIM_CompareMatchCallback(LPTIM_HandleTypeDef *hlptim)
+{
+    if (hlptim->Instance == LPTIM4)
+    {
+        StageCheck();
+    }
+}
+
+/*** END OF FILE ***/
@@ -0,0 +1,48 @@
+/**
+ * @file fmx_batch.h
+ * @brief Batch de volumen con corte exacto por compare-match de LPTIM4.
+ */
+
+#ifndef FMX_BATCH_H_
+#define FMX_BATCH_H_
+
+// --- Includes ---
+#include "main.h"
+#include "fmx.h"
+#include "fm_fmc.h"
+
+// --- Types ---
+
+/** Etapas del batch en curso. */
+typedef enum {
+    FMX_BATCH_IDLE = 0,     ///< Sin batch programado.
+    FMX_BATCH_RUNNING,      ///< Valvula abierta, esperando el pre-cierre o el objetivo.
+    FMX_BATCH_PRE_CLOSED,   ///< Primera etapa cerrada, esperando el objetivo.
+    FMX_BATCH_SETTLING,     ///< Objetivo alcanzado, esperando que el caudal se detenga.
+    FMX_BATCH_DONE,         ///< Batch terminado, sobrepaso registrado.
+} fmx_batch_state_t;
+
+/** Estado y resultado del batch, en pulsos crudos de LPTIM4. */
+typedef struct {
+    fmx_batch_state_t state;
+    uint32_t target;          ///< Pulsos programados desde el inicio.
+    uint32_t pre_close;       ///< Pulsos hasta el pre-cierre (0 sin pre-cierre).
+    uint32_t count;           ///< Pulsos desde el inicio, actualizado por ventana.
+    uint32_t isr_overshoot;   ///< Pulsos entre el objetivo y la lectura en la ISR.
+    uint32_t overshoot;       ///< Pulsos despues del objetivo hasta detenerse el caudal.
+    ufp3_t   overshoot_volume;///< overshoot en la unidad de volumen activa (x1000).
+} fmx_batch_status_t;
+
+// --- API ---
+fmx_status_t       FMX_BATCH_Start(ufp3_t volume, ufp3_t pre_close);
+void               FMX_BATCH_Stop(void);
+void               FMX_BATCH_Update(uint32_t pulse_delta);
+fmx_batch_status_t FMX_BATCH_StatusGet(void);
+
+// Acciones sobre las valvulas, se ejecutan en la ISR de LPTIM4.
+void FMX_BATCH_PreCloseCallback(void);
+void FMX_BATCH_CloseCallback(void);
+
+#endif /* FMX_BATCH_H_ */
+
+/*** END OF FILE ***/
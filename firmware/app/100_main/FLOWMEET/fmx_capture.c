@@ -0,0 +1,391 @@
+/**
+ * @file fmx_capture.c
+ * @brief Captura de flancos del sensor por LPDMA y estimacion de frecuencia.
+ *
+ * LPTIM3 CH1 captura cada flanco del sensor con el LSE de 32.768 kHz y el
+ * LPDMA1 copia CCR1 a un anillo circular en SRAM4, sin despertar al MCU.
+ * Al cerrar cada ventana la frecuencia sale de la pendiente por minimos
+ * cuadrados de todos los flancos, no solo del primero y el ultimo.
+ * @details
+ * - El LPDMA1 en stop 2 solo accede a SRAM4: anillo y nodo viven ahi.
+ * - Las marcas de 16 bits se extienden a 32 bits al drenar el anillo, por eso
+ *   FMX_CAPTURE_Drain debe llamarse con un periodo menor a 2 s (el hilo de
+ *   medicion despierta al menos cada 1 s) y antes de que se llene el anillo,
+ *   ver FMX_CAPTURE_DrainTimeGet.
+ * - Reemplaza la captura por interrupcion CC1 y su rearme por ventana, que
+ *   mitigaba el bug de captura del STM32U575 en stop.
+ */
+
+// --- Includes ---
+#include "fmx_capture.h"
+#include "lptim.h"
+#include "fm_debug.h"
+
+// --- Defines ---
+// 2048 marcas (4 KB) cubren 1.3 s a 1500 Hz, mas que el periodo de drenado.
+#define RING_LENGTH         (2048u)
+// LPTIM4 y LPTIM3 cuentan flancos opuestos: margen antes de dar el anillo por perdido.
+#define RING_MARGIN         (16u)
+#define TIMELINE_WRAP       (65536u)
+// Sin flancos por mas de 16 s se descarta el ultimo flanco como ancla.
+#define ANCHOR_AGE_MAX      (16u * 32768u)
+
+// --- Static Data ---
+static uint16_t capture_ring[RING_LENGTH] __attribute__((section(".SRAM4_Section")));
+static DMA_NodeTypeDef capture_node __attribute__((section(".SRAM4_Section")));
+static DMA_QListTypeDef capture_queue;
+static DMA_HandleTypeDef capture_dma;
+
+// Vueltas de LPTIM3 (cada 2 s) y LPTIM4 (cada 65536 pulsos).
+static volatile uint16_t lptim3_overflow;
+static volatile uint16_t lptim4_overflow;
+
+static uint16_t ring_read;      // Proxima marca a leer.
+static uint32_t drain_time;     // Linea de tiempo LSE en el ultimo drenado.
+static uint32_t drain_pulses;   // Pulsos LPTIM4 en el ultimo drenado.
+static uint32_t drain_fill;     // Ticks LSE hasta medio anillo, al ritmo del ultimo drenado.
+static uint8_t  timeline_ready; // LPTIM3 cuenta y su ARRM esta habilitado.
+
+// Regresion de la ventana en curso: t_i = t_0 + T * i, con t relativo al ancla.
+static uint8_t  anchor_valid;
+static uint32_t anchor_time;
+static uint32_t last_time;
+static uint32_t edges;
+static uint64_t sum_i;
+static uint64_t sum_t;
+static uint64_t sum_ii;
+static uint64_t sum_it;
+
+// --- Static Prototypes ---
+static void     DmaInit(void);
+static void     EdgeAdd(uint32_t time);
+static void     WindowRestart(uint32_t time);
+static uint32_t TimelineExtend(LPTIM_TypeDef *lptim, uint16_t count, uint16_t overflow);
+static uint32_t TimelineRead(LPTIM_TypeDef *lptim, volatile uint16_t *overflow);
+
+// --- Public API ---
+
+/**
+ * @brief Arranca la captura de LPTIM3 por LPDMA y la extension a 32 bits.
+ * @details
+ * LPTIM4 ya debe estar contando. Habilita el ARRM de LPTIM3 y LPTIM4 para
+ * contar vueltas; es la unica interrupcion de la captura.
+ */
+void FMX_CAPTURE_Init(void)
+{
+    DmaInit();
+
+    if (HAL_LPTIM_IC_Start_DMA(&hlptim3,
+                               LPTIM_CHANNEL_1,
+                               (uint32_t *)capture_ring,
+                               sizeof(capture_ring)) != HAL_OK)
+    {
+        FM_DEBUG_LedError(1);
+    }
+
+    // Sin NVIC del LPDMA: el anillo se llena sin despertar al MCU.
+    __HAL_DMA_DISABLE_IT(&capture_dma, DMA_IT_TC | DMA_IT_HT);
+
+    __HAL_LPTIM_ENABLE_IT(&hlptim3, LPTIM_IT_ARRM);
+    __HAL_LPTIM_ENABLE_IT(&hlptim4, LPTIM_IT_ARRM);
+    timeline_ready = 1;
+}
+
+/**
+ * @brief Lee las marcas nuevas del anillo y las suma a la regresion.
+ * @details
+ * Cada marca de 16 bits se ubica en la linea de tiempo contando hacia atras
+ * desde el valor actual de LPTIM3. Si se perdio informacion (mas de 2 s sin
+ * drenar o el anillo se sobrescribio) la ventana se reinicia.
+ */
+void FMX_CAPTURE_Drain(void)
+{
+    uint32_t now;
+    uint32_t pulses;
+    uint16_t write;
+    uint16_t mark;
+
+    // El indice del DMA se lee antes que el tiempo: toda marca es anterior a now.
+    write = (RING_LENGTH - (__HAL_DMA_GET_COUNTER(&capture_dma) / sizeof(uint16_t))) % RING_LENGTH;
+    now = TimelineRead(LPTIM3, &lptim3_overflow);
+    pulses = TimelineRead(LPTIM4, &lptim4_overflow);
+
+    if (((now - drain_time) >= TIMELINE_WRAP) ||
+        ((pulses - drain_pulses) >= (RING_LENGTH - RING_MARGIN)))
+    {
+        ring_read = write;
+        anchor_valid = 0;
+    }
+
+    // Ritmo de flancos desde el drenado anterior, para el proximo drenado.
+    drain_fill = UINT32_MAX;
+    if (pulses != drain_pulses)
+    {
+        drain_fill = (uint32_t)(((uint64_t)(now - drain_time) * (RING_LENGTH / 2u)) /
+                                (pulses - drain_pulses));
+    }
+    drain_time = now;
+    drain_pulses = pulses;
+
+    while (ring_read != write)
+    {
+        mark = capture_ring[ring_read];
+        EdgeAdd(now - (uint16_t)((uint16_t)now - mark));
+        ring_read = (ring_read + 1u) % RING_LENGTH;
+    }
+}
+
+/**
+ * @brief Ticks LSE en que los flancos llenan medio anillo.
+ * @return Al ritmo medido entre los dos ultimos drenados; UINT32_MAX sin flancos.
+ * @details
+ * Drenar antes de ese plazo deja medio anillo de margen para que el caudal
+ * se duplique entre dos drenados sin perder la ventana.
+ */
+uint32_t FMX_CAPTURE_DrainTimeGet(void)
+{
+    return drain_fill;
+}
+
+/**
+ * @brief Devuelve el conteo de pulsos de LPTIM4 extendido a 32 bits.
+ */
+uint32_t FMX_CAPTURE_PulseCountGet(void)
+{
+    return TimelineRead(LPTIM4, &lptim4_overflow);
+}
+
+/**
+ * @brief Devuelve la linea de tiempo LSE de LPTIM3 extendida a 32 bits.
+ * @note Misma base de tiempo que las marcas de captura, sirve para medir
+ *       demoras del procesamiento con resolucion de 30.5 us.
+ */
+uint32_t FMX_CAPTURE_TimeGet(void)
+{
+    return TimelineRead(LPTIM3, &lptim3_overflow);
+}
+
+/**
+ * @brief Indica si FMX_CAPTURE_TimeGet ya sigue al LSE.
+ * @note Antes de FMX_CAPTURE_Init LPTIM3 esta detenido y la linea de tiempo
+ *       no avanza.
+ */
+uint8_t FMX_CAPTURE_TimelineReady(void)
+{
+    return timeline_ready;
+}
+
+/**
+ * @brief Cierra la ventana y devuelve periodos y duracion por regresion.
+ * @return Ventana escalada; pulses igual a 0 si no hubo dos flancos.
+ * @details
+ * Con n flancos la pendiente es T = (n*Sit - Si*St) / (n*Sii - Si^2) y la
+ * duracion (n - 1) * T. Con dos flancos coincide con el calculo punto a punto.
+ * El ultimo flanco queda como ancla (i = 0) de la ventana siguiente, asi no
+ * se pierde el tiempo entre ventanas ni a caudal bajo.
+ */
+fmx_capture_window_t FMX_CAPTURE_WindowClose(void)
+{
+    fmx_capture_window_t window = { 0, 0 };
+    uint64_t num;
+    uint64_t den;
+    uint64_t periods;
+    uint64_t ticks;
+
+    if (anchor_valid && (edges >= 2u))
+    {
+        num = edges * sum_it - sum_i * sum_t;
+        den = edges * sum_ii - sum_i * sum_i;
+        periods = (uint64_t)(edges - 1u) << FMX_CAPTURE_SCALE_SHIFT;
+
+        // periods * num / den sin desbordar 64 bits.
+        ticks = periods * (num / den) + (periods * (num % den)) / den;
+
+        window.pulses = (uint32_t)periods;
+        window.ticks = (ticks > UINT32_MAX) ? UINT32_MAX : (uint32_t)ticks;
+
+        WindowRestart(last_time);
+    }
+    else if (anchor_valid && ((drain_time - anchor_time) > ANCHOR_AGE_MAX))
+    {
+        anchor_valid = 0;
+    }
+
+    return window;
+}
+
+// --- Static Functions ---
+
+/**
+ * @brief Configura el LPDMA1 en lista circular de un nodo hacia el anillo.
+ */
+static void DmaInit(void)
+{
+    DMA_NodeConfTypeDef node_config = { 0 };
+
+    __HAL_RCC_LPDMA1_CLK_ENABLE();
+    // En stop 2 el LPDMA1 y la SRAM4 siguen con reloj en modo autonomo.
+    __HAL_RCC_LPDMA1_CLKAM_ENABLE();
+    __HAL_RCC_SRAM4_CLKAM_ENABLE();
+
+    node_config.NodeType = DMA_LPDMA_LINEAR_NODE;
+    node_config.Init.Request = LPDMA1_REQUEST_LPTIM3_IC1;
+    node_config.Init.BlkHWRequest = DMA_BREQ_SINGLE_BURST;
+    node_config.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    node_config.Init.SrcInc = DMA_SINC_FIXED;
+    node_config.Init.DestInc = DMA_DINC_INCREMENTED;
+    node_config.Init.SrcDataWidth = DMA_SRC_DATAWIDTH_HALFWORD;
+    node_config.Init.DestDataWidth = DMA_DEST_DATAWIDTH_HALFWORD;
+    node_config.Init.Priority = DMA_HIGH_PRIORITY;
+    node_config.Init.SrcBurstLength = 1;
+    node_config.Init.DestBurstLength = 1;
+    node_config.Init.TransferEventMode = DMA_TCEM_BLOCK_TRANSFER;
+    node_config.Init.Mode = DMA_NORMAL;
+    node_config.TriggerConfig.TriggerPolarity = DMA_TRIG_POLARITY_MASKED;
+    node_config.DataHandlingConfig.DataAlignment = DMA_DATA_RIGHTALIGN_ZEROPADDED;
+    node_config.DataHandlingConfig.DataExchange = DMA_EXCHANGE_NONE;
+    node_config.SrcAddress = (uint32_t)&LPTIM3->CCR1;
+    node_config.DstAddress = (uint32_t)capture_ring;
+    node_config.DataSize = sizeof(capture_ring);
+
+    if ((HAL_DMAEx_List_BuildNode(&node_config, &capture_node) != HAL_OK) ||
+        (HAL_DMAEx_List_InsertNode(&capture_queue, NULL, &capture_node) != HAL_OK) ||
+        (HAL_DMAEx_List_SetCircularMode(&capture_queue) != HAL_OK))
+    {
+        FM_DEBUG_LedError(1);
+    }
+
+    capture_dma.Instance = LPDMA1_Channel0;
+    capture_dma.InitLinkedList.Priority = DMA_LOW_PRIORITY_LOW_WEIGHT;
+    capture_dma.InitLinkedList.LinkStepMode = DMA_LSM_FULL_EXECUTION;
+    capture_dma.InitLinkedList.LinkAllocatedPort = DMA_LINK_ALLOCATED_PORT0;
+    capture_dma.InitLinkedList.TransferEventMode = DMA_TCEM_BLOCK_TRANSFER;
+    capture_dma.InitLinkedList.LinkedListMode = DMA_LINKEDLIST_CIRCULAR;
+
+    if ((HAL_DMAEx_List_Init(&capture_dma) != HAL_OK) ||
+        (HAL_DMAEx_List_LinkQ(&capture_dma, &capture_queue) != HAL_OK) ||
+        (HAL_DMA_ConfigChannelAttributes(&capture_dma, DMA_CHANNEL_NPRIV) != HAL_OK))
+    {
+        FM_DEBUG_LedError(1);
+    }
+
+    __HAL_LINKDMA(&hlptim3, hdma[LPTIM_DMA_ID_CC1], capture_dma);
+}
+
+/**
+ * @brief Suma un flanco a la regresion de la ventana en curso.
+ * @param time Marca del flanco en la linea de tiempo de 32 bits.
+ */
+static void EdgeAdd(uint32_t time)
+{
+    uint64_t t;
+
+    if (!anchor_valid)
+    {
+        WindowRestart(time);
+        anchor_valid = 1;
+        return;
+    }
+
+    t = time - anchor_time;
+    sum_i += edges;
+    sum_t += t;
+    sum_ii += (uint64_t)edges * edges;
+    sum_it += edges * t;
+    edges++;
+    last_time = time;
+}
+
+/**
+ * @brief Inicia una ventana con time como unico flanco (i = 0).
+ */
+static void WindowRestart(uint32_t time)
+{
+    anchor_time = time;
+    last_time = time;
+    edges = 1;
+    sum_i = 0;
+    sum_t = 0;
+    sum_ii = 0;
+    sum_it = 0;
+}
+
+/**
+ * @brief Arma el valor de 32 bits de un LPTIM a partir de su parte baja.
+ * @param lptim Timer leido, para consultar un ARRM todavia no atendido.
+ * @param count Valor de 16 bits leido del timer.
+ * @param overflow Vueltas contadas por HAL_LPTIM_AutoReloadMatchCallback.
+ * @return Valor extendido a 32 bits.
+ * @details
+ * Si el ARRM esta pendiente y count es bajo, el valor es posterior a la vuelta
+ * que aun no se conto; si count es alto, es previo y overflow ya es correcto.
+ * ARRM se levanta con CNT en ARR, un tick LSE antes de pasar a 0: si la ISR
+ * ya lo atendio y count sigue en ARR, overflow conto una vuelta de mas.
+ */
+static uint32_t TimelineExtend(LPTIM_TypeDef *lptim, uint16_t count, uint16_t overflow)
+{
+    if ((lptim->ISR & LPTIM_FLAG_ARRM) != 0u)
+    {
+        if (count < 0x8000u)
+        {
+            overflow++;
+        }
+    }
+    else if (count == 0xFFFFu)
+    {
+        overflow--;
+    }
+
+    return (((uint32_t)overflow << 16) | count);
+}
+
+/**
+ * @brief Lee CNT de un LPTIM y lo extiende a 32 bits.
+ * @details
+ * Se bloquean las interrupciones para que el ARRM no cambie overflow entre
+ * ambas lecturas. El clock es asincrono: CNT se lee hasta obtener igual valor.
+ */
+static uint32_t TimelineRead(LPTIM_TypeDef *lptim, volatile uint16_t *overflow)
+{
+    uint32_t primask;
+    uint16_t count;
+    uint16_t count_check;
+    uint32_t value;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    do {
+        count = (uint16_t)lptim->CNT;
+        count_check = (uint16_t)lptim->CNT;
+    } while (count != count_check);
+    value = TimelineExtend(lptim, count, *overflow);
+
+    __set_PRIMASK(primask);
+
+    return value;
+}
+
+// --- Interrupts ---
+
+/**
+ * @brief Callback de auto-reload match de los LPTIM.
+ * @param hlptim Puntero al handle de LPTIM.
+ * @details
+ * Cuenta las vueltas de LPTIM3 y LPTIM4 para extender ambos a 32 bits. Es el
+ * unico trabajo en la ISR, el costo en stop 2 es un despertar breve cada 2 s.
+ * LPTIM1 tambien genera ARRM y se ignora.
+ */
+void HAL_LPTIM_AutoReloadMatchCallback(LPTIM_HandleTypeDef *hlptim)
+{
+    if (hlptim->Instance == LPTIM3)
+    {
+        lptim3_overflow++;
+    }
+    else if (hlptim->Instance == LPTIM4)
+    {
+        lptim4_overflow++;
+    }
+}
+
+/*** END OF FILE ***/
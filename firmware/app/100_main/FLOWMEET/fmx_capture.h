@@ -0,0 +1,36 @@
+/**
+ * @file fmx_capture.h
+ * @brief Captura de flancos del sensor por LPDMA y linea de tiempo de LPTIM3/LPTIM4.
+ */
+
+#ifndef FMX_CAPTURE_H_
+#define FMX_CAPTURE_H_
+
+// --- Includes ---
+#include "main.h"
+
+// --- Defines ---
+// Las ventanas se entregan escaladas por 2^FMX_CAPTURE_SCALE_SHIFT para no
+// perder la fraccion de tick que aporta la regresion.
+#define FMX_CAPTURE_SCALE_SHIFT   (8u)
+
+// --- Types ---
+
+/** Resultado de una ventana de medicion, escalado por 2^FMX_CAPTURE_SCALE_SHIFT. */
+typedef struct {
+    uint32_t pulses;   ///< Periodos del sensor contenidos en la ventana.
+    uint32_t ticks;    ///< Duracion de esos periodos en ticks LSE (regresion).
+} fmx_capture_window_t;
+
+// --- API ---
+void                 FMX_CAPTURE_Init(void);
+void                 FMX_CAPTURE_Drain(void);
+uint32_t             FMX_CAPTURE_DrainTimeGet(void);
+uint32_t             FMX_CAPTURE_PulseCountGet(void);
+uint32_t             FMX_CAPTURE_TimeGet(void);
+uint8_t              FMX_CAPTURE_TimelineReady(void);
+fmx_capture_window_t FMX_CAPTURE_WindowClose(void);
+
+#endif /* FMX_CAPTURE_H_ */
+
+/*** END OF FILE ***/
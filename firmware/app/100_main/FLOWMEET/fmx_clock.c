@@ -0,0 +1,290 @@
+/**
+ * @file fmx_clock.c
+ * @brief Perfiles de reloj y tension del nucleo, pedidos por los subsistemas.
+ *
+ * Los trabajos en rafaga (impresion, trafico AT) piden un perfil al empezar y
+ * lo liberan al terminar; cada perfil lleva su cuenta de pedidos y el nucleo
+ * corre en el mayor perfil pedido. Con todo liberado se vuelve a
+ * FMX_CLOCK_IDLE, el reloj de SystemClock_Config: la rafaga termina antes y
+ * el MCU vuelve antes al stop 2.
+ *
+ * El redibujo del LCD y la escritura de la flash no piden perfil: el SCL del
+ * SPI1 queda fijo en 1.5 MHz con el hilo dormido durante el DMA, y el borrado
+ * y la programacion los temporiza el controlador de la flash. Subir el reloj
+ * solo agregaria cambios de MSIS y de escala del regulador.
+ * @details
+ * - Solo se usa el MSIS, sin PLL: el MSIS conserva su rango al salir del
+ *   stop 2 y FMX_LP_Enter/Exit no tiene que rearmar nada. 48 MHz es el
+ *   maximo del MSIS y alcanza con la escala 3 del regulador.
+ * - Al subir se sube primero la tension y la latencia de la flash, despues el
+ *   rango del MSI; al bajar, al reves.
+ * - El SysTick de ThreadX, el timebase de la HAL, el BRR de USART1/USART3 y el
+ *   prescaler del SPI1 del LCD se recalculan en cada cambio: tick, baud rate y
+ *   SCL no cambian con el perfil. LPTIM y RTC usan el LSE.
+ * - El cambio espera a que el SPI y los UART esten libres, en transmision y en
+ *   recepcion: el UART3 tiene la recepcion por DMA siempre armada con el
+ *   MXChip encendido y el cambio apaga UE para escribir BRR. Queda la ventana
+ *   del propio cambio, con interrupciones deshabilitadas.
+ *   El UART3 debe tener el clock habilitado al pedir y liberar COMMS.
+ * - Solo desde hilos o antes de arrancar el scheduler.
+ */
+
+// --- Includes ---
+#include "fmx_clock.h"
+#include "fmx_stats.h"
+#include "fmx_trace.h"
+#include "fm_debug.h"
+#include "usart.h"
+
+// --- Defines ---
+#define TICKS_PER_SECOND   TX_TIMER_TICKS_PER_SECOND
+
+// --- Types ---
+typedef struct {
+    uint32_t msi_range;     // RCC_MSIRANGE_x del MSIS.
+    uint32_t hz;            // SYSCLK = HCLK = PCLKx.
+    uint32_t voltage;       // PWR_REGULATOR_VOLTAGE_SCALEx.
+    uint32_t latency;       // FLASH_LATENCY_x para hz en esa escala.
+    uint32_t spi_prescaler; // SCL del PCF8553 en 1.5 MHz.
+} clock_profile_t;
+
+// --- Extern Data ---
+extern SPI_HandleTypeDef h_spi1;
+
+// --- Static Data ---
+static const clock_profile_t profiles[FMX_CLOCK_END] = {
+    [FMX_CLOCK_IDLE]  = { RCC_MSIRANGE_1, 24000000u, PWR_REGULATOR_VOLTAGE_SCALE4,
+                          FLASH_LATENCY_1, SPI_BAUDRATEPRESCALER_16 },
+    [FMX_CLOCK_COMMS] = { RCC_MSIRANGE_0, 48000000u, PWR_REGULATOR_VOLTAGE_SCALE3,
+                          FLASH_LATENCY_1, SPI_BAUDRATEPRESCALER_32 },
+};
+
+static uint8_t             requests[FMX_CLOCK_END];
+static fmx_clock_profile_t active = FMX_CLOCK_IDLE;
+
+// --- Static Prototypes ---
+static void                Apply(void);
+static fmx_clock_profile_t Target(void);
+static uint8_t             BusIdle(void);
+static uint8_t             UartIdle(const UART_HandleTypeDef *huart);
+static void                Switch(const clock_profile_t *from, const clock_profile_t *to);
+static void                UartRescale(UART_HandleTypeDef *huart, uint32_t hz);
+
+// --- Public API ---
+
+/**
+ * @brief Pide un perfil; el nucleo sube si es mayor que el activo.
+ * @param profile Perfil pedido, se libera con FMX_CLOCK_Release.
+ */
+void FMX_CLOCK_Request(fmx_clock_profile_t profile)
+{
+    uint32_t primask;
+
+    if ((profile >= FMX_CLOCK_END) || (requests[profile] == UINT8_MAX))
+    {
+        FM_DEBUG_LedError(1);
+        return;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    requests[profile]++;
+    __set_PRIMASK(primask);
+
+    Apply();
+}
+
+/**
+ * @brief Libera un pedido; el nucleo baja al mayor perfil que siga pedido.
+ * @param profile Perfil pedido antes con FMX_CLOCK_Request.
+ */
+void FMX_CLOCK_Release(fmx_clock_profile_t profile)
+{
+    uint32_t primask;
+
+    if ((profile >= FMX_CLOCK_END) || (requests[profile] == 0))
+    {
+        FM_DEBUG_LedError(1);
+        return;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    requests[profile]--;
+    __set_PRIMASK(primask);
+
+    Apply();
+}
+
+/**
+ * @brief Perfil con el que corre el nucleo.
+ */
+fmx_clock_profile_t FMX_CLOCK_ProfileGet(void)
+{
+    return active;
+}
+
+/**
+ * @brief Frecuencia del nucleo en un perfil.
+ * @param profile Perfil.
+ * @return SYSCLK en Hz, o 0 si el perfil no existe.
+ */
+uint32_t FMX_CLOCK_HzGet(fmx_clock_profile_t profile)
+{
+    return (profile < FMX_CLOCK_END) ? profiles[profile].hz : 0u;
+}
+
+// --- Static Functions ---
+
+/*
+ * Lleva el nucleo al perfil pedido. Si el SPI o un UART estan transmitiendo se
+ * espera un tick; el objetivo se recalcula porque otro hilo pudo pedir o
+ * liberar mientras tanto.
+ */
+static void Apply(void)
+{
+    fmx_clock_profile_t target;
+    uint32_t primask;
+
+    for (;;)
+    {
+        primask = __get_PRIMASK();
+        __disable_irq();
+
+        target = Target();
+        if (target == active)
+        {
+            __set_PRIMASK(primask);
+            return;
+        }
+        if (BusIdle())
+        {
+            break;
+        }
+
+        __set_PRIMASK(primask);
+        tx_thread_sleep(1);
+    }
+
+    FMX_STATS_ClockSwitch();
+    FMX_TRACE_ClockSwitch();
+    Switch(&profiles[active], &profiles[target]);
+    active = target;
+
+    __set_PRIMASK(primask);
+}
+
+// Mayor perfil con pedidos, o IDLE.
+static fmx_clock_profile_t Target(void)
+{
+    for (uint32_t i = FMX_CLOCK_END - 1u; i > FMX_CLOCK_IDLE; i--)
+    {
+        if (requests[i] != 0)
+        {
+            return (fmx_clock_profile_t)i;
+        }
+    }
+
+    return FMX_CLOCK_IDLE;
+}
+
+// El SPI1 apaga SPE al cerrar cada transferencia.
+static uint8_t BusIdle(void)
+{
+    if ((h_spi1.State != HAL_SPI_STATE_READY) && (h_spi1.State != HAL_SPI_STATE_RESET))
+    {
+        return 0;
+    }
+    if ((h_spi1.Instance != NULL) && (h_spi1.Instance->CR1 & SPI_CR1_SPE))
+    {
+        return 0;
+    }
+
+    return UartIdle(&huart1) && UartIdle(&huart3);
+}
+
+/*
+ * Sin transmision en curso ni byte entrando (BUSY) o sin leer (RXNE). RxState
+ * no sirve: con ReceiveToIdle_DMA queda en BUSY_RX mientras el UART esta
+ * encendido, haya o no trafico.
+ */
+static uint8_t UartIdle(const UART_HandleTypeDef *huart)
+{
+    if ((huart->gState & HAL_UART_STATE_BUSY_TX) == HAL_UART_STATE_BUSY_TX)
+    {
+        return 0;
+    }
+    if ((huart->gState != HAL_UART_STATE_RESET) && (huart->Instance != NULL) &&
+        (READ_BIT(huart->Instance->CR1, USART_CR1_UE) != 0u) &&
+        (READ_BIT(huart->Instance->ISR, USART_ISR_BUSY | USART_ISR_RXNE_RXFNE) != 0u))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Cambio de perfil con interrupciones deshabilitadas. ControlVoltageScaling
+ * espera VOSRDY con un lazo de CPU, sin el tick de la HAL.
+ */
+static void Switch(const clock_profile_t *from, const clock_profile_t *to)
+{
+    if (to->hz > from->hz)
+    {
+        if (HAL_PWREx_ControlVoltageScaling(to->voltage) != HAL_OK)
+        {
+            FM_DEBUG_LedError(1);
+            return;
+        }
+        __HAL_FLASH_SET_LATENCY(to->latency);
+        while (__HAL_FLASH_GET_LATENCY() != to->latency) {}
+    }
+
+    __HAL_RCC_MSI_RANGE_CONFIG(to->msi_range);
+    while (!__HAL_RCC_GET_FLAG(RCC_FLAG_MSIRDY)) {}
+    SystemCoreClockUpdate();
+
+    if (to->hz < from->hz)
+    {
+        __HAL_FLASH_SET_LATENCY(to->latency);
+        while (__HAL_FLASH_GET_LATENCY() != to->latency) {}
+        if (HAL_PWREx_ControlVoltageScaling(to->voltage) != HAL_OK)
+        {
+            FM_DEBUG_LedError(1);
+        }
+    }
+
+    // Tick de ThreadX: LOAD rige desde la proxima recarga, VAL no se puede
+    // escalar (escribirlo lo pone en 0). El tick en curso se corre < 10 ms.
+    SysTick->LOAD = (SystemCoreClock / TICKS_PER_SECOND) - 1u;
+    HAL_InitTick(uwTickPrio);
+
+    UartRescale(&huart1, SystemCoreClock);
+    UartRescale(&huart3, SystemCoreClock);
+
+    if (h_spi1.Instance != NULL)
+    {
+        MODIFY_REG(h_spi1.Instance->CFG1, SPI_CFG1_MBR, to->spi_prescaler);
+        h_spi1.Init.BaudRatePrescaler = to->spi_prescaler;
+    }
+}
+
+// BRR solo se escribe con UE en 0; el kernel clock de USART1/USART3 es SYSCLK.
+static void UartRescale(UART_HandleTypeDef *huart, uint32_t hz)
+{
+    uint32_t enabled;
+
+    if ((huart->gState == HAL_UART_STATE_RESET) || (huart->Init.BaudRate == 0))
+    {
+        return;
+    }
+
+    enabled = READ_BIT(huart->Instance->CR1, USART_CR1_UE);
+    CLEAR_BIT(huart->Instance->CR1, USART_CR1_UE);
+    huart->Instance->BRR = (uint16_t)UART_DIV_SAMPLING16(hz, huart->Init.BaudRate,
+                                                         huart->Init.ClockPrescaler);
+    SET_BIT(huart->Instance->CR1, enabled);
+}
+
+/*** END OF FILE ***/
@@ -0,0 +1,30 @@
+/**
+ * @file fmx_clock.h
+ * @brief Perfiles de reloj y tension del nucleo, pedidos por los subsistemas.
+ */
+
+#ifndef FMX_CLOCK_H_
+#define FMX_CLOCK_H_
+
+// --- Includes ---
+#include "main.h"
+#include "tx_api.h"
+
+// --- Types ---
+
+/** Perfiles ordenados de menor a mayor; gana el mayor con pedidos activos. */
+typedef enum {
+    FMX_CLOCK_IDLE = 0,     ///< MSI 24 MHz, escala 4: el de SystemClock_Config.
+    FMX_CLOCK_COMMS,        ///< MXChip encendido: AT, impresion, BT esclavo.
+    FMX_CLOCK_END,
+} fmx_clock_profile_t;
+
+// --- API ---
+void                FMX_CLOCK_Request(fmx_clock_profile_t profile);
+void                FMX_CLOCK_Release(fmx_clock_profile_t profile);
+fmx_clock_profile_t FMX_CLOCK_ProfileGet(void);
+uint32_t            FMX_CLOCK_HzGet(fmx_clock_profile_t profile);
+
+#endif /* FMX_CLOCK_H_ */
+
+/*** END OF FILE ***/
@@ -28,6 +28,12 @@
  * caso, si se despierta por otro evento, el valor del LPTIM->CNT es el unico valido para
  * actualizar el reloj de ThreadX.
  *
+ * Con la captura en marcha el reloj de ThreadX se ajusta con la linea de tiempo
+ * LSE de LPTIM3 (fmx_capture.c), que nunca se reinicia: cada arranque del LPTIM1
+ * pierde la fase de su prescaler y un despertar por otra interrupcion (ARRM de
+ * LPTIM3 cada 2 s) dejaba de contar hasta 16 ticks LSE. El LPTIM1 queda para
+ * programar el despertar y para medir el tiempo antes de FMX_CAPTURE_Init.
+ *
  *
  * Versión 1
  * Autor: Daniel H Sagarra
@@ -41,6 +47,9 @@
 #include "fmx_lp.h"
 #include "lptim.h"
 #include "fm_debug.h"
+#include "fmx_capture.h"
+#include "fmx_stats.h"
+#include "fmx_trace.h"
 
 // Typedef.
 
@@ -55,13 +64,13 @@ enum
 // Defines.
 #define LSE_CLK 			32768 // Para reloj de sistema se usa el LSE de 32.768Hz
 #define LSE_DIV 			16 // Para reloj de sistema se usa el LSE de 32.768Hz
-#define TX_TICK_PER_SECOND 	100	  // EL ThreadX se ajusta a 64 tick por segundo
+#define TX_TICK_PER_SECOND 	100	  // EL ThreadX se ajusta a 100 tick por segundo
 
 /*
- * Multiplicador para convertir ticks del ThreadX a ticks del LSE. Tambien funciona como divisor
- * para convertir tick del LSE a ticks del ThreadX.
+ * Tramo maximo de un periodo del LPTIM1 (~31.9 s). Deja margen antes del ARR
+ * (65535) para que la lectura de CNT tras el match no vea el contador ya vuelto.
  */
-#define	TICKS_TO_TICKS ((LSE_CLK / LSE_DIV) / TX_TICK_PER_SECOND)
+#define LPTIM_CHUNK_MAX		0xFF00u
 
 // Debug.
 
@@ -73,27 +82,39 @@ enum
 uint16_t lptim1_stop;
 uint16_t lptim1_ticks;
 
+static uint32_t sleep_left;     // Ticks del LPTIM1 que faltan dormir, sin el tramo en curso.
+static uint32_t sleep_elapsed;  // Ticks del LPTIM1 dormidos en tramos ya cerrados.
+static uint32_t tick_rem;       // Resto de tick de ThreadX (327.68 ticks LSE), en 1/LSE_CLK de tick.
+static uint32_t sync_time;      // Linea de tiempo LSE en el ultimo FMX_LP_Adjust.
+static uint32_t sync_ticks;     // Reloj de ThreadX que corresponde a sync_time.
+static uint8_t  sync_valid;     // sync_time y sync_ticks ya siguen a la linea de tiempo.
+static uint8_t  sleep_armed;    // FMX_LP_Setup programo la espera de este stop.
+static uint8_t  stop_hold;      // Pedidos de FMX_LP_StopHold: se usa sleep en lugar de stop 2.
+
 // Private function prototypes.
+static void     ChunkStart(void);
+static uint16_t CountRead(void);
+static uint8_t  OtherIrqPending(void);
+static uint32_t WakeTime(void);
 
 // Private function bodies.
 
-// Public function bodies.
-
 /*
-
- *
- *
- * @param
- * @retval
+ * Programa el compare del LPTIM1 con el proximo tramo, de hasta LPTIM_CHUNK_MAX,
+ * y lo descuenta de sleep_left.
  */
-void FMX_LP_Setup(ULONG count)
+static void ChunkStart(void)
 {
     LPTIM_OC_ConfigTypeDef config =
-    { .OCPolarity = LPTIM_OCPOLARITY_HIGH, .Pulse = 65535 };
+    { .OCPolarity = LPTIM_OCPOLARITY_HIGH, .Pulse = LPTIM_CHUNK_MAX };
 
-    //FM_DEBUG_UartInt32(count);
-    lptim1_ticks = (count * TICKS_TO_TICKS);
-    config.Pulse = (lptim1_ticks);
+    lptim1_ticks = (sleep_left > LPTIM_CHUNK_MAX) ? LPTIM_CHUNK_MAX : (uint16_t)sleep_left;
+    if (lptim1_ticks == 0)
+    {
+        lptim1_ticks = 1;
+    }
+    sleep_left -= (sleep_left > lptim1_ticks) ? lptim1_ticks : sleep_left;
+    config.Pulse = lptim1_ticks;
 
     if (HAL_LPTIM_OC_ConfigChannel(&hlptim1, &config, LPTIM_CHANNEL_1) != HAL_OK)
     {
@@ -102,55 +123,234 @@ void FMX_LP_Setup(ULONG count)
 }
 
 /*
- * @brief
- * @note
- * @param
- * @retval
+ * CNT del LPTIM1 corre con el LSE, asincrono al bus: se lee hasta obtener dos
+ * valores iguales seguidos.
+ */
+static uint16_t CountRead(void)
+{
+    uint16_t count;
+
+    do
+    {
+        count = (uint16_t)LPTIM1->CNT;
+    } while (count != (uint16_t)LPTIM1->CNT);
+
+    return count;
+}
+
+/*
+ * Indica si hay otra interrupcion habilitada pendiente ademas del LPTIM1.
+ * ThreadX llama a FMX_LP_Enter con interrupciones deshabilitadas: las ISR
+ * corren despues de FMX_LP_Exit, por eso se mira el NVIC.
+ */
+static uint8_t OtherIrqPending(void)
+{
+    uint32_t pending;
+
+    for (uint32_t i = 0; i < (sizeof(NVIC->ISER) / sizeof(NVIC->ISER[0])); i++)
+    {
+        pending = NVIC->ISPR[i] & NVIC->ISER[i];
+        if (i == ((uint32_t)LPTIM1_IRQn >> 5))
+        {
+            pending &= ~(1UL << ((uint32_t)LPTIM1_IRQn & 0x1FUL));
+        }
+        if (pending)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Ticks de ThreadX al despertar, para la traza: el reloj de ThreadX todavia
+ * no sumo el tiempo dormido, eso lo hace FMX_LP_Adjust.
+ */
+static uint32_t WakeTime(void)
+{
+    return (uint32_t)(tx_time_get()
+                      + ((uint64_t)sleep_elapsed * LSE_DIV * TX_TICK_PER_SECOND + tick_rem)
+                      / LSE_CLK);
+}
+
+// Public function bodies.
+
+/*
+ * @brief Calcula cuanto dormir hasta el proximo timer de ThreadX.
+ * @param count Ticks de ThreadX hasta la proxima expiracion.
+ * @note  Resta la fraccion de tick ya acumulada en tick_rem y redondea hacia
+ *        arriba: el timer nunca vence antes de tiempo. Con la linea de tiempo
+ *        la espera se cuenta desde el ultimo ajuste, asi descuenta tambien lo
+ *        que ThreadX corrio desde entonces. Sin limite de 16 bits, el tiempo
+ *        se reparte en tramos encadenados en FMX_LP_Enter.
+ */
+void FMX_LP_Setup(ULONG count)
+{
+    uint64_t ticks;
+    uint32_t elapsed = 0;
+    int32_t owed = (int32_t)count;
+
+    if (sync_valid)
+    {
+        owed = (int32_t)(tx_time_get() + count - sync_ticks);
+        elapsed = FMX_CAPTURE_TimeGet() - sync_time;
+    }
+
+    // Ticks LSE desde el ultimo ajuste hasta la expiracion.
+    ticks = (owed > 0) ? ((uint64_t)owed * LSE_CLK) : 0u;
+    ticks = (ticks > tick_rem) ? (ticks - tick_rem) : 0u;
+    ticks = (ticks + TX_TICK_PER_SECOND - 1u) / TX_TICK_PER_SECOND;
+    ticks = (ticks > elapsed) ? (ticks - elapsed) : 1u;
+    ticks = (ticks + LSE_DIV - 1u) / LSE_DIV;
+
+    sleep_left = (ticks > UINT32_MAX) ? UINT32_MAX : (uint32_t)ticks;
+    sleep_armed = 1;
+    ChunkStart();
+}
+
+/*
+ * @brief Entra en stop 2 y encadena tramos del LPTIM1 hasta cumplir la espera.
+ * @note  Se ejecuta con interrupciones deshabilitadas; el WFI despierta igual
+ *        ante una interrupcion pendiente. Si solo vencio un tramo intermedio
+ *        del LPTIM1 se limpia su interrupcion y se vuelve a dormir sin pasar
+ *        por ThreadX. Cualquier otra interrupcion devuelve el control.
+ *        Sin FMX_LP_Setup (ningun timer activo) se duerme el maximo posible,
+ *        igual llevando la cuenta del tiempo.
  */
 void FMX_LP_Enter(void)
 {
     // Antes de ingresar al modo de bajo consumo apago LED_2_ACTIVE.
+    FM_DEBUG_LedActive(0);
 
-    HAL_LPTIM_PWM_Start_IT(&hlptim1, LPTIM_CHANNEL_1);
+    if (!sleep_armed)
+    {
+        sleep_left = UINT32_MAX;
+        ChunkStart();
+    }
 
-    FM_DEBUG_LedActive(0);
+    for (;;)
+    {
+        HAL_LPTIM_PWM_Start_IT(&hlptim1, LPTIM_CHANNEL_1);
+        FMX_TRACE_StopEnter();
+
+        SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+        if (stop_hold)
+        {
+            // Una transferencia por DMA necesita SYSCLK: se espera en sleep.
+            HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+        }
+        else
+        {
+            HAL_PWREx_EnterSTOP2Mode(PWR_STOPENTRY_WFI);
+        }
+        SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
 
-    SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
-    HAL_PWREx_EnterSTOP2Mode(PWR_STOPENTRY_WFI);
-    SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+        // Un despertar antes del compare, el ultimo tramo u otra IRQ vuelven a ThreadX.
+        lptim1_stop = CountRead();
+        if ((lptim1_stop < lptim1_ticks) || (sleep_left == 0) || OtherIrqPending())
+        {
+            break;
+        }
+
+        sleep_elapsed += lptim1_stop;
+        FMX_STATS_ChunkWake();
+        FMX_TRACE_Wake(FMX_STATS_WAKE_CHUNK, WakeTime());
+        HAL_LPTIM_PWM_Stop_IT(&hlptim1, LPTIM_CHANNEL_1);
+        __HAL_LPTIM_CLEAR_FLAG(&hlptim1, LPTIM_FLAG_CC1);
+        HAL_NVIC_ClearPendingIRQ(LPTIM1_IRQn);
+        ChunkStart();
+    }
 
     FM_DEBUG_LedActive(1);
 }
 
 /*
- * @brief
- * @note
- * @param
- * @retval
+ * @brief Detiene el LPTIM1 y guarda el tiempo dormido en el ultimo tramo.
+ * @note  Informa la residencia y la fuente del despertar a fmx_stats y a la
+ *        traza antes de que corran las ISR pendientes.
  */
 void FMX_LP_Exit(void)
 {
-    lptim1_stop = LPTIM1->CNT;
+    lptim1_stop = CountRead();
     HAL_LPTIM_PWM_Stop_IT(&hlptim1, LPTIM_CHANNEL_1);
+    sleep_elapsed += lptim1_stop;
+    FMX_TRACE_Wake(FMX_STATS_StopExit(sleep_elapsed), WakeTime());
 }
 
 /*
- * @brief
- * @note
- * @param
- * @retval
+ * @brief Convierte el tiempo dormido a ticks de ThreadX.
+ * @retval Ticks enteros a sumar al reloj de ThreadX.
+ * @note  La fraccion que no llega a un tick queda en tick_rem para la proxima
+ *        salida del stop. Con la linea de tiempo, sync_ticks avanza con el LSE
+ *        transcurrido desde el ajuste anterior, dormido o no, y se devuelve lo
+ *        que le falta al reloj de ThreadX: lo que el SysTick conto de mas o de
+ *        menos se corrige aca y el reloj sigue al LSE sin deriva.
  */
 ULONG FMX_LP_Adjust(void)
 {
-    ULONG tx_ticks;
-    ULONG lse_ticks;
-    ULONG drift = 0;
+    uint64_t total;
+    uint32_t now;
+    int32_t owed;
 
-    lse_ticks = lptim1_stop + drift;
-    drift = lse_ticks % TICKS_TO_TICKS;
-    tx_ticks = lse_ticks / TICKS_TO_TICKS;
+    if (FMX_CAPTURE_TimelineReady())
+    {
+        now = FMX_CAPTURE_TimeGet();
+        if (!sync_valid)
+        {
+            // Primer ajuste con la linea de tiempo: este stop lo midio el LPTIM1.
+            sync_ticks = tx_time_get();
+            sync_time = now - sleep_elapsed * LSE_DIV;
+            sync_valid = 1;
+        }
+        total = (uint64_t)(now - sync_time) * TX_TICK_PER_SECOND + tick_rem;
+        sync_time = now;
+    }
+    else
+    {
+        sync_ticks = tx_time_get();
+        total = (uint64_t)sleep_elapsed * LSE_DIV * TX_TICK_PER_SECOND + tick_rem;
+    }
+    sync_ticks += (uint32_t)(total / LSE_CLK);
+    tick_rem = (uint32_t)(total % LSE_CLK);
+    sleep_elapsed = 0;
+    sleep_left = 0;
+    sleep_armed = 0;
+
+    owed = (int32_t)(sync_ticks - tx_time_get());
+    return (owed > 0) ? (ULONG)owed : 0u;
+}
+
+/*
+ * @brief Impide el stop 2 mientras un periferico con reloj del bus trabaja por
+ *        DMA; el idle usa sleep, con el mismo LPTIM1 para el tiempo.
+ * @note  Cada FMX_LP_StopHold se cierra con un FMX_LP_StopRelease.
+ */
+void FMX_LP_StopHold(void)
+{
+    uint32_t primask;
 
-    return tx_ticks;
+    primask = __get_PRIMASK();
+    __disable_irq();
+    stop_hold++;
+    __set_PRIMASK(primask);
+}
+
+void FMX_LP_StopRelease(void)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (stop_hold == 0)
+    {
+        FM_DEBUG_LedError(1);
+    }
+    else
+    {
+        stop_hold--;
+    }
+    __set_PRIMASK(primask);
 }
 
 /**
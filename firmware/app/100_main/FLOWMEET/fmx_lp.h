@@ -26,6 +26,8 @@ void FMX_LP_Delay(ULONG countery);
 void FMX_LP_Enter(void);
 void FMX_LP_Exit(void);
 void FMX_LP_Setup(ULONG count);
+void FMX_LP_StopHold(void);
+void FMX_LP_StopRelease(void);
 
 #endif /* MODULE_H */
 
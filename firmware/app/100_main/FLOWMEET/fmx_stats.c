@@ -0,0 +1,311 @@
+/**
+ * @file fmx_stats.c
+ * @brief Tiempo de CPU por hilo y residencia en stop 2.
+ *
+ * Los hooks de cambio de contexto de ThreadX (TX_ENABLE_EXECUTION_CHANGE_NOTIFY
+ * en tx_user.h) leen DWT CYCCNT y cargan los ciclos transcurridos al hilo que
+ * estaba en ejecucion. FMX_LP_Enter/Exit informan la residencia en stop 2 con
+ * el conteo del LPTIM1 y la fuente de cada despertar.
+ * @details
+ * - CYCCNT se detiene en stop 2: cycles_total es solo tiempo despierto.
+ * - Las ISR de la HAL no pasan por _tx_thread_context_save: sus ciclos se
+ *   cargan al hilo interrumpido, o a cycles_other si el MCU estaba en idle.
+ *   Solo el SysTick de ThreadX llama a los hooks de ISR.
+ * - Los hooks de hilo corren en PendSV y el de ISR en SysTick, que puede
+ *   interrumpir a PendSV: la carga de ciclos se hace con PRIMASK.
+ * - CYCCNT da la vuelta cada ~179 s a 24 MHz; entre dos cargas nunca pasa
+ *   tanto tiempo despierto.
+ * - Para el modelo de energia (tools/fm_energy.py) los ciclos se separan por
+ *   perfil de fmx_clock y los estados de fmx_stats_state_t acumulan su
+ *   duracion: LCD y flash con CYCCNT (esperas activas), MXChip con los ticks
+ *   de ThreadX porque pasa la mayor parte en stop 2.
+ */
+
+// --- Includes ---
+#include "fmx_stats.h"
+#include "tx_thread.h"
+#include <string.h>
+
+// --- Static Data ---
+static fmx_stats_t stats;
+static uint32_t    cycles_last;  // CYCCNT de la ultima carga.
+
+// Apertura de cada estado: CYCCNT o tick de ThreadX segun el estado.
+static uint32_t    state_start[FMX_STATS_STATE_END];
+static uint8_t     state_open[FMX_STATS_STATE_END];
+
+// --- Static Prototypes ---
+static void                CyclesCharge(uint64_t *bucket);
+static fmx_stats_thread_t *ThreadSlot(TX_THREAD *thread);
+static fmx_stats_wake_t    WakeSource(void);
+static uint8_t             IrqPending(IRQn_Type irq);
+
+// --- Public API ---
+
+/**
+ * @brief Copia las estadisticas acumuladas.
+ * @param stats_out Destino de la copia.
+ */
+void FMX_STATS_Get(fmx_stats_t *stats_out)
+{
+    fmx_stats_thread_t *slot;
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    // El hilo que consulta tambien queda al dia.
+    slot = ThreadSlot(_tx_thread_current_ptr);
+    CyclesCharge((slot != NULL) ? &slot->cycles : &stats.cycles_other);
+    *stats_out = stats;
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Pone a cero los contadores; los hilos conocidos conservan su entrada.
+ */
+void FMX_STATS_Reset(void)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    for (uint32_t i = 0; i < FMX_STATS_THREADS; i++)
+    {
+        stats.thread[i].cycles = 0;
+    }
+    stats.cycles_total = 0;
+    stats.cycles_isr = 0;
+    stats.cycles_other = 0;
+    stats.stop_ticks = 0;
+    stats.stop_count = 0;
+    memset(stats.wake, 0, sizeof(stats.wake));
+    memset(stats.cycles_profile, 0, sizeof(stats.cycles_profile));
+    memset(stats.state_us, 0, sizeof(stats.state_us));
+    memset(stats.state_count, 0, sizeof(stats.state_count));
+    cycles_last = DWT->CYCCNT;
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Cuenta un despertar por un tramo intermedio del LPTIM1.
+ * @note  Se llama desde FMX_LP_Enter, que vuelve a dormir sin pasar por ThreadX.
+ */
+void FMX_STATS_ChunkWake(void)
+{
+    stats.wake[FMX_STATS_WAKE_CHUNK]++;
+}
+
+/**
+ * @brief Registra una salida del stop 2 hacia ThreadX.
+ * @param lptim_ticks Tiempo dormido en ticks del LPTIM1, todos los tramos.
+ * @return Fuente del despertar, para la traza de fmx_trace.
+ * @note  Se llama desde FMX_LP_Exit con interrupciones deshabilitadas, antes de
+ *        que corran las ISR: la fuente se deduce de las pendientes del NVIC.
+ */
+fmx_stats_wake_t FMX_STATS_StopExit(uint32_t lptim_ticks)
+{
+    fmx_stats_wake_t source;
+
+    CyclesCharge(&stats.cycles_other);
+    source = WakeSource();
+    stats.stop_ticks += lptim_ticks;
+    stats.stop_count++;
+    stats.wake[source]++;
+
+    return source;
+}
+
+/**
+ * @brief Cierra el tramo en curso antes de un cambio de perfil de reloj.
+ * @note  Desde fmx_clock con interrupciones deshabilitadas: los ciclos hasta
+ *        aca quedan en el perfil que se deja.
+ */
+void FMX_STATS_ClockSwitch(void)
+{
+    fmx_stats_thread_t *slot;
+
+    slot = ThreadSlot(_tx_thread_current_ptr);
+    CyclesCharge((slot != NULL) ? &slot->cycles : &stats.cycles_other);
+}
+
+/**
+ * @brief Abre un estado del modelo de energia.
+ * @param state Estado; uno abierto dos veces conserva la primera apertura.
+ */
+void FMX_STATS_StateBegin(fmx_stats_state_t state)
+{
+    if ((state >= FMX_STATS_STATE_END) || state_open[state])
+    {
+        return;
+    }
+
+    state_start[state] = (state == FMX_STATS_STATE_MXC) ? (uint32_t)tx_time_get()
+                                                         : DWT->CYCCNT;
+    state_open[state] = 1;
+}
+
+/**
+ * @brief Cierra un estado y suma su duracion.
+ * @param state Estado abierto con FMX_STATS_StateBegin.
+ * @note  LCD y flash no cambian de perfil de reloj mientras estan abiertos: se
+ *        convierten con el SystemCoreClock del cierre.
+ */
+void FMX_STATS_StateEnd(fmx_stats_state_t state)
+{
+    uint64_t us;
+    uint32_t primask;
+
+    if ((state >= FMX_STATS_STATE_END) || !state_open[state])
+    {
+        return;
+    }
+
+    if (state == FMX_STATS_STATE_MXC)
+    {
+        us = (uint64_t)((uint32_t)tx_time_get() - state_start[state])
+             * (1000000u / TX_TIMER_TICKS_PER_SECOND);
+    }
+    else
+    {
+        us = ((uint64_t)(DWT->CYCCNT - state_start[state]) * 1000000u) / SystemCoreClock;
+    }
+    state_open[state] = 0;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    stats.state_us[state] += us;
+    stats.state_count[state]++;
+    __set_PRIMASK(primask);
+}
+
+// --- ThreadX Hooks ---
+
+/*
+ * Llamada por tx_initialize_kernel_enter. Habilita el contador de ciclos del
+ * DWT, que la HAL no usa.
+ */
+VOID _tx_execution_initialize(VOID)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    cycles_last = 0;
+}
+
+// PendSV, antes de restaurar el hilo: lo transcurrido fue del scheduler o idle.
+VOID _tx_execution_thread_enter(VOID)
+{
+    CyclesCharge(&stats.cycles_other);
+}
+
+// PendSV, al dejar el hilo en ejecucion.
+VOID _tx_execution_thread_exit(VOID)
+{
+    fmx_stats_thread_t *slot;
+
+    slot = ThreadSlot(_tx_thread_current_ptr);
+    CyclesCharge((slot != NULL) ? &slot->cycles : &stats.cycles_other);
+}
+
+// Entrada del SysTick: se cierra el tramo del hilo interrumpido.
+VOID _tx_execution_isr_enter(VOID)
+{
+    fmx_stats_thread_t *slot;
+
+    slot = ThreadSlot(_tx_thread_current_ptr);
+    CyclesCharge((slot != NULL) ? &slot->cycles : &stats.cycles_other);
+}
+
+VOID _tx_execution_isr_exit(VOID)
+{
+    CyclesCharge(&stats.cycles_isr);
+}
+
+// --- Static Functions ---
+
+// Suma a bucket y al total los ciclos desde la ultima carga.
+static void CyclesCharge(uint64_t *bucket)
+{
+    uint32_t primask;
+    uint32_t now;
+    uint32_t delta;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    now = DWT->CYCCNT;
+    delta = now - cycles_last;
+    cycles_last = now;
+    stats.cycles_total += delta;
+    stats.cycles_profile[FMX_CLOCK_ProfileGet()] += delta;
+    *bucket += delta;
+
+    __set_PRIMASK(primask);
+}
+
+// Entrada del hilo; se asigna una libre la primera vez que se lo ve.
+static fmx_stats_thread_t *ThreadSlot(TX_THREAD *thread)
+{
+    if (thread == NULL)
+    {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < FMX_STATS_THREADS; i++)
+    {
+        if (stats.thread[i].thread == thread)
+        {
+            return &stats.thread[i];
+        }
+        if (stats.thread[i].thread == NULL)
+        {
+            stats.thread[i].thread = thread;
+            return &stats.thread[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Con varias pendientes se elige la de la medicion antes que la del timer:
+ * el LPTIM1 vence seguido y taparia al resto.
+ */
+static fmx_stats_wake_t WakeSource(void)
+{
+    if (IrqPending(LPTIM4_IRQn))
+    {
+        return FMX_STATS_WAKE_PULSE;
+    }
+    if (IrqPending(LPTIM3_IRQn))
+    {
+        return FMX_STATS_WAKE_CAPTURE;
+    }
+    if (IrqPending(EXTI3_IRQn) || IrqPending(EXTI4_IRQn) || IrqPending(EXTI10_IRQn)
+        || IrqPending(EXTI11_IRQn) || IrqPending(EXTI12_IRQn) || IrqPending(EXTI13_IRQn))
+    {
+        return FMX_STATS_WAKE_KEY;
+    }
+    if (IrqPending(USART3_IRQn) || IrqPending(GPDMA1_Channel0_IRQn)
+        || IrqPending(GPDMA1_Channel1_IRQn))
+    {
+        return FMX_STATS_WAKE_UART;
+    }
+    if (IrqPending(LPTIM1_IRQn))
+    {
+        return FMX_STATS_WAKE_TIMER;
+    }
+
+    return FMX_STATS_WAKE_OTHER;
+}
+
+static uint8_t IrqPending(IRQn_Type irq)
+{
+    return (NVIC_GetPendingIRQ(irq) && NVIC_GetEnableIRQ(irq)) ? 1u : 0u;
+}
+
+/*** END OF FILE ***/
@@ -0,0 +1,71 @@
+/**
+ * @file fmx_stats.h
+ * @brief Tiempo de CPU por hilo y residencia en stop 2.
+ */
+
+#ifndef FMX_STATS_H_
+#define FMX_STATS_H_
+
+// --- Includes ---
+#include "main.h"
+#include "tx_api.h"
+#include "fmx_clock.h"
+
+// --- Defines ---
+// Hilos con cuenta propia; alcanza para MAIN, MEASURE, CMD y BT_SLAVE.
+#define FMX_STATS_THREADS   (6u)
+
+// --- Types ---
+
+/** Fuente que saco al MCU del stop 2, segun la interrupcion pendiente. */
+typedef enum {
+    FMX_STATS_WAKE_TIMER = 0, ///< LPTIM1, vencio un timer de ThreadX.
+    FMX_STATS_WAKE_CHUNK,     ///< LPTIM1, tramo intermedio; se vuelve a dormir.
+    FMX_STATS_WAKE_PULSE,     ///< LPTIM4, compare del batch o vuelta del contador.
+    FMX_STATS_WAKE_CAPTURE,   ///< LPTIM3, vuelta de la linea de tiempo.
+    FMX_STATS_WAKE_KEY,       ///< EXTI de las teclas.
+    FMX_STATS_WAKE_UART,      ///< USART3 o GPDMA1.
+    FMX_STATS_WAKE_OTHER,     ///< Otra interrupcion o ninguna pendiente.
+    FMX_STATS_WAKE_END,
+} fmx_stats_wake_t;
+
+/** Estados con consumo propio para el modelo de energia, ademas de run y stop 2. */
+typedef enum {
+    FMX_STATS_STATE_LCD = 0,  ///< Volcado del mapa al PCF8553 por SPI.
+    FMX_STATS_STATE_FLASH,    ///< Borrado y programacion de la flash de datos.
+    FMX_STATS_STATE_MXC,      ///< MXChip alimentado, ~63 mA; abarca tramos en stop 2.
+    FMX_STATS_STATE_END,
+} fmx_stats_state_t;
+
+/** Ciclos de CPU de un hilo de ThreadX. */
+typedef struct {
+    TX_THREAD *thread;  ///< NULL si la entrada esta libre.
+    uint64_t   cycles;  ///< Ciclos de DWT CYCCNT con el hilo en ejecucion.
+} fmx_stats_thread_t;
+
+/** Estadisticas acumuladas desde el arranque o el ultimo FMX_STATS_Reset. */
+typedef struct {
+    fmx_stats_thread_t thread[FMX_STATS_THREADS];
+    uint64_t cycles_total;  ///< Ciclos despierto (CYCCNT se detiene en stop 2).
+    uint64_t cycles_isr;    ///< Ciclos en ISR con hooks de ThreadX (SysTick).
+    uint64_t cycles_other;  ///< Ciclos sin hilo: scheduler, idle despierto y entrada/salida del stop.
+    uint64_t stop_ticks;    ///< Residencia en stop 2, en ticks del LPTIM1 (2048 Hz).
+    uint32_t stop_count;    ///< Salidas del stop 2 hacia ThreadX.
+    uint32_t wake[FMX_STATS_WAKE_END];
+    uint64_t cycles_profile[FMX_CLOCK_END];     ///< Ciclos despierto en cada perfil de reloj.
+    uint64_t state_us[FMX_STATS_STATE_END];     ///< Duracion acumulada de cada estado.
+    uint32_t state_count[FMX_STATS_STATE_END];  ///< Veces que se cerro cada estado.
+} fmx_stats_t;
+
+// --- API ---
+void             FMX_STATS_Get(fmx_stats_t *stats);
+void             FMX_STATS_Reset(void);
+void             FMX_STATS_ChunkWake(void);
+fmx_stats_wake_t FMX_STATS_StopExit(uint32_t lptim_ticks);
+void             FMX_STATS_ClockSwitch(void);
+void             FMX_STATS_StateBegin(fmx_stats_state_t state);
+void             FMX_STATS_StateEnd(fmx_stats_state_t state);
+
+#endif /* FMX_STATS_H_ */
+
+/*** END OF FILE ***/
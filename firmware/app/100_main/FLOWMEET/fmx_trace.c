@@ -0,0 +1,175 @@
+/**
+ * @file fmx_trace.c
+ * @brief Traza de despertares del stop 2 en backup SRAM.
+ *
+ * Cada salida de HAL_PWREx_EnterSTOP2Mode en FMX_LP_Enter deja una entrada
+ * con la hora, la fuente del despertar y el tiempo que el MCU siguio
+ * despierto. El anillo vive en .RAM_BACKUP_Section y sobrevive a los resets:
+ * cada arranque agrega una entrada FMX_TRACE_BOOT con la hora unix del RTC,
+ * que ancla los ticks de ThreadX de las entradas siguientes.
+ * @details
+ * - Se escribe solo desde el camino de idle de ThreadX, que corre con
+ *   interrupciones deshabilitadas: no hace falta otro bloqueo.
+ * - El tiempo despierto se mide con DWT CYCCNT (fmx_stats lo habilita), que
+ *   se detiene en stop 2, y se guarda en ticks LSE hasta ~2 s. Los ciclos se
+ *   convierten en cada cambio de perfil de reloj, con la frecuencia que se
+ *   deja (FMX_TRACE_ClockSwitch).
+ * - FM+TRACE? vuelca el anillo; tools/fm_trace_decode.py arma la linea de
+ *   tiempo y el histograma por fuente.
+ */
+
+// --- Includes ---
+#include "fmx_trace.h"
+#include <string.h>
+
+// --- Defines ---
+#define TRACE_MAGIC     (0x54524331u)   // "TRC1"
+#define LSE_HZ          (32768u)
+#define ACTIVE_SHIFT    (8u)            // wake_lse en 1/256 de tick LSE.
+
+// --- Types ---
+typedef struct {
+    uint32_t magic;
+    uint16_t head;      // Proxima entrada a escribir.
+    uint16_t count;     // Entradas validas, hasta FMX_TRACE_LENGTH.
+    uint32_t boots;     // Arranques desde que se inicializo el anillo.
+    fmx_trace_entry_t entry[FMX_TRACE_LENGTH];
+} trace_ring_t;
+
+// --- Static Data ---
+static trace_ring_t trace __attribute__((section(".RAM_BACKUP_Section")));
+static fmx_trace_entry_t *last;     // Entrada a la que se suma el tiempo despierto.
+static uint32_t           wake_cycles;  // CYCCNT al despertar o en el ultimo cambio de reloj.
+static uint64_t           wake_lse;     // Tiempo despierto ya convertido.
+
+// --- Static Prototypes ---
+static fmx_trace_entry_t *Append(uint8_t reason, uint32_t time);
+static void               ActiveCharge(void);
+
+// --- Public API ---
+
+/**
+ * @brief Valida el anillo y registra el arranque.
+ * @param time_unix Hora del RTC.
+ * @note Llamar despues de FM_BACKUP_Init. Un anillo corrupto se descarta.
+ */
+void FMX_TRACE_Init(uint32_t time_unix)
+{
+    if ((trace.magic != TRACE_MAGIC) || (trace.head >= FMX_TRACE_LENGTH)
+        || (trace.count > FMX_TRACE_LENGTH))
+    {
+        memset(&trace, 0, sizeof(trace));
+        trace.magic = TRACE_MAGIC;
+    }
+
+    trace.boots++;
+    Append(FMX_TRACE_BOOT, time_unix);
+    last = NULL;
+}
+
+/**
+ * @brief Registra una salida del stop 2.
+ * @param reason Fuente del despertar.
+ * @param time Ticks de ThreadX al despertar, con el tiempo dormido incluido.
+ * @note Desde FMX_LP_Enter/Exit, con interrupciones deshabilitadas.
+ */
+void FMX_TRACE_Wake(fmx_stats_wake_t reason, uint32_t time)
+{
+    last = Append((uint8_t)reason, time);
+    wake_cycles = DWT->CYCCNT;
+    wake_lse = 0;
+}
+
+/**
+ * @brief Convierte los ciclos despierto hasta aca con el reloj que se deja.
+ * @note Desde fmx_clock con interrupciones deshabilitadas, antes de cambiar
+ *       SystemCoreClock.
+ */
+void FMX_TRACE_ClockSwitch(void)
+{
+    if (last != NULL)
+    {
+        ActiveCharge();
+    }
+}
+
+/**
+ * @brief Cierra el tiempo despierto de la ultima entrada antes de dormir.
+ * @note Desde FMX_LP_Enter, con interrupciones deshabilitadas.
+ */
+void FMX_TRACE_StopEnter(void)
+{
+    uint64_t lse;
+
+    if (last == NULL)
+    {
+        return;
+    }
+
+    ActiveCharge();
+    lse = wake_lse >> ACTIVE_SHIFT;
+    last->active = (lse > UINT16_MAX) ? UINT16_MAX : (uint16_t)lse;
+    last = NULL;
+}
+
+/**
+ * @brief Copia las entradas de la mas vieja a la mas nueva.
+ * @param dst Destino.
+ * @param length Entradas que entran en dst.
+ * @return Entradas copiadas.
+ */
+uint32_t FMX_TRACE_Read(fmx_trace_entry_t *dst, uint32_t length)
+{
+    uint32_t primask;
+    uint32_t count;
+    uint32_t index;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    count = (trace.count < length) ? trace.count : length;
+    index = (trace.head + FMX_TRACE_LENGTH - trace.count) % FMX_TRACE_LENGTH;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        dst[i] = trace.entry[index];
+        index = (index + 1u) % FMX_TRACE_LENGTH;
+    }
+
+    __set_PRIMASK(primask);
+
+    return count;
+}
+
+// --- Static Functions ---
+
+// Escribe una entrada y avanza el anillo, pisando la mas vieja.
+static fmx_trace_entry_t *Append(uint8_t reason, uint32_t time)
+{
+    fmx_trace_entry_t *entry;
+
+    entry = &trace.entry[trace.head];
+    entry->time = time;
+    entry->active = 0;
+    entry->reason = reason;
+    entry->boot = (uint8_t)trace.boots;
+
+    trace.head = (uint16_t)((trace.head + 1u) % FMX_TRACE_LENGTH);
+    if (trace.count < FMX_TRACE_LENGTH)
+    {
+        trace.count++;
+    }
+
+    return entry;
+}
+
+// Suma los ciclos desde wake_cycles con el SystemCoreClock actual.
+static void ActiveCharge(void)
+{
+    uint32_t cycles;
+
+    cycles = DWT->CYCCNT;
+    wake_lse += ((uint64_t)(cycles - wake_cycles) * (LSE_HZ << ACTIVE_SHIFT)) / SystemCoreClock;
+    wake_cycles = cycles;
+}
+
+/*** END OF FILE ***/
@@ -0,0 +1,38 @@
+/**
+ * @file fmx_trace.h
+ * @brief Traza de despertares del stop 2 en backup SRAM.
+ */
+
+#ifndef FMX_TRACE_H_
+#define FMX_TRACE_H_
+
+// --- Includes ---
+#include "main.h"
+#include "fmx_stats.h"
+
+// --- Defines ---
+// 64 entradas de 8 bytes: 512 B de los 2 KB de .RAM_BACKUP_Section.
+#define FMX_TRACE_LENGTH    (64u)
+// Motivo de la entrada que marca un arranque; time es la hora unix del RTC.
+#define FMX_TRACE_BOOT      (0xFEu)
+
+// --- Types ---
+
+/** Un despertar del stop 2, 8 bytes. */
+typedef struct {
+    uint32_t time;    ///< Ticks de ThreadX al despertar (hora unix en FMX_TRACE_BOOT).
+    uint16_t active;  ///< Tiempo despierto hasta el proximo stop, ticks LSE (saturado).
+    uint8_t  reason;  ///< fmx_stats_wake_t o FMX_TRACE_BOOT.
+    uint8_t  boot;    ///< 8 bits bajos del numero de arranque.
+} fmx_trace_entry_t;
+
+// --- API ---
+void     FMX_TRACE_Init(uint32_t time_unix);
+void     FMX_TRACE_Wake(fmx_stats_wake_t reason, uint32_t time);
+void     FMX_TRACE_ClockSwitch(void);
+void     FMX_TRACE_StopEnter(void);
+uint32_t FMX_TRACE_Read(fmx_trace_entry_t *dst, uint32_t length);
+
+#endif /* FMX_TRACE_H_ */
+
+/*** END OF FILE ***/
@@ -0,0 +1,297 @@
+/**
+ * @file fmx_wake.c
+ * @brief Planificador de despertares: agrupa el trabajo periodico en un solo
+ *        despertar por periodo, alineado al segundo del RTC.
+ *
+ * Cada cliente declara su vencimiento y una holgura (slack): puede correr en
+ * cualquier momento entre el vencimiento y el vencimiento mas la holgura. Un
+ * unico TX_TIMER vence en el menor de esos limites y en ese despertar avisa a
+ * todos los clientes ya vencidos, asi los trabajos cercanos comparten una
+ * sola salida del stop 2.
+ * @details
+ * - Si un segundo del RTC cae dentro de la ventana de un cliente, su limite
+ *   pasa a ser ese segundo: medicion, LCD, creditos de log y BT tienden a
+ *   despertar juntos en el flanco del segundo.
+ * - Los periodos de segundos enteros arrancan en el flanco del segundo y lo
+ *   conservan, el vencimiento avanza de a un periodo.
+ * - Los avisos solo marcan flags, colas o semaforos del hilo dueno del
+ *   trabajo; corren en el hilo de timers de ThreadX.
+ * - El RTC y el LPTIM1 usan el LSE: la fase del segundo no deriva respecto
+ *   de tx_time_get, igual se relee en cada planificacion.
+ */
+
+// --- Includes ---
+#include "fmx_wake.h"
+#include "fm_debug.h"
+
+// --- Defines ---
+#define TICKS_PER_SECOND   TX_TIMER_TICKS_PER_SECOND
+
+// --- Types ---
+typedef struct {
+    fmx_wake_callback_t callback;
+    ULONG   deadline;   // Vencimiento en ticks de tx_time_get.
+    ULONG   period;     // 0: un solo aviso, se rearma con FMX_WAKE_Schedule.
+    ULONG   slack;      // Demora admitida despues del vencimiento.
+    uint8_t armed;
+} wake_client_t;
+
+// --- Static Data ---
+static TX_TIMER         wake_timer;
+static wake_client_t    clients[FMX_WAKE_END];
+static fmx_wake_count_t count;
+
+// --- Static Prototypes ---
+static void  Plan(void);
+static ULONG SecondPhase(void);
+static ULONG EdgeNext(ULONG ticks, ULONG phase);
+static uint8_t Due(ULONG now, ULONG at);
+static void  TimerEntryWake(ULONG timer_input);
+
+// --- Public API ---
+
+/**
+ * @brief Crea el timer del planificador, sin clientes armados.
+ * @return TX_SUCCESS o el error de tx_timer_create.
+ */
+UINT FMX_WAKE_Init(void)
+{
+    return tx_timer_create(&wake_timer,
+                           "WAKE_TIMER",
+                           TimerEntryWake,
+                           0,
+                           1,
+                           0,
+                           TX_NO_ACTIVATE);
+}
+
+/**
+ * @brief Asocia el aviso de un cliente.
+ * @param id Cliente.
+ * @param callback Aviso, no debe bloquear.
+ */
+void FMX_WAKE_Register(fmx_wake_id_t id, fmx_wake_callback_t callback)
+{
+    if (id >= FMX_WAKE_END)
+    {
+        FM_DEBUG_LedError(1);
+        return;
+    }
+    clients[id].callback = callback;
+}
+
+/**
+ * @brief Programa el proximo aviso de un cliente.
+ * @param id Cliente.
+ * @param ticks Ticks de ThreadX hasta el vencimiento.
+ * @param period Periodo de los avisos siguientes; 0 para un solo aviso.
+ * @param slack Demora admitida despues de cada vencimiento.
+ * @note Con un periodo de segundos enteros el primer vencimiento se corre al
+ *       siguiente flanco del segundo del RTC.
+ */
+void FMX_WAKE_Schedule(fmx_wake_id_t id, ULONG ticks, ULONG period, ULONG slack)
+{
+    wake_client_t *client;
+    uint32_t primask;
+
+    if (id >= FMX_WAKE_END)
+    {
+        FM_DEBUG_LedError(1);
+        return;
+    }
+    client = &clients[id];
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    client->deadline = tx_time_get() + ticks;
+    if ((period != 0) && ((period % TICKS_PER_SECOND) == 0))
+    {
+        client->deadline = EdgeNext(client->deadline, SecondPhase());
+    }
+    client->period = period;
+    client->slack = slack;
+    client->armed = 1;
+    Plan();
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Desarma un cliente; un aviso ya entregado no se deshace.
+ * @param id Cliente.
+ */
+void FMX_WAKE_Cancel(fmx_wake_id_t id)
+{
+    uint32_t primask;
+
+    if (id >= FMX_WAKE_END)
+    {
+        return;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    clients[id].armed = 0;
+    Plan();
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Copia los contadores de despertares y avisos.
+ * @param dst Destino de la copia.
+ */
+void FMX_WAKE_CountGet(fmx_wake_count_t *dst)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    *dst = count;
+    __set_PRIMASK(primask);
+}
+
+// --- Static Functions ---
+
+/*
+ * Reprograma el timer al menor limite (vencimiento + holgura, o el segundo del
+ * RTC dentro de esa ventana) entre los clientes armados. Corre con
+ * interrupciones deshabilitadas.
+ */
+static void Plan(void)
+{
+    ULONG now;
+    ULONG phase;
+    ULONG latest;
+    ULONG edge;
+    ULONG next = 0;
+    uint8_t found = 0;
+
+    now = tx_time_get();
+    phase = SecondPhase();
+
+    for (uint32_t i = 0; i < FMX_WAKE_END; i++)
+    {
+        if (!clients[i].armed)
+        {
+            continue;
+        }
+
+        latest = clients[i].deadline + clients[i].slack;
+        edge = EdgeNext(clients[i].deadline, phase);
+        if ((edge - clients[i].deadline) <= clients[i].slack)
+        {
+            latest = edge;
+        }
+
+        if (!found || ((LONG)(latest - next) < 0))
+        {
+            next = latest;
+            found = 1;
+        }
+    }
+
+    tx_timer_deactivate(&wake_timer);
+    if (!found)
+    {
+        return;
+    }
+
+    // Un limite ya pasado vence en el proximo tick.
+    next = ((LONG)(next - now) > 0) ? (next - now) : 1u;
+    tx_timer_change(&wake_timer, next, 0);
+    tx_timer_activate(&wake_timer);
+}
+
+/*
+ * Fase del segundo del RTC en ticks de ThreadX: los flancos caen en los ticks
+ * t con t % TICKS_PER_SECOND == fase. SSR baja de PREDIV_S a 0 en cada segundo.
+ * Con los shadow registers (BYPSHAD = 0) leer SSR congela TR y DR hasta leer
+ * DR: se lee DR para que el proximo HAL_RTC_GetTime no devuelva esta hora.
+ */
+static ULONG SecondPhase(void)
+{
+    uint32_t prediv;
+    uint32_t ssr;
+    ULONG to_edge;
+
+    prediv = RTC->PRER & RTC_PRER_PREDIV_S_Msk;
+    ssr = RTC->SSR;
+    (void)RTC->DR;
+    if (ssr > prediv)
+    {
+        ssr = prediv;
+    }
+    to_edge = (ULONG)(((ssr + 1u) * TICKS_PER_SECOND) / (prediv + 1u));
+
+    return (tx_time_get() + to_edge) % TICKS_PER_SECOND;
+}
+
+// Primer flanco del segundo igual o posterior a ticks.
+static ULONG EdgeNext(ULONG ticks, ULONG phase)
+{
+    ULONG offset;
+
+    offset = (ticks + TICKS_PER_SECOND - phase) % TICKS_PER_SECOND;
+
+    return (offset != 0) ? (ticks + TICKS_PER_SECOND - offset) : ticks;
+}
+
+// El reloj de ThreadX da la vuelta: se compara la diferencia con signo.
+static uint8_t Due(ULONG now, ULONG at)
+{
+    return ((LONG)(now - at) >= 0);
+}
+
+// --- Timers ---
+
+/*
+ * Vencimiento del planificador: avisa a todos los clientes vencidos, incluso
+ * los que todavia tenian holgura, y vuelve a planificar.
+ */
+static void TimerEntryWake(ULONG timer_input)
+{
+    ULONG now;
+    uint32_t primask;
+
+    (void)timer_input;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    now = tx_time_get();
+    count.wakes++;
+
+    for (uint32_t i = 0; i < FMX_WAKE_END; i++)
+    {
+        if (!clients[i].armed || !Due(now, clients[i].deadline))
+        {
+            continue;
+        }
+
+        if (clients[i].period != 0)
+        {
+            clients[i].deadline += clients[i].period;
+            if (Due(now, clients[i].deadline))
+            {
+                clients[i].deadline = now + clients[i].period;
+            }
+        }
+        else
+        {
+            clients[i].armed = 0;
+        }
+
+        count.runs[i]++;
+        if (clients[i].callback != NULL)
+        {
+            clients[i].callback();
+        }
+    }
+
+    Plan();
+
+    __set_PRIMASK(primask);
+}
+
+/*** END OF FILE ***/
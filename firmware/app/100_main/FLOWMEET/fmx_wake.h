@@ -0,0 +1,43 @@
+/**
+ * @file fmx_wake.h
+ * @brief Planificador de despertares: agrupa el trabajo periodico en un solo
+ *        despertar por periodo, alineado al segundo del RTC.
+ */
+
+#ifndef FMX_WAKE_H_
+#define FMX_WAKE_H_
+
+// --- Includes ---
+#include "main.h"
+#include "tx_api.h"
+
+// --- Types ---
+
+/** Clientes del planificador, uno por trabajo periodico. */
+typedef enum {
+    FMX_WAKE_MEASURE = 0,   ///< Cierre de ventana y drenado de la captura.
+    FMX_WAKE_LCD,           ///< Redibujo de la UI.
+    FMX_WAKE_LOG_CREDIT,    ///< Recarga de creditos de la politica de log.
+    FMX_WAKE_BT,            ///< Cuenta regresiva de la conexion Bluetooth.
+    FMX_WAKE_END,
+} fmx_wake_id_t;
+
+/** Aviso al dueno del trabajo; corre en el hilo de timers de ThreadX. */
+typedef void (*fmx_wake_callback_t)(void);
+
+/** Contadores desde el arranque, para comparar despertares por minuto. */
+typedef struct {
+    uint32_t wakes;                 ///< Vencimientos del timer del planificador.
+    uint32_t runs[FMX_WAKE_END];    ///< Avisos entregados a cada cliente.
+} fmx_wake_count_t;
+
+// --- API ---
+UINT FMX_WAKE_Init(void);
+void FMX_WAKE_Register(fmx_wake_id_t id, fmx_wake_callback_t callback);
+void FMX_WAKE_Schedule(fmx_wake_id_t id, ULONG ticks, ULONG period, ULONG slack);
+void FMX_WAKE_Cancel(fmx_wake_id_t id);
+void FMX_WAKE_CountGet(fmx_wake_count_t *count);
+
+#endif /* FMX_WAKE_H_ */
+
+/*** END OF FILE ***/
@@ -7,12 +7,32 @@
  */
 
 #include "fm_cmd.h"
+#include "fm_fmc.h"
+#include "fm_ktable.h"
+#include "fmx_batch.h"
+#include "fmx_stats.h"
+#include "fmx_trace.h"
+#include "fmx_wake.h"
+#include "fm_pcf8553.h"
+#include "fm_lcd.h"
 #include <string.h>
 #include <stdio.h>
 
 // --- Internal constants ---
 
 #define UART3_TX_BUFFER_SIZE   (32u)
+#define KTABLE_LINE_SIZE       (28u)
+#define BATCH_LINE_SIZE        (72u)
+#define MEASURE_LINE_SIZE      (96u)
+#define LATENCY_LINE_SIZE      (32u + 11u * FMX_LATENCY_BUCKETS)
+#define STATS_LINE_SIZE        (352u + 48u * FMX_STATS_THREADS)
+#define TRACE_LINE_SIZE        (16u + 28u * FMX_TRACE_LENGTH)
+#define LCD_LINE_SIZE          (16u + 4u * PCF8553_RAM_SIZE)
+#ifdef FM_BENCH
+#define UFP3_LINE_SIZE         (40u)
+#define UFP3_DECIMALS          (4u)
+#define UFP3_ROW_SIZE          (20u)
+#endif
 #define NUM_COMMANDS           (sizeof(fm_commands) / sizeof(fm_commands[0]))
 
 // --- Internal state ---
@@ -24,6 +44,22 @@ static const fm_cmd_entry_t fm_commands[] = {
     { "FM+TEMP?",     FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleTemp },
     { "FM+LOG_ALL?",  FM_CMD_TYPE_DEFERRED, .response.handler = FM_CMD_HandleLogAll },
     { "FM+COUNT?",    FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleCount },
+    { "FM+KTAB?",     FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleKTableGet },
+    { "FM+KTAB=",     FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleKTablePointSet },
+    { "FM+KTAB_N=",   FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleKTableCountSet },
+    { "FM+BATCH?",    FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleBatchGet },
+    { "FM+BATCH=",    FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleBatchStart },
+    { "FM+BATCH_STOP",FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleBatchStop },
+    { "FM+MEAS?",     FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleMeasureGet },
+    { "FM+LAT?",      FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleLatencyGet },
+    { "FM+LAT_RESET", FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleLatencyReset },
+    { "FM+STATS?",    FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleStatsGet },
+    { "FM+STATS_RESET",FM_CMD_TYPE_HANDLER, .response.handler = FM_CMD_HandleStatsReset },
+    { "FM+TRACE?",    FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleTraceGet },
+    { "FM+LCD?",      FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleLcdGet },
+#ifdef FM_BENCH
+    { "FM+UFP3?",     FM_CMD_TYPE_HANDLER,  .response.handler = FM_CMD_HandleUfp3Bench },
+#endif
 };
 
 static TX_THREAD cmd_thread; ///< Thread in charge of processing FM+ commands.
@@ -33,6 +69,11 @@ static uint8_t   cmd_queue_buffer[3u * FM_CMD_BYTE_SIZE];
 // --- Private prototypes ---
 
 static void process_line_(const char *line);
+static void reply_status_(fmx_status_t status);
+static unsigned long cycles_to_ms_(uint64_t cycles);
+#ifdef FM_BENCH
+static void ufp3_snprintf_(uint32_t value, uint8_t decimals, fm_lcd_ll_row_t row);
+#endif
 
 // --- Private functions ---
 
@@ -58,6 +99,55 @@ static void process_line_(const char *line)
     }
 }
 
+/**
+ * Replies OK or ERROR according to the status of a setter.
+ * @param status Result returned by the module that applied the change.
+ */
+static void reply_status_(fmx_status_t status)
+{
+    static const char ok[] = "OK\r\n";
+    static const char error[] = "ERROR\r\n";
+
+    if (status == FMX_STATUS_OK) {
+        HAL_UART_Transmit_DMA(&huart3, (uint8_t *)ok, sizeof(ok) - 1u);
+    } else {
+        HAL_UART_Transmit_DMA(&huart3, (uint8_t *)error, sizeof(error) - 1u);
+    }
+}
+
+/**
+ * Converts DWT cycles to milliseconds at the current core clock.
+ * @param cycles Cycle count from fmx_stats.
+ */
+static unsigned long cycles_to_ms_(uint64_t cycles)
+{
+    return (unsigned long)(cycles / (SystemCoreClock / 1000u));
+}
+
+#ifdef FM_BENCH
+/**
+ * Renders a ufp3_t the way fm_user.c did before FM_LCD_PutUfp3, with snprintf
+ * and FM_LCD_PutString. Kept only as the baseline of FM+UFP3?, which exists
+ * only in builds with FM_BENCH defined.
+ * @param value Fixed-point value with three decimals.
+ * @param decimals Decimals shown, 0 to 3.
+ * @param row Target row; row 2 is zero padded.
+ */
+static void ufp3_snprintf_(uint32_t value, uint8_t decimals, fm_lcd_ll_row_t row)
+{
+    static const char *const formats[FM_LCD_LL_ROWS][UFP3_DECIMALS] = {
+        { "%8lu", "%7lu.%1lu", "%6lu.%02lu", "%5lu.%03lu" },
+        { "%07lu", "%06lu.%01lu", "%05lu.%02lu", "%04lu.%03lu" },
+    };
+    static const uint32_t frac_div[UFP3_DECIMALS] = { 1000u, 100u, 10u, 1u };
+    static char line[UFP3_ROW_SIZE];
+
+    snprintf(line, sizeof(line), formats[row][decimals], (unsigned long)(value / 1000u),
+             (unsigned long)((value % 1000u) / frac_div[decimals]));
+    FM_LCD_PutString(line, FM_LCD_LL_GetRowSize(row), row);
+}
+#endif
+
 // --- Public handlers ---
 
 /**
@@ -99,6 +189,360 @@ void FM_CMD_HandleCount(const char *args)
     HAL_UART_Transmit_IT(&huart3, (uint8_t *)buf, strlen(buf));
 }
 
+/**
+ * Dumps the K-factor linearization table in a single DMA transfer.
+ * Format: "KTAB:<count>" followed by "<index>,<freq mHz>,<K x1000>" per point.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleKTableGet(const char *args)
+{
+    (void)args;
+    static char response[KTABLE_LINE_SIZE * (FM_KTABLE_POINTS + 1u)];
+    flash_k_point_t point;
+    size_t length;
+
+    length = (size_t)snprintf(response, sizeof(response), "KTAB:%u\r\n", FM_KTABLE_CountGet());
+
+    for (uint8_t i = 0; i < FM_KTABLE_POINTS; ++i) {
+        FM_KTABLE_PointGet(i, &point);
+        length += (size_t)snprintf(&response[length], sizeof(response) - length, "%u,%lu,%lu\r\n",
+                                   i, (unsigned long)point.freq, (unsigned long)point.k);
+    }
+
+    HAL_UART_Transmit_DMA(&huart3, (uint8_t *)response, length);
+}
+
+/**
+ * Writes one point of the K-factor table: "FM+KTAB=<index>,<freq mHz>,<K x1000>".
+ * @param args Full command line.
+ */
+void FM_CMD_HandleKTablePointSet(const char *args)
+{
+    unsigned long index;
+    unsigned long freq;
+    unsigned long k;
+    flash_k_point_t point;
+
+    if (sscanf(args + strlen("FM+KTAB="), "%lu,%lu,%lu", &index, &freq, &k) != 3
+        || index >= FM_KTABLE_POINTS) {
+        reply_status_(FMX_STATUS_INVALIDA_PARAM);
+        return;
+    }
+
+    point.freq = (uint32_t)freq;
+    point.k = (uint32_t)k;
+    reply_status_(FM_KTABLE_PointSet((uint8_t)index, point));
+}
+
+/**
+ * Sets how many table points are active: "FM+KTAB_N=<count>", 0 disables it.
+ * @param args Full command line.
+ */
+void FM_CMD_HandleKTableCountSet(const char *args)
+{
+    unsigned long count;
+
+    if (sscanf(args + strlen("FM+KTAB_N="), "%lu", &count) != 1 || count > FM_KTABLE_POINTS) {
+        reply_status_(FMX_STATUS_INVALIDA_PARAM);
+        return;
+    }
+
+    reply_status_(FM_KTABLE_CountSet((uint8_t)count));
+}
+
+/**
+ * Reports the batch state: "BATCH:<state>,<target>,<count>,<overshoot>,<overshoot vol x1000>".
+ * Target, count and overshoot are raw sensor pulses.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleBatchGet(const char *args)
+{
+    (void)args;
+    static char response[BATCH_LINE_SIZE];
+    fmx_batch_status_t batch = FMX_BATCH_StatusGet();
+
+    snprintf(response, sizeof(response), "BATCH:%u,%lu,%lu,%lu,%lu\r\n",
+             (unsigned)batch.state, (unsigned long)batch.target, (unsigned long)batch.count,
+             (unsigned long)batch.overshoot, (unsigned long)batch.overshoot_volume);
+    HAL_UART_Transmit_DMA(&huart3, (uint8_t *)response, strlen(response));
+}
+
+/**
+ * Starts a batch: "FM+BATCH=<volume x1000>[,<pre-close volume x1000>]".
+ * @param args Full command line.
+ */
+void FM_CMD_HandleBatchStart(const char *args)
+{
+    unsigned long volume;
+    unsigned long pre_close = 0;
+
+    if (sscanf(args + strlen("FM+BATCH="), "%lu,%lu", &volume, &pre_close) < 1) {
+        reply_status_(FMX_STATUS_INVALIDA_PARAM);
+        return;
+    }
+
+    reply_status_(FMX_BATCH_Start((ufp3_t)volume, (ufp3_t)pre_close));
+}
+
+/**
+ * Cancels the running batch and closes the valve.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleBatchStop(const char *args)
+{
+    (void)args;
+    FMX_BATCH_Stop();
+    reply_status_(FMX_STATUS_OK);
+}
+
+/**
+ * Reports the last published measurement:
+ * "MEAS:<seq>,<unix time>,<status>,<rate x1000>,<ACM x1000>,<TTL x1000>".
+ * All fields come from the same measurement window.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleMeasureGet(const char *args)
+{
+    (void)args;
+    static char response[MEASURE_LINE_SIZE];
+    fm_fmc_snapshot_t snapshot;
+
+    FM_FMC_SnapshotGet(&snapshot);
+
+    snprintf(response, sizeof(response), "MEAS:%lu,%lu,%u,%lu,%lu,%lu\r\n",
+             (unsigned long)snapshot.sequence, (unsigned long)snapshot.time_unix,
+             (unsigned)snapshot.status, (unsigned long)snapshot.rate,
+             (unsigned long)snapshot.acm, (unsigned long)snapshot.ttl);
+    HAL_UART_Transmit_DMA(&huart3, (uint8_t *)response, strlen(response));
+}
+
+/**
+ * Reports the measurement latency histogram:
+ * "LAT:<windows>,<max>,<bucket 0>,...,<bucket 15>", in LSE ticks (30.5 us).
+ * Bucket 0 is on time; bucket k counts latencies in [2^(k-1), 2^k) ticks.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleLatencyGet(const char *args)
+{
+    (void)args;
+    static char response[LATENCY_LINE_SIZE];
+    fmx_latency_t latency;
+    size_t length;
+
+    FMX_LatencyGet(&latency);
+
+    length = (size_t)snprintf(response, sizeof(response), "LAT:%lu,%lu",
+                              (unsigned long)latency.count, (unsigned long)latency.max);
+    for (uint32_t i = 0; i < FMX_LATENCY_BUCKETS; ++i) {
+        length += (size_t)snprintf(&response[length], sizeof(response) - length, ",%lu",
+                                   (unsigned long)latency.bucket[i]);
+    }
+    length += (size_t)snprintf(&response[length], sizeof(response) - length, "\r\n");
+
+    HAL_UART_Transmit_DMA(&huart3, (uint8_t *)response, length);
+}
+
+/**
+ * Clears the measurement latency histogram.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleLatencyReset(const char *args)
+{
+    (void)args;
+    FMX_LatencyReset();
+    reply_status_(FMX_STATUS_OK);
+}
+
+/**
+ * Reports CPU time and stop 2 residency, in milliseconds:
+ * "STATS:<awake>,<isr>,<other>,<stop>,<stop exits>",
+ * "WAKE:<timer>,<chunk>,<pulse>,<capture>,<key>,<uart>,<other>",
+ * "SCHED:<wakes>,<measure>,<lcd>,<log credit>,<bt>" from the wake scheduler,
+ * "CLOCK:<idle>,<ui>,<comms>,<flash>" awake time per clock profile,
+ * "STATE:<lcd>,<n>,<flash>,<n>,<mxc>,<n>" energy model states with their count
+ * and one "THR:<name>,<awake>" line per thread seen by ThreadX.
+ * tools/fm_energy.py turns the dump into a battery life projection.
+ * HAL interrupts are charged to the thread they preempt.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleStatsGet(const char *args)
+{
+    (void)args;
+    static char response[STATS_LINE_SIZE];
+    fmx_stats_t stats;
+    fmx_wake_count_t wake;
+    size_t length;
+
+    FMX_STATS_Get(&stats);
+    FMX_WAKE_CountGet(&wake);
+
+    length = (size_t)snprintf(response, sizeof(response), "STATS:%lu,%lu,%lu,%lu,%lu\r\nWAKE:",
+                              cycles_to_ms_(stats.cycles_total), cycles_to_ms_(stats.cycles_isr),
+                              cycles_to_ms_(stats.cycles_other),
+                              (unsigned long)((stats.stop_ticks * 1000u) / 2048u),
+                              (unsigned long)stats.stop_count);
+    for (uint32_t i = 0; i < FMX_STATS_WAKE_END; ++i) {
+        length += (size_t)snprintf(&response[length], sizeof(response) - length,
+                                   (i == 0) ? "%lu" : ",%lu", (unsigned long)stats.wake[i]);
+    }
+    length += (size_t)snprintf(&response[length], sizeof(response) - length, "\r\nSCHED:%lu",
+                               (unsigned long)wake.wakes);
+    for (uint32_t i = 0; i < FMX_WAKE_END; ++i) {
+        length += (size_t)snprintf(&response[length], sizeof(response) - length, ",%lu",
+                                   (unsigned long)wake.runs[i]);
+    }
+    length += (size_t)snprintf(&response[length], sizeof(response) - length, "\r\nCLOCK:");
+    for (uint32_t i = 0; i < FMX_CLOCK_END; ++i) {
+        length += (size_t)snprintf(&response[length], sizeof(response) - length,
+                                   (i == 0) ? "%lu" : ",%lu",
+                                   (unsigned long)(stats.cycles_profile[i]
+                                                   / (FMX_CLOCK_HzGet((fmx_clock_profile_t)i) / 1000u)));
+    }
+    length += (size_t)snprintf(&response[length], sizeof(response) - length, "\r\nSTATE:");
+    for (uint32_t i = 0; i < FMX_STATS_STATE_END; ++i) {
+        length += (size_t)snprintf(&response[length], sizeof(response) - length,
+                                   (i == 0) ? "%lu,%lu" : ",%lu,%lu",
+                                   (unsigned long)(stats.state_us[i] / 1000u),
+                                   (unsigned long)stats.state_count[i]);
+    }
+    length += (size_t)snprintf(&response[length], sizeof(response) - length, "\r\n");
+    for (uint32_t i = 0; i < FMX_STATS_THREADS; ++i) {
+        if (stats.thread[i].thread == NULL) {
+            break;
+        }
+        length += (size_t)snprintf(&response[length], sizeof(response) - length, "THR:%.31s,%lu\r\n",
+                                   stats.thread[i].thread->tx_thread_name,
+                                   cycles_to_ms_(stats.thread[i].cycles));
+    }
+
+    HAL_UART_Transmit_DMA(&huart3, (uint8_t *)response, length);
+}
+
+/**
+ * Clears the CPU time and stop 2 counters.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleStatsReset(const char *args)
+{
+    (void)args;
+    FMX_STATS_Reset();
+    reply_status_(FMX_STATUS_OK);
+}
+
+/**
+ * Dumps the stop 2 wake trace, oldest entry first: "TRACE:<entries>" and one
+ * "<boot>,<time>,<reason>,<active>" line per entry. time is in ThreadX ticks
+ * (10 ms), or unix seconds on boot entries (reason 254); active is in LSE
+ * ticks. tools/fm_trace_decode.py turns the dump into a timeline.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleTraceGet(const char *args)
+{
+    (void)args;
+    static char response[TRACE_LINE_SIZE];
+    static fmx_trace_entry_t entry[FMX_TRACE_LENGTH];
+    uint32_t count;
+    size_t length;
+
+    count = FMX_TRACE_Read(entry, FMX_TRACE_LENGTH);
+
+    length = (size_t)snprintf(response, sizeof(response), "TRACE:%lu\r\n", (unsigned long)count);
+    for (uint32_t i = 0; i < count; ++i) {
+        length += (size_t)snprintf(&response[length], sizeof(response) - length, "%u,%lu,%u,%u\r\n",
+                                   (unsigned)entry[i].boot, (unsigned long)entry[i].time,
+                                   (unsigned)entry[i].reason, (unsigned)entry[i].active);
+    }
+
+    HAL_UART_Transmit_DMA(&huart3, (uint8_t *)response, length);
+}
+
+/**
+ * Dumps what the PCF8553 is showing: "LCD:<valid>,<map>,<blink mask>", both
+ * maps as 20 bytes of hex in controller RAM order. valid is 0 before the first
+ * refresh or after an SPI error. tools/fm_lcd_decode.py renders the dump as
+ * the two digit rows, the unit characters and the symbols.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleLcdGet(const char *args)
+{
+    (void)args;
+    static char response[LCD_LINE_SIZE];
+    uint8_t map[PCF8553_RAM_SIZE];
+    uint8_t mask[PCF8553_RAM_SIZE];
+    uint8_t valid;
+    size_t length;
+
+    valid = FM_PCF8553_FrameGet(map, mask);
+
+    length = (size_t)snprintf(response, sizeof(response), "LCD:%u,", (unsigned)valid);
+    for (uint32_t i = 0; i < PCF8553_RAM_SIZE; ++i) {
+        length += (size_t)snprintf(&response[length], sizeof(response) - length, "%02X", map[i]);
+    }
+    response[length++] = ',';
+    for (uint32_t i = 0; i < PCF8553_RAM_SIZE; ++i) {
+        length += (size_t)snprintf(&response[length], sizeof(response) - length, "%02X", mask[i]);
+    }
+    length += (size_t)snprintf(&response[length], sizeof(response) - length, "\r\n");
+
+    HAL_UART_Transmit_DMA(&huart3, (uint8_t *)response, length);
+}
+
+#ifdef FM_BENCH
+/**
+ * Times one row render in DWT cycles (fmx_stats enables CYCCNT), before and
+ * after FM_LCD_PutUfp3, at the current core clock. Each render runs with
+ * interrupts masked and the LCD map saved and restored, so the frame of the
+ * main thread is left as it was.
+ * Format: "UFP3:<MHz>" and one "<row>,<decimals>,<snprintf cycles>,<ufp3 cycles>"
+ * line per case, averaged over a fixed set of values. Only built with FM_BENCH.
+ * @param args Optional argument string (unused).
+ */
+void FM_CMD_HandleUfp3Bench(const char *args)
+{
+    (void)args;
+    static const uint32_t values[] = { 0u, 7u, 1250u, 98765u, 1234567u, 45678901u, 999999999u, UINT32_MAX };
+    static char response[UFP3_LINE_SIZE * (1u + (FM_LCD_LL_ROWS * UFP3_DECIMALS))];
+    static uint8_t map[PCF8553_RAM_SIZE];
+    uint32_t before;
+    uint32_t after;
+    uint32_t start;
+    uint32_t primask;
+    size_t length;
+
+    length = (size_t)snprintf(response, sizeof(response), "UFP3:%lu\r\n",
+                              (unsigned long)(SystemCoreClock / 1000000u));
+
+    for (uint8_t row = FM_LCD_LL_ROW_1; row < FM_LCD_LL_ROWS; ++row) {
+        for (uint8_t decimals = 0; decimals < UFP3_DECIMALS; ++decimals) {
+            before = 0;
+            after = 0;
+            for (uint32_t i = 0; i < (sizeof(values) / sizeof(values[0])); ++i) {
+                primask = __get_PRIMASK();
+                __disable_irq();
+                memcpy(map, pcf8553_ram_map, PCF8553_RAM_SIZE);
+
+                start = DWT->CYCCNT;
+                ufp3_snprintf_(values[i], decimals, (fm_lcd_ll_row_t)row);
+                before += DWT->CYCCNT - start;
+
+                start = DWT->CYCCNT;
+                FM_LCD_PutUfp3(values[i], decimals, (row == FM_LCD_LL_ROW_1) ? ' ' : '0', (fm_lcd_ll_row_t)row);
+                after += DWT->CYCCNT - start;
+
+                memcpy(pcf8553_ram_map, map, PCF8553_RAM_SIZE);
+                __set_PRIMASK(primask);
+            }
+            length += (size_t)snprintf(&response[length], sizeof(response) - length, "%u,%u,%lu,%lu\r\n",
+                                       row + 1u, decimals,
+                                       (unsigned long)(before / (sizeof(values) / sizeof(values[0]))),
+                                       (unsigned long)(after / (sizeof(values) / sizeof(values[0]))));
+        }
+    }
+
+    HAL_UART_Transmit_DMA(&huart3, (uint8_t *)response, length);
+}
+#endif
+
 // --- API ---
 
 /**
@@ -54,6 +54,22 @@ void FM_CMD_ThreadEntry(ULONG input);
 void FM_CMD_HandleTemp(const char *args);
 void FM_CMD_HandleLogAll(const char *args);
 void FM_CMD_HandleCount(const char *args);
+void FM_CMD_HandleKTableGet(const char *args);
+void FM_CMD_HandleKTablePointSet(const char *args);
+void FM_CMD_HandleKTableCountSet(const char *args);
+void FM_CMD_HandleBatchGet(const char *args);
+void FM_CMD_HandleBatchStart(const char *args);
+void FM_CMD_HandleBatchStop(const char *args);
+void FM_CMD_HandleMeasureGet(const char *args);
+void FM_CMD_HandleLatencyGet(const char *args);
+void FM_CMD_HandleLatencyReset(const char *args);
+void FM_CMD_HandleStatsGet(const char *args);
+void FM_CMD_HandleStatsReset(const char *args);
+void FM_CMD_HandleTraceGet(const char *args);
+void FM_CMD_HandleLcdGet(const char *args);
+#ifdef FM_BENCH
+void FM_CMD_HandleUfp3Bench(const char *args);
+#endif
 
 #endif // FM_CMD_H_
 
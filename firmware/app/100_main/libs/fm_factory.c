@@ -24,7 +24,7 @@ static const fm_fmc_totalizer_t k_sensor_0 = {
     .rate.limit_high  = 1500000, // 1500 Hz
     .rate.limit_low   = 250,     // 0.1 Hz
     .rate.delta_t     = 1000,
-    .rate.filter      = 1,
+    .rate.filter      = FM_FMC_FILTER(FM_FMC_FILTER_EMA, 1),
     .ticket_number    = 0,
 };
 
@@ -42,7 +42,7 @@ static const fm_fmc_totalizer_t k_sensor_ai_25 = {
     .rate.limit_high  = 1500000,
     .rate.limit_low   = 250,
     .rate.delta_t     = 1000,
-    .rate.filter      = 1,
+    .rate.filter      = FM_FMC_FILTER(FM_FMC_FILTER_EMA, 1),
     .ticket_number    = 0,
 };
 
@@ -60,7 +60,7 @@ static const fm_fmc_totalizer_t k_sensor_ai_80 = {
     .rate.limit_high  = 1500000,
     .rate.limit_low   = 250,
     .rate.delta_t     = 1000,
-    .rate.filter      = 1,
+    .rate.filter      = FM_FMC_FILTER(FM_FMC_FILTER_EMA, 1),
     .ticket_number    = 0,
 };
 
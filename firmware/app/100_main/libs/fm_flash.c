@@ -6,6 +6,8 @@
 #include "main.h"
 #include "fm_flash.h"
 #include "fm_debug.h"
+#include "fmx_stats.h"
+#include <string.h>
 
 // --- Memory layout ---
 
@@ -18,6 +20,11 @@
 
 #define PAGE_SIZE               FLASH_PAGE_SIZE
 
+// --- State ---
+
+// Double ECC errors cleared by FM_FLASH_EccNmi; FM_FLASH_WordRead compares it.
+static volatile uint32_t ecc_errors;
+
 // --- Persistent data ---
 
 static flash_chip_info_t chip_info __attribute__((section(".FLASH_CHIP_Section"))) = {
@@ -57,6 +64,26 @@ uint16_t FM_FLASH_NewReset(void)
     return info.reset_counter;
 }
 
+/**
+ * Reads the K-factor linearization table from the device page.
+ * The caller checks magic and count; an erased page reads as 0xFF.
+ */
+flash_k_table_t FM_FLASH_KTableRead(void)
+{
+    flash_k_table_t table;
+    FM_FLASH_Read(FLASH_DEVICE_START, table.data, FM_FLASH_K_TABLE_SIZE);
+    return table;
+}
+
+/**
+ * Stores the K-factor linearization table in the device page.
+ * @param table Table to persist; the page is erased before programming.
+ */
+void FM_FLASH_KTableWrite(const flash_k_table_t *table)
+{
+    FM_FLASH_Write(FLASH_DEVICE_START, table->data, FM_FLASH_K_TABLE_SIZE);
+}
+
 /**
  * Writes to the Flash window emulating non-volatile storage.
  * @param address Absolute address to start writing.
@@ -89,6 +116,7 @@ uint32_t FM_FLASH_Write(uint32_t address, const uint8_t *data, uint16_t data_len
                         (aligned_length / FLASH_PAGE_SIZE);
     erase_cfg.Banks = FLASH_BANK_2;
 
+    FMX_STATS_StateBegin(FMX_STATS_STATE_FLASH);
     HAL_FLASH_Unlock();
     HAL_FLASHEx_Erase(&erase_cfg, &error_status);
 
@@ -103,9 +131,148 @@ uint32_t FM_FLASH_Write(uint32_t address, const uint8_t *data, uint16_t data_len
     }
 
     HAL_FLASH_Lock();
+    FMX_STATS_StateEnd(FMX_STATS_STATE_FLASH);
     return aligned_length;
 }
 
+/**
+ * Clears a double ECC error raised by a read of the log area.
+ * A power cut while a quad-word is being programmed can leave it with a
+ * double ECC error, and reading it raises the NMI. Called from NMI_Handler:
+ * inside the log the flag is cleared and counted, and the interrupted read
+ * returns a meaningless value that FM_FLASH_WordRead reports as unreadable.
+ * @return 1 if the NMI was such an error, 0 for any other source or address.
+ */
+uint8_t FM_FLASH_EccNmi(void)
+{
+    uint32_t eccr = FLASH->ECCR;
+    uint32_t address;
+
+    if (((eccr & FLASH_ECCR_ECCD) == 0u) || ((eccr & FLASH_ECCR_SYSF_ECC) != 0u) ||
+        ((eccr & FLASH_ECCR_BK_ECC) == 0u)) {
+        return 0;
+    }
+
+    // ADDR_ECC is the offset inside the bank; the log lives in bank 2.
+    address = FLASH_START + (eccr & FLASH_ECCR_ADDR_ECC);
+    if ((address < FM_FLASH_LOG_START) || (address > FM_FLASH_LOG_END)) {
+        return 0;
+    }
+
+    // ECCD and ECCC are cleared by writing 1: leave ECCC as it is.
+    FLASH->ECCR = eccr & ~FLASH_ECCR_ECCC;
+    ecc_errors++;
+    return 1;
+}
+
+/**
+ * Reads a Flash word that a power cut may have left half programmed.
+ * @param address Word address, aligned to 4 bytes.
+ * @param word Value read; meaningless when the function returns 0.
+ * @return 1 if the word read cleanly, 0 on a double ECC error.
+ */
+uint8_t FM_FLASH_WordRead(uint32_t address, uint32_t *word)
+{
+    uint32_t errors = ecc_errors;
+
+    *word = *(const volatile uint32_t *)address;
+
+    // The NMI is taken after the load; make sure it ran before comparing.
+    __DSB();
+    __ISB();
+    return (ecc_errors == errors);
+}
+
+/**
+ * Checks that a Flash range reads as erased (all 0xFF).
+ * A word with a double ECC error is not erased.
+ * @param address Base address, aligned to 4 bytes.
+ * @param length Number of bytes, multiple of 4.
+ * @return 1 if every word is erased.
+ */
+uint8_t FM_FLASH_IsErased(uint32_t address, uint32_t length)
+{
+    uint32_t word;
+
+    for (uint32_t offset = 0; offset < length; offset += sizeof(uint32_t)) {
+        if (!FM_FLASH_WordRead(address + offset, &word) || (word != UINT32_MAX)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Erases the Flash page that holds an address.
+ * @param address Any address inside the page.
+ * @return Number of bytes erased, 0 on error.
+ */
+uint32_t FM_FLASH_PageErase(uint32_t address)
+{
+    uint32_t error_status = 0;
+    HAL_StatusTypeDef status;
+    FLASH_EraseInitTypeDef erase_cfg = {0};
+
+    if (address < FLASH_START || address > FLASH_END) {
+        FM_DEBUG_LedError(1);
+        return 0;
+    }
+
+    erase_cfg.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase_cfg.Page = (address - FLASH_START) / PAGE_SIZE;
+    erase_cfg.NbPages = 1u;
+    erase_cfg.Banks = FLASH_BANK_2;
+
+    FMX_STATS_StateBegin(FMX_STATS_STATE_FLASH);
+    HAL_FLASH_Unlock();
+    status = HAL_FLASHEx_Erase(&erase_cfg, &error_status);
+    HAL_FLASH_Lock();
+    FMX_STATS_StateEnd(FMX_STATS_STATE_FLASH);
+
+    return (status == HAL_OK) ? PAGE_SIZE : 0u;
+}
+
+/**
+ * Programs quad-words into already erased Flash, without erasing first.
+ * Each quad-word is written once, in increasing address order: the last
+ * quad-word of the block lands last.
+ * @param address Absolute address to start writing (must align to FM_FLASH_BLOCK_SIZE).
+ * @param data Pointer to the data block.
+ * @param data_length Number of bytes to program, rounded down to FM_FLASH_BLOCK_SIZE.
+ * @return Number of bytes programmed; stops at the first failed quad-word.
+ */
+uint32_t FM_FLASH_Program(uint32_t address, const uint8_t *data, uint16_t data_length)
+{
+    uint8_t quad_word[FM_FLASH_BLOCK_SIZE];
+    uint16_t aligned_length = data_length - (data_length % FM_FLASH_BLOCK_SIZE);
+    uint32_t offset;
+
+    if (address < FLASH_START || (address + aligned_length) > FLASH_END) {
+        FM_DEBUG_LedError(1);
+        return 0;
+    }
+
+    if ((address % FM_FLASH_BLOCK_SIZE) != 0u || aligned_length == 0u) {
+        FM_DEBUG_LedError(1);
+        return 0;
+    }
+
+    FMX_STATS_StateBegin(FMX_STATS_STATE_FLASH);
+    HAL_FLASH_Unlock();
+
+    for (offset = 0; offset < aligned_length; offset += FM_FLASH_BLOCK_SIZE) {
+        memcpy(quad_word, &data[offset], FM_FLASH_BLOCK_SIZE);
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_QUADWORD, address + offset,
+                              (uint32_t)quad_word) != HAL_OK) {
+            break;
+        }
+    }
+
+    HAL_FLASH_Lock();
+    FMX_STATS_StateEnd(FMX_STATS_STATE_FLASH);
+    return offset;
+}
+
 /**
  * Reads bytes from Flash into RAM.
  * @param address Base address in Flash.
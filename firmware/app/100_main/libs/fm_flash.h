@@ -13,6 +13,10 @@
 #define FM_FLASH_BLOCK_SIZE        (16u)
 #define FM_FLASH_CHIP_INFO_SIZE    (FM_FLASH_BLOCK_SIZE * 1u)
 
+#define FM_FLASH_K_TABLE_POINTS    (16u)
+#define FM_FLASH_K_TABLE_MAGIC     (0x4B544231u)   // "KTB1"
+#define FM_FLASH_K_TABLE_SIZE      (FM_FLASH_BLOCK_SIZE * 9u)
+
 #define FM_FLASH_LOG_START         (0x08104000u)
 #define FM_FLASH_LOG_END           (0x081FFFFFu)
 #define FM_FLASH_LOG_SIZE          ((FM_FLASH_LOG_END - FM_FLASH_LOG_START) + 1u)
@@ -29,11 +33,38 @@ typedef union {
     };
 } flash_chip_info_t;
 
+/** One linearization point: sensor frequency and the K factor measured there. */
+typedef struct {
+    uint32_t freq;     ///< Sensor frequency in mHz.
+    uint32_t k;        ///< K factor in pulses per liter x1000 (same as factor_cal).
+} flash_k_point_t;
+
+/** K-factor linearization table kept in the device page of Flash. */
+typedef union {
+    uint8_t data[FM_FLASH_K_TABLE_SIZE];
+    struct {
+        uint32_t        magic;      ///< FM_FLASH_K_TABLE_MAGIC once written.
+        uint8_t         count;      ///< Points in use, from the start of point[].
+        uint8_t         reserved_1;
+        uint16_t        reserved_2;
+        uint32_t        reserved_3;
+        uint32_t        reserved_4;
+        flash_k_point_t point[FM_FLASH_K_TABLE_POINTS];
+    };
+} flash_k_table_t;
+
 // --- API ---
 
 flash_chip_info_t FM_FLASH_ChipInfoRead(void);
 void FM_FLASH_ChipInfoWrite(flash_chip_info_t info);
 uint16_t FM_FLASH_NewReset(void);
+flash_k_table_t FM_FLASH_KTableRead(void);
+void FM_FLASH_KTableWrite(const flash_k_table_t *table);
+uint8_t  FM_FLASH_EccNmi(void);
+uint8_t  FM_FLASH_WordRead(uint32_t address, uint32_t *word);
+uint8_t  FM_FLASH_IsErased(uint32_t address, uint32_t length);
+uint32_t FM_FLASH_PageErase(uint32_t address);
+uint32_t FM_FLASH_Program(uint32_t address, const uint8_t *data, uint16_t data_length);
 uint32_t FM_FLASH_Read(uint32_t address, uint8_t *data, uint16_t data_length);
 uint32_t FM_FLASH_Write(uint32_t address, const uint8_t *data, uint16_t data_length);
 
@@ -12,7 +12,33 @@
 #include "fm_factory.h"
 #include "fm_lcd.h"
 #include "fm_debug.h"
+#include "fm_ktable.h"
 #include "fmx.h"
+#include <stddef.h>
+
+// --- Definiciones ---
+
+/*
+ * El LPTIM3 cuenta a 32.768 kHz = 2^15 Hz. factor_r incluye ese valor, por lo
+ * que el motor entero lo separa como un desplazamiento del conteo de pulsos.
+ */
+#define LPTIM_CLK_SHIFT     15u
+#define LPTIM_CLK_HZ        (1u << LPTIM_CLK_SHIFT)
+
+// Limite inferior de la mantisa normalizada (2^31).
+#define Q_MUL_MIN           2147483648.0
+#define Q_SHIFT_MAX         63u
+
+/*
+ * Un firmware nuevo arranca sobre la RAM BACKUP del anterior: los campos del
+ * formato original no se mueven y los agregados van despues de ticket_number.
+ */
+_Static_assert(offsetof(fm_fmc_totalizer_t, factor_k) == 40u, "backup layout changed");
+_Static_assert(offsetof(fm_fmc_totalizer_t, rate) == 56u, "backup layout changed");
+_Static_assert(offsetof(fm_fmc_totalizer_t, ticket_number) == 96u, "backup layout changed");
+
+#define MEDIAN_LENGTH       5u
+
 // --- Tipos ---
 
 /*
@@ -22,6 +48,18 @@
  * Cada estructura, union y enumeracion nueva se declara mediante typedef.
  */
 
+/*
+ * Estado del filtro de caudal. No se guarda en backup: tras un reset el filtro
+ * arranca con la primera muestra, igual que al pasar a FMX_ACK_RATE_STARTED.
+ */
+typedef struct {
+    uint64_t ema_acc;                          // Caudal * largo (EMA).
+    uint64_t sum;                              // Suma del anillo (promedio).
+    ufp3_t   ring[FM_FMC_FILTER_AVERAGE_MAX];  // Ultimas muestras.
+    uint8_t  index;                            // Proxima posicion del anillo.
+    uint8_t  primed;                           // Ya recibio la primera muestra.
+} fmc_filter_state_t;
+
 // --- Datos constantes ---
 // Segundos por unidad de tiempo; coincide con fm_fmc_time_unit_t.
 const uint32_t seconds_in[] =
@@ -55,10 +93,320 @@ fm_fmc_vol_data_t vol_unit_list[] = {
  */
 fm_fmc_totalizer_t totalizer __attribute__((section(".RAM_BACKUP_Section")));
 
+static fmc_filter_state_t rate_filter;
+
+// K de la tabla de linealizacion para la ultima ventana, 0 sin linealizacion.
+static ufp3_t lin_k;
+
+/*
+ * Doble buffer de la medicion publicada. snapshot_seq es impar mientras se
+ * escribe; la publicacion n (snapshot_seq / 2) esta en snapshot_buf[n & 1].
+ * Los escritores (hilo de medicion y resets desde los menus) se serializan
+ * con FMX_MeasureLock; los lectores no bloquean.
+ */
+static fm_fmc_snapshot_t snapshot_buf[2];
+static volatile uint32_t snapshot_seq;
+
 // Prototipos de funciones privadas.
 
+static uint64_t MulShift(uint64_t value, uint32_t mul, uint8_t shift, uint64_t *rem);
+static void     QFormatSet(double factor, uint32_t *mul, uint8_t *shift);
+static ufp3_t   Ufp3Saturate(uint64_t value);
+static void     VolumeAdd(ufp3_t *volume, uint64_t *rem, uint32_t pulse_delta);
+static void     VolumeResync(void);
+static uint8_t  TotalizerValid(const fm_fmc_totalizer_t *t);
+static uint64_t LinPulses(uint64_t pulses, uint32_t *frac);
+static ufp3_t   RateFilter(ufp3_t sample);
+static ufp3_t   Median5(const ufp3_t *ring);
+static void     SnapshotWrite(fmx_ack_t status, uint32_t time_unix);
+static void     SnapshotRefresh(void);
+
 // Cuerpos de funciones privadas.
 
+/*
+ * Configuracion leida de la RAM BACKUP dentro de rango. Con la RAM sin
+ * inicializar o escrita por un firmware de otro formato, vol_unit indexaria
+ * fuera de las tablas y factor_cal podria ser 0.
+ */
+static uint8_t TotalizerValid(const fm_fmc_totalizer_t *t)
+{
+    return (t->vol_unit < VOL_UNIT_END) && (t->time_unit < TIME_UNIT_END) &&
+           (t->factor_cal >= FM_FMC_FACTOR_CAL_MIN) &&
+           (t->factor_cal <= FM_FMC_FACTOR_CAL_MAX) &&
+           (t->vol_pf_sel <= FM_FMC_FP_SEL_3) &&
+           (t->rate.rate_pf_sel <= FM_FMC_FP_SEL_3);
+}
+
+/*
+ * Devuelve floor(value * mul / 2^shift) sin perder bits intermedios.
+ * El producto de 96 bits se arma con dos multiplicaciones 32x32 -> 64, que el
+ * Cortex-M33 resuelve con UMULL. Satura en UINT64_MAX si no entra en 64 bits.
+ * Si rem no es NULL devuelve ahi los shift bits bajos descartados del producto.
+ */
+static uint64_t MulShift(uint64_t value, uint32_t mul, uint8_t shift, uint64_t *rem)
+{
+    uint64_t prod_lo;
+    uint64_t prod_hi;
+
+    prod_lo = (uint64_t)(uint32_t)value * mul;
+    prod_hi = (value >> 32) * mul + (prod_lo >> 32);
+
+    if (rem != NULL)
+    {
+        if (shift > 32u)
+        {
+            *rem = ((prod_hi & ((1ull << (shift - 32u)) - 1u)) << 32)
+                 | (uint32_t)prod_lo;
+        }
+        else
+        {
+            *rem = (uint32_t)prod_lo & ((1ull << shift) - 1u);
+        }
+    }
+
+    if (shift >= 32u)
+    {
+        return prod_hi >> (shift - 32u);
+    }
+
+    if ((prod_hi >> (32u + shift)) != 0u)
+    {
+        return UINT64_MAX;
+    }
+
+    return (prod_hi << (32u - shift)) | ((uint32_t)prod_lo >> shift);
+}
+
+/*
+ * Convierte un factor positivo a mantisa de 32 bits y desplazamiento, de modo
+ * que factor ~= mul / 2^shift con error relativo menor a 2^-31.
+ * Solo se usa al configurar; el calculo por segundo queda en enteros.
+ */
+static void QFormatSet(double factor, uint32_t *mul, uint8_t *shift)
+{
+    uint8_t shift_new = 0;
+
+    if (factor <= 0)
+    {
+        *mul = 0;
+        *shift = 0;
+        return;
+    }
+
+    while ((factor < Q_MUL_MIN) && (shift_new < Q_SHIFT_MAX))
+    {
+        factor *= 2;
+        shift_new++;
+    }
+
+    factor += 0.5;
+    if (factor >= (2 * Q_MUL_MIN))
+    {
+        // Factores mayores a 2^32 no son alcanzables desde el setup.
+        *mul = UINT32_MAX;
+    }
+    else
+    {
+        *mul = (uint32_t)factor;
+    }
+    *shift = shift_new;
+}
+
+// Recorta un resultado de 64 bits al rango de ufp3_t.
+static ufp3_t Ufp3Saturate(uint64_t value)
+{
+    if (value > UINT32_MAX)
+    {
+        return UINT32_MAX;
+    }
+    return (ufp3_t)value;
+}
+
+/*
+ * Suma pulse_delta * vol_mul / 2^vol_shift al volumen, arrastrando en rem la
+ * fraccion que todavia no completa una unidad (x1000). Se cumple siempre que
+ * volume * 2^vol_shift + rem == pulsos * vol_mul, por lo que el resultado es
+ * identico a recalcular desde el contador de pulsos completo.
+ */
+static void VolumeAdd(ufp3_t *volume, uint64_t *rem, uint32_t pulse_delta)
+{
+    uint64_t add;
+    uint64_t mask;
+    uint64_t frac;
+    uint64_t volume_new;
+
+    add  = (uint64_t)pulse_delta * totalizer.vol_mul;
+    mask = (1ull << totalizer.vol_shift) - 1u;
+
+    // vol_shift <= 63, la suma de dos valores menores a 2^vol_shift entra en 64 bits.
+    frac = (add & mask) + *rem;
+    *rem = frac & mask;
+
+    volume_new = (uint64_t)*volume
+               + (add >> totalizer.vol_shift)
+               + (frac >> totalizer.vol_shift);
+    *volume = Ufp3Saturate(volume_new);
+}
+
+/*
+ * Convierte pulsos medidos con K = lin_k en pulsos equivalentes al factor de
+ * calibracion: pulses * factor_cal / lin_k. Con frac no NULL arrastra la
+ * fraccion en Q32 entre ventanas para no perder volumen por truncamiento.
+ * pulses < 2^32 y factor_cal < 2^27, el producto entra en 64 bits.
+ */
+static uint64_t LinPulses(uint64_t pulses, uint32_t *frac)
+{
+    uint64_t num;
+    uint64_t result;
+    uint64_t frac_new;
+
+    num = pulses * totalizer.factor_cal;
+    result = num / lin_k;
+
+    if (frac != NULL)
+    {
+        frac_new = (uint64_t)*frac + (((num % lin_k) << 32) / lin_k);
+        result += frac_new >> 32;
+        *frac = (uint32_t)frac_new;
+    }
+
+    return result;
+}
+
+/*
+ * Etapa de filtro entre la medicion y el caudal en cache, segun
+ * totalizer.rate.filter. Solo enteros y O(1) por muestra: la EMA guarda el
+ * caudal multiplicado por el largo, el promedio mantiene la suma del anillo y
+ * la mediana ordena siempre 5 valores.
+ */
+static ufp3_t RateFilter(ufp3_t sample)
+{
+    fm_fmc_filter_t type;
+    uint8_t length;
+    uint8_t i;
+
+    type = (fm_fmc_filter_t)(totalizer.rate.filter >> 8);
+    length = (uint8_t)(totalizer.rate.filter & 0xFFu);
+
+    if ((length <= 1u) && (type != FM_FMC_FILTER_MEDIAN_5))
+    {
+        return sample;
+    }
+    if (length > FM_FMC_FILTER_AVERAGE_MAX)
+    {
+        length = FM_FMC_FILTER_AVERAGE_MAX;
+    }
+
+    // La primera muestra llena el estado: sin rampa desde cero.
+    if (!rate_filter.primed)
+    {
+        rate_filter.primed = 1;
+        rate_filter.index = 0;
+        rate_filter.ema_acc = (uint64_t)sample * length;
+        rate_filter.sum = (uint64_t)sample * length;
+        for (i = 0; i < FM_FMC_FILTER_AVERAGE_MAX; i++)
+        {
+            rate_filter.ring[i] = sample;
+        }
+        return sample;
+    }
+
+    switch (type)
+    {
+    case FM_FMC_FILTER_EMA:
+        // acc = acc - acc / L + x: con x constante acc queda en x * L.
+        rate_filter.ema_acc -= rate_filter.ema_acc / length;
+        rate_filter.ema_acc += sample;
+        return (ufp3_t)(rate_filter.ema_acc / length);
+
+    case FM_FMC_FILTER_AVERAGE:
+        rate_filter.sum -= rate_filter.ring[rate_filter.index];
+        rate_filter.sum += sample;
+        rate_filter.ring[rate_filter.index] = sample;
+        rate_filter.index = (rate_filter.index + 1u) % length;
+        return (ufp3_t)(rate_filter.sum / length);
+
+    case FM_FMC_FILTER_MEDIAN_5:
+        rate_filter.ring[rate_filter.index] = sample;
+        rate_filter.index = (rate_filter.index + 1u) % MEDIAN_LENGTH;
+        return Median5(rate_filter.ring);
+
+    default:
+        return sample;
+    }
+}
+
+// Mediana de 5 valores con 7 comparaciones, sin modificar el anillo.
+static ufp3_t Median5(const ufp3_t *ring)
+{
+    ufp3_t a = ring[0], b = ring[1], c = ring[2], d = ring[3], e = ring[4];
+    ufp3_t tmp;
+
+    // Ordena (a, b) y (c, d), descarta el menor de los minimos.
+    if (a > b) { tmp = a; a = b; b = tmp; }
+    if (c > d) { tmp = c; c = d; d = tmp; }
+    if (a < c) { a = e; if (a > b) { tmp = a; a = b; b = tmp; } }
+    else       { c = e; if (c > d) { tmp = c; c = d; d = tmp; } }
+
+    // Con 4 valores restantes, descarta otra vez el menor de los minimos.
+    if (a < c) { return (b < c) ? b : c; }
+    return (d < a) ? d : a;
+}
+
+/*
+ * Recalcula ACM, TTL y sus restos desde los contadores de pulsos. Necesario
+ * cada vez que cambia vol_mul, y al arrancar para partir de un estado exacto.
+ */
+static void VolumeResync(void)
+{
+    totalizer.acm = Ufp3Saturate(MulShift(totalizer.pulse_acm,
+                                          totalizer.vol_mul,
+                                          totalizer.vol_shift,
+                                          &totalizer.acm_rem));
+    totalizer.ttl = Ufp3Saturate(MulShift(totalizer.pulse_ttl,
+                                          totalizer.vol_mul,
+                                          totalizer.vol_shift,
+                                          &totalizer.ttl_rem));
+}
+
+/*
+ * Publica el estado actual del totalizador en el buffer libre. Los lectores
+ * siguen usando el otro buffer mientras dura la escritura.
+ */
+static void SnapshotWrite(fmx_ack_t status, uint32_t time_unix)
+{
+    fm_fmc_snapshot_t *next;
+    uint32_t seq;
+
+    seq = snapshot_seq + 1u;
+    snapshot_seq = seq;
+    __DMB();
+
+    next = &snapshot_buf[((seq + 1u) >> 1) & 1u];
+    next->rate = totalizer.rate.rate;
+    next->acm = totalizer.acm;
+    next->ttl = totalizer.ttl;
+    next->pulse_acm = totalizer.pulse_acm;
+    next->pulse_ttl = totalizer.pulse_ttl;
+    next->status = status;
+    next->time_unix = time_unix;
+    next->sequence = (seq + 1u) >> 1;
+
+    __DMB();
+    snapshot_seq = seq + 1u;
+}
+
+/*
+ * Vuelve a publicar tras un reset de ACM/TTL o un cambio de configuracion,
+ * para no mostrar el valor viejo hasta la proxima ventana.
+ */
+static void SnapshotRefresh(void)
+{
+    const fm_fmc_snapshot_t *last = &snapshot_buf[(snapshot_seq >> 1) & 1u];
+
+    SnapshotWrite(last->status, last->time_unix);
+}
+
 // Cuerpos de funciones publicas.
 
 /**
@@ -68,36 +416,52 @@ fm_fmc_totalizer_t totalizer __attribute__((section(".RAM_BACKUP_Section")));
  * @details
  * Copia el preset desde la RAM de respaldo y recalcula factor_k.
  * Ademas actualiza factor_r segun la base de tiempo antes de habilitar la UI.
+ * Ambos factores se guardan tambien como reciprocos en punto fijo, que son los
+ * que usan FM_FMC_PulseAdd y FM_FMC_RateCalc. ACM y TTL se recalculan
+ * completos desde los pulsos, de modo que tras un reset con VBAT el
+ * totalizador incremental parte del mismo valor exacto.
+ * Si la configuracion esta fuera de rango se cargan los valores de fabrica.
+ * Si magic no coincide, el final de la estructura viene de un formato
+ * anterior: todo se recalcula salvo lin_frac, que arranca en 0.
  */
 void FM_FMC_Init(sensors_list_t sensor)
 {
     totalizer = FM_FACTORY_TotalizerGet(sensor);
+    if (!TotalizerValid(&totalizer))
+    {
+        totalizer = FM_FACTORY_TotalizerGet(FM_FACTORY_SENSOR_0);
+    }
+    if (totalizer.magic != FM_FMC_TOTALIZER_MAGIC)
+    {
+        totalizer.lin_frac = 0;
+        totalizer.magic = FM_FMC_TOTALIZER_MAGIC;
+    }
+    FM_FMC_RateFilterReset();
+    FM_KTABLE_Init();
+    lin_k = 0;
     totalizer.factor_k = FM_FMC_FactorKCalc(totalizer.factor_cal, totalizer.vol_unit);
-    totalizer.rate.factor_r = FM_FMC_FactorRateCalc(totalizer.factor_k, totalizer.time_unit);
+    QFormatSet(1000 / totalizer.factor_k, &totalizer.vol_mul, &totalizer.vol_shift);
+    VolumeResync();
+    FM_FMC_FactorRateSet(FM_FMC_FactorRateCalc(totalizer.factor_k, totalizer.time_unit));
+    SnapshotRefresh();
 }
 
 /**
- * @brief Calcula el volumen acumulado (ACM) desde los contadores de pulsos.
+ * @brief Devuelve el volumen acumulado (ACM).
  * @return Volumen en punto fijo (x1000).
  * @details
- * Usa los pulsos acumulados en backup SRAM y aplica factor_k.
- * Convierte el resultado a ufp3_t (x1000) y actualiza totalizer.acm en cache.
+ * FM_FMC_PulseAdd actualiza el ACM en forma incremental con el resto guardado
+ * en backup SRAM, por lo que la lectura es O(1) y no divide.
+ * El valor satura si excede el rango de ufp3_t.
  */
 ufp3_t FM_FMC_AcmCalc()
 {
-    double acm;
-
-    acm = totalizer.pulse_acm;
-    acm /= totalizer.factor_k;
-    acm *= 1000;
-    totalizer.acm = (ufp3_t) acm;
-
     return totalizer.acm;
 }
 
 /**
  * @brief Devuelve el volumen ACM almacenado en cache.
- * @note No recalcula; invocar FM_FMC_AcmCalc luego de sumar nuevos pulsos.
+ * @note Se mantiene al dia en cada FM_FMC_PulseAdd.
  */
 ufp3_t FM_FMC_AcmGet()
 {
@@ -121,7 +485,9 @@ uint64_t FM_FMC_AcmGetPulse()
 void FM_FMC_AcmReset()
 {
     totalizer.acm = 0;
+    totalizer.acm_rem = 0;
     totalizer.pulse_acm = 0;
+    SnapshotRefresh();
 }
 
 /**
@@ -130,9 +496,26 @@ void FM_FMC_AcmReset()
  * La capa de interrupcion activa esta rutina.
  * FM_FMC_RateCalc consume los datos
  * fuera de la ISR.
+ * Con la tabla de linealizacion activa evalua K a la frecuencia de la ventana
+ * y guarda delta_p ya corregido; el FM_FMC_PulseAdd siguiente usa el mismo K.
+ * @note Debe llamarse antes de FM_FMC_PulseAdd en cada ventana.
  */
-void FM_FMC_CaptureSet(uint16_t pulse, uint16_t time)
+void FM_FMC_CaptureSet(uint32_t pulse, uint32_t time)
 {
+    uint64_t freq = 0;
+
+    if (time != 0)
+    {
+        // Frecuencia en mHz; pulse < 2^32 y 32768000 < 2^25.
+        freq = (uint64_t)pulse * LPTIM_CLK_HZ * 1000u / time;
+    }
+    lin_k = FM_KTABLE_Eval((freq > UINT32_MAX) ? UINT32_MAX : (uint32_t)freq);
+
+    if (lin_k != 0)
+    {
+        pulse = Ufp3Saturate(LinPulses(pulse, NULL));
+    }
+
     totalizer.rate.delta_p = pulse;
     totalizer.rate.delta_t = time;
 }
@@ -207,6 +590,8 @@ double FM_FMC_FactorKGet()
  * @return 1 si se acepta el valor, 0 en caso contrario.
  * @details
  * Mantiene el entorno consistente validando contra los limites de calibracion.
+ * Recalcula el reciproco en punto fijo usado por ACM y TTL y vuelve a
+ * sincronizar ambos totales con el nuevo factor.
  */
 uint32_t FM_FMC_FactorKSet(ufp3_t factor_k)
 {
@@ -215,6 +600,8 @@ uint32_t FM_FMC_FactorKSet(ufp3_t factor_k)
     if ((factor_k > FM_FMC_FACTOR_CAL_MIN) && (factor_k < FM_FMC_FACTOR_CAL_MAX))
     {
         totalizer.factor_k = factor_k;
+        QFormatSet(1000 / totalizer.factor_k, &totalizer.vol_mul, &totalizer.vol_shift);
+        VolumeResync();
     }
     else
     {
@@ -232,12 +619,13 @@ uint32_t FM_FMC_FactorKSet(ufp3_t factor_k)
  * Parte de 32768 pulsos por segundo generados por el LPTIM.
  * Aplica factor_k para
  * obtener volumen por pulso y escala por seconds_in[time_unit].
+ * Se llama solo al configurar; FM_FMC_FactorRateSet lo pasa a punto fijo.
  */
 double FM_FMC_FactorRateCalc(double factor_k, fm_fmc_time_unit_t time_unit)
 {
     double factor_r;
 
-    factor_r = 32768.0;
+    factor_r = LPTIM_CLK_HZ;
     factor_r /= factor_k;
     factor_r *= seconds_in[time_unit];
 
@@ -250,6 +638,8 @@ double FM_FMC_FactorRateCalc(double factor_k, fm_fmc_time_unit_t time_unit)
  * @return FMX_STATUS_OK si es positivo, FMX_STATUS_ERROR en caso contrario.
  * @details
  * En caso de recibir un valor no positivo fuerza un fallback seguro igual a 1.
+ * Guarda factor_r * 1000 / 32768 en punto fijo (rate_mul, rate_shift) para
+ * que FM_FMC_RateCalc no use aritmetica double.
  */
 fmx_status_t FM_FMC_FactorRateSet(double factor_rate)
 {
@@ -265,6 +655,10 @@ fmx_status_t FM_FMC_FactorRateSet(double factor_rate)
         status = FMX_STATUS_ERROR;
     }
 
+    QFormatSet(totalizer.rate.factor_r * 1000 / LPTIM_CLK_HZ,
+               &totalizer.rate_mul,
+               &totalizer.rate_shift);
+
     return status;
 }
 
@@ -282,12 +676,106 @@ fm_fmc_totalizer_t FM_FMC_GetEnviroment(void)
 /**
  * @brief Suma un delta de pulsos a los acumuladores de ACM y TTL.
  * @details
- * Mantiene sincronizados los contadores antes de recalcular ACM o TTL.
+ * Mantiene sincronizados los contadores y convierte solo el delta a volumen,
+ * arrastrando la fraccion restante en acm_rem y ttl_rem (backup SRAM).
+ * Con la tabla de linealizacion activa el delta se convierte antes a pulsos
+ * equivalentes a factor_cal, con el K de la ultima FM_FMC_CaptureSet. Asi
+ * pulse_acm y pulse_ttl siguen siendo exactos respecto de vol_mul y un cambio
+ * de unidad o de factor_cal se resincroniza igual que sin tabla.
  */
 void FM_FMC_PulseAdd(uint32_t pulse_delta)
 {
+    if (lin_k != 0)
+    {
+        pulse_delta = Ufp3Saturate(LinPulses(pulse_delta, &totalizer.lin_frac));
+    }
+
     totalizer.pulse_acm += pulse_delta;
     totalizer.pulse_ttl += pulse_delta;
+
+    VolumeAdd(&totalizer.acm, &totalizer.acm_rem, pulse_delta);
+    VolumeAdd(&totalizer.ttl, &totalizer.ttl_rem, pulse_delta);
+}
+
+/**
+ * @brief Convierte un volumen en la cantidad de pulsos del sensor que lo miden.
+ * @param volume Volumen en la unidad activa (x1000).
+ * @return Pulsos crudos, redondeados al mas cercano.
+ * @details
+ * Usa factor_k y, con la tabla de linealizacion activa, el K de la ultima
+ * ventana. Se llama al programar un batch, no en el lazo de medicion.
+ */
+uint32_t FM_FMC_VolumeToPulses(ufp3_t volume)
+{
+    double pulses;
+
+    pulses = (double)volume * totalizer.factor_k / 1000;
+
+    if (lin_k != 0)
+    {
+        pulses = pulses * lin_k / totalizer.factor_cal;
+    }
+
+    pulses += 0.5;
+    if (pulses >= (double)UINT32_MAX)
+    {
+        return UINT32_MAX;
+    }
+    return (uint32_t)pulses;
+}
+
+/**
+ * @brief Convierte pulsos crudos del sensor en volumen de la unidad activa.
+ * @return Volumen en punto fijo (x1000), truncado.
+ * @note Misma conversion que FM_FMC_PulseAdd, sin arrastrar restos.
+ */
+ufp3_t FM_FMC_PulsesToVolume(uint32_t pulses)
+{
+    uint64_t value = pulses;
+
+    if (lin_k != 0)
+    {
+        value = LinPulses(value, NULL);
+    }
+
+    return Ufp3Saturate(MulShift(value, totalizer.vol_mul, totalizer.vol_shift, NULL));
+}
+
+/**
+ * @brief Publica la medicion de la ventana que acaba de cerrar.
+ * @param status Estado del caudal en la ventana.
+ * @param time_unix Hora del RTC al cerrar la ventana.
+ * @note Llamar una vez por ciclo, despues de FM_FMC_RateCalc, con
+ *       FMX_MeasureLock tomado: el doble buffer admite un escritor a la vez.
+ */
+void FM_FMC_SnapshotPublish(fmx_ack_t status, uint32_t time_unix)
+{
+    SnapshotWrite(status, time_unix);
+}
+
+/**
+ * @brief Copia la ultima medicion publicada, sin bloquear.
+ * @param snapshot Destino de la copia.
+ * @details
+ * Lee el buffer de la ultima publicacion completa y verifica con snapshot_seq
+ * que el escritor no haya empezado a reescribirlo durante la copia; eso
+ * requiere dos publicaciones en el medio, por lo que el reintento es raro.
+ * Se puede llamar desde cualquier hilo o interrupcion.
+ */
+void FM_FMC_SnapshotGet(fm_fmc_snapshot_t *snapshot)
+{
+    uint32_t seq_start;
+    uint32_t seq_end;
+
+    do
+    {
+        seq_start = snapshot_seq;
+        __DMB();
+        *snapshot = snapshot_buf[(seq_start >> 1) & 1u];
+        __DMB();
+        seq_end = snapshot_seq;
+    }
+    while ((seq_end - (seq_start & ~1u)) > 2u);
 }
 
 /**
@@ -296,23 +784,42 @@ void FM_FMC_PulseAdd(uint32_t pulse_delta)
  * @details
  * Usa delta_p del sensor y delta_t del LPTIM para obtener pulsos por segundo,
  * los escala con factor_r y guarda el resultado en cache.
- * @warning delta_t debe ser mayor que 1 para evitar division por cero.
+ * Calcula floor(delta_p * 32768 * rate_mul / 2^rate_shift / (delta_t - 1)):
+ * una multiplicacion de 64 bits y una unica division entera.
+ * El resultado pasa por el filtro configurado en rate.filter antes de
+ * guardarse, sin alargar la ventana de medicion.
+ * @note Con delta_t menor o igual a 1 no hay ventana valida y la muestra es 0.
  */
 ufp3_t FM_FMC_RateCalc()
 {
-    double rate;
+    uint64_t rate = 0;
 
-    rate = totalizer.rate.delta_p;
-    rate /= (totalizer.rate.delta_t-1);
-    rate *= totalizer.rate.factor_r;
+    if (totalizer.rate.delta_t > 1)
+    {
+        rate = MulShift((uint64_t)totalizer.rate.delta_p << LPTIM_CLK_SHIFT,
+                        totalizer.rate_mul,
+                        totalizer.rate_shift,
+                        NULL);
+        rate /= (totalizer.rate.delta_t - 1);
+    }
 
-    // Convierte a punto fijo con tres decimales.
-    rate *= 1000;
-    totalizer.rate.rate = (ufp3_t) rate;
+    // Resultado en punto fijo con tres decimales.
+    totalizer.rate.rate = RateFilter(Ufp3Saturate(rate));
 
     return (totalizer.rate.rate);
 }
 
+/**
+ * @brief Descarta el historial del filtro de caudal.
+ * @details
+ * Se llama al pasar a FMX_ACK_RATE_STARTED para que el arranque del caudal no
+ * se mezcle con muestras viejas; la proxima muestra inicializa el filtro.
+ */
+void FM_FMC_RateFilterReset()
+{
+    rate_filter.primed = 0;
+}
+
 /**
  * @brief Devuelve la posicion decimal usada para mostrar el caudal.
  * @note Compartida por la UI y los reportes del sistema.
@@ -359,28 +866,20 @@ void FM_FMC_RateClear()
 }
 
 /**
- * @brief Calcula el total de viaje (TTL) a partir de los contadores de pulsos.
+ * @brief Devuelve el total de viaje (TTL) actualizado por FM_FMC_PulseAdd.
  * @return Volumen en punto fijo (x1000).
  * @details
- * Convierte los pulsos acumulados con factor_k y guarda el resultado en cache.
+ * Igual que FM_FMC_AcmCalc, el TTL se actualiza en FM_FMC_PulseAdd y aqui
+ * solo se lee el valor en cache.
  */
 ufp3_t FM_FMC_TtlCalc()
 {
-    double ttl = 0;
-
-    ttl = totalizer.pulse_ttl;
-    ttl /= totalizer.factor_k;
-
-    // Ajusta a punto fijo con tres decimales.
-    ttl *= 1000;
-    totalizer.ttl = (ufp3_t) ttl;
-
     return (totalizer.ttl);
 }
 
 /**
  * @brief Devuelve el total de viaje (TTL) almacenado en cache.
- * @note Requiere llamar a FM_FMC_TtlCalc para reflejar nuevos pulsos.
+ * @note Se mantiene al dia en cada FM_FMC_PulseAdd.
  */
 ufp3_t FM_FMC_TtlGet()
 {
@@ -472,7 +971,9 @@ fmx_status_t FM_FMC_TotalizerTimeUnitSet(fm_fmc_time_unit_t time_unit)
 void FM_FMC_TtlReset()
 {
     totalizer.ttl = 0;
+    totalizer.ttl_rem = 0;
     totalizer.pulse_ttl = 0;
+    SnapshotRefresh();
 }
 
 /**
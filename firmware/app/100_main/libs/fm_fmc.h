@@ -58,6 +58,20 @@ typedef enum {
     TIME_UNIT_END,
 } fm_fmc_time_unit_t;
 
+/**
+ * Filtros de caudal seleccionables con fm_fmc_rate_t.filter.
+ * filter = (tipo << 8) | largo; con largo 1 cualquier tipo deja pasar el dato.
+ */
+typedef enum {
+    FM_FMC_FILTER_EMA = 0,    ///< Media movil exponencial, alfa = 1 / largo.
+    FM_FMC_FILTER_AVERAGE,    ///< Promedio de las ultimas largo muestras.
+    FM_FMC_FILTER_MEDIAN_5,   ///< Mediana de 5, rechaza picos aislados.
+    FM_FMC_FILTER_END,
+} fm_fmc_filter_t;
+
+#define FM_FMC_FILTER(type, length)   (((uint32_t)(type) << 8) | ((length) & 0xFFu))
+#define FM_FMC_FILTER_AVERAGE_MAX     16u
+
 /** Datos en runtime asociados al caudal instantaneo. */
 typedef struct {
     double  	factor_r;    // Factor de caudal (factor K + base de tiempo).
@@ -67,28 +81,61 @@ typedef struct {
     uint8_t 	rate_pf_sel; // Posicion del punto decimal mostrado en el LCD.
     ufp3_t 		limit_high;  // Limite nominal superior del caudal.
     ufp3_t  	limit_low;   // Limite nominal inferior del caudal.
-    uint32_t 	filter;      // Configuracion adicional del filtro.
+    uint32_t 	filter;      // Filtro del caudal, ver FM_FMC_FILTER().
     fmx_ack_t 	ack;       // Estado actual del caudal.
 } fm_fmc_rate_t;
 
-/** Contadores y configuraciones agregados para el totalizador. */
+/**
+ * Contadores y configuraciones agregados para el totalizador.
+ * Vive en la RAM BACKUP y sobrevive con VBAT a una actualizacion de firmware:
+ * hasta ticket_number los campos quedan donde estaban en el formato original y
+ * los nuevos se agregan al final, antes de magic.
+ */
 typedef struct {
     ufp3_t            acm;          ///< Volumen acumulado (x1000).
     ufp3_t            ttl;          ///< Volumen de viaje (x1000).
     uint8_t           vol_pf_sel;   ///< Punto decimal para mostrar ACM/TTL.
-    uint64_t          pulse_acm;    ///< Acumulador de pulsos para ACM.
-    uint64_t          pulse_ttl;    ///< Acumulador de pulsos para TTL.
+    uint64_t          pulse_acm;    ///< Acumulador de pulsos para ACM (linealizados si hay tabla K).
+    uint64_t          pulse_ttl;    ///< Acumulador de pulsos para TTL (linealizados si hay tabla K).
     ufp3_t            factor_cal;   ///< Factor de calibracion (pulsos/litro).
     double            factor_k;     ///< Factor K derivado de calibracion.
     fm_fmc_vol_unit_t vol_unit;     ///< Unidad de volumen activa.
     fm_fmc_time_unit_t time_unit;   ///< Base de tiempo activa.
     fm_fmc_rate_t     rate;         ///< Seguimiento del caudal instantaneo.
     uint16_t          ticket_number;///< Ticket secuencial para reportes.   
+    // Agregados al formato original; FM_FMC_Init recalcula todos menos lin_frac.
+    uint32_t          rate_mul;     ///< Mantisa Q32 de rate.factor_r * 1000 / 32768, ver rate_shift.
+    uint8_t           rate_shift;   ///< Desplazamiento asociado a rate_mul.
+    uint32_t          vol_mul;      ///< Mantisa Q32 de 1000 / factor_k.
+    uint8_t           vol_shift;    ///< Desplazamiento asociado a vol_mul.
+    uint64_t          acm_rem;      ///< Resto de pulse_acm * vol_mul no volcado al ACM.
+    uint64_t          ttl_rem;      ///< Resto de pulse_ttl * vol_mul no volcado al TTL.
+    uint32_t          lin_frac;     ///< Fraccion Q32 de pulso linealizado pendiente.
+    uint32_t          magic;        ///< FM_FMC_TOTALIZER_MAGIC si el final es de este formato.
 } fm_fmc_totalizer_t;
 
+/**
+ * Medicion de una ventana, publicada una vez por ciclo con
+ * FM_FMC_SnapshotPublish. LCD, log, impresora y comandos la leen con
+ * FM_FMC_SnapshotGet sin recalcular ni bloquear.
+ */
+typedef struct {
+    ufp3_t    rate;       ///< Caudal filtrado (x1000).
+    ufp3_t    acm;        ///< Volumen acumulado (x1000).
+    ufp3_t    ttl;        ///< Volumen de viaje (x1000).
+    uint64_t  pulse_acm;  ///< Pulsos del ACM.
+    uint64_t  pulse_ttl;  ///< Pulsos del TTL.
+    fmx_ack_t status;     ///< Estado del caudal en la ventana.
+    uint32_t  time_unix;  ///< Hora del RTC al cerrar la ventana.
+    uint32_t  sequence;   ///< Numero de publicacion, crece en cada ventana.
+} fm_fmc_snapshot_t;
+
 #define FM_FMC_FACTOR_CAL_MAX 99999999u
 #define FM_FMC_FACTOR_CAL_MIN 1000u
 
+// Cambiar al agregar campos a fm_fmc_totalizer_t.
+#define FM_FMC_TOTALIZER_MAGIC  (0x544F5431u)   // "TOT1"
+
 // --- API ---
 
 ufp3_t      FM_FMC_AcmCalc(void);
@@ -107,10 +154,11 @@ fmx_status_t FM_FMC_FactorRateSet(double factor_rate);
 fm_fmc_totalizer_t FM_FMC_GetEnviroment(void);
 void              FM_FMC_Init(sensors_list_t sensor);
 
-void     FM_FMC_CaptureSet(uint16_t pulse, uint16_t time);
+void     FM_FMC_CaptureSet(uint32_t pulse, uint32_t time);
 ufp3_t   FM_FMC_RateCalc(void);
 void     FM_FMC_RateClear(void);
 ufp3_t   FM_FMC_RateGet(void);
+void     FM_FMC_RateFilterReset(void);
 uint8_t  FM_FMC_RateFpSelGet(void);
 void     FM_FMC_RateFpInc(void);
 
@@ -131,6 +179,11 @@ uint64_t FM_FMC_TtlPulseGet(void);
 void     FM_FMC_TtlReset(void);
 
 void     FM_FMC_PulseAdd(uint32_t pulse_delta);
+uint32_t FM_FMC_VolumeToPulses(ufp3_t volume);
+ufp3_t   FM_FMC_PulsesToVolume(uint32_t pulses);
+
+void     FM_FMC_SnapshotPublish(fmx_ack_t status, uint32_t time_unix);
+void     FM_FMC_SnapshotGet(fm_fmc_snapshot_t *snapshot);
 
 #endif // FM_FMC_H_
 
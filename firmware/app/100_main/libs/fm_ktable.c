@@ -0,0 +1,262 @@
+/**
+ * @file fm_ktable.c
+ * @brief Tabla de linealizacion del factor K en funcion de la frecuencia.
+ *
+ * Los sensores de turbina no tienen un factor K constante: varia con la
+ * frecuencia de pulsos. La tabla guarda hasta FM_KTABLE_POINTS pares
+ * (frecuencia, K) en la pagina de dispositivo de la flash y el totalizador
+ * interpola K entre ellos en cada ventana de medicion.
+ * @details
+ * - Los puntos activos son los primeros count de la tabla, con frecuencia
+ *   estrictamente creciente y K dentro de los limites de factor_cal.
+ * - Al cargar la tabla se precalcula la pendiente de cada tramo en Q32, asi
+ *   FM_KTABLE_Eval hace una busqueda binaria de 4 pasos fijos, una resta y
+ *   una multiplicacion.
+ * - Fuera del rango de la tabla K queda fijo en el punto extremo.
+ * - Con count 0 la tabla esta inactiva y el totalizador usa factor_cal.
+ */
+
+// --- Includes ---
+#include "fm_ktable.h"
+#include "fm_debug.h"
+#include "main.h"
+#include <string.h>
+
+// --- Defines ---
+#define SLOPE_SHIFT         (32u)
+
+// --- Types ---
+
+/*
+ * Tabla lista para evaluar. Las posiciones sin usar quedan con frecuencia
+ * maxima y el K del ultimo punto, de modo que la busqueda no necesita count.
+ */
+typedef struct {
+    uint32_t freq[FM_KTABLE_POINTS];
+    uint32_t k[FM_KTABLE_POINTS];
+    int64_t  slope[FM_KTABLE_POINTS];   // (k[i+1] - k[i]) / (freq[i+1] - freq[i]) en Q32.
+    uint8_t  count;
+} ktable_lut_t;
+
+// --- Static Data ---
+static flash_k_table_t table;   // Copia editable de la tabla en flash.
+static ktable_lut_t lut;
+
+// --- Static Prototypes ---
+static uint8_t      ValidCountGet(const flash_k_table_t *candidate);
+static void         LutBuild(void);
+static fmx_status_t TableCommit(const flash_k_table_t *candidate);
+
+// --- Public API ---
+
+/**
+ * @brief Carga la tabla desde la flash y prepara la evaluacion.
+ * @details
+ * Una pagina borrada o una tabla incoherente deja la linealizacion
+ * desactivada; los puntos guardados se conservan para poder corregirlos.
+ */
+void FM_KTABLE_Init(void)
+{
+    table = FM_FLASH_KTableRead();
+
+    if (table.magic != FM_FLASH_K_TABLE_MAGIC)
+    {
+        memset(&table, 0, sizeof(table));
+        table.magic = FM_FLASH_K_TABLE_MAGIC;
+    }
+    else if (ValidCountGet(&table) < table.count)
+    {
+        FM_DEBUG_LedError(1);
+        table.count = 0;
+    }
+
+    LutBuild();
+}
+
+/**
+ * @brief Devuelve el factor K interpolado para una frecuencia.
+ * @param freq Frecuencia del sensor en mHz.
+ * @return K en pulsos por litro x1000, o 0 si la tabla esta inactiva.
+ */
+ufp3_t FM_KTABLE_Eval(uint32_t freq)
+{
+    uint32_t index = 0;
+    uint32_t dx;
+
+    if (lut.count == 0)
+    {
+        return 0;
+    }
+
+    // Las posiciones sin usar valen UINT32_MAX y nunca se eligen.
+    if (freq == UINT32_MAX)
+    {
+        freq--;
+    }
+
+    index += (freq >= lut.freq[index + 8u]) ? 8u : 0u;
+    index += (freq >= lut.freq[index + 4u]) ? 4u : 0u;
+    index += (freq >= lut.freq[index + 2u]) ? 2u : 0u;
+    index += (freq >= lut.freq[index + 1u]) ? 1u : 0u;
+
+    // Por debajo del primer punto index es 0 y K queda en k[0].
+    dx = (freq > lut.freq[index]) ? (freq - lut.freq[index]) : 0u;
+
+    // dx es menor al ancho del tramo: el producto no supera |dk| * 2^32.
+    return (ufp3_t)((int64_t)lut.k[index] + ((lut.slope[index] * (int64_t)dx) >> SLOPE_SHIFT));
+}
+
+/**
+ * @brief Devuelve la cantidad de puntos activos.
+ */
+uint8_t FM_KTABLE_CountGet(void)
+{
+    return table.count;
+}
+
+/**
+ * @brief Devuelve la mayor cantidad de puntos que forman una tabla valida.
+ * @note Es el limite para FM_KTABLE_CountSet con los puntos guardados.
+ */
+uint8_t FM_KTABLE_CountMaxGet(void)
+{
+    return ValidCountGet(&table);
+}
+
+/**
+ * @brief Cambia la cantidad de puntos activos y guarda la tabla.
+ * @param count 0 desactiva la linealizacion.
+ * @return FMX_STATUS_OK, o FMX_STATUS_INVALIDA_PARAM si los puntos no son validos.
+ */
+fmx_status_t FM_KTABLE_CountSet(uint8_t count)
+{
+    flash_k_table_t candidate = table;
+
+    candidate.count = count;
+
+    return TableCommit(&candidate);
+}
+
+/**
+ * @brief Lee un punto de la tabla, activo o no.
+ */
+fmx_status_t FM_KTABLE_PointGet(uint8_t index, flash_k_point_t *point)
+{
+    if (index >= FM_KTABLE_POINTS)
+    {
+        return FMX_STATUS_OUT_OF_RANGE;
+    }
+
+    *point = table.point[index];
+
+    return FMX_STATUS_OK;
+}
+
+/**
+ * @brief Escribe un punto de la tabla y la guarda en flash.
+ * @details
+ * Si el punto es activo la tabla resultante debe seguir siendo valida. Los
+ * puntos fuera de count se pueden cargar en cualquier orden y se activan
+ * despues con FM_KTABLE_CountSet.
+ */
+fmx_status_t FM_KTABLE_PointSet(uint8_t index, flash_k_point_t point)
+{
+    flash_k_table_t candidate = table;
+
+    if (index >= FM_KTABLE_POINTS)
+    {
+        return FMX_STATUS_OUT_OF_RANGE;
+    }
+
+    if ((point.k < FM_FMC_FACTOR_CAL_MIN) || (point.k > FM_FMC_FACTOR_CAL_MAX))
+    {
+        return FMX_STATUS_INVALIDA_PARAM;
+    }
+
+    candidate.point[index] = point;
+
+    return TableCommit(&candidate);
+}
+
+// --- Static Functions ---
+
+// Cantidad de puntos iniciales con K en rango y frecuencia creciente.
+static uint8_t ValidCountGet(const flash_k_table_t *candidate)
+{
+    uint8_t i;
+
+    for (i = 0; i < FM_KTABLE_POINTS; i++)
+    {
+        if ((candidate->point[i].k < FM_FMC_FACTOR_CAL_MIN)
+            || (candidate->point[i].k > FM_FMC_FACTOR_CAL_MAX)
+            || (candidate->point[i].freq == UINT32_MAX))
+        {
+            break;
+        }
+        if ((i > 0) && (candidate->point[i].freq <= candidate->point[i - 1].freq))
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/*
+ * Arma la tabla de evaluacion desde la copia editable. Se construye aparte y
+ * se copia con interrupciones deshabilitadas: el hilo de comandos puede
+ * editar la tabla mientras el hilo principal la evalua.
+ */
+static void LutBuild(void)
+{
+    ktable_lut_t lut_new;
+    uint32_t primask;
+    uint8_t last;
+    uint8_t i;
+
+    lut_new.count = table.count;
+    last = (table.count > 0) ? (table.count - 1u) : 0u;
+
+    for (i = 0; i < FM_KTABLE_POINTS; i++)
+    {
+        if (i < table.count)
+        {
+            lut_new.freq[i] = table.point[i].freq;
+            lut_new.k[i] = table.point[i].k;
+        }
+        else
+        {
+            lut_new.freq[i] = UINT32_MAX;
+            lut_new.k[i] = table.point[last].k;
+        }
+        lut_new.slope[i] = 0;
+    }
+
+    for (i = 0; (i + 1u) < table.count; i++)
+    {
+        lut_new.slope[i] = ((int64_t)lut_new.k[i + 1u] - (int64_t)lut_new.k[i]) * (1ll << SLOPE_SHIFT)
+                         / (int64_t)(lut_new.freq[i + 1u] - lut_new.freq[i]);
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    lut = lut_new;
+    __set_PRIMASK(primask);
+}
+
+// Valida, guarda en flash y activa una tabla editada.
+static fmx_status_t TableCommit(const flash_k_table_t *candidate)
+{
+    if ((candidate->count > FM_KTABLE_POINTS) || (ValidCountGet(candidate) < candidate->count))
+    {
+        return FMX_STATUS_INVALIDA_PARAM;
+    }
+
+    table = *candidate;
+    FM_FLASH_KTableWrite(&table);
+    LutBuild();
+
+    return FMX_STATUS_OK;
+}
+
+/*** END OF FILE ***/
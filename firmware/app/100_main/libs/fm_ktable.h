@@ -0,0 +1,28 @@
+/**
+ * @file fm_ktable.h
+ * @brief Tabla de linealizacion del factor K en funcion de la frecuencia.
+ */
+
+#ifndef FM_KTABLE_H_
+#define FM_KTABLE_H_
+
+// --- Includes ---
+#include "fm_flash.h"
+#include "fm_fmc.h"
+#include "fmx.h"
+
+// --- Defines ---
+#define FM_KTABLE_POINTS   FM_FLASH_K_TABLE_POINTS
+
+// --- API ---
+void         FM_KTABLE_Init(void);
+ufp3_t       FM_KTABLE_Eval(uint32_t freq);
+uint8_t      FM_KTABLE_CountGet(void);
+uint8_t      FM_KTABLE_CountMaxGet(void);
+fmx_status_t FM_KTABLE_CountSet(uint8_t count);
+fmx_status_t FM_KTABLE_PointGet(uint8_t index, flash_k_point_t *point);
+fmx_status_t FM_KTABLE_PointSet(uint8_t index, flash_k_point_t point);
+
+#endif /* FM_KTABLE_H_ */
+
+/*** END OF FILE ***/
@@ -8,6 +8,7 @@
 
 // Includes.
 #include "fm_lcd.h"
+#include "fm_debug.h"
 #include "stdio.h"
 
 // Typedef.
@@ -16,6 +17,8 @@
 
 // Defines.
 #define LCD_BUFFER_SIZE 20
+#define UFP3_DECIMALS   3
+#define UFP3_DIGITS_MAX 10  // UINT32_MAX has 10 digits.
 
 // Project variables, non-static, at least used in other file.
 
@@ -26,9 +29,20 @@
 char lcd_buffer[LCD_BUFFER_SIZE];
 
 // Private function prototypes.
+static uint32_t
+Div10(uint32_t value);
 
 // Private function bodies.
 
+/*
+ * value / 10 without a divide: 0xCCCCCCCD = ceil(2^35 / 10) gives the exact
+ * quotient for every 32-bit value with one UMULL and a shift.
+ */
+static uint32_t Div10(uint32_t value)
+{
+    return (uint32_t) (((uint64_t) value * 0xCCCCCCCDu) >> 35); // @suppress("Avoid magic numbers")
+}
+
 // Public function bodies.
 
 /**
@@ -131,6 +145,66 @@ void FM_LCD_PutUnsignedInt32(uint32_t num, fm_lcd_ll_row_t row)
     }
 }
 
+/**
+ * @brief Renders a ufp3_t (value x1000) straight into the LCD shadow, no printf.
+ * @param value    Fixed-point value with three decimals.
+ * @param decimals Decimals shown, 0 to 3 (fm_fmc_fp_sel); the rest are truncated.
+ * @param pad      Fill for the unused integer columns, ' ' or '0'.
+ * @param row      Target row.
+ * @note Same layout as "%*lu.%0*lu" through FM_LCD_PutString: the integer part
+ *       takes the columns the decimals leave and a longer one pushes the
+ *       decimals off the right end. The point goes on the last integer digit.
+ */
+void FM_LCD_PutUfp3(uint32_t value, uint8_t decimals, char pad, fm_lcd_ll_row_t row)
+{
+    uint8_t digits[UFP3_DIGITS_MAX];
+    uint32_t quotient;
+    uint32_t cols;
+    uint8_t count = 0;
+    uint8_t integers;
+    uint8_t field;
+    uint8_t col;
+    char c;
+
+    cols = FM_LCD_LL_GetRowSize(row);
+    if ((decimals > UFP3_DECIMALS) || (decimals >= cols))
+    {
+        FM_DEBUG_LedError(1);
+        return;
+    }
+
+    // Digits, least significant first, with at least one integer digit.
+    do
+    {
+        quotient = Div10(value);
+        digits[count] = (uint8_t) (value - (quotient * 10u)); // @suppress("Avoid magic numbers")
+        count++;
+        value = quotient;
+    } while ((value != 0) || (count <= UFP3_DECIMALS));
+
+    integers = count - UFP3_DECIMALS;
+    field = (integers > (cols - decimals)) ? integers : (uint8_t) (cols - decimals);
+
+    for (col = 0; col < cols; col++)
+    {
+        if (col < (field - integers))
+        {
+            c = pad;
+        }
+        else
+        {
+            count--;
+            c = (char) ('0' + digits[count]);
+        }
+        FM_LCD_LL_PutChar(c, col, row);
+
+        if ((decimals != 0) && (col == (field - 1)) && (field < cols))
+        {
+            FM_LCD_LL_PutChar('.', col, row);
+        }
+    }
+}
+
 // Interrupts
 
 /*** end of file ***/
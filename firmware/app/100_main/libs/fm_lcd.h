@@ -18,6 +18,7 @@ void FM_LCD_Init(uint8_t fill);
 void FM_LCD_fill(uint8_t fill);
 void FM_LCD_PutString(const char *str, uint32_t str_len, fm_lcd_ll_row_t row);
 void FM_LCD_PutUnsignedInt32(uint32_t value, fm_lcd_ll_row_t row);
+void FM_LCD_PutUfp3(uint32_t value, uint8_t decimals, char pad, fm_lcd_ll_row_t row);
 void FM_LCD_PutChar(char *ch);
 
 #endif // FM_LCD_H_
@@ -21,116 +21,289 @@
 // Includes.
 #include "fm_lcd_ll.h"
 #include "fm_debug.h"
+#include "fmx_stats.h"
+#include "tx_api.h"
 
 // Typedef.
 
+// Tramo de un registro que ocupa un caracter de 14 segmentos, ver glyph_14.
+typedef struct
+{
+    uint8_t reg;               // Registro del tramo en el backplane 0.
+    uint8_t nibble_shift;      // Bits del nibble del glifo que quedan fuera del tramo.
+    uint8_t pin_shift;         // Bit del registro donde cae el primer bit que queda.
+    uint8_t pins[4];           // Pines del caracter en el registro, por backplane.
+} span_t;
+
+// Bit de un simbolo en el mapa del pcf8553.
 typedef struct
 {
-    uint8_t pos;
     uint8_t reg;
-} octal_t;
+    uint8_t mask;   // 0 si el simbolo no esta conectado.
+} symbol_bit_t;
 
 // Defines.
 #define FALSE   0
 #define TRUE    1
 
 /*
- * Ver hoja de datos del lcd, cada segmento se identifica con una letra, se
- * codifica a numero. Cada segmento esta conectado a un pin del pcf8553, luego
- * cada pin esta relacionado con bit de un registro de 8 bits en el mapa de
- * memoria del pcf8553. Se debe construir una matiz que relacione los segmentos
- * con el bit que se quiere encender, esto se hará para un solo digito, luego
- * por se obtendrán las posiciones de los siguientes dígitos.
- *
+ * El mapa de memoria del pcf8553 son 4 backplanes (AMARILLO, VERDE, ROJO y AZUL
+ * en el esquematico) de 40 pines S0 a S39, 5 registros por backplane: el pin p
+ * del backplane k es el bit p % 8 de pcf8553_ram_map[5 * k + p / 8]. Cada
+ * caracter usa los mismos pines en los 4 backplanes, asi que un glifo se guarda
+ * como un grupo de bits por backplane y se escribe con una operacion
+ * enmascarada por registro, sin recorrer segmento por segmento.
+ */
+#define BACKPLANES      4
+#define BACKPLANE_REGS  5
+
+/*
+ * Ver hoja de datos del lcd, cada segmento de los digitos se identifica con
+ * una letra. Un digito ocupa dos pines contiguos, el primero par, en los 4
+ * backplanes: dos bits por backplane. Los bits siguen el orden de la fila 1;
+ * en la fila 2 los dos pines de cada backplane estan invertidos.
  */
-#define SEG_A 0
-#define SEG_B 1
-#define SEG_C 2
-#define SEG_D 3
-#define SEG_E 4
-#define SEG_F 5
-#define SEG_G 6
-#define SEG_H 7
+#define SEG_B   (1 << 0)    // Backplane 0.
+#define SEG_C   (1 << 1)
+#define SEG_A   (1 << 2)    // Backplane 1.
+#define SEG_H   (1 << 3)    // Punto.
+#define SEG_E   (1 << 4)    // Backplane 2.
+#define SEG_G   (1 << 5)
+#define SEG_D   (1 << 6)    // Backplane 3.
+#define SEG_F   (1 << 7)
+#define SEGS_7  (SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G)
+
+/*
+ * Glifo de un digito: byte bajo, segmentos encendidos; byte alto, segmentos
+ * que se escriben. Los que no se escriben conservan su estado, como el punto
+ * o un digito con un caracter que no esta en la tabla.
+ */
+#define GLYPH_7(on, written)    ((uint16_t)((on) | ((written) << 8)))
 
 #define LCD_MSG_LENGTH 12
 
 #define ROW_1_SIZE 8 // Caracteres en linea 1
 #define ROW_2_SIZE 7 // Caracteres en linea 2
 
+/*
+ * Fases del parpadeo por software, en ticks de ThreadX. La fase sale del
+ * tiempo transcurrido desde que se activo el parpadeo, no de la cantidad de
+ * redibujos: un refresco por otro motivo no adelanta ni agrega fases.
+ */
+#define BLINK_ON_TICKS      (TX_TIMER_TICKS_PER_SECOND)
+#define BLINK_OFF_TICKS     (TX_TIMER_TICKS_PER_SECOND * 15 / 100)
+#define BLINK_PERIOD_TICKS  (BLINK_ON_TICKS + BLINK_OFF_TICKS)
+
+/*
+ * Parpadeo del pcf8553, de la pantalla completa. Se usa solo cuando todo lo
+ * encendido parpadea; 1 Hz es lo mas cercano al periodo por software.
+ */
+#define BLINK_HW_SPEED      MED_SPEED
+
 // Project variables, non-static, at least used in other file.
 
 // Extern variables.
 
 // Global variables, statics.
 
-uint8_t blink_short_refresh = 0;
+/*
+ * Los digitos, caracteres y simbolos que parpadean se marcan en
+ * pcf8553_blink_mask y se escriben en el mapa como cualquier otro: el mapa
+ * siempre tiene lo que se ve en la fase encendida. blink_start es el tick en
+ * que arranco la fase encendida; blink_software indica que el ultimo refresco
+ * dejo el parpadeo a cargo del micro.
+ */
+static ULONG blink_start = 0;
+static uint8_t blink_software = FALSE;
 
 /*
- * Lo que se quiera escribir en las líneas 1 y 2 primero se vuelca a este
- * buffer. Leer el buffer es la única manera practica que se tiene para
- * saber que esta escrito en la pantalla, no se debe corromper esta condición.
+ * Glifos de los digitos de las filas 1 y 2. Los caracteres fuera de la tabla
+ * no modifican el digito.
  */
-fm_lcd_ll_blink_t blink_number[FM_LCD_LL_ROWS][FM_LCD_LL_COLS]; // Mapa de dígitos a parpadear.
-fm_lcd_ll_blink_t blink_char_1 = 0;
-fm_lcd_ll_blink_t blink_char_2 = 0;
-fm_lcd_ll_blink_t blink_symbol[FM_LCD_LL_SYM_END];
+static const uint16_t glyph_7[] =
+{
+    [0] = GLYPH_7(SEG_A | SEG_D, SEGS_7),   // Nulo, '_' y '-' superpuestos.
+    [' '] = GLYPH_7(0, SEGS_7),
+    ['-'] = GLYPH_7(SEG_D, SEGS_7),
+    ['.'] = GLYPH_7(SEG_H, SEG_H),
+    ['0'] = GLYPH_7(SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G, SEGS_7),
+    ['1'] = GLYPH_7(SEG_C | SEG_F, SEGS_7),
+    ['2'] = GLYPH_7(SEG_A | SEG_B | SEG_D | SEG_F | SEG_G, SEGS_7),
+    ['3'] = GLYPH_7(SEG_A | SEG_C | SEG_D | SEG_F | SEG_G, SEGS_7),
+    ['4'] = GLYPH_7(SEG_C | SEG_D | SEG_E | SEG_F, SEGS_7),
+    ['5'] = GLYPH_7(SEG_A | SEG_C | SEG_D | SEG_E | SEG_G, SEGS_7),
+    ['6'] = GLYPH_7(SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_G, SEGS_7),
+    ['7'] = GLYPH_7(SEG_C | SEG_F | SEG_G, SEGS_7),
+    ['8'] = GLYPH_7(SEGS_7, SEGS_7),
+    ['9'] = GLYPH_7(SEG_C | SEG_D | SEG_E | SEG_F | SEG_G, SEGS_7),
+    ['A'] = GLYPH_7(SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G, SEGS_7),
+    ['E'] = GLYPH_7(SEG_A | SEG_B | SEG_D | SEG_E | SEG_G, SEGS_7),
+    ['L'] = GLYPH_7(SEG_A | SEG_B | SEG_E, SEGS_7),
+    ['O'] = GLYPH_7(SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G, SEGS_7),
+    ['P'] = GLYPH_7(SEG_B | SEG_D | SEG_E | SEG_F | SEG_G, SEGS_7),
+    ['S'] = GLYPH_7(SEG_A | SEG_C | SEG_D | SEG_E | SEG_G, SEGS_7),
+    ['U'] = GLYPH_7(SEG_A | SEG_B | SEG_C | SEG_E | SEG_F, SEGS_7),
+    ['_'] = GLYPH_7(SEG_A, SEGS_7),
+    ['b'] = GLYPH_7(SEG_B | SEG_D | SEG_E | SEG_F | SEG_G, SEGS_7 | SEG_H),
+};
 
-uint8_t g_col; // se usara para calcular que registro y posición del bit a modificar.
-uint8_t g_row; // se usara para calcular que registro y posición del bit a modificar.
+/*
+ * Primer pin de cada digito, por fila y columna. La fila 2 se numera de
+ * derecha a izquierda.
+ */
+static const uint8_t digit_pin[FM_LCD_LL_ROWS][FM_LCD_LL_COLS] =
+{
+    [FM_LCD_LL_ROW_1] = { 22, 24, 26, 28, 30, 32, 34, 36 },
+    [FM_LCD_LL_ROW_2] = { 18, 16, 14, 12, 10, 8, 6 },
+};
 
 /*
- *  Para un caracter octal, en la linea superior del LCD, inicializo el
- *  siguiente arreglo. Ver tabla memoria del PCF8553, el encendido/apagado
- *  de cada segmento esta controlado por un bit en esta tabla, son 20 registros
- *  de 8 bits cada uno, 160 bits par controlar la misma cantidad de segmentos.
- *  Los valores de inicialización de la siguiente tabla corresponde al caracter
- *  ubicado mas a la derecha en la tabla superior, ver datasheet del LCD.
- *  Cada par de valores pos y reg se corresponden a la dirección de un registro
- *  y el bit correspondiente que controlan los segmentos de A a G.
- *  Solo se necesitan los datos de este caracter, las posiciones de los demás
- *  se obtienen por aritmética dentro de la función WriteLine.
+ * Glifos de los caracteres de 14 segmentos de la unidad de volumen, un nibble
+ * por backplane: el bit i del nibble k es el pin S(2 + i) del backplane k en el
+ * caracter 1. Los caracteres fuera de la tabla se ven apagados.
  */
-octal_t octal_1[] =
+static const uint16_t glyph_14[] =
+{
+    [1] = 0xF7DF,  // Todos los segmentos encendidos.
+    ['0'] = 0xA28A,
+    ['1'] = 0x2002,
+    ['2'] = 0x328C,
+    ['3'] = 0x3286,
+    ['4'] = 0xB006,
+    ['5'] = 0x9286,
+    ['6'] = 0x928E,
+    ['7'] = 0x2202,
+    ['8'] = 0xB28E,
+    ['9'] = 0xB206,
+    ['A'] = 0xB20E,
+    ['B'] = 0x2696,
+    ['C'] = 0x8288,
+    ['D'] = 0x2692,
+    ['E'] = 0x9288,
+    ['F'] = 0x9208,
+    ['G'] = 0x928E,
+    ['H'] = 0xB00E,
+    ['I'] = 0x0690,
+    ['J'] = 0x2082,
+    ['K'] = 0xD048,
+    ['L'] = 0x8088,
+    ['M'] = 0xE10A,
+    ['N'] = 0xA14A,
+    ['O'] = 0xA28A,
+    ['P'] = 0xB20C,
+    ['Q'] = 0xA2CA,
+    ['R'] = 0xB24C,
+    ['S'] = 0x9286,
+    ['T'] = 0x0610,
+    ['U'] = 0xA08A,
+    ['V'] = 0xC009,
+    ['W'] = 0xA04B,
+    ['X'] = 0x4141,
+    ['Y'] = 0x4110,
+    ['Z'] = 0x5285,
+    ['a'] = 0x908E,
+    ['b'] = 0x908E,
+    ['c'] = 0x8288,
+    ['d'] = 0x2692,
+    ['e'] = 0x9288,
+    ['f'] = 0x9208,
+    ['g'] = 0x928E,
+    ['h'] = 0xB00E,
+    ['i'] = 0x0690,
+    ['j'] = 0x2082,
+    ['k'] = 0xD048,
+    ['l'] = 0x8088,
+    ['m'] = 0xE10A,
+    ['n'] = 0xA14A,
+    ['o'] = 0xA28A,
+    ['p'] = 0xB20C,
+    ['q'] = 0xA2CA,
+    ['r'] = 0xB24C,
+    ['s'] = 0x9286,
+    ['t'] = 0x0610,
+    ['u'] = 0xA08A,
+    ['v'] = 0xC009,
+    ['w'] = 0xA04B,
+    ['x'] = 0x4141,
+    ['y'] = 0x4110,
+    ['z'] = 0x5285,
+};
+
+// Caracter 1: pines S2 a S5.
+static const span_t char_1_spans[] =
+{
+{ .reg = REG_0, .nibble_shift = 0, .pin_shift = 2, .pins = { 0x3C, 0x34, 0x1C, 0x3C } }, };
+
+// Caracter 2: los mismos segmentos en los pines S38, S39, S0 y S1.
+static const span_t char_2_spans[] =
 {
-{ .pos = 6, .reg = 7 },
-{ .pos = 6, .reg = 2 },
-{ .pos = 7, .reg = 2 },
-{ .pos = 6, .reg = 17 },
-{ .pos = 6, .reg = 12 },
-{ .pos = 7, .reg = 17 },
-{ .pos = 7, .reg = 12 },
-{ .pos = 7, .reg = 7 }, };
+{ .reg = REG_0, .nibble_shift = 2, .pin_shift = 0, .pins = { 0x03, 0x03, 0x01, 0x03 } },
+{ .reg = REG_4, .nibble_shift = 0, .pin_shift = 6, .pins = { 0xC0, 0x40, 0xC0, 0xC0 } }, };
 
-octal_t octal_2[] =
+// Registro y bit de cada simbolo y punto decimal.
+static const symbol_bit_t symbol_bit[FM_LCD_LL_SYM_END] =
 {
-{ .pos = 7, .reg = 5 },
-{ .pos = 7, .reg = 0 },
-{ .pos = 6, .reg = 0 },
-{ .pos = 7, .reg = 15 },
-{ .pos = 7, .reg = 10 },
-{ .pos = 6, .reg = 15 },
-{ .pos = 6, .reg = 10 },
-{ .pos = 6, .reg = 5 } };
+    [FM_LCD_LL_SYM_POINT] = { REG_7, 1 << BIT_4 },
+    [FM_LCD_LL_SYM_BATTERY] = { REG_7, 1 << BIT_5 },
+    [FM_LCD_LL_SYM_POWER] = { REG_2, 1 << BIT_5 },
+    [FM_LCD_LL_SYM_RATE] = { REG_17, 1 << BIT_5 },
+    [FM_LCD_LL_SYM_E] = { REG_2, 1 << BIT_4 },
+    [FM_LCD_LL_SYM_BATCH] = { REG_12, 1 << BIT_5 },
+    [FM_LCD_LL_SYM_ACM_1] = { REG_0, 0 },  // implementar
+    [FM_LCD_LL_SYM_TTL] = { REG_17, 1 << BIT_4 },
+    [FM_LCD_LL_SYM_BACKSLASH] = { REG_10, 1 << BIT_1 },
+    [FM_LCD_LL_SYM_ACM_2] = { REG_12, 1 << BIT_4 },
+    [FM_LCD_LL_SYM_S] = { REG_10, 1 << BIT_5 },
+    [FM_LCD_LL_SYM_M] = { REG_9, 1 << BIT_7 },
+    [FM_LCD_LL_SYM_H] = { REG_5, 1 << BIT_6 },
+    [FM_LCD_LL_SYM_D] = { REG_9, 1 << BIT_5 },
+    [DOT_ROW_1_DECI] = { REG_7, 1 << BIT_7 },
+    [DOT_ROW_1_CENTI] = { REG_8, 1 << BIT_1 },
+    [DOT_ROW_1_MILI] = { REG_8, 1 << BIT_3 },
+    [DOT_ROW_1_MICRO] = { REG_8, 1 << BIT_5 },
+    [DOT_ROW_1_NANO] = { REG_8, 1 << BIT_7 },
+    [DOT_ROW_1_PICO] = { REG_9, 1 << BIT_1 },
+    [DOT_ROW_1_FEMTO] = { REG_9, 1 << BIT_3 },
+    [DOT_ROW_2_DECI] = { REG_7, 1 << BIT_2 },
+    [DOT_ROW_2_CENTI] = { REG_7, 1 << BIT_0 },
+    [DOT_ROW_2_MILI] = { REG_6, 1 << BIT_6 },
+    [DOT_ROW_2_MICRO] = { REG_6, 1 << BIT_4 },
+    [DOT_ROW_2_NANO] = { REG_6, 1 << BIT_2 },
+    [DOT_ROW_2_PICO] = { REG_6, 1 << BIT_0 },
+};
+
+// Private function prototypes.
+static void
+BlinkApply(void);
+static void
+BlinkRestart(uint8_t state);
+static void
+CharWrite(uint8_t *map, const span_t *span, uint32_t spans, uint16_t glyph);
+static void
+DigitWrite(uint8_t *map, uint8_t pin, uint8_t on, uint8_t written);
+static uint16_t
+Glyph14(char c);
+static uint8_t
+PairSwap(uint8_t bits);
+
+// Public function bodies.
 
 /*
- * @brief   Controla el encendido y apagado del parpadeo.
+ * @brief   Controla el encendido y apagado del parpadeo de los dos caracteres
+ *          de la unidad de volumen.
  * @note
  * @param   state:  0 parpadeo desactivado,
- *                  1 activado y encendido,
- *                  2 activado y apagado.
+ *                  distinto de 0 activado.
  * @retval  ninguno
  */
 void FM_LCD_LL_BlinkChar(uint8_t state)
 {
-    blink_char_1 = state;
-    blink_char_2 = state;
-}
+    uint16_t pins = state ? 0xFFFF : 0;
 
-// Private function prototypes.
-void
-WriteLine(uint8_t seg, uint8_t data);
-
-// Public function bodies.
+    CharWrite(pcf8553_blink_mask, char_1_spans, sizeof(char_1_spans) / sizeof(char_1_spans[0]), pins);
+    CharWrite(pcf8553_blink_mask, char_2_spans, sizeof(char_2_spans) / sizeof(char_2_spans[0]), pins);
+    BlinkRestart(state);
+}
 
 /*
  * @brief		Detiene todos los parpadeos.
@@ -140,24 +313,10 @@ WriteLine(uint8_t seg, uint8_t data);
  */
 void FM_LCD_LL_BlinkClear()
 {
-
-    for (int n = 0; n < FM_LCD_LL_SYM_END; n++)
-    {
-        blink_symbol[n] = FM_LCD_LL_BLINK_OFF;  //
-    }
-
-    for (int n = 0; n < FM_LCD_LL_ROW_1_COLS; n++)
-    {
-        blink_number[FM_LCD_LL_ROW_1][n] = FM_LCD_LL_BLINK_OFF;  //
-    }
-
-    for (int n = 0; n < FM_LCD_LL_ROW_2_COLS; n++)
+    for (int n = 0; n < PCF8553_RAM_SIZE; n++)
     {
-        blink_number[FM_LCD_LL_ROW_2][n] = FM_LCD_LL_BLINK_OFF;  //
+        pcf8553_blink_mask[n] = 0;
     }
-
-    blink_char_1 = 0;
-    blink_char_2 = 0;
 }
 
 /*
@@ -172,66 +331,66 @@ void FM_LCD_LL_BlinkClear()
  */
 void FM_LCD_LL_BlinkNumber(fm_lcd_ll_row_t row, uint8_t digit, fm_lcd_ll_blink_t state)
 {
-    switch (row)
+    uint8_t segs;
+
+    if ((row >= FM_LCD_LL_ROWS) || (digit >= FM_LCD_LL_GetRowSize(row)))
     {
-    case (FM_LCD_LL_ROW_1):
-        if (digit < FM_LCD_LL_ROW_1_COLS)
-        {
-            blink_number[row][digit] = state;
-        }
-        break;
-    case (FM_LCD_LL_ROW_2):
-        if (digit < FM_LCD_LL_ROW_2_COLS)
-        {
-            blink_number[row][digit] = state;
-        }
-        break;
-    default:
-        break;
+        return;
     }
+
+    // El punto no parpadea con el digito.
+    segs = (row == FM_LCD_LL_ROW_2) ? PairSwap(SEGS_7) : SEGS_7;
+    DigitWrite(pcf8553_blink_mask, digit_pin[row][digit], (state != FM_LCD_LL_BLINK_OFF) ? segs : 0,
+            segs);
+    BlinkRestart(state != FM_LCD_LL_BLINK_OFF);
 }
 
 /*
- * @brief   Cambia el estado de parpadedo. Para los segmentos que estén habilitados para parpadear
- *          esta función lee y ajusta su condición. Esta funcion solo afecta a los segmentos que
- *          tengan habilitado el parpadeo.
- * @param   mode    0, los segmentos habilitados se apagaran, al refrescar el LCD.
- *                  1, los segmentos habilitados se encenderan, al resfrescar el LCD.
- *                  2, solo lectura.
- * @retval
+ * @brief   Tiempo hasta el proximo cambio de fase del parpadeo por software.
+ * @note    Llamar despues de FM_LCD_LL_Refresh. Si no hay nada parpadeando, o
+ *          lo hace el pcf8553 solo, no hace falta redibujar por el parpadeo.
+ * @param   ninguno
+ * @retval  Milisegundos, redondeados al tick; 0 sin parpadeo por software.
  */
-uint8_t FM_LCD_LL_BlinkRefresh(uint8_t mode)
+uint32_t FM_LCD_LL_BlinkWait()
 {
-    uint8_t ret;
+    ULONG elapsed;
+    ULONG ticks;
 
-    ret = blink_short_refresh;
-
-    switch (mode)
+    if (!blink_software)
     {
-    case 0:  // read&clear
-        blink_short_refresh = 0;
-        break;
-    case 1:  // read&set
-        blink_short_refresh = 1;
-        break;
-    case 2:  // read
-        break;
-    default:
-        blink_short_refresh = 0;
-        break;
+        return 0;
     }
-    return ret;
+
+    elapsed = (tx_time_get() - blink_start) % BLINK_PERIOD_TICKS;
+    ticks = (elapsed < BLINK_ON_TICKS) ? (BLINK_ON_TICKS - elapsed) : (BLINK_PERIOD_TICKS - elapsed);
+
+    return ticks * (1000 / TX_TIMER_TICKS_PER_SECOND);  // @suppress("Avoid magic numbers")
 }
 
 /*
- * @brief
+ * @brief   Habilita o deshabilita el parpadeo de un simbolo.
  * @note
- * @param
- * @retval
+ * @param   symbol, simbolo o punto decimal.
+ *          blink, estado del parpadeo.
+ * @retval  ninguno
  */
 void FM_LCD_LL_BlinkSymbol(fm_lcd_ll_sym_t symbol, fm_lcd_ll_blink_t blink)
 {
-    blink_symbol[symbol] = blink;
+    if (symbol >= FM_LCD_LL_SYM_END)
+    {
+        return;
+    }
+
+    if (blink != FM_LCD_LL_BLINK_OFF)
+    {
+        pcf8553_blink_mask[symbol_bit[symbol].reg] |= symbol_bit[symbol].mask;
+    }
+    else
+    {
+        pcf8553_blink_mask[symbol_bit[symbol].reg] &= ~symbol_bit[symbol].mask;
+    }
+    BlinkRestart(blink != FM_LCD_LL_BLINK_OFF);
 }
 
 /*
@@ -295,267 +454,36 @@ void FM_LCD_LL_Init(uint8_t segments)
  */
 void FM_LCD_LL_PutChar(char c, uint8_t col, fm_lcd_ll_row_t row)
 {
+    uint16_t glyph;
+    uint8_t on;
+    uint8_t written;
 
-    // Control automático de parpadeo
-    if (c == '.') // si hay que imprimir un punto el siguiente algoritmo no se usa.
-    {
-        // No se implementa parpadeo para el punto
-    }
-    else
+    if ((row >= FM_LCD_LL_ROWS) || (col >= FM_LCD_LL_GetRowSize(row)))
     {
-        switch (blink_number[row][col])
-        {
-        case FM_LCD_LL_BLINK_OFF:  // Sin parpadeo.
-            break;
-        case FM_LCD_LL_BLINK_ON_ON: // Parpadeo encendido, se visualizar el caracter.
-            blink_number[row][col] = FM_LCD_LL_BLINK_ON_OFF;
-            break;
-        case FM_LCD_LL_BLINK_ON_OFF:
-            blink_number[row][col] = FM_LCD_LL_BLINK_ON_ON;
-            c = ' '; // Parpadeo encendido, se visualiza el cursor, corresponde a caracter apagado.
-            blink_short_refresh = TRUE; // El símbolo debe durar poco apagado, se necesita refresco rapido;
-            break;
-        default:
-            FM_DEBUG_LedError(1);
-            break;
-        }
+        return;
     }
 
-    g_row = row;
+    glyph = ((uint8_t) c < (sizeof(glyph_7) / sizeof(glyph_7[0]))) ? glyph_7[(uint8_t) c] : 0;
+    on = (uint8_t) glyph;
+    written = (uint8_t) (glyph >> 8);
 
-    switch (row)
+    /*
+     * En la fila 1 el punto del digito se apaga antes de escribir un caracter,
+     * salvo en la ultima columna, donde ese pin es el simbolo D. En la fila 2
+     * los puntos no se tocan.
+     */
+    if ((row == FM_LCD_LL_ROW_1) && (col != (ROW_1_SIZE - 1)) && (c != '.'))
     {
-    case FM_LCD_LL_ROW_1:
-        g_col = col;
-        if (col != (ROW_1_SIZE - 1))
-        {
-            if (c != '.')
-            {
-                WriteLine(SEG_H, 0);
-            }
-        }
-        break;
-    case FM_LCD_LL_ROW_2:
-        g_col = 6 - col;  // @suppress("Avoid magic numbers")
-        break;
-        if (col != (ROW_2_SIZE - 1))
-        {
-            if (c != '.')
-            {
-                WriteLine(SEG_H, 0);
-            }
-        }
-    default:
-        return;
+        written |= SEG_H;
     }
 
-    switch (c)
+    if (row == FM_LCD_LL_ROW_2)
     {
-    case 0: // Si se imprime terminador nullo ser verán  los símbolos '_' y '-' superpuestos.
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 0);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 0);
-        WriteLine(SEG_F, 0);
-        WriteLine(SEG_G, 0);
-        break;
-    case '-':  //
-        WriteLine(SEG_A, 0);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 0);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 0);
-        WriteLine(SEG_F, 0);
-        WriteLine(SEG_G, 0);
-        break;
-    case ' ':
-        WriteLine(SEG_A, 0);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 0);
-        WriteLine(SEG_D, 0);
-        WriteLine(SEG_E, 0);
-        WriteLine(SEG_F, 0);
-        WriteLine(SEG_G, 0);
-        break;
-    case '.':
-        WriteLine(SEG_H, 1);
-        break;
-    case '0':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 0);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 1);
-        break;
-    case '1':
-        WriteLine(SEG_A, 0);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 0);
-        WriteLine(SEG_E, 0);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 0);
-        break;
-    case '2':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 0);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 0);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 1);
-        break;
-    case '3':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 0);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 1);
-        break;
-    case '4':
-        WriteLine(SEG_A, 0);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 0);
-        break;
-    case '5':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 0);
-        WriteLine(SEG_G, 1);
-        break;
-    case '6':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 0);
-        WriteLine(SEG_G, 1);
-        break;
-    case '7':
-        WriteLine(SEG_A, 0);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 0);
-        WriteLine(SEG_E, 0);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 1);
-        break;
-    case '8':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 1);
-        break;
-    case '9':
-        WriteLine(SEG_A, 0);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 1);
-        break;
-    case 'A':
-        WriteLine(SEG_A, 0);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 1);
-        break;
-    case 'E':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 0);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 0);
-        WriteLine(SEG_G, 1);
-        break;
-    case 'L':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 0);
-        WriteLine(SEG_D, 0);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 0);
-        WriteLine(SEG_G, 0);
-        break;
-    case 'O':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 0);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 1);
-        break;
-    case 'P':
-        WriteLine(SEG_A, 0);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 0);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 1);
-        break;
-    case 'S':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 0);
-        WriteLine(SEG_G, 1);
-        break;
-    case 'U':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 1);
-        WriteLine(SEG_D, 0);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 0);
-        break;
-    case '_':
-        WriteLine(SEG_A, 1);
-        WriteLine(SEG_B, 0);
-        WriteLine(SEG_C, 0);
-        WriteLine(SEG_D, 0);
-        WriteLine(SEG_E, 0);
-        WriteLine(SEG_F, 0);
-        WriteLine(SEG_G, 0);
-        break;
-    case 'b':
-        WriteLine(SEG_A, 0);
-        WriteLine(SEG_B, 1);
-        WriteLine(SEG_C, 0);
-        WriteLine(SEG_D, 1);
-        WriteLine(SEG_E, 1);
-        WriteLine(SEG_F, 1);
-        WriteLine(SEG_G, 1);
-        WriteLine(SEG_H, 0);
-        break;
-    default:
-        break;
+        on = PairSwap(on);
+        written = PairSwap(written);
     }
+
+    DigitWrite(pcf8553_ram_map, digit_pin[row][col], on, written);
 }
 
 /*
@@ -567,7 +495,10 @@ void FM_LCD_LL_PutChar(char c, uint8_t col, fm_lcd_ll_row_t row)
  */
 void FM_LCD_LL_Refresh()
 {
+    FMX_STATS_StateBegin(FMX_STATS_STATE_LCD);
+    BlinkApply();
     FM_PCF8553_Refresh();
+    FMX_STATS_StateEnd(FMX_STATS_STATE_LCD);
 }
 
 /*
@@ -579,1223 +510,164 @@ void FM_LCD_LL_Refresh()
  */
 void FM_LCD_LL_SymbolWrite(fm_lcd_ll_sym_t symbol, uint8_t state)
 {
-
-    switch (blink_symbol[symbol])
+    if (symbol >= FM_LCD_LL_SYM_END)
     {
-    case FM_LCD_LL_BLINK_OFF:
-        break;
-    case FM_LCD_LL_BLINK_ON_ON:
-        blink_symbol[symbol] = FM_LCD_LL_BLINK_ON_OFF;
-        break;
-    case FM_LCD_LL_BLINK_ON_OFF:
-        blink_short_refresh = TRUE;
-        blink_symbol[symbol] = FM_LCD_LL_BLINK_ON_ON;
-        state = 0;
-        break;
-    default:
-        FM_DEBUG_LedError(1);
-        break;
+        return;
     }
 
-    switch (symbol)
+    if (state)
     {
-    case FM_LCD_LL_SYM_POINT:
-        if (state)
-        {
-            pcf8553_ram_map[REG_7] |= (1 << BIT_4);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_7] &= ~(1 << BIT_4);
-        }
-        break;
-    case FM_LCD_LL_SYM_BATTERY:
-        if (state)
-        {
-            pcf8553_ram_map[REG_7] |= (1 << BIT_5);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_7] &= ~(1 << BIT_5);
-        }
-        break;
-    case FM_LCD_LL_SYM_POWER:
-        if (state)
-        {
-            pcf8553_ram_map[REG_2] |= (1 << BIT_5);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_2] &= ~(1 << BIT_5);
-        }
-        break;
-    case FM_LCD_LL_SYM_RATE:
-        if (state)
-        {
-            pcf8553_ram_map[REG_17] |= (1 << BIT_5);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_17] &= ~(1 << BIT_5);
-        }
-        break;
-    case FM_LCD_LL_SYM_E:
-        if (state)
-        {
-            pcf8553_ram_map[REG_2] |= (1 << BIT_4);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_2] &= ~(1 << BIT_4);
-        }
-        break;
-    case FM_LCD_LL_SYM_BATCH:
-        if (state)
-        {
-            pcf8553_ram_map[REG_12] |= (1 << BIT_5);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_12] &= ~(1 << BIT_5);
-        }
-        break;
-    case FM_LCD_LL_SYM_ACM_1:
-        // implementar
-        break;
-    case FM_LCD_LL_SYM_TTL:
-        if (state)
-        {
-            pcf8553_ram_map[REG_17] |= (1 << BIT_4);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_17] &= ~(1 << BIT_4);
-        }
-        break;
-    case FM_LCD_LL_SYM_BACKSLASH:
-        if (state)
-        {
-            pcf8553_ram_map[REG_10] |= (1 << BIT_1);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_10] &= ~(1 << BIT_1);
-        }
-        break;
-    case FM_LCD_LL_SYM_ACM_2:
-        if (state)
-        {
-            pcf8553_ram_map[REG_12] |= (1 << BIT_4);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_12] &= ~(1 << BIT_4);
-        }
-        break;
-    case FM_LCD_LL_SYM_S:
-        if (state)
-        {
-            pcf8553_ram_map[REG_10] |= (1 << BIT_5);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_10] &= ~(1 << BIT_5);
-        }
-
-        break;
-    case FM_LCD_LL_SYM_M:
-        if (state)
-        {
-            pcf8553_ram_map[REG_9] |= (1 << BIT_7);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_9] &= ~(1 << BIT_7);
-        }
-        break;
-    case FM_LCD_LL_SYM_H:
-        if (state)
-        {
-            pcf8553_ram_map[REG_5] |= (1 << BIT_6);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_5] &= ~(1 << BIT_6);
-        }
-        break;
-    case FM_LCD_LL_SYM_D:
-        if (state)
-        {
-            pcf8553_ram_map[REG_9] |= (1 << BIT_5);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_9] &= ~(1 << BIT_5);
-        }
-        break;
-
-    case DOT_ROW_1_DECI:
-        if (state)
-        {
-            pcf8553_ram_map[REG_7] |= (1 << BIT_7);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_7] &= ~(1 << BIT_7);
-        }
-        break;
-    case DOT_ROW_1_CENTI:
-        if (state)
-        {
-            pcf8553_ram_map[REG_8] |= (1 << BIT_1);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_8] &= ~(1 << BIT_1);
-        }
-        break;
-    case DOT_ROW_1_MILI:
-        if (state)
-        {
-            pcf8553_ram_map[REG_8] |= (1 << BIT_3);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_8] &= ~(1 << BIT_3);
-        }
-
-        break;
-    case DOT_ROW_1_MICRO:
-        if (state)
-        {
-            pcf8553_ram_map[REG_8] |= (1 << BIT_5);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_8] &= ~(1 << BIT_5);
-        }
-
-        break;
-    case DOT_ROW_1_NANO:
-        if (state)
-        {
-            pcf8553_ram_map[REG_8] |= (1 << BIT_7);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_8] &= ~(1 << BIT_7);
-        }
-
-        break;
-    case DOT_ROW_1_PICO:
-        if (state)
-        {
-            pcf8553_ram_map[REG_9] |= (1 << BIT_1);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_9] &= ~(1 << BIT_1);
-        }
-
-        break;
-    case DOT_ROW_1_FEMTO:
-        if (state)
-        {
-            pcf8553_ram_map[REG_9] |= (1 << BIT_3);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_9] &= ~(1 << BIT_3);
-        }
-
-        break;
-    case DOT_ROW_2_DECI:
-        if (state)
-        {
-            pcf8553_ram_map[REG_7] |= (1 << BIT_2);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_7] &= ~(1 << BIT_2);
-        }
-
-        break;
-    case DOT_ROW_2_CENTI:
-        if (state)
-        {
-            pcf8553_ram_map[REG_7] |= (1 << BIT_0);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_7] &= ~(1 << BIT_0);
-        }
-
-        break;
-    case DOT_ROW_2_MILI:
-        if (state)
-        {
-            pcf8553_ram_map[REG_6] |= (1 << BIT_6);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_6] &= ~(1 << BIT_6);
-        }
-
-        break;
-    case DOT_ROW_2_MICRO:
-        if (state)
-        {
-            pcf8553_ram_map[REG_6] |= (1 << BIT_4);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_6] &= ~(1 << BIT_4);
-        }
-
-        break;
-    case DOT_ROW_2_NANO:
-        if (state)
-        {
-            pcf8553_ram_map[REG_6] |= (1 << BIT_2);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_6] &= ~(1 << BIT_2);
-        }
-
-        break;
-    case DOT_ROW_2_PICO:
-        if (state)
-        {
-            pcf8553_ram_map[REG_6] |= (1 << BIT_0);
-        }
-        else
-        {
-            pcf8553_ram_map[REG_6] &= ~(1 << BIT_0);
-        }
-
-        break;
-
-    case FM_LCD_LL_SYM_END:
-        // implementar
-        break;
-    default:
-        break;
+        pcf8553_ram_map[symbol_bit[symbol].reg] |= symbol_bit[symbol].mask;
+    }
+    else
+    {
+        pcf8553_ram_map[symbol_bit[symbol].reg] &= ~symbol_bit[symbol].mask;
     }
 }
 
 /*
  * @brief 	Función que imprime la unidad de volumen a utilizar.
  * @note
- * @param 	Unidad a imprimir y velocidad de parpadeo.
+ * @param 	Caracter a imprimir.
  * @retval 	None
  *
  */
 void FM_LCD_LL_PutChar_1(char ascii_char)
 {
-
-    // borro
-    pcf8553_ram_map[REG_0] &= ~(1 << BIT_2);  // AMARILLO S2
-    pcf8553_ram_map[REG_0] &= ~(1 << BIT_3);  // AMARILLO S3
-    pcf8553_ram_map[REG_0] &= ~(1 << BIT_4);  // AMARILLO S4
-    pcf8553_ram_map[REG_0] &= ~(1 << BIT_5);  // AMARILLO S5
-    pcf8553_ram_map[REG_5] &= ~(1 << BIT_2);  // VERDE S2
-    pcf8553_ram_map[REG_5] &= ~(1 << BIT_4);  // VERDE S4
-    pcf8553_ram_map[REG_5] &= ~(1 << BIT_5);  // VERDE S5
-    pcf8553_ram_map[REG_10] &= ~(1 << BIT_2);  // ROJO S2
-    pcf8553_ram_map[REG_10] &= ~(1 << BIT_3);  // ROJO S3
-    pcf8553_ram_map[REG_10] &= ~(1 << BIT_4);  // ROJO S4
-    pcf8553_ram_map[REG_15] &= ~(1 << BIT_2);  // AZUL S2
-    pcf8553_ram_map[REG_15] &= ~(1 << BIT_3);  // AZUL S3
-    pcf8553_ram_map[REG_15] &= ~(1 << BIT_4);  // AZUL S4
-    pcf8553_ram_map[REG_15] &= ~(1 << BIT_5);  // AZUL S5
-
-    switch (blink_char_1)
-    {
-    case 0:
-        break;
-    case FM_LCD_LL_BLINK_ON_ON:
-        blink_char_1 = FM_LCD_LL_BLINK_ON_OFF;
-        break;
-    case FM_LCD_LL_BLINK_ON_OFF:
-        blink_char_1 = FM_LCD_LL_BLINK_ON_ON;
-        ascii_char = ' ';
-        blink_short_refresh = TRUE; // El símbolo debe durar poco apagado, se necesita refresco rapido;
-        return;
-        break;
-    }
-
-    switch (ascii_char)
-    {
-
-    case 0:
-        break;
-    case ' ':
-        break;
-    case 1:  // Enciendo todos los segmentos.
-        pcf8553_ram_map[REG_0] |= (1 << BIT_2);  // AMARILLO S2
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);  // AMARILLO S4
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);  // AMARILLO S5
-        pcf8553_ram_map[REG_5] |= (1 << BIT_2);  // VERDE S2
-        pcf8553_ram_map[REG_5] |= (1 << BIT_4);  // VERDE S4
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);  // VERDE S5
-        pcf8553_ram_map[REG_10] |= (1 << BIT_2);  // ROJO S2
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        pcf8553_ram_map[REG_10] |= (1 << BIT_4);  // ROJO S4
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);  // AZUL S2
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_4);  // AZUL S4
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);  // AZUL S5
-    case '0':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);  // AMARILLO S5
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);  // VERDE S5
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);  // AZUL S5
-        break;
-    case '1':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        break;
-    case '2':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);  // AMARILLO S4
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);  // AMARILLO S5
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);  // VERDE S5
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);  // AZUL S2
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        break;
-    case '3':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);  // AMARILLO S4
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);  // VERDE S5
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);  // AZUL S2
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        break;
-    case '4':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);  // AMARILLO S4
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);  // AZUL S2
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);  // AZUL S5
-        break;
-    case '5':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);  // VERDE S5
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);  // AZUL S2
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);  // AZUL S5
-        break;
-    case '6':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);  // AMARILLO S4
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);  // AMARILLO S5
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);  // VERDE S5
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);  // AZUL S2
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);  // AZUL S5
-        break;
-    case '7':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        break;
-    case '8':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);  // AMARILLO S4
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);  // AMARILLO S5
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);  // VERDE S5
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);  // AZUL S2
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);  // AZUL S5
-        break;
-    case '9':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);  // AMARILLO S4
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);  // AZUL S2
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);  // AZUL S5
-        break;
-    case 'A':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'B':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        break;
-    case 'C':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'D':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        break;
-    case 'E':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-        break;
-    case 'F':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'G':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-        break;
-    case 'H':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'I':
-        pcf8553_ram_map[REG_5] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_4);
-        break;
-    case 'J':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        break;
-    case 'K':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'L':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'M':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'N':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'O':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'P':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'Q':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'R':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'S':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'T':
-        pcf8553_ram_map[REG_5] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_4);
-        break;
-    case 'U':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'V':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'W':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-        break;
-    case 'X':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-        break;
-    case 'Y':
-        pcf8553_ram_map[REG_5] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-        break;
-    case 'Z':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-        pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-        break;
-    case 'a':
-        //pcf8553_ram_map[REG_0] |= (1 << BIT_2);  // AMARILLO S2
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);  // AMARILLO S4
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);  // AMARILLO S5
-        //pcf8553_ram_map[REG_5] |= (1 << BIT_2);  // VERDE S2
-        //pcf8553_ram_map[REG_5] |= (1 << BIT_4);  // VERDE S4
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);  // VERDE S5
-        //pcf8553_ram_map[REG_10] |= (1 << BIT_2);  // ROJO S2
-        //pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        //pcf8553_ram_map[REG_10] |= (1 << BIT_4);  // ROJO S4
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);  // AZUL S2
-        //pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        //pcf8553_ram_map[REG_15] |= (1 << BIT_4);  // AZUL S4
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);  // AZUL S5
-           break;
-	case 'b':
-        //pcf8553_ram_map[REG_0] |= (1 << BIT_2);  // AMARILLO S2
-        pcf8553_ram_map[REG_0] |= (1 << BIT_3);  // AMARILLO S3
-        pcf8553_ram_map[REG_0] |= (1 << BIT_4);  // AMARILLO S4
-        pcf8553_ram_map[REG_0] |= (1 << BIT_5);  // AMARILLO S5
-        //pcf8553_ram_map[REG_5] |= (1 << BIT_2);  // VERDE S2
-        //pcf8553_ram_map[REG_5] |= (1 << BIT_4);  // VERDE S4
-        pcf8553_ram_map[REG_5] |= (1 << BIT_5);  // VERDE S5
-        //pcf8553_ram_map[REG_10] |= (1 << BIT_2);  // ROJO S2
-        //pcf8553_ram_map[REG_10] |= (1 << BIT_3);  // ROJO S3
-        //pcf8553_ram_map[REG_10] |= (1 << BIT_4);  // ROJO S4
-        pcf8553_ram_map[REG_15] |= (1 << BIT_2);  // AZUL S2
-        //pcf8553_ram_map[REG_15] |= (1 << BIT_3);  // AZUL S3
-        //pcf8553_ram_map[REG_15] |= (1 << BIT_4);  // AZUL S4
-        pcf8553_ram_map[REG_15] |= (1 << BIT_5);  // AZUL S5
-	   break;
-	case 'c':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'd':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   break;
-	case 'e':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-	   break;
-	case 'f':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'g':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-	   break;
-	case 'h':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'i':
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_4);
-	   break;
-	case 'j':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   break;
-	case 'k':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'l':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'm':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'n':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'o':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'p':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'q':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'r':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 's':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 't':
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_4);
-	   break;
-	case 'u':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'v':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'w':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_5);
-	   break;
-	case 'x':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-	   break;
-	case 'y':
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-	   break;
-	case 'z':
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_0] |= (1 << BIT_4);
-	   pcf8553_ram_map[REG_5] |= (1 << BIT_5);
-	   pcf8553_ram_map[REG_10] |= (1 << BIT_3);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_2);
-	   pcf8553_ram_map[REG_15] |= (1 << BIT_4);
-	   break;
-   case 176:  // Grados centidrados
-       break;
-    default:
-        break;
-    }
+    CharWrite(pcf8553_ram_map, char_1_spans, sizeof(char_1_spans) / sizeof(char_1_spans[0]), Glyph14(ascii_char));
 }
 
+/*
+ * @brief 	Función que imprime el segundo caracter de la unidad de volumen.
+ * @note
+ * @param 	Caracter a imprimir.
+ * @retval 	None
+ *
+ */
 void FM_LCD_LL_PutChar_2(char ascii_char)
 {
+    CharWrite(pcf8553_ram_map, char_2_spans, sizeof(char_2_spans) / sizeof(char_2_spans[0]), Glyph14(ascii_char));
+}
 
-// Borro caracter antes de escribir uno nuevo
-    pcf8553_ram_map[REG_0] &= ~(1 << BIT_0);  // AMARILLO S0
-    pcf8553_ram_map[REG_0] &= ~(1 << BIT_1);  // AMARILLO S1
-    pcf8553_ram_map[REG_4] &= ~(1 << BIT_6);  // AMARILLO S38
-    pcf8553_ram_map[REG_4] &= ~(1 << BIT_7);  // AMARILLO S39
-    pcf8553_ram_map[REG_5] &= ~(1 << BIT_0);  // VERDE S0
-    pcf8553_ram_map[REG_5] &= ~(1 << BIT_1);  // VERDE S1
-    pcf8553_ram_map[REG_9] &= ~(1 << BIT_6);  // VERDE S38
-    pcf8553_ram_map[REG_10] &= ~(1 << BIT_0);  // ROJO S0
-    pcf8553_ram_map[REG_14] &= ~(1 << BIT_6);  // ROJO 38
-    pcf8553_ram_map[REG_14] &= ~(1 << BIT_7);  // ROJO S39
-    pcf8553_ram_map[REG_15] &= ~(1 << BIT_0);  // AZUL S0
-    pcf8553_ram_map[REG_15] &= ~(1 << BIT_1);  // AZUL S1
-    pcf8553_ram_map[REG_19] &= ~(1 << BIT_6);  // AZUL S38
-    pcf8553_ram_map[REG_19] &= ~(1 << BIT_7);  // AZUL S39
+// Private function bodies.
 
-    switch (blink_char_2)
+/*
+ * @brief   Elige quien hace parpadear lo marcado en pcf8553_blink_mask antes de
+ *          un refresco. Si todo lo encendido parpadea, el pcf8553 hace parpadear
+ *          la pantalla completa sin mas refrescos; si no, el micro oculta lo
+ *          marcado en la fase apagada. El pcf8553 no tiene un segundo banco de
+ *          RAM ni parpadeo por segmento.
+ * @param   ninguno
+ * @retval  ninguno
+ */
+static void BlinkApply(void)
+{
+    uint8_t marked = 0;
+    uint8_t steady = 0;
+
+    for (int n = 0; n < PCF8553_RAM_SIZE; n++)
     {
-    case FM_LCD_LL_BLINK_OFF:
-        break;
-    case FM_LCD_LL_BLINK_ON_ON:
-        blink_char_2 = FM_LCD_LL_BLINK_ON_OFF;
-        break;
-    case FM_LCD_LL_BLINK_ON_OFF:
-        blink_char_2 = FM_LCD_LL_BLINK_ON_ON;
-        return;
-        break;
+        marked |= pcf8553_blink_mask[n];
+        steady |= pcf8553_ram_map[n] & ~pcf8553_blink_mask[n];
     }
 
-    switch (ascii_char)
+    if (marked && !steady)
     {
-    case 0: // Con la sigueinte macro se construye cualquier cararter de 14-segmentos digito 2
-        break;
-    case '0':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case '1':
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case '2':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case '3':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case '4':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case '5':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        break;
-    case '6':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        break;
-    case '7':
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case '8':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case '9':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'A':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);
-        break;
-    case 'B':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_9] |= (1 << BIT_6);  // VERDE S38
-        pcf8553_ram_map[REG_10] |= (1 << BIT_0);  // ROJO S0
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'C':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);
-        break;
-    case 'D':
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_9] |= (1 << BIT_6);  // VERDE S38
-        pcf8553_ram_map[REG_10] |= (1 << BIT_0);  // ROJO S0
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'E':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-
-        break;
-    case 'F':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-
-        break;
-    case 'G':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-
-        break;
-    case 'H':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
+        blink_software = FALSE;
+        FM_PCF8553_BlinkHide(FALSE);
+        FM_PCF8553_Blink(BLINK_HW_SPEED);
+        return;
+    }
 
-        break;
-    case 'I':
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_9] |= (1 << BIT_6);  // VERDE S38
-        pcf8553_ram_map[REG_10] |= (1 << BIT_0);  // ROJO S0
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        break;
-    case 'J':
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'K':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_5] |= (1 << BIT_0);  // VERDE S0
-        pcf8553_ram_map[REG_15] |= (1 << BIT_0);  // AZUL S0
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
+    FM_PCF8553_Blink(OFF_SPEED);
+    blink_software = (marked != 0);
+    FM_PCF8553_BlinkHide(
+            blink_software && (((tx_time_get() - blink_start) % BLINK_PERIOD_TICKS) >= BLINK_ON_TICKS));
+}
 
-        break;
-    case 'L':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        break;
-    case 'M':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_14] |= (1 << BIT_6);  // ROJO 38
-        pcf8553_ram_map[REG_15] |= (1 << BIT_0);  // AZUL S0
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'N':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_0);  // VERDE S0
-        pcf8553_ram_map[REG_14] |= (1 << BIT_6);  // ROJO 38
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'O':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'P':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'Q':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_0);  // VERDE S0
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'R':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_5] |= (1 << BIT_0);  // VERDE S0
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'S':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        break;
-    case 'T':
-        pcf8553_ram_map[REG_9] |= (1 << BIT_6);  // VERDE S38
-        pcf8553_ram_map[REG_10] |= (1 << BIT_0);  // ROJO S0
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        break;
-    case 'U':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'V':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_6);  // AMARILLO S38
-        pcf8553_ram_map[REG_15] |= (1 << BIT_0);  // AZUL S0
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        break;
-    case 'W':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_1);  // AMARILLO S1
-        pcf8553_ram_map[REG_4] |= (1 << BIT_6);  // AMARILLO S38
-        pcf8553_ram_map[REG_4] |= (1 << BIT_7);  // AMARILLO S39
-        pcf8553_ram_map[REG_5] |= (1 << BIT_0);  // VERDE S0
-        pcf8553_ram_map[REG_15] |= (1 << BIT_1);  // AZUL S1
-        pcf8553_ram_map[REG_19] |= (1 << BIT_7);  // AZUL S39
-        break;
-    case 'X':
-        pcf8553_ram_map[REG_4] |= (1 << BIT_6);  // AMARILLO S38
-        pcf8553_ram_map[REG_5] |= (1 << BIT_0);  // VERDE S0
-        pcf8553_ram_map[REG_14] |= (1 << BIT_6);  // ROJO 38
-        pcf8553_ram_map[REG_15] |= (1 << BIT_0);  // AZUL S0
-        break;
-    case 'Y':
-        pcf8553_ram_map[REG_9] |= (1 << BIT_6);  // VERDE S38
-        pcf8553_ram_map[REG_14] |= (1 << BIT_6);  // ROJO 38
-        pcf8553_ram_map[REG_15] |= (1 << BIT_0);  // AZUL S0
-        break;
-    case 'Z':
-        pcf8553_ram_map[REG_0] |= (1 << BIT_0);  // AMARILLO S0
-        pcf8553_ram_map[REG_4] |= (1 << BIT_6);  // AMARILLO S38
-        pcf8553_ram_map[REG_5] |= (1 << BIT_1);  // VERDE S1
-        pcf8553_ram_map[REG_14] |= (1 << BIT_7);  // ROJO S39
-        pcf8553_ram_map[REG_15] |= (1 << BIT_0);  // AZUL S0
-        pcf8553_ram_map[REG_19] |= (1 << BIT_6);  // AZUL S38
-        break;
-    case 176:  // Grados centidrados
-        //pcf8553_ram_map[REG_0] |= (1 << BIT_0); // AMARILLO S0
-        //pcf8553_ram_map[REG_0] |= (1 << BIT_1); // AMARILLO S1
-        //pcf8553_ram_map[REG_4] |= (1 << BIT_6); // AMARILLO S38
-        //pcf8553_ram_map[REG_4] |= (1 << BIT_7); // AMARILLO S39
-        //pcf8553_ram_map[REG_5] |= (1 << BIT_0); // VERDE S0
-        //pcf8553_ram_map[REG_5] |= (1 << BIT_1); // VERDE S1
-        //pcf8553_ram_map[REG_9] |= (1 << BIT_6); // VERDE S38
-        //pcf8553_ram_map[REG_10] |= (1 << BIT_0); // ROJO S0
-        //pcf8553_ram_map[REG_14] |= (1 << BIT_6); // ROJO 38
-        //pcf8553_ram_map[REG_14] |= (1 << BIT_7); // ROJO S39
-        //pcf8553_ram_map[REG_15] |= (1 << BIT_1); // AZUL S1
-        //pcf8553_ram_map[REG_19] |= (1 << BIT_6); // AZUL S38
-        //pcf8553_ram_map[REG_19] |= (1 << BIT_7); // AZUL S39
-        break;
-    default:
-        break;
+/*
+ * @brief   Al marcar algo para parpadear la fase vuelve a empezar encendida: el
+ *          cursor que se mueve se ve enseguida.
+ * @param   state: distinto de 0 si se marco algo.
+ * @retval  ninguno
+ */
+static void BlinkRestart(uint8_t state)
+{
+    if (state)
+    {
+        blink_start = tx_time_get();
     }
 }
 
-// Private function bodies.
-
 /*
- * @brief
- * @nota	Esta funcion ajusta el estado de un segmento, encendido o apagado,
- * por cada llamada. El caracter a manipular, linea 1 o linea 2 y la posicion
- * del cursor, son informaciones guardadas en dos variables globales, g_cursor
- * y g_line. Con el mapeo de los segmentos, y sabiendo que segmento se quiere
- * manipular, notar que para el primer caracter de cada linea se tiene una matriz
- * con la posicion en el mapa de memoria para el pcf8553, con lo cual no se
- * requiere calculo, el calculo es de utilidad para los caracteres que no ocupan
- * la primera posicion de cada linea.
- * @param	seg:
- * @param 	data:
- * @retval	ninguno
- *
+ * @brief   Escribe un glifo de 14 segmentos, apagando antes los pines del caracter.
+ * @param   map: mapa a escribir, pcf8553_ram_map o pcf8553_blink_mask.
+ * @param   span: tramos de registro que ocupa el caracter en cada backplane.
+ * @param   spans: cantidad de tramos.
+ * @param   glyph: glifo de glyph_14.
+ * @retval  ninguno
  */
-void WriteLine(uint8_t seg, uint8_t data)
+static void CharWrite(uint8_t *map, const span_t *span, uint32_t spans, uint16_t glyph)
 {
-    uint8_t reg = 0;
-    uint8_t pos = 0;
+    span_t s;  // Copia local: escribir el mapa no obliga a releer el tramo.
+    uint8_t *reg;
+    uint16_t nibbles;
 
-    /*
-     *
-     *
-     */
-    switch (g_row)
+    while (spans--)
     {
-    case FM_LCD_LL_ROW_1:
-        pos = octal_1[seg].pos;
-        pos += g_col * 2;
-        reg = (pos / 8) + octal_1[seg].reg;  // @suppress("Avoid magic numbers")
-        pos = pos % 8;  // @suppress("Avoid magic numbers")
-        break;
-    case FM_LCD_LL_ROW_2:
-        pos = octal_2[seg].pos;
-        pos += g_col * 2;
-        reg = (pos / 8) + octal_2[seg].reg;  // @suppress("Avoid magic numbers")
-        pos = pos % 8;  // @suppress("Avoid magic numbers")
-        break;
-    default:
-        break;
+        s = *span++;
+        reg = &map[s.reg];
+        nibbles = glyph;
+        for (uint32_t k = 0; k < BACKPLANES; k++)
+        {
+            *reg = (*reg & ~s.pins[k])
+                | ((((nibbles & 0x0F) >> s.nibble_shift) << s.pin_shift) & s.pins[k]);
+            reg += BACKPLANE_REGS;
+            nibbles >>= 4;  // @suppress("Avoid magic numbers")
+        }
     }
+}
+
+/*
+ * @brief   Escribe los segmentos de un digito, dos pines por backplane.
+ * @param   map: mapa a escribir, pcf8553_ram_map o pcf8553_blink_mask.
+ * @param   pin: primer pin del digito, de digit_pin.
+ * @param   on: segmentos encendidos.
+ * @param   written: segmentos que se escriben, el resto no se modifica.
+ * @retval  ninguno
+ */
+static void DigitWrite(uint8_t *map, uint8_t pin, uint8_t on, uint8_t written)
+{
+    uint8_t *reg = &map[pin / 8];  // @suppress("Avoid magic numbers")
+    uint8_t shift = pin % 8;  // @suppress("Avoid magic numbers")
+    uint8_t mask;
 
-    if (data)
+    for (uint32_t k = 0; k < BACKPLANES; k++)
     {
-        pcf8553_ram_map[reg] |= 1 << pos;
+        mask = ((written >> (2 * k)) & 0x03) << shift;
+        reg[k * BACKPLANE_REGS] = (reg[k * BACKPLANE_REGS] & ~mask)
+            | ((((on >> (2 * k)) & 0x03) << shift) & mask);
     }
-    else
+}
+
+/*
+ * @brief   Glifo de 14 segmentos de un caracter, apagado si no esta en la tabla.
+ */
+static uint16_t Glyph14(char c)
+{
+    if ((uint8_t) c < (sizeof(glyph_14) / sizeof(glyph_14[0])))
     {
-        pcf8553_ram_map[reg] &= ~(1 << pos);
+        return glyph_14[(uint8_t) c];
     }
+    return 0;
+}
+
+/*
+ * @brief   Intercambia los dos bits de cada backplane, de la fila 1 a la fila 2.
+ */
+static uint8_t PairSwap(uint8_t bits)
+{
+    return (uint8_t) (((bits & 0x55) << 1) | ((bits >> 1) & 0x55));  // @suppress("Avoid magic numbers")
 }
 
 /*** end of file ***/
@@ -149,10 +149,10 @@ void
 FM_LCD_LL_BlinkChar(uint8_t state);
 void
 FM_LCD_LL_BlinkNumber(fm_lcd_ll_row_t row, uint8_t digit, fm_lcd_ll_blink_t state);
-uint8_t
-FM_LCD_LL_BlinkRefresh(uint8_t mode);
 void
 FM_LCD_LL_BlinkSymbol(fm_lcd_ll_sym_t, fm_lcd_ll_blink_t);
+uint32_t
+FM_LCD_LL_BlinkWait();
 void
 FM_LCD_LL_Clear();
 uint32_t
@@ -4,6 +4,21 @@
  * 			Para la memoria flash comprueba los limites y datos a guardar, la
  * 			escritura de la flash se hace con una API externa.
  *
+ * La flash del log es un anillo de solo agregado: cada registro lleva un
+ * numero de secuencia y ocupa el lugar sequence % DATA_FLASH_LENGTH, que se
+ * programa una sola vez. Una pagina se borra solo cuando el head entra en
+ * ella, asi que un reset o un corte no pisan la historia. Al arrancar el head
+ * se busca por biseccion sobre las secuencias.
+ *
+ * El primer lugar de cada pagina es un resumen (tiempos, motivos y cantidad
+ * de registros) que se programa al salir el head de la pagina. Las consultas
+ * por tiempo y motivo saltean las paginas cuyo resumen no coincide y bisecan
+ * por tiempo dentro de las demas.
+ *
+ * Un corte a mitad de programar un quad-word puede dejarlo con doble error de
+ * ECC. La secuencia de un registro y el magic de un resumen estan en el ultimo
+ * quad-word, que se programa ultimo: se leen con FM_FLASH_WordRead y con error
+ * el lugar no es valido. El resto del lugar se lee directo solo despues.
  */
 
 #include "fm_log.h"
@@ -14,6 +29,7 @@
 #include "fm_fmc.h"
 #include "fmx.h"
 #include "fm_log_policy.h"
+#include <stddef.h>
 
 // --- Constants ---
 
@@ -31,39 +47,96 @@
 #define LOG_DATA_SIZE             (64u)
 #define BACKUP_RAM_SIZE           (1024u)
 #define DATA_BACKUP_RAM_LENGTH    (BACKUP_RAM_SIZE / LOG_DATA_SIZE)		//
-#define DATA_FLASH_LENGTH         (FM_FLASH_LOG_SIZE / LOG_DATA_SIZE) 	// Equivale a 16128 registros
+
+#define LOG_PAGES                 (FM_FLASH_LOG_SIZE / FLASH_PAGE_SIZE) // 126 paginas
+#define LOG_PAGE_RECORDS          ((FLASH_PAGE_SIZE / LOG_DATA_SIZE) - 1u) // 127 registros y el resumen
+#define DATA_FLASH_LENGTH         (LOG_PAGES * LOG_PAGE_RECORDS) 	// Equivale a 16002 registros
+#define LOG_PAGE_MAGIC            (0x50414731u)   // "PAG1"
+#define LOG_STAGE_MAGIC           (0x4C4F4731u)   // "LOG1"
+#define SEQUENCE_NONE             (0xFFFFFFFFu)   // Lugar borrado, o registro cortado en su ultimo quad-word o antes.
+
+_Static_assert((FM_FLASH_LOG_START % FLASH_PAGE_SIZE) == 0u, "log must start on a page");
+_Static_assert((FM_FLASH_LOG_SIZE % FLASH_PAGE_SIZE) == 0u, "log must be whole pages");
+_Static_assert(offsetof(fm_log_data_t, sequence) == (LOG_DATA_SIZE - sizeof(uint32_t)),
+               "sequence must be in the last quad-word");
+_Static_assert(FMX_ACK_BATCH_DONE < 32, "ack bitmap is 32 bits");
+
+// --- Types ---
+
+/*
+ * Registros en espera de la flash. Vive en la BACKUP RAM con su cuenta, asi
+ * que un reset no los pierde; magic invalida el contenido de una RAM sin
+ * bateria de backup.
+ */
+typedef struct {
+    uint32_t      magic;
+    uint32_t      count;
+    fm_log_data_t record[DATA_BACKUP_RAM_LENGTH];
+} log_stage_t;
+
+/*
+ * Resumen de una pagina, en su primer lugar. Con el RTC en orden time_first y
+ * time_last son el primer y el ultimo registro; se guardan el menor y el
+ * mayor para que un ajuste de hora no haga saltear la pagina.
+ */
+typedef struct {
+    uint32_t time_first;    // Menor time_unix de la pagina.
+    uint32_t time_last;     // Mayor time_unix de la pagina.
+    uint32_t acks;          // FM_LOG_ACK(ack) de cada motivo presente.
+    uint32_t count;         // Registros validos.
+    uint32_t sequence;      // Secuencia del primer lugar, identifica la vuelta.
+    uint8_t  reserved[40];
+    uint32_t magic;         // Ultimo campo, se programa ultimo.
+} log_page_header_t;
+
+_Static_assert(sizeof(log_page_header_t) == LOG_DATA_SIZE, "header must fill a slot");
 
 // --- Logger state ---
 
-static uint32_t log_data_address = FM_FLASH_LOG_START;
-static fm_log_data_t data_buffer[DATA_BACKUP_RAM_LENGTH] __attribute__((section(".RAM_BACKUP_Section")));
+static log_stage_t stage __attribute__((section(".RAM_BACKUP_Section")));
+static uint32_t    next_sequence;  // Secuencia del proximo registro en la flash.
 
 // --- Private functions ---
 
 static void LogFlash(void);
+static void RecordWrite(fm_log_data_t *record);
+static void PageClose(uint32_t sequence);
+static uint32_t HeadFind(void);
+static uint32_t PageAddress(uint32_t page);
+static uint32_t SlotAddress(uint32_t slot);
+static uint32_t SlotSequence(uint32_t slot);
+static const log_page_header_t *PageHeader(uint32_t sequence);
+static uint32_t TimeLowerBound(uint32_t low, uint32_t high, uint32_t time);
 
 
 /**
- *
+ * Recupera los registros en espera y busca el head del log en la flash.
+ * @note Llamar despues de FM_BACKUP_Init.
  */
 void FM_LOG_Init()
 {
-	memset(data_buffer, 0, sizeof(data_buffer));
+    if ((stage.magic != LOG_STAGE_MAGIC) || (stage.count > DATA_BACKUP_RAM_LENGTH))
+    {
+        memset(&stage, 0, sizeof(stage));
+        stage.magic = LOG_STAGE_MAGIC;
+    }
+
+    next_sequence = HeadFind();
 }
 
 
 /**
- *
+ * Registra la ultima medicion publicada por FM_FMC_SnapshotPublish.
  */
 fmx_status_t FM_LOG_NewEvent(fmx_ack_t ack)
 {
-    static uint8_t data_index = 0u;
-	static uint32_t time_now;
+	fm_fmc_snapshot_t snapshot;
+	fm_log_data_t *record;
 
 	if(FM_LOG_POLICY_Step(ack))
 	{
-		// Se loggeara un nuevo dato.
-		time_now = FM_RTC_GetUnixTime();
+		// Se loggeara un nuevo dato, con la hora y los contadores de la ventana.
+		FM_FMC_SnapshotGet(&snapshot);
 	}
 	else
 	{
@@ -71,36 +144,274 @@ fmx_status_t FM_LOG_NewEvent(fmx_ack_t ack)
 		return FMX_STATUS_ERROR;
 	}
 
-	data_buffer[data_index].ack        = ack;
-	data_buffer[data_index].time_unix  = time_now;
-	data_buffer[data_index].ttl_pulses = FM_FMC_TtlPulseGet();
-	data_buffer[data_index].acm_pulses = FM_FMC_AcmGetPulse();
-	data_buffer[data_index].factor_cal = FM_FMC_FactorCalGet();
-	data_buffer[data_index].rate	   = FM_FMC_RateGet();
+    // Lleno al arrancar: un corte interrumpio el volcado anterior.
+    if (stage.count >= DATA_BACKUP_RAM_LENGTH)
+    {
+        LogFlash();
+    }
+
+	record = &stage.record[stage.count];
+	memset(record, 0, sizeof(*record));
+	record->ack        = ack;
+	record->time_unix  = snapshot.time_unix;
+	record->ttl_pulses = snapshot.pulse_ttl;
+	record->acm_pulses = snapshot.pulse_acm;
+	record->factor_cal = FM_FMC_FactorCalGet();
+	record->rate	   = snapshot.rate;
+	record->sequence   = SEQUENCE_NONE;
 
-    data_index++;
+    stage.count++;
 
-    if (data_index >= DATA_BACKUP_RAM_LENGTH)
+    if (stage.count >= DATA_BACKUP_RAM_LENGTH)
     {
-          data_index = 0u;
           LogFlash();
     }
     return FMX_STATUS_OK;
 }
 
 /**
- *
+ * Vuelca los registros en espera. Un registro que ya tiene una secuencia menor
+ * que el head se escribio antes de un corte y no se repite.
  */
 static void LogFlash(void)
 {
+    for (uint32_t i = 0; i < stage.count; i++)
+    {
+        if ((stage.record[i].sequence != SEQUENCE_NONE) && (stage.record[i].sequence < next_sequence))
+        {
+            continue;
+        }
+        RecordWrite(&stage.record[i]);
+    }
+    stage.count = 0;
+ }
+
+/*
+ * Programa un registro en el lugar de next_sequence. Al entrar en una pagina
+ * se cierra la anterior con su resumen y se borra la nueva, si no lo esta; un
+ * lugar no borrado dentro de la pagina es un registro cortado a medio
+ * programar y se saltea, gastando su secuencia.
+ */
+static void RecordWrite(fm_log_data_t *record)
+{
+    uint32_t slot;
+    uint32_t address;
 
-    FM_FLASH_Write(log_data_address, (const uint8_t *)data_buffer, BACKUP_RAM_SIZE);
-    log_data_address += BACKUP_RAM_SIZE;
+    for (;;)
+    {
+        slot = next_sequence % DATA_FLASH_LENGTH;
+        address = SlotAddress(slot);
 
-    if (log_data_address >= FM_FLASH_LOG_END) {
-        log_data_address = FM_FLASH_LOG_START;
+        if ((slot % LOG_PAGE_RECORDS) == 0u)
+        {
+            if (next_sequence != 0u)
+            {
+                PageClose(next_sequence - 1u);
+            }
+            if (!FM_FLASH_IsErased(PageAddress(slot / LOG_PAGE_RECORDS), FLASH_PAGE_SIZE)
+                && (FM_FLASH_PageErase(PageAddress(slot / LOG_PAGE_RECORDS)) == 0u))
+            {
+                FM_DEBUG_LedError(1);
+                return;
+            }
+        }
+        if (FM_FLASH_IsErased(address, LOG_DATA_SIZE))
+        {
+            break;
+        }
+        next_sequence++;
+    }
+
+    record->sequence = next_sequence;
+    next_sequence++;
+
+    if (FM_FLASH_Program(address, (const uint8_t *)record, LOG_DATA_SIZE) != LOG_DATA_SIZE)
+    {
+        FM_DEBUG_LedError(1);
+    }
+}
+
+/*
+ * Programa el resumen de la pagina de sequence, su ultimo registro. Se arma
+ * leyendo la pagina, asi que tambien se cierra bien despues de un reset. Si el
+ * lugar del resumen no esta borrado la pagina ya se cerro, o un corte lo dejo
+ * a medias y la pagina queda sin resumen.
+ */
+static void PageClose(uint32_t sequence)
+{
+    log_page_header_t header;
+    const fm_log_data_t *record;
+    uint32_t first;
+    uint32_t address;
+
+    first = sequence - (sequence % LOG_PAGE_RECORDS);
+    address = PageAddress((sequence % DATA_FLASH_LENGTH) / LOG_PAGE_RECORDS);
+    if (!FM_FLASH_IsErased(address, LOG_DATA_SIZE))
+    {
+        return;
     }
- }
+
+    memset(&header, 0, sizeof(header));
+    header.time_first = UINT32_MAX;
+    header.sequence = first;
+    header.magic = LOG_PAGE_MAGIC;
+    for (uint32_t i = first; i <= sequence; i++)
+    {
+        if (SlotSequence(i % DATA_FLASH_LENGTH) != i)
+        {
+            continue;
+        }
+        record = (const fm_log_data_t *)SlotAddress(i % DATA_FLASH_LENGTH);
+        header.time_first = (record->time_unix < header.time_first) ? record->time_unix : header.time_first;
+        header.time_last = (record->time_unix > header.time_last) ? record->time_unix : header.time_last;
+        header.acks |= FM_LOG_ACK(record->ack);
+        header.count++;
+    }
+
+    if (FM_FLASH_Program(address, (const uint8_t *)&header, LOG_DATA_SIZE) != LOG_DATA_SIZE)
+    {
+        FM_DEBUG_LedError(1);
+    }
+}
+
+/*
+ * Secuencia del proximo registro. Las paginas se llenan en orden, y la del head
+ * se borra al entrar en ella. Por eso el primer registro de cada pagina crece
+ * desde la pagina 0 hasta la del head, y despues cae: la pagina siguiente esta
+ * borrada o trae la vuelta anterior. Una biseccion encuentra la pagina del head
+ * y otra el ultimo registro valido dentro de ella: 14 lecturas en lugar de
+ * recorrer los 16002 registros.
+ */
+static uint32_t HeadFind(void)
+{
+    uint32_t first;
+    uint32_t sequence;
+    uint32_t low;
+    uint32_t high;
+    uint32_t mid;
+
+    first = SlotSequence(0);
+    if (first == SEQUENCE_NONE)
+    {
+        // Log vacio, o la pagina 0 es la del head y el corte fue al entrar en ella.
+        low = LOG_PAGES - 1u;
+        if (SlotSequence(low * LOG_PAGE_RECORDS) == SEQUENCE_NONE)
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        // Ultima pagina con primer registro valido y de esta vuelta.
+        low = 0;
+        high = LOG_PAGES - 1u;
+        while (low < high)
+        {
+            mid = (low + high + 1u) / 2u;
+            sequence = SlotSequence(mid * LOG_PAGE_RECORDS);
+            if ((sequence != SEQUENCE_NONE) && (sequence >= first))
+            {
+                low = mid;
+            }
+            else
+            {
+                high = mid - 1u;
+            }
+        }
+    }
+
+    // Ultimo registro valido de la pagina; el primero lo es.
+    low *= LOG_PAGE_RECORDS;
+    high = low + LOG_PAGE_RECORDS - 1u;
+    while (low < high)
+    {
+        mid = (low + high + 1u) / 2u;
+        if (SlotSequence(mid) != SEQUENCE_NONE)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1u;
+        }
+    }
+
+    return SlotSequence(low) + 1u;
+}
+
+static uint32_t PageAddress(uint32_t page)
+{
+    return FM_FLASH_LOG_START + (page * FLASH_PAGE_SIZE);
+}
+
+// El lugar 0 de cada pagina es el resumen.
+static uint32_t SlotAddress(uint32_t slot)
+{
+    return PageAddress(slot / LOG_PAGE_RECORDS) + (((slot % LOG_PAGE_RECORDS) + 1u) * LOG_DATA_SIZE);
+}
+
+/*
+ * Secuencia del registro de un lugar, o SEQUENCE_NONE si esta borrado, cortado
+ * (tambien con error de ECC) o no corresponde al lugar.
+ */
+static uint32_t SlotSequence(uint32_t slot)
+{
+    uint32_t sequence;
+
+    if (!FM_FLASH_WordRead(SlotAddress(slot) + offsetof(fm_log_data_t, sequence), &sequence)
+        || ((sequence % DATA_FLASH_LENGTH) != slot))
+    {
+        return SEQUENCE_NONE;
+    }
+    return sequence;
+}
+
+/*
+ * Resumen de la pagina de sequence, o NULL si la pagina no se cerro en esta
+ * vuelta o el resumen quedo cortado.
+ */
+static const log_page_header_t *PageHeader(uint32_t sequence)
+{
+    const log_page_header_t *header;
+    uint32_t magic;
+
+    header = (const log_page_header_t *)PageAddress((sequence % DATA_FLASH_LENGTH) / LOG_PAGE_RECORDS);
+    if (!FM_FLASH_WordRead((uint32_t)&header->magic, &magic) || (magic != LOG_PAGE_MAGIC)
+        || (header->sequence != (sequence - (sequence % LOG_PAGE_RECORDS))))
+    {
+        return NULL;
+    }
+    return header;
+}
+
+/*
+ * Primera secuencia de [low, high) cuyo registro, o el siguiente valido, tiene
+ * time_unix >= time; high si no hay. Dentro de una pagina el tiempo crece con
+ * la secuencia.
+ */
+static uint32_t TimeLowerBound(uint32_t low, uint32_t high, uint32_t time)
+{
+    uint32_t mid;
+    uint32_t valid;
+
+    while (low < high)
+    {
+        mid = low + ((high - low) / 2u);
+        for (valid = mid; (valid < high) && (SlotSequence(valid % DATA_FLASH_LENGTH) != valid); valid++)
+        {
+        }
+        if ((valid < high)
+            && (((const fm_log_data_t *)SlotAddress(valid % DATA_FLASH_LENGTH))->time_unix < time))
+        {
+            low = valid + 1u;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
 
 // --- API ---
 
@@ -108,28 +419,108 @@ static void LogFlash(void)
  * Reads log entries from Flash in reverse chronological order.
  * @param data_index Relative index: 1 returns the latest entry, etc.
  * @param data_ptr Destination buffer to copy the entry into.
- * @return Number of bytes read or an error code.
+ * @return FMX_STATUS_OUT_OF_RANGE past the oldest entry, FMX_STATUS_ERROR if
+ *         the entry was erased with its page or lost to a power cut.
  */
 fmx_status_t FM_LOG_ReadLog(uint32_t data_index, uint8_t *data_ptr)
 {
-    fmx_status_t ret_status = FMX_STATUS_OK;
-    uint32_t memory_address;
-    uint32_t data_offset_index;
+    uint32_t sequence;
+    uint32_t slot;
 
-    if (data_index >= DATA_FLASH_LENGTH) {
+    if ((data_index == 0u) || (data_index > next_sequence) || (data_index > DATA_FLASH_LENGTH)) {
         return FMX_STATUS_OUT_OF_RANGE;
     }
 
-    data_offset_index = (log_data_address - FM_FLASH_LOG_START) / LOG_DATA_SIZE;
+    sequence = next_sequence - data_index;
+    slot = sequence % DATA_FLASH_LENGTH;
+    if (SlotSequence(slot) != sequence) {
+        return FMX_STATUS_ERROR;
+    }
+
+    FM_FLASH_Read(SlotAddress(slot), data_ptr, LOG_DATA_SIZE);
+    return FMX_STATUS_OK;
+}
+
+/**
+ * Starts a query over the log, oldest entry first.
+ * @param query Query state, passed to FM_LOG_QueryNext.
+ * @param time_from First time_unix included.
+ * @param time_to Last time_unix included.
+ * @param acks FM_LOG_ACK bits of the reasons included, 0 for all.
+ */
+void FM_LOG_QueryStart(fm_log_query_t *query, uint32_t time_from, uint32_t time_to, uint32_t acks)
+{
+    query->time_from = time_from;
+    query->time_to = time_to;
+    query->acks = (acks != 0u) ? acks : UINT32_MAX;
+
+    // La pagina del head ya perdio los registros de la vuelta anterior.
+    query->sequence = 0;
+    if (next_sequence > DATA_FLASH_LENGTH)
+    {
+        query->sequence = next_sequence - DATA_FLASH_LENGTH;
+        query->sequence += (LOG_PAGE_RECORDS - (query->sequence % LOG_PAGE_RECORDS)) % LOG_PAGE_RECORDS;
+    }
+    query->page_end = query->sequence;
+}
+
+/**
+ * Copies the next log entry matching the query. Pages whose summary does not
+ * match are skipped without reading their entries, and the first entry in the
+ * time range of a page is found by bisection.
+ * @param query Query started with FM_LOG_QueryStart.
+ * @param data Destination of the entry.
+ * @return FMX_STATUS_OK with an entry, FMX_STATUS_OUT_OF_RANGE when done.
+ */
+fmx_status_t FM_LOG_QueryNext(fm_log_query_t *query, fm_log_data_t *data)
+{
+    const log_page_header_t *header;
+    const fm_log_data_t *record;
+    uint32_t address;
+    uint32_t end;
+
+    while (query->sequence < next_sequence)
+    {
+        if (query->sequence >= query->page_end)
+        {
+            // Entrada a una pagina: el resumen decide si se lee.
+            query->page_end = query->sequence - (query->sequence % LOG_PAGE_RECORDS) + LOG_PAGE_RECORDS;
+            end = (query->page_end < next_sequence) ? query->page_end : next_sequence;
+            header = PageHeader(query->sequence);
+            if ((header != NULL)
+                && ((header->time_last < query->time_from) || (header->time_first > query->time_to)
+                    || ((header->acks & query->acks) == 0u)))
+            {
+                query->sequence = query->page_end;
+                continue;
+            }
+            if ((header == NULL) || (header->time_first < query->time_from))
+            {
+                query->sequence = TimeLowerBound(query->sequence, end, query->time_from);
+                continue;
+            }
+        }
 
-    if (data_index <= data_offset_index) {
-        memory_address = log_data_address;
-        memory_address -= (data_offset_index * LOG_DATA_SIZE);
-    } else {
-        data_offset_index -= (data_index + 1u);
-        memory_address = FM_FLASH_LOG_END - (data_offset_index * LOG_DATA_SIZE);
+        address = SlotAddress(query->sequence % DATA_FLASH_LENGTH);
+        record = (const fm_log_data_t *)address;
+        if (SlotSequence(query->sequence % DATA_FLASH_LENGTH) != query->sequence)
+        {
+            query->sequence++;
+            continue;
+        }
+        if (record->time_unix > query->time_to)
+        {
+            // El resto de la pagina es posterior.
+            query->sequence = query->page_end;
+            continue;
+        }
+        query->sequence++;
+        if ((record->time_unix >= query->time_from) && ((FM_LOG_ACK(record->ack) & query->acks) != 0u))
+        {
+            FM_FLASH_Read(address, (uint8_t *)data, LOG_DATA_SIZE);
+            return FMX_STATUS_OK;
+        }
     }
 
-    FM_FLASH_Read(memory_address, data_ptr, LOG_DATA_SIZE);
-    return ret_status;
+    return FMX_STATUS_OUT_OF_RANGE;
 }
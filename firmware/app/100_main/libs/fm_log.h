@@ -24,15 +24,30 @@ typedef struct {
     uint16_t    temp_ext;
     uint16_t    temp_int;
     fmx_ack_t 	ack;		// Motivo del log
-    uint8_t		reserver[30];
+    uint8_t		reserver[27];
+    uint32_t    sequence;   // Numero de registro en la flash; ultimo campo, se programa ultimo.
 } fm_log_data_t;
 
 _Static_assert(sizeof(fm_log_data_t) == 64, "size must be 64");
 
+/** Bit of a reason in the acks filter of FM_LOG_QueryStart. */
+#define FM_LOG_ACK(ack)   (1uL << (uint32_t)(ack))
+
+/** Cursor of a query by time and reason, see FM_LOG_QueryStart. */
+typedef struct {
+    uint32_t time_from;
+    uint32_t time_to;
+    uint32_t acks;
+    uint32_t sequence;  // Proximo registro a mirar.
+    uint32_t page_end;  // Secuencia de la pagina siguiente a la que se esta leyendo.
+} fm_log_query_t;
+
 
 void FM_LOG_Init();
 fmx_status_t FM_LOG_ReadLog(uint32_t data_index, uint8_t *data_ptr);
 fmx_status_t FM_LOG_NewEvent(fmx_ack_t ack);
+void FM_LOG_QueryStart(fm_log_query_t *query, uint32_t time_from, uint32_t time_to, uint32_t acks);
+fmx_status_t FM_LOG_QueryNext(fm_log_query_t *query, fm_log_data_t *data);
 
 #endif // FM_LOG_H_
 
@@ -15,6 +15,8 @@
 #include "fm_cmd.h"
 #include "fm_debug.h"
 #include "fm_usart.h"
+#include "fmx_clock.h"
+#include "fmx_stats.h"
 #include "stdbool.h"
 
 // Sección define sin dependencia.
@@ -103,6 +105,7 @@ typedef struct
 
 // Variables statics, primero las tipo const.
 static TX_QUEUE *queue_ptr = NULL;          // Puntero a la cola de comandos
+static bool comms_clock = false;            // Perfil FMX_CLOCK_COMMS pedido.
 
 /*
  *  Lista de comandos AT del EMC-3080. Para los comando que aun no estudie su respuesta, completo
@@ -211,12 +214,20 @@ void FM_MXC_PowerOn()
     fmx_status_t ret_status;
 
     FM_MXC_Mode(FM_MXC_MODE_ON);
+    FMX_STATS_StateBegin(FMX_STATS_STATE_MXC);
 
     ret_status = FM_USART_Uart3PowerOn();
     if (ret_status != FMX_STATUS_OK)
     {
         FM_DEBUG_LedError(1);
     }
+
+    // Con el clock del UART3 ya habilitado, para que se recalcule su BRR.
+    if (!comms_clock)
+    {
+        FMX_CLOCK_Request(FMX_CLOCK_COMMS);
+        comms_clock = true;
+    }
 }
 
 /*
@@ -227,8 +238,14 @@ void FM_MXC_PowerOn()
 void FM_MXC_PowerOff()
 {
     HAL_UART_AbortReceive(&huart3);
+    if (comms_clock)
+    {
+        FMX_CLOCK_Release(FMX_CLOCK_COMMS);
+        comms_clock = false;
+    }
     HAL_UART_MspDeInit(&huart3);
     FM_MXC_Mode(FM_MXC_MODE_OFF);
+    FMX_STATS_StateEnd(FMX_STATS_STATE_MXC);
 }
 
 /*
@@ -31,6 +31,10 @@
 
 /////////////////// Includes.
 #include "fm_pcf8553.h"
+#include "fm_debug.h"
+#include "fmx_lp.h"
+#include "tx_api.h"
+#include <string.h>
 
 /////////////////// Typedef.
 
@@ -99,6 +103,12 @@ const uint32_t DELAY_5_MS = 5;
 
 #define DATA_ADDRESS            4 /* First data address */
 
+/*
+ * Espera maxima del fin de un volcado por DMA, en ticks de ThreadX. El peor caso,
+ * 21 bytes a 1.5 MHz, dura ~0.12 ms.
+ */
+#define REFRESH_TIMEOUT         2
+
 /*
  * Los dos siguientes #defines se crean para poder inicializar el miembro
  * read_write de struct register_address_t, la solucion actual no me parece
@@ -126,6 +136,7 @@ extern SPI_HandleTypeDef hspi1;
 
 // Non-static global, used on other modules.
 SPI_HandleTypeDef h_spi1;
+DMA_HandleTypeDef pcf8553_dma;  // GPDMA1 canal 2, SPI1 TX; su IRQ esta en stm32u5xx_it.c.
 
 /*
  * El driver PCF8553 tiene una memoria interna, es estado de los bits, 0 o 1,
@@ -140,6 +151,13 @@ SPI_HandleTypeDef h_spi1;
 uint8_t pcf8553_ram_map[PCF8553_RAM_SIZE]; // se usa el alias "memoria shadow de pantalla" para referirse a
 // este buffer cuando se lo escribe sin actualizar la pantalla.
 
+/*
+ * Segmentos que parpadean por software. El pcf8553 solo hace parpadear la
+ * pantalla completa (Display_ctrl_2, BL); para un digito o un simbolo,
+ * FM_PCF8553_Refresh manda estos bits en 0 mientras la fase este oculta.
+ */
+uint8_t pcf8553_blink_mask[PCF8553_RAM_SIZE];
+
 // Global variables, statics.
 
 /*
@@ -173,12 +191,46 @@ static display_ctrl_2_t g_display_ctrl_2 =
 { .reg_bits.inversion = 0, /* line inversion (default) */
 .reg_bits.blink = 0, .reg_bits.default_value = 0 };
 
+/*
+ * Copia de lo ultimo enviado al pcf8553. FM_PCF8553_Refresh solo manda el tramo
+ * contiguo que cambio respecto de esta copia; sent_valid en 0 (arranque, reset
+ * o error de SPI) fuerza a mandar el mapa completo.
+ */
+static uint8_t sent_map[PCF8553_RAM_SIZE];
+static uint8_t sent_valid = 0;
+
+// Direccion mas datos de un volcado; el DMA lo lee despues de volver de la HAL.
+static uint8_t refresh_buffer[PCF8553_RAM_SIZE + 1];
+
+/*
+ * Doble buffer: los menus arman el cuadro en pcf8553_ram_map y
+ * FM_PCF8553_Refresh lo da vuelta de una vez a frame, que es lo que debe verse
+ * (el mapa, sin lo marcado en pcf8553_blink_mask si blink_hide). El DMA sale
+ * de frame via refresh_buffer, nunca del mapa que se esta armando.
+ */
+static uint8_t frame[PCF8553_RAM_SIZE];
+static uint8_t blink_hide = 0;
+
+/*
+ * Unico hilo que arma el mapa y refresca, fijado con FM_PCF8553_OwnerSet. Los
+ * demas piden el redibujo con FMX_RefreshEventTrue.
+ */
+static TX_THREAD *owner = TX_NULL;
+
+// Fin de volcado por DMA, dado desde HAL_SPI_TxCpltCallback.
+static TX_SEMAPHORE refresh_semaphore;
+static uint8_t rtos_ready = 0;
+
 // Private function prototypes.
 
 static void
 ReadyToSend(uint8_t add);
 static void
 SpiInit(void);
+static void
+DmaInit(void);
+static uint8_t
+DirtyRange(uint8_t *first, uint8_t *last);
 
 // Private function bodies.
 
@@ -213,6 +265,11 @@ void static ReadyToSend(uint8_t add)
  */
 static void SpiInit(void)
 {
+    // Una sola vez: el prescaler lo ajusta fmx_clock segun el perfil de reloj.
+    if (h_spi1.Instance != NULL)
+    {
+        return;
+    }
 
     h_spi1 = hspi1;
     h_spi1.Instance = SPI1;
@@ -233,23 +290,108 @@ static void SpiInit(void)
     {
         Error_Handler();
     }
+
+    DmaInit();
+}
+
+/*
+ * @brief GPDMA1 canal 2 para el TX del SPI1. El fin de la transferencia lo da
+ * la interrupcion EOT del SPI1, no la del DMA: se habilitan las dos.
+ * @param None
+ * @retval None
+ */
+static void DmaInit(void)
+{
+    pcf8553_dma.Instance = GPDMA1_Channel2;
+    pcf8553_dma.Init.Request = GPDMA1_REQUEST_SPI1_TX;
+    pcf8553_dma.Init.BlkHWRequest = DMA_BREQ_SINGLE_BURST;
+    pcf8553_dma.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    pcf8553_dma.Init.SrcInc = DMA_SINC_INCREMENTED;
+    pcf8553_dma.Init.DestInc = DMA_DINC_FIXED;
+    pcf8553_dma.Init.SrcDataWidth = DMA_SRC_DATAWIDTH_BYTE;
+    pcf8553_dma.Init.DestDataWidth = DMA_DEST_DATAWIDTH_BYTE;
+    pcf8553_dma.Init.Priority = DMA_LOW_PRIORITY_LOW_WEIGHT;
+    pcf8553_dma.Init.SrcBurstLength = 1;
+    pcf8553_dma.Init.DestBurstLength = 1;
+    pcf8553_dma.Init.TransferAllocatedPort = DMA_SRC_ALLOCATED_PORT0 | DMA_DEST_ALLOCATED_PORT0;
+    pcf8553_dma.Init.TransferEventMode = DMA_TCEM_BLOCK_TRANSFER;
+    pcf8553_dma.Init.Mode = DMA_NORMAL;
+    if (HAL_DMA_Init(&pcf8553_dma) != HAL_OK)
+    {
+        Error_Handler();
+    }
+    __HAL_LINKDMA(&h_spi1, hdmatx, pcf8553_dma);
+    if (HAL_DMA_ConfigChannelAttributes(&pcf8553_dma, DMA_CHANNEL_NPRIV) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    HAL_NVIC_SetPriority(GPDMA1_Channel2_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(GPDMA1_Channel2_IRQn);
+    HAL_NVIC_SetPriority(SPI1_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(SPI1_IRQn);
+}
+
+/*
+ * @brief Arma el cuadro a mostrar y busca el tramo contiguo que difiere de lo ya
+ * enviado.
+ * @param first, last primer y ultimo byte a enviar.
+ * @retval 1 si hay algo que enviar.
+ */
+static uint8_t DirtyRange(uint8_t *first, uint8_t *last)
+{
+    int i;
+
+    for (i = 0; i < PCF8553_RAM_SIZE; i++)
+    {
+        frame[i] = blink_hide ? (pcf8553_ram_map[i] & ~pcf8553_blink_mask[i]) : pcf8553_ram_map[i];
+    }
+
+    if (!sent_valid)
+    {
+        *first = 0;
+        *last = PCF8553_RAM_SIZE - 1;
+        return 1;
+    }
+
+    for (i = 0; (i < PCF8553_RAM_SIZE) && (frame[i] == sent_map[i]); i++)
+    {
+    }
+    if (i == PCF8553_RAM_SIZE)
+    {
+        return 0;
+    }
+    *first = (uint8_t)i;
+
+    for (i = PCF8553_RAM_SIZE - 1; frame[i] == sent_map[i]; i--)
+    {
+    }
+    *last = (uint8_t)i;
+
+    return 1;
 }
 
 // Public function bodies.
 
 /*
  * @brief
- * Modify the actual blinking mode, all segment.
+ * Modify the actual blinking mode, all segment. Only writes Display_ctrl_2
+ * when the mode changes.
  * @param
- * PCF_BLINK_OFF = 0,
- * PCF_BLINK_TWO_SECOND
- * PCF_BLINK_ONE_SECOND,
- * PCF_BLINK_HALF_SECOND
+ * OFF_SPEED = 0,
+ * LOW_SPEED, 0.5 Hz
+ * MED_SPEED, 1 Hz
+ * HIGH_SPEED, 2 Hz
  * @retval None
  *
  */
-void Blink(blink_t mode)
+void FM_PCF8553_Blink(blink_t mode)
 {
+    if (g_display_ctrl_2.reg_bits.blink == mode)
+    {
+        return;
+    }
+
     HAL_GPIO_WritePin(PCF8553_CE_PORT, PCF8553_CE_PIN, GPIO_PIN_RESET);
     g_display_ctrl_2.reg_bits.blink = mode;
     ReadyToSend(DISPLAY_CTRL_2_ADDRESS);
@@ -257,6 +399,17 @@ void Blink(blink_t mode)
     HAL_GPIO_WritePin(PCF8553_CE_PORT, PCF8553_CE_PIN, GPIO_PIN_SET);
 }
 
+/*
+ * @brief Oculta o muestra los segmentos marcados en pcf8553_blink_mask.
+ * @param hide distinto de 0 para ocultarlos; rige desde el proximo
+ * FM_PCF8553_Refresh.
+ * @retval None
+ */
+void FM_PCF8553_BlinkHide(uint8_t hide)
+{
+    blink_hide = (hide != 0);
+}
+
 /*
  * @brief
  * Limpia el buffer final, que es mandado directamente al controlador de la pantalla LCD.
@@ -284,6 +437,7 @@ void FM_PCF8553_Init()
 {
     SpiInit();
     FM_PCF8553_Reset();
+    sent_valid = 0;
     HAL_Delay(DELAY_5_MS);
 
     // El pcf8553 tiene un pin de chip select, la siguiente instruccion habilita el chip.
@@ -321,13 +475,122 @@ void FM_PCF8553_Init()
  */
 void FM_PCF8553_Refresh()
 {
+    register_address_t reg;
+    HAL_StatusTypeDef status;
+    uint8_t first;
+    uint8_t last;
+    uint16_t length;
+    uint32_t primask;
+
+    // Otro hilo estaria mezclando su cuadro con uno a medio armar.
+    if ((owner != TX_NULL) && (tx_thread_identify() != owner))
+    {
+        FM_DEBUG_LedError(1);
+        return;
+    }
+
+    // Sin cambios respecto de lo enviado no se toca el bus.
+    if (!DirtyRange(&first, &last))
+    {
+        return;
+    }
+
+    // El pcf8553 incrementa la direccion en cada byte: un solo burst desde first.
+    reg.bits.address = DATA_ADDRESS + first;
+    reg.bits.not_used = 0;
+    reg.bits.read_write = WRITE_DATA;
+    refresh_buffer[0] = reg.data;
+    length = (uint16_t)(last - first + 1);
+    memcpy(&refresh_buffer[1], &frame[first], length);
+    primask = __get_PRIMASK();
+    __disable_irq();
+    memcpy(&sent_map[first], &frame[first], length);
+    __set_PRIMASK(primask);
+    length++;
+
     HAL_GPIO_WritePin(PCF8553_CE_PORT, PCF8553_CE_PIN, GPIO_PIN_RESET);
-    ReadyToSend(DATA_ADDRESS);
-    for (int i = 0; i < PCF8553_RAM_SIZE; i++)
+    if (rtos_ready && (tx_thread_identify() != TX_NULL))
+    {
+        // El hilo duerme durante el burst; el stop 2 detendria el SPI1.
+        FMX_LP_StopHold();
+        status = HAL_SPI_Transmit_DMA(&h_spi1, refresh_buffer, length);
+        if ((status == HAL_OK)
+            && (tx_semaphore_get(&refresh_semaphore, REFRESH_TIMEOUT) != TX_SUCCESS))
+        {
+            HAL_SPI_Abort(&h_spi1);
+            // Si el callback llego entre el timeout y el abort, su put quedaria
+            // pendiente y el proximo burst volveria sin esperar al DMA.
+            (void)tx_semaphore_get(&refresh_semaphore, TX_NO_WAIT);
+            status = HAL_TIMEOUT;
+        }
+        if ((status == HAL_OK) && (h_spi1.ErrorCode != HAL_SPI_ERROR_NONE))
+        {
+            status = HAL_ERROR;
+        }
+        FMX_LP_StopRelease();
+    }
+    else
     {
-        HAL_SPI_Transmit(&h_spi1, pcf8553_ram_map + i, 1, DELAY_5_MS);
+        status = HAL_SPI_Transmit(&h_spi1, refresh_buffer, length, DELAY_5_MS);
     }
     HAL_GPIO_WritePin(PCF8553_CE_PORT, PCF8553_CE_PIN, GPIO_PIN_SET);
+
+    if (status != HAL_OK)
+    {
+        FM_DEBUG_LedError(1);
+        sent_valid = 0;
+        return;
+    }
+    sent_valid = 1;
+}
+
+/*
+ * @brief Crea el semaforo de fin de volcado. Hasta llamarla, FM_PCF8553_Refresh
+ * usa el SPI bloqueante.
+ * @param None
+ * @retval None
+ */
+void FM_PCF8553_RtosInit()
+{
+    if (tx_semaphore_create(&refresh_semaphore, "LCD_REFRESH_SEMAPHORE", 0) != TX_SUCCESS)
+    {
+        FM_DEBUG_LedError(1);
+        return;
+    }
+    rtos_ready = 1;
+}
+
+/*
+ * @brief Copia lo ultimo enviado al pcf8553, lo que se ve en la pantalla, y la
+ * mascara de parpadeo. Se puede llamar desde cualquier hilo (FM+LCD?).
+ * @param map, mask destinos de PCF8553_RAM_SIZE bytes.
+ * @retval 1 si map es lo que muestra el pcf8553; 0 antes del primer refresco
+ * o despues de un error de SPI.
+ */
+uint8_t FM_PCF8553_FrameGet(uint8_t *map, uint8_t *mask)
+{
+    uint32_t primask;
+    uint8_t valid;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    memcpy(map, sent_map, PCF8553_RAM_SIZE);
+    memcpy(mask, pcf8553_blink_mask, PCF8553_RAM_SIZE);
+    valid = sent_valid;
+    __set_PRIMASK(primask);
+
+    return valid;
+}
+
+/*
+ * @brief Fija al hilo que llama como unico dueno del LCD. Desde otro hilo,
+ * FM_PCF8553_Refresh no envia nada y marca error.
+ * @param None
+ * @retval None
+ */
+void FM_PCF8553_OwnerSet()
+{
+    owner = tx_thread_identify();
 }
 
 /*
@@ -379,6 +642,30 @@ void FM_PC8553_WriteByte(uint8_t add, uint8_t data)
     ReadyToSend(add);
     HAL_SPI_Transmit(&h_spi1, &data, 1, DELAY_5_MS);
     HAL_GPIO_WritePin(PCF8553_CE_PORT, PCF8553_CE_PIN, GPIO_PIN_SET);
+
+    // Escritura por fuera del mapa: el proximo refresco lo manda completo.
+    if (add >= DATA_ADDRESS)
+    {
+        sent_valid = 0;
+    }
+}
+
+// Interrupts
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi == &h_spi1)
+    {
+        tx_semaphore_put(&refresh_semaphore);
+    }
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi == &h_spi1)
+    {
+        tx_semaphore_put(&refresh_semaphore);
+    }
 }
 
 /*** end of file ***/
@@ -51,20 +51,29 @@ typedef enum
 // Extern
 
 extern uint8_t pcf8553_ram_map[PCF8553_RAM_SIZE];
+extern uint8_t pcf8553_blink_mask[PCF8553_RAM_SIZE];
 
 // Public function prototypes.
 
 void
 FM_PCF8553_Blink(blink_t mode);
 void
+FM_PCF8553_BlinkHide(uint8_t hide);
+void
 FM_PCF8553_ClearBuffer();
+uint8_t
+FM_PCF8553_FrameGet(uint8_t *map, uint8_t *mask);
 void
 FM_PCF8553_Init();
 void
+FM_PCF8553_OwnerSet();
+void
 FM_PCF8553_Refresh();
 void
 FM_PCF8553_Reset();
 void
+FM_PCF8553_RtosInit();
+void
 FM_PCF8553_WriteAll(uint8_t data);
 void
 FM_PCF8553_WriteByte(uint8_t add, uint8_t data);
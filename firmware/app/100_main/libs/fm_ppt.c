@@ -54,11 +54,15 @@ char page_buffer[FM_USART_TX3_BUF_SIZE];
 
 void FM_PPT_FormatTicket()
 {
+    fm_fmc_snapshot_t snapshot;
+
+    // TTL y ACM de la misma ventana, aunque el hilo principal publique otra.
+    FM_FMC_SnapshotGet(&snapshot);
 
     snprintf(ticket.number, MAX_FIELD_LEN, "%u", FM_FMC_TicketNumberGet());
-    snprintf(ticket.ttl, MAX_FIELD_LEN, "%lu", FM_FMC_TtlGet());
+    snprintf(ticket.ttl, MAX_FIELD_LEN, "%lu", snapshot.ttl);
     FM_RTC_GetPpt(ticket.time, ticket.date);
-    snprintf(ticket.acm, MAX_FIELD_LEN, "%lu", FM_FMC_AcmGet());
+    snprintf(ticket.acm, MAX_FIELD_LEN, "%lu", snapshot.acm);
 }
 
 void FM_PPT_PrintTicket()
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""
+Battery life projection from FM+STATS? dumps.
+
+Usage: fm_energy.py dump.txt[:hours] [dump.txt[:hours] ...]
+                    [--prints-per-day N] [--current STATE=mA ...]
+                    [--battery-mah 3500] [--usable 0.85] [--min-years Y]
+
+Each dump is the reply to FM+STATS? after FM+STATS_RESET and a run of the
+unit in one operating mode (no flow, flow, BT session...). The lines used are:
+- "STATS:<awake>,<isr>,<other>,<stop>,<exits>": stop 2 residency in ms.
+- "CLOCK:<idle>,<comms>": awake ms per fmx_clock profile.
+- "STATE:<lcd>,<n>,<flash>,<n>,<mxc>,<n>": ms in each fmx_stats_state_t.
+The window of a dump is stop + awake time. Its average current is applied to
+the hours per day given after the colon; dumps without hours share what is
+left of the 24 h. Ticket prints are added per day with the bench figures of
+the logger/printer battery spreadsheet (68 mA during 6.2 s).
+
+The currents are board level, in mA; LCD, flash and MXChip add to the run or
+stop current underneath. With --min-years the exit status is 1 when the
+projection falls below it, so a CI job can flag energy regressions.
+"""
+
+import argparse
+import sys
+from collections import OrderedDict
+
+# Same order as fmx_clock_profile_t in FLOWMEET/fmx_clock.h.
+PROFILES = ["idle", "comms"]
+# Same order as fmx_stats_state_t in FLOWMEET/fmx_stats.h.
+STATES = ["lcd", "flash_op", "mxc"]
+
+CURRENT_MA = OrderedDict([
+    ("stop", 0.014),        # 102_stop_mode_2 bench, ST-LINK disconnected.
+    ("run_idle", 0.8),      # MSIS 24 MHz, VOS4, SMPS; datasheet estimate.
+    ("run_comms", 1.4),     # MSIS 48 MHz, VOS3.
+    ("lcd", 0.2),           # SPI1 at 1.5 MHz and the PCF8553 during the write.
+    ("flash_op", 3.0),      # Flash erase/program on top of run.
+    ("mxc", 63.0),          # fm_mxc.h, FM_MXC_MODE_ON.
+])
+
+PRINT_MA = 68.0
+PRINT_SECONDS = 6.2
+
+
+def parse_dump(path):
+    dump = {"stop": 0.0, "awake": 0.0, "clock": None, "state": [0.0] * len(STATES)}
+    with open(path) as source:
+        for line in source:
+            line = line.strip()
+            tag, _, values = line.partition(":")
+            if tag not in ("STATS", "CLOCK", "STATE") or not values:
+                continue
+            fields = [float(v) for v in values.split(",")]
+            if tag == "STATS":
+                dump["awake"] = fields[0]
+                dump["stop"] = fields[3]
+            elif tag == "CLOCK":
+                dump["clock"] = fields[:len(PROFILES)]
+            else:
+                dump["state"] = fields[0:2 * len(STATES):2]
+    if dump["clock"] is None:
+        # Firmware without profiles: all awake time at the idle clock.
+        dump["clock"] = [dump["awake"]] + [0.0] * (len(PROFILES) - 1)
+    return dump
+
+
+def charge(dump, current):
+    """Per-state charge in mA*ms and the window in ms."""
+    rows = OrderedDict()
+    rows["stop"] = (dump["stop"], current["stop"])
+    for name, ms in zip(PROFILES, dump["clock"]):
+        rows["run_" + name] = (ms, current["run_" + name])
+    for name, ms in zip(STATES, dump["state"]):
+        rows[name] = (ms, current[name])
+    window = dump["stop"] + sum(dump["clock"])
+    return rows, window
+
+
+def split_hours(specs):
+    named = [(path, float(hours)) for path, hours in specs if hours is not None]
+    free = [path for path, hours in specs if hours is None]
+    left = 24.0 - sum(hours for _, hours in named)
+    if left < 0 or (free and left <= 0):
+        sys.exit("hours per day add up to more than 24")
+    share = left / len(free) if free else 0.0
+    return named + [(path, share) for path in free]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("dumps", nargs="+", help="FM+STATS? dump, optionally path:hours")
+    parser.add_argument("--prints-per-day", type=float, default=0.0)
+    parser.add_argument("--current", action="append", default=[], metavar="STATE=mA")
+    parser.add_argument("--battery-mah", type=float, default=3500.0)   # Energizer L91.
+    parser.add_argument("--usable", type=float, default=0.85)          # Down to V low.
+    parser.add_argument("--min-years", type=float)
+    args = parser.parse_args()
+
+    current = OrderedDict(CURRENT_MA)
+    for item in args.current:
+        name, _, value = item.partition("=")
+        if name not in current:
+            sys.exit("unknown state %s, one of: %s" % (name, ", ".join(current)))
+        current[name] = float(value)
+
+    specs = []
+    for spec in args.dumps:
+        path, sep, hours = spec.rpartition(":")
+        specs.append((path, hours) if sep and hours.replace(".", "", 1).isdigit() else (spec, None))
+
+    mah_day = 0.0
+    for path, hours in split_hours(specs):
+        rows, window = charge(parse_dump(path), current)
+        if window <= 0:
+            sys.exit("%s: empty window, dump FM+STATS? after running the unit" % path)
+        total = sum(ms * ma for ms, ma in rows.values())
+        average = total / window
+        mah_day += average * hours
+
+        print("%s: %.1f s window, %.2f h/day, %.1f uA average" % (path, window / 1000.0, hours,
+                                                                  average * 1000.0))
+        print("  %-10s %12s %7s %8s %10s" % ("state", "ms", "%", "mA", "mAh/day"))
+        for name, (ms, ma) in rows.items():
+            print("  %-10s %12.0f %7.2f %8.3f %10.4f" % (name, ms, 100.0 * ms / window, ma,
+                                                          ms * ma / window * hours))
+
+    prints = args.prints_per_day * PRINT_MA * PRINT_SECONDS / 3600.0
+    mah_day += prints
+    if prints:
+        print("prints: %.1f/day, %.4f mAh/day" % (args.prints_per_day, prints))
+
+    days = args.battery_mah * args.usable / mah_day if mah_day > 0 else float("inf")
+    years = days / 365.0
+    print("total: %.4f mAh/day, %.1f uA average, %.2f years on %.0f mAh (%.0f %% usable)"
+          % (mah_day, mah_day / 24.0 * 1000.0, years, args.battery_mah, 100.0 * args.usable))
+
+    if args.min_years is not None and years < args.min_years:
+        print("below --min-years %.2f" % args.min_years)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
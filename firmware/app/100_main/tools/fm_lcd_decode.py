@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+"""
+Renders an FM+LCD? dump as the text the display is showing.
+
+Usage: fm_lcd_decode.py [dump.txt] [--hex MAP[,MASK]] [--golden FILE]
+
+Each dump line is "LCD:<valid>,<map>,<blink mask>", both maps as the 20 bytes
+of PCF8553 RAM in hex; without a file the lines are read from stdin. --hex
+takes a map copied from the debugger (pcf8553_ram_map) instead. The output is
+the two digit rows with their decimal points, the two 14-segment unit
+characters, the lit symbols and what is marked to blink.
+
+With --golden the rendering of the last frame is compared against FILE, a
+previous output of this script; the exit status is 1 on a mismatch, so a
+scripted session of key presses can be checked screen by screen.
+"""
+
+import argparse
+import difflib
+import sys
+
+RAM_SIZE = 20
+BACKPLANES = 4
+BACKPLANE_REGS = 5
+
+# Segment bits of a digit in the row 1 layout, same as SEG_x in libs/fm_lcd_ll.c.
+SEG_B, SEG_C, SEG_A, SEG_H, SEG_E, SEG_G, SEG_D, SEG_F = (1 << bit for bit in range(8))
+SEGS_7 = SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G
+
+# Lit segments of each character of glyph_7. The first one wins when two
+# characters share a glyph ('0' and 'O', '5' and 'S').
+GLYPH_7 = [
+    (" ", 0),
+    ("-", SEG_D),
+    ("0", SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G),
+    ("1", SEG_C | SEG_F),
+    ("2", SEG_A | SEG_B | SEG_D | SEG_F | SEG_G),
+    ("3", SEG_A | SEG_C | SEG_D | SEG_F | SEG_G),
+    ("4", SEG_C | SEG_D | SEG_E | SEG_F),
+    ("5", SEG_A | SEG_C | SEG_D | SEG_E | SEG_G),
+    ("6", SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_G),
+    ("7", SEG_C | SEG_F | SEG_G),
+    ("8", SEGS_7),
+    ("9", SEG_C | SEG_D | SEG_E | SEG_F | SEG_G),
+    ("A", SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G),
+    ("E", SEG_A | SEG_B | SEG_D | SEG_E | SEG_G),
+    ("L", SEG_A | SEG_B | SEG_E),
+    ("P", SEG_B | SEG_D | SEG_E | SEG_F | SEG_G),
+    ("U", SEG_A | SEG_B | SEG_C | SEG_E | SEG_F),
+    ("_", SEG_A),
+    ("=", SEG_A | SEG_D),           # Null character, '_' and '-' together.
+    ("b", SEG_B | SEG_D | SEG_E | SEG_F | SEG_G),
+]
+DECODE_7 = {}
+for char, segs in GLYPH_7:
+    DECODE_7.setdefault(segs, char)
+
+# First pin of each digit, digit_pin in libs/fm_lcd_ll.c.
+DIGIT_PIN = [
+    [22, 24, 26, 28, 30, 32, 34, 36],
+    [18, 16, 14, 12, 10, 8, 6],
+]
+
+# glyph_14 in libs/fm_lcd_ll.c: a nibble per backplane, bit i is pin S(2 + i)
+# of character 1. Lower case letters reuse the upper case glyphs.
+GLYPH_14 = [
+    ("0", 0xA28A), ("1", 0x2002), ("2", 0x328C), ("3", 0x3286), ("4", 0xB006),
+    ("5", 0x9286), ("6", 0x928E), ("7", 0x2202), ("8", 0xB28E), ("9", 0xB206),
+    ("A", 0xB20E), ("B", 0x2696), ("C", 0x8288), ("D", 0x2692), ("E", 0x9288),
+    ("F", 0x9208), ("G", 0x928E), ("H", 0xB00E), ("I", 0x0690), ("J", 0x2082),
+    ("K", 0xD048), ("L", 0x8088), ("M", 0xE10A), ("N", 0xA14A), ("O", 0xA28A),
+    ("P", 0xB20C), ("Q", 0xA2CA), ("R", 0xB24C), ("S", 0x9286), ("T", 0x0610),
+    ("U", 0xA08A), ("V", 0xC009), ("W", 0xA04B), ("X", 0x4141), ("Y", 0x4110),
+    ("Z", 0x5285), ("b", 0x908E), ("#", 0xF7DF), (" ", 0x0000),
+]
+DECODE_14 = {}
+for char, glyph in GLYPH_14:
+    DECODE_14.setdefault(glyph, char)
+
+# char_1_spans and char_2_spans: (register, nibble shift, pin shift, pins per backplane).
+CHAR_SPANS = [
+    [(0, 0, 2, (0x3C, 0x34, 0x1C, 0x3C))],
+    [(0, 2, 0, (0x03, 0x03, 0x01, 0x03)), (4, 0, 6, (0xC0, 0x40, 0xC0, 0xC0))],
+]
+
+# symbol_bit in libs/fm_lcd_ll.c, without the decimal points (shown in the
+# rows) and ACM_1 (not connected). D and H share pins with the last digit of
+# each row, so those two points are never drawn as points.
+SYMBOLS = [
+    ("POINT", 7, 4), ("BATTERY", 7, 5), ("POWER", 2, 5), ("RATE", 17, 5), ("E", 2, 4),
+    ("BATCH", 12, 5), ("TTL", 17, 4), ("/", 10, 1), ("ACM", 12, 4), ("S", 10, 5),
+    ("M", 9, 7), ("H", 5, 6), ("D", 9, 5),
+]
+
+
+def pair_swap(bits):
+    return ((bits & 0x55) << 1) | ((bits >> 1) & 0x55)
+
+
+def digit_bits(ram, row, col):
+    pin = DIGIT_PIN[row][col]
+    bits = 0
+    for k in range(BACKPLANES):
+        bits |= ((ram[k * BACKPLANE_REGS + pin // 8] >> (pin % 8)) & 0x03) << (2 * k)
+    return pair_swap(bits) if row == 1 else bits
+
+
+def char_glyph(ram, spans):
+    glyph = 0
+    for reg, nibble_shift, pin_shift, pins in spans:
+        for k in range(BACKPLANES):
+            bits = ram[reg + k * BACKPLANE_REGS] & pins[k]
+            glyph |= ((bits >> pin_shift) << nibble_shift) << (4 * k)
+    return glyph
+
+
+def render(ram, mask):
+    lines = []
+    blink = []
+    for row, pins in enumerate(DIGIT_PIN):
+        text = ""
+        for col in range(len(pins)):
+            segs = digit_bits(ram, row, col)
+            text += DECODE_7.get(segs & SEGS_7, "?")
+            if col < len(pins) - 1 and segs & SEG_H:
+                text += "."
+            if digit_bits(mask, row, col) & SEGS_7:
+                blink.append("row %u col %u" % (row + 1, col))
+        lines.append("row %u:   \"%s\"" % (row + 1, text))
+
+    unit = ""
+    for index, spans in enumerate(CHAR_SPANS):
+        glyph = char_glyph(ram, spans)
+        unit += DECODE_14.get(glyph, "?")
+        if char_glyph(mask, spans):
+            blink.append("char %u" % (index + 1))
+    lines.append("unit:    \"%s\"" % unit)
+
+    lit = [name for name, reg, bit in SYMBOLS if ram[reg] & (1 << bit)]
+    blink += [name for name, reg, bit in SYMBOLS if mask[reg] & (1 << bit)]
+    lines.append("symbols: %s" % (" ".join(lit) if lit else "-"))
+    lines.append("blink:   %s" % (", ".join(blink) if blink else "-"))
+    return lines
+
+
+def parse_hex(text):
+    data = bytes.fromhex(text)
+    if len(data) != RAM_SIZE:
+        sys.exit("expected %u bytes of map, got %u" % (RAM_SIZE, len(data)))
+    return data
+
+
+def parse(lines):
+    frames = []
+    for line in lines:
+        line = line.strip()
+        if not line.startswith("LCD:"):
+            continue
+        fields = line[4:].split(",")
+        if len(fields) != 3:
+            continue
+        frames.append((int(fields[0]), parse_hex(fields[1]), parse_hex(fields[2])))
+    return frames
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("dump", nargs="?", help="FM+LCD? dump, stdin without it")
+    parser.add_argument("--hex", metavar="MAP[,MASK]", help="map from the debugger")
+    parser.add_argument("--golden", metavar="FILE", help="expected rendering of the last frame")
+    args = parser.parse_args()
+
+    if args.hex:
+        fields = args.hex.replace(" ", "").split(",")
+        mask = parse_hex(fields[1]) if len(fields) > 1 else bytes(RAM_SIZE)
+        frames = [(1, parse_hex(fields[0]), mask)]
+    else:
+        frames = parse(open(args.dump) if args.dump else sys.stdin)
+    if not frames:
+        sys.exit("no LCD: lines in the dump")
+
+    rendered = []
+    for index, (valid, ram, mask) in enumerate(frames):
+        rendered = render(ram, mask)
+        if index:
+            print()
+        if not valid:
+            print("(not sent: before the first refresh or after an SPI error)")
+        print("\n".join(rendered))
+
+    if args.golden:
+        with open(args.golden) as source:
+            expected = [line.rstrip("\n") for line in source if line.strip()]
+        expected = [line for line in expected if not line.startswith("(")]
+        if expected[-len(rendered):] != rendered:
+            sys.stdout.writelines(difflib.unified_diff(
+                [line + "\n" for line in expected[-len(rendered):]],
+                [line + "\n" for line in rendered], args.golden, "frame"))
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
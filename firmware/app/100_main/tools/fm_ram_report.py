@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""
+Retained SRAM footprint report from the GNU ld map file.
+
+Usage: fm_ram_report.py [Debug/100_main.map] [--top N]
+
+Lists what stays powered in stop 2: the SRAM1 pages up to _eheap_min, the
+MSP stack plus the minimum heap (kept by FM_INIT_Init, the heap fills the rest
+of the last page), SRAM4 (LPDMA capture ring) and the backup SRAM. For SRAM1 it
+shows the bytes used in each 64 KB page and the largest input sections, so a
+change that spills into a new page is easy to spot.
+"""
+
+import re
+import sys
+
+REGIONS = [
+    # name, base, size, retained page size (0: the whole region)
+    ("SRAM1", 0x20000000, 192 * 1024, 64 * 1024),
+    ("SRAM4", 0x28000000, 16 * 1024, 0),
+    ("BKPSRAM", 0x40036400, 2 * 1024, 0),
+]
+
+SECTION = re.compile(r"^ (\.[\w.$]+|COMMON)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+NAME_ONLY = re.compile(r"^ (\.[\w.$]+|COMMON)\s*$")
+HEAP_MIN_END = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+_eheap_min = \.")
+
+
+def region_of(address):
+    for region in REGIONS:
+        if region[1] <= address < region[1] + region[2]:
+            return region
+    return None
+
+
+def parse(lines):
+    sections = []
+    heap_min_end = None
+    pending = None
+    in_map = False
+
+    for line in lines:
+        if line.startswith("Linker script and memory map"):
+            in_map = True
+            continue
+        if not in_map:
+            continue
+
+        match = HEAP_MIN_END.match(line)
+        if match:
+            heap_min_end = int(match.group(1), 16)
+            continue
+
+        match = NAME_ONLY.match(line)
+        if match:
+            pending = match.group(1)
+            continue
+
+        match = SECTION.match(line)
+        if match:
+            name = match.group(1) or pending
+            pending = None
+            address = int(match.group(2), 16)
+            size = int(match.group(3), 16)
+            if name and size and region_of(address):
+                sections.append((name, address, size, match.group(4).strip()))
+            continue
+        pending = None
+
+    return sections, heap_min_end
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    top = 15
+    if "--top" in sys.argv:
+        top = int(sys.argv[sys.argv.index("--top") + 1])
+        if str(top) in args:
+            args.remove(str(top))
+    path = args[0] if args else "Debug/100_main.map"
+
+    with open(path) as source:
+        sections, heap_min_end = parse(source)
+
+    for name, base, size, page in REGIONS:
+        inside = [s for s in sections if base <= s[1] < base + size]
+        used = sum(s[2] for s in inside)
+        print("%-8s %7u B in sections" % (name, used))
+        if not page:
+            continue
+
+        end = heap_min_end if heap_min_end else max((s[1] + s[2] for s in inside), default=base)
+        pages = (end - base + page - 1) // page
+        print("         retained up to 0x%08x (_eheap_min): %u of %u pages, %u B"
+              % (end, pages, size // page, pages * page))
+        for index in range(size // page):
+            start = base + index * page
+            fill = sum(max(0, min(s[1] + s[2], start + page) - max(s[1], start)) for s in inside)
+            state = "retained" if index < pages else "off in stop 2"
+            print("         page %u 0x%08x %7u B  %s" % (index + 1, start, fill, state))
+
+        print("         largest sections:")
+        for name_s, address, size_s, owner in sorted(inside, key=lambda s: -s[2])[:top]:
+            print("         %7u B  0x%08x  page %u  %s %s"
+                  % (size_s, address, (address - base) // page + 1, name_s, owner))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""
+Decodes an FM+TRACE? dump into a wake timeline and a per-source histogram.
+
+Usage: fm_trace_decode.py [dump.txt]   (reads stdin without a file)
+
+Each dump line is "<boot>,<time>,<reason>,<active>":
+- time is in ThreadX ticks (10 ms) since that boot, or unix seconds when
+  reason is 254 (boot marker).
+- active is the time awake after the wake, in LSE ticks (1/32768 s).
+Entries whose boot marker was already overwritten are shown relative to the
+first entry of that boot.
+"""
+
+import sys
+import time
+from collections import OrderedDict
+
+TICKS_PER_SECOND = 100
+LSE_HZ = 32768
+BOOT = 254
+
+# Same order as fmx_stats_wake_t in FLOWMEET/fmx_stats.h.
+REASONS = ["TIMER", "CHUNK", "PULSE", "CAPTURE", "KEY", "UART", "OTHER"]
+
+
+def reason_name(reason):
+    if reason == BOOT:
+        return "BOOT"
+    if reason < len(REASONS):
+        return REASONS[reason]
+    return "R%u" % reason
+
+
+def parse(lines):
+    entries = []
+    for line in lines:
+        line = line.strip()
+        if not line or line.startswith("TRACE:"):
+            continue
+        fields = line.split(",")
+        if len(fields) != 4:
+            continue
+        entries.append(tuple(int(f) for f in fields))
+    return entries
+
+
+def main():
+    source = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    entries = parse(source)
+
+    histogram = OrderedDict((name, [0, 0]) for name in REASONS)
+    anchor = {}         # boot -> unix time at tick 0
+    origin = {}         # boot -> first tick seen, without anchor
+    previous = None     # (boot, wake time, active) of the previous entry
+
+    print("%-19s %10s %-8s %10s %10s" % ("time", "tick", "reason", "awake ms", "slept ms"))
+    for boot, tick, reason, active in entries:
+        if reason == BOOT:
+            anchor[boot] = tick
+            previous = None
+            stamp = time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(tick))
+            print("%-19s %10s %-8s  boot %u" % (stamp, "-", "BOOT", boot))
+            continue
+
+        if boot in anchor:
+            stamp = time.strftime("%Y-%m-%d %H:%M:%S",
+                                  time.gmtime(anchor[boot] + tick // TICKS_PER_SECOND))
+        else:
+            origin.setdefault(boot, tick)
+            stamp = "+%.2f s" % ((tick - origin[boot]) / TICKS_PER_SECOND)
+
+        awake_ms = active * 1000.0 / LSE_HZ
+        slept = ""
+        if previous is not None and previous[0] == boot:
+            gap_ms = (tick - previous[1]) * 1000.0 / TICKS_PER_SECOND - previous[2]
+            slept = "%.0f" % max(gap_ms, 0.0)
+        previous = (boot, tick, awake_ms)
+
+        name = reason_name(reason)
+        print("%-19s %10u %-8s %10.2f %10s" % (stamp, tick, name, awake_ms, slept))
+
+        bucket = histogram.setdefault(name, [0, 0])
+        bucket[0] += 1
+        bucket[1] += active
+
+    total = sum(count for count, _ in histogram.values()) or 1
+    print()
+    print("%-8s %6s %6s %12s" % ("source", "wakes", "%", "awake ms"))
+    for name, (count, active) in histogram.items():
+        print("%-8s %6u %6.1f %12.2f" % (name, count, 100.0 * count / total,
+                                          active * 1000.0 / LSE_HZ))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,73 @@
+/**
+ * @file cmsis_host.h
+ * @brief Intrinsecos de CMSIS para compilar los modulos del firmware en el host.
+ *
+ * Se incluye antes que todo (-include) y toma el guard de cmsis_gcc.h: los
+ * headers de la HAL y del port de ThreadX compilan igual, sin ensamblador de
+ * ARM. PRIMASK es una variable; no hay interrupciones en el host.
+ */
+
+#ifndef CMSIS_HOST_H_
+#define CMSIS_HOST_H_
+
+#define __CMSIS_GCC_H
+
+#include <stdint.h>
+
+#define __ASM                    __asm
+#define __INLINE                 inline
+#define __STATIC_INLINE          static inline
+#define __STATIC_FORCEINLINE     __attribute__((always_inline)) static inline
+#define __NO_RETURN              __attribute__((__noreturn__))
+#define __USED                   __attribute__((used))
+#define __WEAK                   __attribute__((weak))
+#define __PACKED                 __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT          struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION           union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)             __attribute__((aligned(x)))
+#define __RESTRICT               __restrict
+#define __COMPILER_BARRIER()     __asm volatile("" ::: "memory")
+
+#define __UNALIGNED_UINT16_READ(addr)         (*(const uint16_t *)(const void *)(addr))
+#define __UNALIGNED_UINT16_WRITE(addr, val)   (void)(*(uint16_t *)(void *)(addr) = (val))
+#define __UNALIGNED_UINT32_READ(addr)         (*(const uint32_t *)(const void *)(addr))
+#define __UNALIGNED_UINT32_WRITE(addr, val)   (void)(*(uint32_t *)(void *)(addr) = (val))
+#define __UNALIGNED_UINT32(x)                 (*(uint32_t *)(x))
+
+#define __NOP()                  __COMPILER_BARRIER()
+#define __WFI()                  __COMPILER_BARRIER()
+#define __WFE()                  __COMPILER_BARRIER()
+#define __SEV()                  __COMPILER_BARRIER()
+#define __BKPT(value)            __builtin_trap()
+
+extern uint32_t cmsis_host_primask;
+
+__STATIC_FORCEINLINE void __ISB(void) { __COMPILER_BARRIER(); }
+__STATIC_FORCEINLINE void __DSB(void) { __COMPILER_BARRIER(); }
+__STATIC_FORCEINLINE void __DMB(void) { __COMPILER_BARRIER(); }
+__STATIC_FORCEINLINE void __enable_irq(void) { cmsis_host_primask = 0u; }
+__STATIC_FORCEINLINE void __disable_irq(void) { cmsis_host_primask = 1u; }
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK(void) { return cmsis_host_primask; }
+__STATIC_FORCEINLINE void __set_PRIMASK(uint32_t primask) { cmsis_host_primask = primask; }
+__STATIC_FORCEINLINE uint32_t __get_IPSR(void) { return 0u; }
+__STATIC_FORCEINLINE uint32_t __get_CONTROL(void) { return 0u; }
+__STATIC_FORCEINLINE void __set_CONTROL(uint32_t control) { (void)control; }
+__STATIC_FORCEINLINE uint32_t __get_BASEPRI(void) { return 0u; }
+__STATIC_FORCEINLINE void __set_BASEPRI(uint32_t basepri) { (void)basepri; }
+__STATIC_FORCEINLINE uint32_t __get_MSP(void) { return 0u; }
+__STATIC_FORCEINLINE uint32_t __get_PSP(void) { return 0u; }
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t value) { return __builtin_bswap32(value); }
+__STATIC_FORCEINLINE uint8_t __CLZ(uint32_t value) { return (value == 0u) ? 32u : (uint8_t)__builtin_clz(value); }
+
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value)
+{
+    uint32_t result = 0u;
+
+    for (uint32_t i = 0u; i < 32u; i++)
+    {
+        result = (result << 1) | ((value >> i) & 1u);
+    }
+    return result;
+}
+
+#endif // CMSIS_HOST_H_
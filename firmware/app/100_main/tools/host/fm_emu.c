@@ -0,0 +1,288 @@
+/**
+ * @file fm_emu.c
+ * @brief Corre los menus del firmware en Linux con un guion de teclas.
+ *
+ * Repite lo que hace ThreadEntryMain en fmx.c: cada evento va a
+ * FM_USER_MenuNav o FM_SETUP_MenuNav segun el menu activo y despues se
+ * refresca el LCD. Los refrescos que piden los menus con FMX_RefreshEventTrue
+ * se atienden antes de la proxima linea del guion, como el hilo principal
+ * antes de dormir. SymbolsRefresh (bateria, batch y estado del caudal) es de
+ * fmx.c y no corre aca.
+ *
+ * El LCD sale por la RAM del PCF8553 emulado en fm_emu_stubs.c, no por
+ * pcf8553_ram_map: un frame muestra lo que llego al chip por el SPI.
+ *
+ * Guion, una orden por linea, '#' comenta:
+ *   key <DOWN|UP|ESC|ENTER|DOWN_LONG|UP_LONG|ESC_LONG|ENTER_LONG|EXT_1|EXT_2>
+ *   flow <pulsos>  pulsos por segundo desde esta linea (1000 por litro en SENSOR_0)
+ *   wait <s>       s segundos; en cada uno, una medicion y el redibujo periodico
+ *   frame          "LCD:<valid>,<RAM del chip>,<mascara>", el formato de FM+LCD?
+ *   bench <n>      n redibujos de la pantalla actual, tiempos a stderr; avanza los
+ *                  menus igual que n refrescos
+ *
+ * Uso: fm_emu <guion> | ../fm_lcd_decode.py
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fm_emu.h"
+#include "fmx.h"
+#include "fmx_capture.h"
+#include "fm_fmc.h"
+#include "fm_factory.h"
+#include "fm_lcd_ll.h"
+#include "fm_pcf8553.h"
+#include "fm_rtc.h"
+#include "fm_setup.h"
+#include "fm_user.h"
+
+#define LINE_SIZE          (128)
+#define LSE_HZ             (32768u)
+#define REFRESH_MAX        (32u)   // Refrescos encadenados antes de dar por trabado el menu.
+#define MENU_USER          (0u)
+#define MENU_SETUP         (1u)
+
+static const struct {
+    const char  *name;
+    fmx_events_t event;
+} keys[] = {
+    { "DOWN", FMX_EVENT_KEY_DOWN },           { "UP", FMX_EVENT_KEY_UP },
+    { "ESC", FMX_EVENT_KEY_ESC },             { "ENTER", FMX_EVENT_KEY_ENTER },
+    { "DOWN_LONG", FMX_EVENT_KEY_DOWN_LONG }, { "UP_LONG", FMX_EVENT_KEY_UP_LONG },
+    { "ESC_LONG", FMX_EVENT_KEY_ESC_LONG },   { "ENTER_LONG", FMX_EVENT_KEY_ENTER_LONG },
+    { "EXT_1", FMX_EVENT_KEY_EXT_1 },         { "EXT_2", FMX_EVENT_KEY_EXT_2 },
+};
+
+static uint8_t  menu = MENU_USER;
+static uint32_t flow_pulses;
+static double   menu_ns;
+static double   lcd_ns;
+
+static double Now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (t.tv_sec * 1e9) + t.tv_nsec;
+}
+
+// Una vuelta de ThreadEntryMain con el evento recibido.
+static void Dispatch(fmx_events_t event)
+{
+    double t0;
+    double t1;
+    double t2;
+
+    t0 = Now();
+    if ((event >= FMX_EVENT_MENU_REFRESH) && (event < FMX_EVENT_TIME_OUT))
+    {
+        if (menu == MENU_USER)
+        {
+            if (FM_USER_MenuNav(event))
+            {
+                menu = MENU_SETUP;
+                FMX_RefreshEventTrue();
+            }
+        }
+        else if (FM_SETUP_MenuNav(event))
+        {
+            menu = MENU_USER;
+            FMX_RefreshEventTrue();
+        }
+    }
+    t1 = Now();
+    FM_LCD_LL_Refresh();
+    t2 = Now();
+
+    menu_ns += t1 - t0;
+    lcd_ns += t2 - t1;
+}
+
+// Atiende la cola hasta vaciarla; 0 si el menu no deja de pedir refrescos.
+static int Drain(void)
+{
+    ULONG event;
+    uint32_t count = 0;
+
+    while (EMU_EventReceive(&event))
+    {
+        if (++count > REFRESH_MAX)
+        {
+            return 0;
+        }
+        Dispatch((fmx_events_t)event);
+    }
+    return 1;
+}
+
+// Lo que hace el hilo de medicion en cada ventana, con una ventana por segundo y
+// el caudal punto a punto de fmx.c (pulsos y duracion escalados).
+static void Measure(void)
+{
+    static uint32_t flow_pulses_last;
+
+    if ((flow_pulses != 0u) && (flow_pulses_last == 0u))
+    {
+        FM_FMC_RateFilterReset();
+    }
+    flow_pulses_last = flow_pulses;
+
+    FM_FMC_CaptureSet(flow_pulses << FMX_CAPTURE_SCALE_SHIFT, LSE_HZ << FMX_CAPTURE_SCALE_SHIFT);
+    FM_FMC_PulseAdd(flow_pulses);
+    FM_FMC_TtlCalc();
+    FM_FMC_AcmCalc();
+    FM_FMC_RateCalc();
+    FM_FMC_SnapshotPublish((flow_pulses != 0u) ? FMX_ACK_RATE_ON : FMX_ACK_RATE_OFF, FM_RTC_GetUnixTime());
+}
+
+static int FrameDump(void)
+{
+    uint8_t map[PCF8553_RAM_SIZE];
+    uint8_t mask[PCF8553_RAM_SIZE];
+    uint8_t valid;
+
+    valid = FM_PCF8553_FrameGet(map, mask);
+    printf("LCD:%u,", valid);
+    for (uint32_t i = 0; i < PCF8553_RAM_SIZE; i++)
+    {
+        printf("%02X", emu_chip_ram[EMU_CHIP_DATA + i]);
+    }
+    printf(",");
+    for (uint32_t i = 0; i < PCF8553_RAM_SIZE; i++)
+    {
+        printf("%02X", mask[i]);
+    }
+    printf("\n");
+
+    // Lo que el driver cree enviado tiene que ser lo que tiene el chip.
+    return !valid || (memcmp(map, &emu_chip_ram[EMU_CHIP_DATA], PCF8553_RAM_SIZE) == 0);
+}
+
+static int Command(char *line)
+{
+    char *verb;
+    char *arg;
+    long value;
+
+    verb = strtok(line, " \t\r\n");
+    if ((verb == NULL) || (verb[0] == '#'))
+    {
+        return 1;
+    }
+    arg = strtok(NULL, " \t\r\n");
+
+    if (strcmp(verb, "key") == 0)
+    {
+        for (uint32_t i = 0; (arg != NULL) && (i < (sizeof(keys) / sizeof(keys[0]))); i++)
+        {
+            if (strcmp(arg, keys[i].name) == 0)
+            {
+                EMU_EventSend(keys[i].event);
+                return Drain();
+            }
+        }
+        return 0;
+    }
+    if (strcmp(verb, "frame") == 0)
+    {
+        return FrameDump();
+    }
+
+    value = (arg != NULL) ? strtol(arg, NULL, 10) : -1;
+    if (value < 0)
+    {
+        return 0;
+    }
+    if (strcmp(verb, "flow") == 0)
+    {
+        // El mismo limite que el caudal punto a punto de fmx.c.
+        if (value >= (long)(UINT32_MAX >> FMX_CAPTURE_SCALE_SHIFT))
+        {
+            return 0;
+        }
+        flow_pulses = (uint32_t)value;
+        return 1;
+    }
+    if (strcmp(verb, "wait") == 0)
+    {
+        for (long s = 0; s < value; s++)
+        {
+            emu_ticks += TX_TIMER_TICKS_PER_SECOND;
+            emu_rtc++;
+            Measure();
+            FMX_RefreshEventTrue();
+            if (!Drain())
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    if (strcmp(verb, "bench") == 0)
+    {
+        menu_ns = 0;
+        lcd_ns = 0;
+        for (long n = 0; n < value; n++)
+        {
+            FMX_RefreshEventTrue();
+            if (!Drain())
+            {
+                return 0;
+            }
+        }
+        fprintf(stderr, "bench %ld redraws: menu %.0f ns, lcd %.0f ns per redraw (host)\n", value,
+                menu_ns / value, lcd_ns / value);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    char line[LINE_SIZE];
+    unsigned number = 0;
+    FILE *script;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <script>\n", argv[0]);
+        return 2;
+    }
+    script = fopen(argv[1], "r");
+    if (script == NULL)
+    {
+        perror(argv[1]);
+        return 2;
+    }
+
+    // FM_RTC_GetUnixTime usa mktime: hora local en UTC, como el RTC.
+    setenv("TZ", "UTC0", 1);
+    tzset();
+
+    // El primer encendido de FM_INIT_Init y el arranque de ThreadEntryMain.
+    FM_RTC_Init();
+    FM_FMC_Init(FM_FACTORY_SENSOR_0);
+    FM_PCF8553_OwnerSet();
+    EMU_EventSend(FMX_EVENT_MENU_REFRESH);
+    Drain();
+
+    while (fgets(line, sizeof(line), script) != NULL)
+    {
+        number++;
+        if (!Command(line))
+        {
+            fprintf(stderr, "%s:%u: bad command, or the menu kept requesting refreshes, "
+                    "or the chip RAM differs from the driver map\n", argv[1], number);
+            return 1;
+        }
+    }
+    fclose(script);
+
+    if (emu_led_errors != 0u)
+    {
+        fprintf(stderr, "%s: FM_DEBUG_LedError raised %lu times\n", argv[1], (unsigned long)emu_led_errors);
+    }
+    return 0;
+}
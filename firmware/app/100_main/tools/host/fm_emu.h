@@ -0,0 +1,25 @@
+/**
+ * @file fm_emu.h
+ * @brief Estado compartido entre el reproductor fm_emu.c y sus stubs.
+ */
+
+#ifndef FM_EMU_H_
+#define FM_EMU_H_
+
+#include <stdint.h>
+#include <time.h>
+#include "tx_api.h"
+
+#define EMU_CHIP_REGISTERS   (24u)  // 4 de control y los 20 bytes de segmentos.
+#define EMU_CHIP_DATA        (4u)   // Primer registro de segmentos.
+#define EMU_QUEUE_LENGTH     (8u)
+
+extern uint8_t  emu_chip_ram[EMU_CHIP_REGISTERS];
+extern uint32_t emu_led_errors;
+extern ULONG    emu_ticks;
+extern time_t   emu_rtc;
+
+uint8_t EMU_EventSend(ULONG event);
+uint8_t EMU_EventReceive(ULONG *event);
+
+#endif // FM_EMU_H_
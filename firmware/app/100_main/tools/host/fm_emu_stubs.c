@@ -0,0 +1,280 @@
+/**
+ * @file fm_emu_stubs.c
+ * @brief Stubs de host para correr los menus del firmware en Linux (fm_emu).
+ *
+ * - ThreadX: un solo hilo, el principal; tx_time_get devuelve el tiempo
+ *   simulado que avanza fm_emu.
+ * - HAL: el SPI1 con CE en PA4 emula la RAM del PCF8553. Cada CE bajo empieza
+ *   con el byte de direccion y los siguientes se escriben con autoincremento,
+ *   como en el chip. El RTC es un calendario en segundos unix.
+ * - Flash: la tabla K vive en RAM, borrada al arrancar.
+ * - fmx, fm_mxc, fm_ppt, fm_debug: lo que los menus llaman fuera de la UI.
+ *   FMX_RefreshEventTrue encola un refresco como el de fmx.c.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "fm_emu.h"
+#include "main.h"
+#include "tx_api.h"
+#include "fmx.h"
+#include "fmx_lp.h"
+#include "fmx_stats.h"
+#include "fm_debug.h"
+#include "fm_flash.h"
+#include "fm_mxc.h"
+#include "fm_ppt.h"
+#include "fm_pcf8553.h"
+
+#define CHIP_ADDRESS_MASK  (0x1Fu)
+#define CHIP_READ          (0x80u)
+
+// --- Estado del emulador ---
+
+uint8_t  emu_chip_ram[EMU_CHIP_REGISTERS];
+uint32_t emu_led_errors;
+ULONG    emu_ticks;
+time_t   emu_rtc;
+
+static ULONG   queue[EMU_QUEUE_LENGTH];
+static uint8_t queue_head;
+static uint8_t queue_count;
+
+// Transferencia SPI en curso: -1 espera el byte de direccion.
+static int chip_address = -1;
+
+// --- Globales de CubeMX y fmx.c ---
+
+SPI_HandleTypeDef hspi1;
+RTC_HandleTypeDef hrtc;
+ULONG global_menu_refresh;
+
+static TX_THREAD main_thread;
+
+// --- Cola de eventos del hilo principal ---
+
+uint8_t EMU_EventSend(ULONG event)
+{
+    if (queue_count == EMU_QUEUE_LENGTH)
+    {
+        return 0;
+    }
+    queue[(queue_head + queue_count) % EMU_QUEUE_LENGTH] = event;
+    queue_count++;
+    return 1;
+}
+
+uint8_t EMU_EventReceive(ULONG *event)
+{
+    if (queue_count == 0)
+    {
+        return 0;
+    }
+    *event = queue[queue_head];
+    queue_head = (queue_head + 1u) % EMU_QUEUE_LENGTH;
+    queue_count--;
+    return 1;
+}
+
+void FMX_RefreshEventTrue(void)
+{
+    if (queue_count == 0)
+    {
+        EMU_EventSend(FMX_EVENT_MENU_REFRESH);
+    }
+}
+
+// --- ThreadX ---
+
+TX_THREAD *_tx_thread_identify(VOID) { return &main_thread; }
+ULONG _tx_time_get(VOID) { return emu_ticks; }
+VOID _txe_thread_relinquish(VOID) {}
+
+UINT _txe_semaphore_create(TX_SEMAPHORE *semaphore_ptr, CHAR *name_ptr, ULONG initial_count,
+                           UINT semaphore_control_block_size)
+{
+    (void)semaphore_ptr;
+    (void)name_ptr;
+    (void)initial_count;
+    (void)semaphore_control_block_size;
+    return TX_SUCCESS;
+}
+
+UINT _txe_semaphore_get(TX_SEMAPHORE *semaphore_ptr, ULONG wait_option)
+{
+    (void)semaphore_ptr;
+    (void)wait_option;
+    return TX_SUCCESS;
+}
+
+UINT _txe_semaphore_put(TX_SEMAPHORE *semaphore_ptr)
+{
+    (void)semaphore_ptr;
+    return TX_SUCCESS;
+}
+
+// --- HAL: GPIO y SPI1 con el PCF8553 ---
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    if ((GPIOx == PCF8553_CE_PORT) && (GPIO_Pin == PCF8553_CE_PIN))
+    {
+        chip_address = -1;
+        (void)PinState;
+    }
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, const uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+    (void)hspi;
+    (void)Timeout;
+    for (uint16_t i = 0; i < Size; i++)
+    {
+        if (chip_address < 0)
+        {
+            // Las lecturas no se emulan: el resto del burst se descarta.
+            chip_address = (pData[i] & CHIP_READ) ? EMU_CHIP_REGISTERS : (pData[i] & CHIP_ADDRESS_MASK);
+        }
+        else if (chip_address < EMU_CHIP_REGISTERS)
+        {
+            emu_chip_ram[chip_address] = pData[i];
+            chip_address++;
+        }
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, const uint8_t *pData, uint16_t Size)
+{
+    return HAL_SPI_Transmit(hspi, pData, Size, 0);
+}
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi) { (void)hspi; return HAL_OK; }
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef *hspi) { (void)hspi; return HAL_OK; }
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma) { (void)hdma; return HAL_OK; }
+
+HAL_StatusTypeDef HAL_DMA_ConfigChannelAttributes(DMA_HandleTypeDef *hdma, uint32_t ChannelAttributes)
+{
+    (void)hdma;
+    (void)ChannelAttributes;
+    return HAL_OK;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+    (void)IRQn;
+    (void)PreemptPriority;
+    (void)SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) { (void)IRQn; }
+void HAL_Delay(uint32_t Delay) { (void)Delay; }
+void Error_Handler(void) { emu_led_errors++; }
+
+// --- HAL: RTC ---
+
+static uint8_t Bcd2Bin(uint8_t value) { return (uint8_t)(((value >> 4) * 10u) + (value & 0x0Fu)); }
+static uint8_t Bin2Bcd(uint8_t value) { return (uint8_t)(((value / 10u) << 4) | (value % 10u)); }
+
+static uint8_t Field(uint8_t value, uint32_t format)
+{
+    return (format == RTC_FORMAT_BCD) ? Bin2Bcd(value) : value;
+}
+
+static uint8_t FieldSet(uint8_t value, uint32_t format)
+{
+    return (format == RTC_FORMAT_BCD) ? Bcd2Bin(value) : value;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetTime(const RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+    struct tm tm;
+
+    (void)hrtc;
+    gmtime_r(&emu_rtc, &tm);
+    memset(sTime, 0, sizeof(*sTime));
+    sTime->Hours = Field((uint8_t)tm.tm_hour, Format);
+    sTime->Minutes = Field((uint8_t)tm.tm_min, Format);
+    sTime->Seconds = Field((uint8_t)tm.tm_sec, Format);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetDate(const RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+    struct tm tm;
+
+    (void)hrtc;
+    gmtime_r(&emu_rtc, &tm);
+    sDate->WeekDay = (tm.tm_wday == 0) ? RTC_WEEKDAY_SUNDAY : (uint8_t)tm.tm_wday;
+    sDate->Month = Field((uint8_t)(tm.tm_mon + 1), Format);
+    sDate->Date = Field((uint8_t)tm.tm_mday, Format);
+    sDate->Year = Field((uint8_t)(tm.tm_year - 100), Format);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+    struct tm tm;
+
+    (void)hrtc;
+    gmtime_r(&emu_rtc, &tm);
+    tm.tm_hour = FieldSet(sTime->Hours, Format);
+    tm.tm_min = FieldSet(sTime->Minutes, Format);
+    tm.tm_sec = FieldSet(sTime->Seconds, Format);
+    emu_rtc = timegm(&tm);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+    struct tm tm;
+
+    (void)hrtc;
+    gmtime_r(&emu_rtc, &tm);
+    tm.tm_mon = FieldSet(sDate->Month, Format) - 1;
+    tm.tm_mday = FieldSet(sDate->Date, Format);
+    tm.tm_year = FieldSet(sDate->Year, Format) + 100;
+    emu_rtc = timegm(&tm);
+    return HAL_OK;
+}
+
+// --- Flash ---
+
+static flash_k_table_t k_table;
+static uint8_t k_table_written;
+
+flash_k_table_t FM_FLASH_KTableRead(void)
+{
+    if (!k_table_written)
+    {
+        memset(&k_table, 0xFF, sizeof(k_table));
+    }
+    return k_table;
+}
+
+void FM_FLASH_KTableWrite(const flash_k_table_t *table)
+{
+    k_table = *table;
+    k_table_written = 1;
+}
+
+// --- Resto del firmware ---
+
+void FM_DEBUG_Init(void) {}
+void FM_DEBUG_LedError(int status) { if (status) emu_led_errors++; }
+void FM_DEBUG_UartMsg(const char *p_msg, uint8_t len) { (void)p_msg; (void)len; }
+
+// Sin impresora ni modulo Bluetooth en el banco: la conexion falla.
+fmx_status_t FM_MXC_ConnectMaster() { return FMX_STATUS_ERROR; }
+fmx_status_t FM_MXC_ConnectSlave() { return FMX_STATUS_ERROR; }
+void FM_MXC_PowerOff() {}
+void FM_PPT_FormatTicket() {}
+void FM_PPT_PrintTicket() {}
+
+void FMX_BluetoothTickSet(uint8_t enable) { (void)enable; }
+void FMX_MeasureLock(void) {}
+void FMX_MeasureUnlock(void) {}
+void FMX_LP_StopHold(void) {}
+void FMX_LP_StopRelease(void) {}
+void FMX_STATS_StateBegin(fmx_stats_state_t state) { (void)state; }
+void FMX_STATS_StateEnd(fmx_stats_state_t state) { (void)state; }
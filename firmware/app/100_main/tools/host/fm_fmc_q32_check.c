@@ -0,0 +1,182 @@
+/**
+ * @file fm_fmc_q32_check.c
+ * @brief Verifica los reciprocos Q32 de fm_fmc.c contra las formulas double.
+ *
+ * Recorre factor_cal de FM_FMC_FACTOR_CAL_MIN a FM_FMC_FACTOR_CAL_MAX en
+ * escala logaritmica, con todas las unidades de volumen y de tiempo. Para cada
+ * combinacion compara ACM, TTL y caudal de FM_FMC_Init y FM_FMC_RateCalc con
+ * las formulas double del firmware anterior. QFormatSet garantiza un error
+ * relativo menor a 2^-31, por lo que la diferencia admitida es 1 + valor / 2^30.
+ * Ademas verifica que sumar los mismos pulsos de a partes con FM_FMC_PulseAdd
+ * da exactamente lo mismo que recalcular desde el contador completo.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "fm_fmc.h"
+#include "fm_debug.h"
+#include "fm_factory.h"
+#include "fm_ktable.h"
+
+#define CAL_STEPS   2000u
+
+extern fm_fmc_totalizer_t totalizer;
+
+// Configuracion que FM_FMC_Init lee en lugar de la RAM BACKUP.
+static fm_fmc_totalizer_t backup;
+
+// --- Stubs ---
+void FM_DEBUG_LedError(int status) { (void)status; }
+void FM_DEBUG_UartMsg(const char *p_msg, uint8_t len) { (void)p_msg; (void)len; }
+fm_fmc_totalizer_t FM_FACTORY_TotalizerGet(sensors_list_t sel) { (void)sel; return backup; }
+ufp3_t FM_KTABLE_Eval(uint32_t freq) { (void)freq; return 0; }
+void FM_KTABLE_Init(void) {}
+void FM_LCD_LL_SymbolWrite(fm_lcd_ll_sym_t symbol, uint8_t state) { (void)symbol; (void)state; }
+
+static const uint64_t pulses[] = { 0, 1, 7, 999, 1000, 65535, 123456789, 4294967295ull,
+                                   1000000000000ull, 18446744073709ull };
+
+static const uint32_t rate_pulses[] = { 1, 13, 1000, 65535, 3000000, 4294967295u };
+static const uint32_t rate_times[] = { 3278, 32769, 262145, 1048577 };
+
+static double max_rel;
+static uint32_t max_diff;
+
+/*
+ * Compara un resultado entero con la referencia double: saturado si la
+ * referencia no entra en ufp3_t, si no dentro de 1 + ref / 2^30.
+ */
+static int Compare(const char *what, ufp3_t value, double ref)
+{
+    double diff;
+    double tol;
+
+    if (ref >= 4294967295.0)
+    {
+        return (value == UINT32_MAX) ? 0 : 1;
+    }
+
+    diff = fabs((double)value - floor(ref));
+    tol = 1 + floor(ref / 1073741824.0);
+    if (diff > max_diff)
+    {
+        max_diff = (uint32_t)diff;
+    }
+    if ((ref >= 1000) && ((diff / ref) > max_rel))
+    {
+        max_rel = diff / ref;
+    }
+    if (diff > tol)
+    {
+        printf("FAIL %s: factor_cal %lu vol %u time %u: %lu vs %.3f\n", what,
+               (unsigned long)backup.factor_cal, backup.vol_unit, backup.time_unit,
+               (unsigned long)value, ref);
+        return 1;
+    }
+    return 0;
+}
+
+static int CheckVolume(void)
+{
+    double factor_k = FM_FMC_FactorKCalc(backup.factor_cal, backup.vol_unit);
+    int errors = 0;
+
+    for (uint32_t i = 0; i < sizeof(pulses) / sizeof(pulses[0]); i++)
+    {
+        backup.pulse_acm = pulses[i];
+        backup.pulse_ttl = pulses[(i + 3) % (sizeof(pulses) / sizeof(pulses[0]))];
+        FM_FMC_Init(FM_FACTORY_SENSOR_0);
+        errors += Compare("acm", FM_FMC_AcmGet(), backup.pulse_acm / factor_k * 1000);
+        errors += Compare("ttl", FM_FMC_TtlGet(), backup.pulse_ttl / factor_k * 1000);
+    }
+    return errors;
+}
+
+/*
+ * Parte desde cero y suma los pulsos en deltas irregulares; el volumen y el
+ * resto deben coincidir bit a bit con FM_FMC_Init sobre el mismo contador.
+ */
+static int CheckIncremental(void)
+{
+    uint32_t delta = 1;
+    ufp3_t acm;
+    uint64_t rem;
+
+    backup.pulse_acm = 0;
+    backup.pulse_ttl = 0;
+    FM_FMC_Init(FM_FACTORY_SENSOR_0);
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        FM_FMC_PulseAdd(delta);
+        delta = delta * 7u + 13u;
+    }
+    acm = totalizer.acm;
+    rem = totalizer.acm_rem;
+
+    backup.pulse_acm = totalizer.pulse_acm;
+    FM_FMC_Init(FM_FACTORY_SENSOR_0);
+    if ((acm != totalizer.acm) || (rem != totalizer.acm_rem))
+    {
+        printf("FAIL incremental: factor_cal %lu vol %u: %lu vs %lu\n",
+               (unsigned long)backup.factor_cal, backup.vol_unit,
+               (unsigned long)acm, (unsigned long)totalizer.acm);
+        return 1;
+    }
+    return 0;
+}
+
+static int CheckRate(void)
+{
+    double factor_r = FM_FMC_FactorRateCalc(FM_FMC_FactorKCalc(backup.factor_cal, backup.vol_unit),
+                                            backup.time_unit);
+    int errors = 0;
+    double ref;
+
+    for (uint32_t p = 0; p < sizeof(rate_pulses) / sizeof(rate_pulses[0]); p++)
+    {
+        for (uint32_t t = 0; t < sizeof(rate_times) / sizeof(rate_times[0]); t++)
+        {
+            FM_FMC_CaptureSet(rate_pulses[p], rate_times[t]);
+            ref = rate_pulses[p];
+            ref /= (rate_times[t] - 1);
+            ref *= factor_r;
+            ref *= 1000;
+            errors += Compare("rate", FM_FMC_RateCalc(), ref);
+        }
+    }
+    return errors;
+}
+
+int main(void)
+{
+    double ratio = log((double)FM_FMC_FACTOR_CAL_MAX / FM_FMC_FACTOR_CAL_MIN) / CAL_STEPS;
+    int errors = 0;
+    int cases = 0;
+
+    backup.rate.filter = FM_FMC_FILTER(FM_FMC_FILTER_EMA, 1);
+
+    for (uint32_t step = 0; step <= CAL_STEPS; step++)
+    {
+        backup.factor_cal = (ufp3_t)llround(FM_FMC_FACTOR_CAL_MIN * exp(ratio * step));
+        if (step == CAL_STEPS)
+        {
+            backup.factor_cal = FM_FMC_FACTOR_CAL_MAX;
+        }
+        for (uint32_t vol = 0; vol < VOL_UNIT_END; vol++)
+        {
+            for (uint32_t time = 0; time < TIME_UNIT_END; time++)
+            {
+                backup.vol_unit = (fm_fmc_vol_unit_t)vol;
+                backup.time_unit = (fm_fmc_time_unit_t)time;
+                errors += CheckVolume();
+                errors += CheckIncremental();
+                errors += CheckRate();
+                cases++;
+            }
+        }
+    }
+
+    printf("%d configurations, %d failures, max diff %lu, max relative error %.2e\n",
+           cases, errors, (unsigned long)max_diff, max_rel);
+    return (errors != 0);
+}
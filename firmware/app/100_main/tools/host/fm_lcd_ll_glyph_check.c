@@ -0,0 +1,260 @@
+/**
+ * @file fm_lcd_ll_glyph_check.c
+ * @brief Verifica los glifos de fm_lcd_ll.c contra el codificador anterior a las tablas.
+ *
+ * golden/lcd_ll_glyphs.txt tiene, por cada caracter imprimible, un FNV-1a de
+ * pcf8553_ram_map en la fila 1, la fila 2 y los caracteres 1 y 2 de la unidad.
+ * Cada hash recorre todas las columnas de la fila y, en cada una, escribe el
+ * caracter sobre el mapa en 0x00 y en 0xFF: asi quedan fijados los segmentos
+ * encendidos, los apagados y los que no se tocan.
+ *
+ * La tabla se genero con el fm_lcd_ll.c anterior a glyph_7/glyph_14 (los
+ * switch por caracter); no se regenera con el codigo actual:
+ *   ./fm_lcd_ll_glyph_check --print > golden/lcd_ll_glyphs.txt
+ * compilado contra ese fm_lcd_ll.c.
+ *
+ * Las dos diferencias buscadas se verifican aparte, sin la tabla:
+ * - Caracter 1 '5': el anterior apagaba un segmento; ahora es igual a 'S'.
+ * - Caracter 2 en minuscula: el anterior lo dejaba apagado; ahora muestra los
+ *   segmentos del caracter 1 en sus pines (S2-S5 -> S38, S39, S0, S1).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "fm_lcd_ll.h"
+#include "fm_pcf8553.h"
+#include "fmx_stats.h"
+#include "fm_debug.h"
+
+#define GOLDEN_PATH   "golden/lcd_ll_glyphs.txt"
+#define CHAR_FIRST    (0x20)
+#define CHAR_LAST     (0x7E)
+
+typedef enum { GROUP_ROW_1, GROUP_ROW_2, GROUP_CHAR_1, GROUP_CHAR_2, GROUP_END } group_t;
+
+static const char *const group_name[GROUP_END] = { "row 1", "row 2", "char 1", "char 2" };
+
+uint8_t pcf8553_ram_map[PCF8553_RAM_SIZE];
+uint8_t pcf8553_blink_mask[PCF8553_RAM_SIZE];
+
+// --- Stubs ---
+void FM_DEBUG_LedError(int status) { (void)status; }
+void FM_PCF8553_Blink(blink_t mode) { (void)mode; }
+void FM_PCF8553_BlinkHide(uint8_t hide) { (void)hide; }
+void FM_PCF8553_ClearBuffer() { memset(pcf8553_ram_map, 0, sizeof(pcf8553_ram_map)); }
+void FM_PCF8553_Init() {}
+void FM_PCF8553_Refresh() {}
+void FM_PCF8553_WriteAll(uint8_t data) { memset(pcf8553_ram_map, data, sizeof(pcf8553_ram_map)); }
+void FMX_STATS_StateBegin(fmx_stats_state_t state) { (void)state; }
+void FMX_STATS_StateEnd(fmx_stats_state_t state) { (void)state; }
+ULONG tx_time_get(void) { return 0; }
+
+static uint32_t Fnv(uint32_t hash, const uint8_t *data, uint32_t size)
+{
+    while (size--)
+    {
+        hash = (hash ^ *data++) * 16777619u;
+    }
+    return hash;
+}
+
+// Escribe c en una posicion del grupo sobre el fondo dado.
+static void Write(group_t group, uint8_t col, char c, uint8_t background)
+{
+    memset(pcf8553_ram_map, background, sizeof(pcf8553_ram_map));
+    switch (group)
+    {
+        case GROUP_ROW_1:
+            FM_LCD_LL_PutChar(c, col, FM_LCD_LL_ROW_1);
+            break;
+        case GROUP_ROW_2:
+            FM_LCD_LL_PutChar(c, col, FM_LCD_LL_ROW_2);
+            break;
+        case GROUP_CHAR_1:
+            FM_LCD_LL_PutChar_1(c);
+            break;
+        default:
+            FM_LCD_LL_PutChar_2(c);
+            break;
+    }
+}
+
+static uint8_t Columns(group_t group)
+{
+    if (group == GROUP_ROW_1)
+    {
+        return (uint8_t)FM_LCD_LL_GetRowSize(FM_LCD_LL_ROW_1);
+    }
+    if (group == GROUP_ROW_2)
+    {
+        return (uint8_t)FM_LCD_LL_GetRowSize(FM_LCD_LL_ROW_2);
+    }
+    return 1;
+}
+
+static uint32_t Hash(group_t group, char c)
+{
+    static const uint8_t backgrounds[] = { 0x00, 0xFF };
+    uint32_t hash = 2166136261u;
+
+    for (uint8_t col = 0; col < Columns(group); col++)
+    {
+        for (uint32_t b = 0; b < sizeof(backgrounds); b++)
+        {
+            Write(group, col, c, backgrounds[b]);
+            hash = Fnv(hash, pcf8553_ram_map, sizeof(pcf8553_ram_map));
+        }
+    }
+    return hash;
+}
+
+static void MapPrint(const char *what)
+{
+    printf("  %s:", what);
+    for (uint32_t n = 0; n < sizeof(pcf8553_ram_map); n++)
+    {
+        printf(" %02x", pcf8553_ram_map[n]);
+    }
+    printf("\n");
+}
+
+/*
+ * Pines del caracter 1 llevados a los del caracter 2: bit i del nibble de cada
+ * backplane, S(2 + i) en el caracter 1 y S38, S39, S0, S1 en el caracter 2.
+ */
+static void CharOneToTwo(const uint8_t *one, uint8_t *two)
+{
+    static const uint8_t pin_2[] = { 38, 39, 0, 1 };
+    uint8_t pin;
+
+    for (uint32_t k = 0; k < 4u; k++)
+    {
+        for (uint32_t i = 0; i < sizeof(pin_2); i++)
+        {
+            pin = pin_2[i];
+            two[5u * k + pin / 8u] &= (uint8_t)~(1u << (pin % 8u));
+            if (one[5u * k] & (1u << (2u + i)))
+            {
+                two[5u * k + pin / 8u] |= (uint8_t)(1u << (pin % 8u));
+            }
+        }
+    }
+}
+
+/*
+ * Diferencias documentadas: el caracter 1 '5' igual a 'S' y el caracter 2 en
+ * minuscula igual al caracter 1, sobre fondo 0x00 y 0xFF.
+ */
+static int Exceptions(void)
+{
+    static const uint8_t backgrounds[] = { 0x00, 0xFF };
+    uint8_t one[PCF8553_RAM_SIZE];
+    uint8_t expected[PCF8553_RAM_SIZE];
+    int errors = 0;
+
+    for (uint32_t b = 0; b < sizeof(backgrounds); b++)
+    {
+        Write(GROUP_CHAR_1, 0, 'S', backgrounds[b]);
+        memcpy(one, pcf8553_ram_map, sizeof(one));
+        Write(GROUP_CHAR_1, 0, '5', backgrounds[b]);
+        if (memcmp(one, pcf8553_ram_map, sizeof(one)) != 0)
+        {
+            printf("FAIL char 1 '5' differs from 'S', background %02x\n", backgrounds[b]);
+            errors++;
+        }
+
+        for (char c = 'a'; c <= 'z'; c++)
+        {
+            Write(GROUP_CHAR_1, 0, c, backgrounds[b]);
+            memcpy(one, pcf8553_ram_map, sizeof(one));
+            memset(expected, backgrounds[b], sizeof(expected));
+            CharOneToTwo(one, expected);
+            Write(GROUP_CHAR_2, 0, c, backgrounds[b]);
+            if (memcmp(expected, pcf8553_ram_map, sizeof(expected)) != 0)
+            {
+                printf("FAIL char 2 '%c' differs from char 1, background %02x\n", c, backgrounds[b]);
+                MapPrint("char 2");
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+static uint8_t IsException(group_t group, char c)
+{
+    return ((group == GROUP_CHAR_1) && (c == '5')) ||
+           ((group == GROUP_CHAR_2) && (c >= 'a') && (c <= 'z'));
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t golden[GROUP_END];
+    uint32_t hash;
+    unsigned code;
+    char line[128];
+    FILE *file;
+    int errors = 0;
+    int cases = 0;
+
+    if ((argc > 1) && (strcmp(argv[1], "--print") == 0))
+    {
+        printf("# caracter, FNV-1a de fila 1, fila 2, caracter 1 y caracter 2 (fm_lcd_ll_glyph_check.c)\n");
+        for (int c = CHAR_FIRST; c <= CHAR_LAST; c++)
+        {
+            printf("%02x", c);
+            for (uint32_t g = 0; g < GROUP_END; g++)
+            {
+                printf(" %08x", Hash((group_t)g, (char)c));
+            }
+            printf("\n");
+        }
+        return 0;
+    }
+
+    file = fopen(GOLDEN_PATH, "r");
+    if (file == NULL)
+    {
+        perror(GOLDEN_PATH);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if ((line[0] == '#') ||
+            (sscanf(line, "%x %x %x %x %x", &code, &golden[0], &golden[1], &golden[2], &golden[3]) != 5))
+        {
+            continue;
+        }
+        for (uint32_t g = 0; g < GROUP_END; g++)
+        {
+            if (IsException((group_t)g, (char)code))
+            {
+                continue;
+            }
+            hash = Hash((group_t)g, (char)code);
+            cases++;
+            if (hash != golden[g])
+            {
+                printf("FAIL '%c' (%02x) in %s: %08x, golden %08x\n", code, code, group_name[g], hash, golden[g]);
+                for (uint8_t col = 0; col < Columns((group_t)g); col++)
+                {
+                    Write((group_t)g, col, (char)code, 0x00);
+                    MapPrint("background 00");
+                }
+                errors++;
+            }
+        }
+    }
+    fclose(file);
+
+    if (cases != (CHAR_LAST - CHAR_FIRST + 1) * GROUP_END - 1 - 26)
+    {
+        printf("FAIL %s: %d cases\n", GOLDEN_PATH, cases);
+        errors++;
+    }
+    errors += Exceptions();
+
+    printf("%d chars per group, %d cases, %d failures\n", CHAR_LAST - CHAR_FIRST + 1, cases, errors);
+    printf("%s\n", errors ? "FAIL" : "OK");
+    return (errors != 0);
+}
@@ -0,0 +1,188 @@
+/**
+ * @file fm_lcd_ufp3_check.c
+ * @brief Verifica FM_LCD_PutUfp3 contra el camino anterior de fm_user.c.
+ *
+ * El camino anterior formateaba con snprintf ("%8lu", "%7lu.%1lu"... en la
+ * fila 1 y "%07lu", "%06lu.%01lu"... en la fila 2) y escribia con
+ * FM_LCD_PutString. Los dos caminos corren sobre un FM_LCD_LL_PutChar que
+ * graba cada llamada; las secuencias tienen que ser iguales para todos los
+ * decimales en las dos filas. Los valores son los bordes, 3 millones
+ * pseudoaleatorios y un paso primo por todo el rango de 32 bits, que tambien
+ * cubre Div10.
+ *
+ * Al final mide los dos caminos en el host. Son nanosegundos de x86 y glibc,
+ * solo sirven como relacion; los ciclos del STM32 salen de FM+UFP3? en un
+ * build de la placa con FM_BENCH definido.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "fm_lcd.h"
+#include "fm_debug.h"
+#include "fm_fmc.h"
+
+#define LINE_SIZE     (20)
+#define RECORD_SIZE   (64)
+#define RANDOM_VALUES (3000000u)
+#define STRIDE        (7919u)
+#define BENCH_RUNS    (2000000)
+
+typedef struct {
+    uint8_t n;
+    char    call[RECORD_SIZE][3];
+} record_t;
+
+static record_t *record;
+static int led_errors;
+
+// --- Stubs ---
+
+void FM_DEBUG_LedError(int status) { if (status) led_errors++; }
+void FM_LCD_LL_Init(uint8_t fill) { (void)fill; }
+void FM_LCD_LL_PutChar_1(char c) { (void)c; }
+void FM_LCD_LL_PutChar_2(char c) { (void)c; }
+
+uint32_t FM_LCD_LL_GetRowSize(fm_lcd_ll_row_t row)
+{
+    return (row == FM_LCD_LL_ROW_1) ? FM_LCD_LL_ROW_1_COLS : FM_LCD_LL_ROW_2_COLS;
+}
+
+void FM_LCD_LL_PutChar(char c, uint8_t col, fm_lcd_ll_row_t row)
+{
+    if (record->n < RECORD_SIZE)
+    {
+        record->call[record->n][0] = c;
+        record->call[record->n][1] = (char)col;
+        record->call[record->n][2] = (char)row;
+        record->n++;
+    }
+}
+
+// --- Caminos ---
+
+// Copia de MenuUserTtlRateRefresh y MenuUserRateRefresh antes de FM_LCD_PutUfp3.
+static void RenderSnprintf(uint32_t value, uint8_t sel, fm_lcd_ll_row_t row)
+{
+    static char line[LINE_SIZE];
+    unsigned long p_integer = value / 1000u;
+    unsigned long p_frac = value % 1000u;
+
+    if (row == FM_LCD_LL_ROW_1)
+    {
+        switch (sel)
+        {
+        case FM_FMC_FP_SEL_0: snprintf(line, sizeof(line), "%8lu", p_integer); break;
+        case FM_FMC_FP_SEL_1: snprintf(line, sizeof(line), "%7lu.%1lu", p_integer, p_frac / 100u); break;
+        case FM_FMC_FP_SEL_2: snprintf(line, sizeof(line), "%6lu.%02lu", p_integer, p_frac / 10u); break;
+        default:              snprintf(line, sizeof(line), "%5lu.%03lu", p_integer, p_frac); break;
+        }
+        FM_LCD_PutString(line, FM_LCD_LL_ROW_1_COLS, FM_LCD_LL_ROW_1);
+    }
+    else
+    {
+        switch (sel)
+        {
+        case FM_FMC_FP_SEL_0: snprintf(line, sizeof(line), "%07lu", p_integer); break;
+        case FM_FMC_FP_SEL_1: snprintf(line, sizeof(line), "%06lu.%01lu", p_integer, p_frac / 100u); break;
+        case FM_FMC_FP_SEL_2: snprintf(line, sizeof(line), "%05lu.%02lu", p_integer, p_frac / 10u); break;
+        default:              snprintf(line, sizeof(line), "%04lu.%03lu", p_integer, p_frac); break;
+        }
+        FM_LCD_PutString(line, FM_LCD_LL_ROW_2_COLS, FM_LCD_LL_ROW_2);
+    }
+}
+
+static void RenderUfp3(uint32_t value, uint8_t sel, fm_lcd_ll_row_t row)
+{
+    FM_LCD_PutUfp3(value, sel, (row == FM_LCD_LL_ROW_1) ? ' ' : '0', row);
+}
+
+static void Show(const char *name, const record_t *r)
+{
+    printf("  %s:", name);
+    for (int i = 0; i < r->n; i++)
+    {
+        printf(" %c@%d", r->call[i][0], r->call[i][1]);
+    }
+    printf("\n");
+}
+
+static unsigned long failures;
+static unsigned long cases;
+
+static void Compare(uint32_t value)
+{
+    static record_t expected;
+    static record_t got;
+
+    for (fm_lcd_ll_row_t row = FM_LCD_LL_ROW_1; row <= FM_LCD_LL_ROW_2; row++)
+    {
+        for (uint8_t sel = FM_FMC_FP_SEL_0; sel <= FM_FMC_FP_SEL_3; sel++)
+        {
+            record = &expected;
+            expected.n = 0;
+            RenderSnprintf(value, sel, row);
+            record = &got;
+            got.n = 0;
+            RenderUfp3(value, sel, row);
+            cases++;
+
+            if ((expected.n != got.n) || (memcmp(expected.call, got.call, sizeof(got.call[0]) * got.n) != 0))
+            {
+                if (failures < 10u)
+                {
+                    printf("FAIL value %lu decimals %u row %d\n", (unsigned long)value, sel, row + 1);
+                    Show("snprintf", &expected);
+                    Show("ufp3    ", &got);
+                }
+                failures++;
+            }
+        }
+    }
+}
+
+static double Bench(void (*render)(uint32_t, uint8_t, fm_lcd_ll_row_t), fm_lcd_ll_row_t row)
+{
+    static record_t sink;
+    struct timespec t0;
+    struct timespec t1;
+
+    record = &sink;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < BENCH_RUNS; i++)
+    {
+        sink.n = 0;
+        render(1234567u + ((uint32_t)i * 7u), FM_FMC_FP_SEL_3, row);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (((t1.tv_sec - t0.tv_sec) * 1e9) + (t1.tv_nsec - t0.tv_nsec)) / BENCH_RUNS;
+}
+
+int main(void)
+{
+    static const uint32_t edges[] = { 0, 1, 9, 10, 99, 100, 999, 1000, 1001, 12345, 99999, 100000, 999999,
+                                      1000000, 9999999, 12345678, 99999999, 100000000, 999999999,
+                                      1000000000, 4294967295u };
+
+    for (uint32_t i = 0; i < (sizeof(edges) / sizeof(edges[0])); i++)
+    {
+        Compare(edges[i]);
+    }
+    for (uint64_t k = 0; k < RANDOM_VALUES; k++)
+    {
+        Compare((uint32_t)(((k * k * 2654435761u) ^ (k * 1431655765u)) >> (k % 32u)));
+    }
+    for (uint64_t value = 0; value <= UINT32_MAX; value += STRIDE)
+    {
+        Compare((uint32_t)value);
+    }
+    printf("%lu cases, %lu failures, %d led errors\n", cases, failures, led_errors);
+
+    for (fm_lcd_ll_row_t row = FM_LCD_LL_ROW_1; row <= FM_LCD_LL_ROW_2; row++)
+    {
+        printf("row %d, 3 decimals: snprintf %.1f ns, ufp3 %.1f ns (host)\n", row + 1,
+               Bench(RenderSnprintf, row), Bench(RenderUfp3, row));
+    }
+
+    return ((failures == 0u) && (led_errors == 0)) ? 0 : 1;
+}
@@ -0,0 +1,467 @@
+/**
+ * @file fm_log_query_check.c
+ * @brief Verifica y mide las consultas de fm_log.c sobre una flash simulada.
+ *
+ * La flash del log se mapea en su direccion del STM32 (0x08100000) y los
+ * stubs de fm_flash.c borran de a media pagina y programan de a 16 bytes,
+ * sin programar sobre lo ya programado. Se arma un log de unas 2.3 vueltas
+ * con eventos cada 5 a 30 minutos, una vez limpio y otra con cortes de
+ * energia al azar entre operaciones de flash (longjmp y FM_LOG_Init).
+ *
+ * Con cortes, la mitad de los que caen en un FM_FLASH_Program dejan el
+ * quad-word en curso cortado: con los datos que se querian escribir, que es
+ * el peor caso porque parecen validos, y con doble error de ECC. En el STM32
+ * leerlo entra al NMI; aca sus paginas quedan protegidas y toda lectura que no
+ * sea de FM_FLASH_WordRead o FM_FLASH_IsErased cuenta como una lectura directa
+ * de un dato corrupto, y la verificacion falla.
+ *
+ * Cada consulta FM_LOG_QueryStart/QueryNext se compara registro a registro
+ * con un recorrido completo de FM_LOG_ReadLog. Para medir cuanto lee cada
+ * una, la flash se protege y cada acceso se atrapa con un paso simple
+ * (SIGSEGV y luego SIGTRAP con TF): se cuentan los lugares de 64 bytes
+ * distintos leidos, resumenes incluidos, sin instrumentar fm_log.c.
+ */
+
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "main.h"
+#include "fm_log.h"
+#include "fm_flash.h"
+#include "fm_debug.h"
+#include "fm_log_policy.h"
+
+#define FLASH_BASE_SIM   (0x08100000u)
+#define FLASH_SIZE_SIM   (0x00100000u)
+#define SLOT_SIZE        (64u)
+#define SLOTS            (FLASH_SIZE_SIM / SLOT_SIZE)
+#define QUADS            (FLASH_SIZE_SIM / 16u)
+#define EFLAGS_TF        (0x100)
+#define REPEAT           (20)
+
+static jmp_buf cut;
+static long    cut_at = -1;
+static long    flash_ops;
+static int     led_errors;
+static uint32_t now = 1700000000u;
+
+static uint8_t torn[QUADS];     // Quad-words con doble error de ECC.
+static long    torn_count;
+static long    torn_reads;      // Lecturas de un quad-word cortado fuera de los stubs.
+static volatile sig_atomic_t in_stub;  // Acceso de un stub que conoce el ECC.
+static int     counting;        // Toda la flash protegida para contar lugares.
+static int     timing;          // Toda la flash abierta para medir tiempos.
+
+static void PageProtect(uintptr_t page);
+
+// --- Stubs ---
+
+void FM_DEBUG_LedError(int status) { if (status) led_errors++; }
+uint32_t FM_LOG_POLICY_Step(fmx_ack_t ack) { (void)ack; return 1; }
+ufp3_t FM_FMC_FactorCalGet(void) { return 1234; }
+
+void FM_FMC_SnapshotGet(fm_fmc_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->time_unix = now;
+    snapshot->pulse_ttl = now;
+    snapshot->pulse_acm = now;
+    snapshot->rate = 1;
+}
+
+// Un corte de energia puede caer entre dos operaciones de flash cualquiera.
+static int FlashCut(void)
+{
+    return (cut_at >= 0) && (flash_ops++ == cut_at);
+}
+
+static void FlashOp(void)
+{
+    if (FlashCut())
+    {
+        in_stub = 0;
+        longjmp(cut, 1);
+    }
+}
+
+// Como en el STM32: la lectura se hace, y un quad-word cortado da error.
+uint8_t FM_FLASH_WordRead(uint32_t address, uint32_t *word)
+{
+    in_stub = 1;
+    *word = *(const volatile uint32_t *)(uintptr_t)address;
+    in_stub = 0;
+    return !torn[(address - FLASH_BASE_SIM) / 16u];
+}
+
+uint8_t FM_FLASH_IsErased(uint32_t address, uint32_t length)
+{
+    uint32_t word;
+
+    for (uint32_t i = 0; i < length; i += 4u)
+    {
+        if (!FM_FLASH_WordRead(address + i, &word) || (word != UINT32_MAX))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void HalfErase(uint32_t address)
+{
+    in_stub = 1;
+    memset((void *)(uintptr_t)address, 0xFF, FLASH_PAGE_SIZE / 2u);
+    in_stub = 0;
+    memset(&torn[(address - FLASH_BASE_SIM) / 16u], 0, FLASH_PAGE_SIZE / 32u);
+    for (uint32_t offset = 0; offset < (FLASH_PAGE_SIZE / 2u); offset += getpagesize())
+    {
+        PageProtect(address + offset);
+    }
+}
+
+uint32_t FM_FLASH_PageErase(uint32_t address)
+{
+    uint32_t page = address & ~(FLASH_PAGE_SIZE - 1u);
+
+    FlashOp();
+    HalfErase(page);
+    FlashOp();
+    HalfErase(page + (FLASH_PAGE_SIZE / 2u));
+    return FLASH_PAGE_SIZE;
+}
+
+uint32_t FM_FLASH_Program(uint32_t address, const uint8_t *data, uint16_t data_length)
+{
+    for (uint32_t offset = 0; offset < data_length; offset += 16u)
+    {
+        uint8_t *quad = (uint8_t *)(uintptr_t)(address + offset);
+
+        if (FlashCut())
+        {
+            if ((rand() % 2) == 0)
+            {
+                in_stub = 1;
+                memcpy(quad, data + offset, 16u);
+                in_stub = 0;
+                torn[(address + offset - FLASH_BASE_SIM) / 16u] = 1;
+                torn_count++;
+                PageProtect((uintptr_t)quad & ~((uintptr_t)getpagesize() - 1u));
+            }
+            longjmp(cut, 1);
+        }
+        in_stub = 1;
+        for (int i = 0; i < 16; i++)
+        {
+            if (quad[i] != 0xFFu)
+            {
+                printf("FAIL program over programmed flash at %08lx\n", (unsigned long)(address + offset));
+                exit(1);
+            }
+        }
+        memcpy(quad, data + offset, 16u);
+        in_stub = 0;
+    }
+    return data_length;
+}
+
+uint32_t FM_FLASH_Read(uint32_t address, uint8_t *data, uint16_t data_length)
+{
+    memcpy(data, (const void *)(uintptr_t)address, data_length);
+    return data_length;
+}
+
+// --- Conteo de lugares leidos y lecturas de quad-words cortados ---
+
+static uint8_t  slot_seen[SLOTS];
+static uint32_t slots_read;
+static uintptr_t trap_page;
+
+static void PageProtect(uintptr_t page)
+{
+    uint32_t first = (page - FLASH_BASE_SIM) / 16u;
+    int closed = counting;
+
+    for (uint32_t q = first; !closed && !timing && (q < (first + (getpagesize() / 16u))); q++)
+    {
+        closed = torn[q];
+    }
+    mprotect((void *)page, getpagesize(), closed ? PROT_NONE : (PROT_READ | PROT_WRITE));
+}
+
+static void ProtectAll(void)
+{
+    for (uintptr_t page = FLASH_BASE_SIM; page < (FLASH_BASE_SIM + FLASH_SIZE_SIM); page += getpagesize())
+    {
+        PageProtect(page);
+    }
+}
+
+static void OnFault(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+    uintptr_t address = (uintptr_t)info->si_addr;
+    uint32_t slot;
+
+    (void)sig;
+    if ((address < FLASH_BASE_SIM) || (address >= (FLASH_BASE_SIM + FLASH_SIZE_SIM)))
+    {
+        abort();
+    }
+    if (torn[(address - FLASH_BASE_SIM) / 16u] && !in_stub)
+    {
+        torn_reads++;
+    }
+    slot = (address - FLASH_BASE_SIM) / SLOT_SIZE;
+    if (counting && !slot_seen[slot])
+    {
+        slot_seen[slot] = 1;
+        slots_read++;
+    }
+    // Se abre la pagina para una instruccion y se vuelve a cerrar en OnStep.
+    trap_page = address & ~((uintptr_t)getpagesize() - 1u);
+    mprotect((void *)trap_page, getpagesize(), PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+}
+
+static void OnStep(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+
+    (void)sig;
+    (void)info;
+    PageProtect(trap_page);
+    uc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+}
+
+static void CountStart(void)
+{
+    memset(slot_seen, 0, sizeof(slot_seen));
+    slots_read = 0;
+    counting = 1;
+    ProtectAll();
+}
+
+static uint32_t CountStop(void)
+{
+    counting = 0;
+    ProtectAll();
+    return slots_read;
+}
+
+// --- Log sintetico ---
+
+static fmx_ack_t AckPick(void)
+{
+    int r = rand() % 100;
+
+    return (r < 70) ? FMX_ACK_RATE_CHANGE
+         : (r < 85) ? FMX_ACK_RATE_ON
+         : (r < 97) ? FMX_ACK_RATE_OFF
+         : (r < 99) ? FMX_ACK_TICKET
+         : FMX_ACK_LOW_BATTERY;
+}
+
+static long LogFill(uint32_t events, int cuts_on)
+{
+    long cuts = 0;
+
+    memset(torn, 0, sizeof(torn));
+    torn_count = 0;
+    torn_reads = 0;
+    ProtectAll();
+    memset((void *)(uintptr_t)FLASH_BASE_SIM, 0xFF, FLASH_SIZE_SIM);
+    srand(11);
+    now = 1700000000u;
+    FM_LOG_Init();
+    while (events > 0u)
+    {
+        if (cuts_on && setjmp(cut))
+        {
+            cuts++;
+            cut_at = -1;
+            FM_LOG_Init();
+            continue;
+        }
+        if (cuts_on && ((rand() % 97) == 0))
+        {
+            cut_at = flash_ops + (rand() % 80);
+        }
+        now += 300u + (uint32_t)(rand() % 1500);
+        FM_LOG_NewEvent(AckPick());
+        events--;
+    }
+    cut_at = -1;
+    return cuts;
+}
+
+// --- Consultas ---
+
+// Lo que hace hoy un cliente: todos los registros con FM_LOG_ReadLog.
+static int Scan(uint32_t from, uint32_t to, uint32_t acks, uint32_t *sequences)
+{
+    fm_log_data_t record;
+    int n = 0;
+
+    for (uint32_t index = 16002u; index >= 1u; index--)
+    {
+        if (FM_LOG_ReadLog(index, (uint8_t *)&record) != FMX_STATUS_OK)
+        {
+            continue;
+        }
+        if ((record.time_unix >= from) && (record.time_unix <= to) && ((FM_LOG_ACK(record.ack) & acks) != 0u))
+        {
+            sequences[n++] = record.sequence;
+        }
+    }
+    return n;
+}
+
+static int Query(uint32_t from, uint32_t to, uint32_t acks, uint32_t *sequences)
+{
+    fm_log_query_t query;
+    fm_log_data_t record;
+    int n = 0;
+
+    FM_LOG_QueryStart(&query, from, to, acks);
+    while (FM_LOG_QueryNext(&query, &record) == FMX_STATUS_OK)
+    {
+        sequences[n++] = record.sequence;
+    }
+    return n;
+}
+
+static double Now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (t.tv_sec * 1e9) + t.tv_nsec;
+}
+
+static int QueriesRun(void)
+{
+    static uint32_t expected[20000];
+    static uint32_t got[20000];
+    fm_log_query_t query;
+    fm_log_data_t record;
+    uint32_t oldest;
+    int errors = 0;
+
+    FM_LOG_QueryStart(&query, 0, UINT32_MAX, 0);
+    FM_LOG_QueryNext(&query, &record);
+    oldest = record.time_unix;
+    printf("log span %.1f days\n", (now - oldest) / 86400.0);
+
+    const struct {
+        const char *name;
+        uint32_t from;
+        uint32_t to;
+        uint32_t acks;
+    } queries[] = {
+        { "last week, RATE_ON", now - (7u * 86400u), now, FM_LOG_ACK(FMX_ACK_RATE_ON) },
+        { "last week, all", now - (7u * 86400u), now, 0 },
+        { "one day mid log", oldest + (60u * 86400u), oldest + (61u * 86400u), 0 },
+        { "LOW_BATTERY, all time", 0, UINT32_MAX, FM_LOG_ACK(FMX_ACK_LOW_BATTERY) },
+        { "TICKET|BATCH_DONE, 30 d", now - (30u * 86400u), now,
+          FM_LOG_ACK(FMX_ACK_TICKET) | FM_LOG_ACK(FMX_ACK_BATCH_DONE) },
+        { "reason never logged", 0, UINT32_MAX, FM_LOG_ACK(FMX_ACK_NEW_CONFIG) },
+        { "everything", 0, UINT32_MAX, 0 },
+    };
+
+    printf("%-26s %6s %11s %11s %9s %9s\n", "query", "hits", "scan slots", "query slots", "scan us", "query us");
+    for (unsigned k = 0; k < (sizeof(queries) / sizeof(queries[0])); k++)
+    {
+        uint32_t acks = (queries[k].acks != 0u) ? queries[k].acks : UINT32_MAX;
+        uint32_t scan_slots;
+        uint32_t query_slots;
+        double t0;
+        double t1;
+        double t2;
+        int n_scan;
+        int n_query;
+        int same;
+
+        CountStart();
+        n_scan = Scan(queries[k].from, queries[k].to, acks, expected);
+        scan_slots = CountStop();
+        CountStart();
+        n_query = Query(queries[k].from, queries[k].to, queries[k].acks, got);
+        query_slots = CountStop();
+
+        // Scan recorre del mas viejo al mas nuevo, igual que la consulta.
+        same = (n_scan == n_query);
+        for (int i = 0; same && (i < n_scan); i++)
+        {
+            same = (expected[i] == got[i]);
+        }
+        if (!same)
+        {
+            printf("FAIL %s: scan %d records, query %d\n", queries[k].name, n_scan, n_query);
+            errors++;
+        }
+
+        // Las mismas consultas ya verificadas, sin atrapar los quad-words cortados.
+        timing = 1;
+        ProtectAll();
+        t0 = Now();
+        for (int r = 0; r < REPEAT; r++)
+        {
+            Scan(queries[k].from, queries[k].to, acks, expected);
+        }
+        t1 = Now();
+        for (int r = 0; r < REPEAT; r++)
+        {
+            Query(queries[k].from, queries[k].to, queries[k].acks, got);
+        }
+        t2 = Now();
+        timing = 0;
+        ProtectAll();
+        printf("%-26s %6d %11lu %11lu %9.1f %9.1f\n", queries[k].name, n_query, (unsigned long)scan_slots,
+               (unsigned long)query_slots, (t1 - t0) / (REPEAT * 1e3), (t2 - t1) / (REPEAT * 1e3));
+    }
+    return errors;
+}
+
+int main(void)
+{
+    struct sigaction fault = { 0 };
+    struct sigaction step = { 0 };
+    uint32_t events = (16002u * 2u) + 5000u;  // Dos vueltas y el head a mitad del anillo.
+    int errors = 0;
+    long cuts;
+
+    if (mmap((void *)(uintptr_t)FLASH_BASE_SIM, FLASH_SIZE_SIM, PROT_READ | PROT_WRITE,
+             MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    fault.sa_sigaction = OnFault;
+    fault.sa_flags = SA_SIGINFO;
+    sigaction(SIGSEGV, &fault, NULL);
+    step.sa_sigaction = OnStep;
+    step.sa_flags = SA_SIGINFO;
+    sigaction(SIGTRAP, &step, NULL);
+
+    for (int cuts_on = 0; cuts_on <= 1; cuts_on++)
+    {
+        cuts = LogFill(events, cuts_on);
+        printf("%u events, %ld power cuts, %ld torn quad-words, %d led errors\n", events, cuts, torn_count,
+               led_errors);
+        errors += QueriesRun();
+        if (torn_reads != 0)
+        {
+            printf("FAIL %ld direct reads of a torn quad-word (NMI on the STM32)\n", torn_reads);
+            errors++;
+        }
+    }
+
+    printf("%s\n", (errors == 0) ? "OK" : "FAILED");
+    return (errors == 0) ? 0 : 1;
+}
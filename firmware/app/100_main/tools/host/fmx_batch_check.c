@@ -0,0 +1,304 @@
+/**
+ * @file fmx_batch_check.c
+ * @brief Simula el sobrepaso del batch de fmx_batch.c contra el corte por ventana de 1 s.
+ *
+ * fmx_batch.c corre sin cambios sobre LPTIM4 mapeado en su direccion del
+ * STM32. Los pulsos del sensor llegan a frecuencia fija; cada pulso incrementa
+ * CNT y, si coincide con CCR1 y CC1 esta habilitada, la ISR corre
+ * ISR_LATENCY_NS despues. FMX_MeasureWake adelanta el cierre de la ventana,
+ * como en fmx.c; las siguientes cierran cada 1 s.
+ *
+ * El corte anterior se modela en el mismo escenario: la valvula se cierra en
+ * el primer cierre de ventana (cada 1 s) con el objetivo alcanzado. Para cada
+ * frecuencia y objetivo se prueban varias fases de la ventana respecto del
+ * inicio, conteos de inicio cerca de las vueltas de 16 y 32 bits y pre-cierre.
+ *
+ * Falla si el batch no termina, si el log no registra un FMX_ACK_BATCH_DONE,
+ * si la ISR lee mas pulsos que los que llegan durante su latencia, si el
+ * sobrepaso por compare supera esos pulsos mas el cierre de la valvula, o si
+ * supera al del corte por ventana.
+ */
+
+#include <stdio.h>
+#include <sys/mman.h>
+#include "main.h"
+#include "lptim.h"
+#include "fmx_batch.h"
+#include "fmx_capture.h"
+#include "fm_debug.h"
+#include "fm_log.h"
+
+#define PERIPH_SIM_BASE   (APB3PERIPH_BASE_NS)
+#define PERIPH_SIM_SIZE   (0x00010000u)    // APB3: LPTIM4.
+
+#define NS_PER_S          (1000000000ull)
+#define WINDOW_NS         (NS_PER_S)
+#define WAKE_NS           (1000000ull)     // Del FMX_MeasureWake al cierre de la ventana.
+#define VALVE_NS          (20000000ull)    // Cierre mecanico de la valvula.
+#define PRE_CLOSE_DIV     (4u)             // La primera etapa deja pasar 1/4 del caudal.
+#define PHASES            (8u)
+
+typedef enum { CUT_COMPARE, CUT_WINDOW } cut_t;
+
+// Estado de la simulacion de un batch.
+typedef struct {
+    uint64_t now;
+    uint64_t pulse_next;
+    uint64_t window_next;
+    uint64_t isr_at;          // UINT64_MAX sin ISR pendiente.
+    uint64_t valve_at;        // Cambio de caudal pendiente.
+    uint32_t period_ns;       // Periodo actual de los pulsos; 0 con la valvula cerrada.
+    uint32_t period_next;     // Periodo despues de valve_at.
+    uint32_t count;           // Conteo de 32 bits de LPTIM4.
+    uint32_t window_count;
+} sim_t;
+
+uint32_t cmsis_host_primask;
+uint32_t SystemCoreClock = 4000000u;
+LPTIM_HandleTypeDef hlptim4 = { .Instance = LPTIM4 };
+
+static sim_t sim;
+static uint32_t isr_latency_ns;
+static int led_errors;
+static int log_events;
+
+// --- Stubs ---
+void FM_DEBUG_LedError(int status) { (void)status; led_errors++; }
+uint32_t FM_FMC_VolumeToPulses(ufp3_t volume) { return volume; }
+ufp3_t FM_FMC_PulsesToVolume(uint32_t pulses) { return pulses; }
+uint32_t FMX_CAPTURE_PulseCountGet(void) { return sim.count; }
+fmx_status_t FM_LOG_NewEvent(fmx_ack_t ack)
+{
+    log_events += (ack == FMX_ACK_BATCH_DONE);
+    return FMX_STATUS_OK;
+}
+
+void FMX_MeasureWake(void)
+{
+    sim.window_next = sim.now + WAKE_NS;
+}
+
+// Valvula: la orden llega desde la ISR y el caudal cambia VALVE_NS despues.
+static void ValveSet(uint32_t period_ns)
+{
+    sim.valve_at = sim.now + VALVE_NS;
+    sim.period_next = period_ns;
+}
+
+void FMX_BATCH_PreCloseCallback(void)
+{
+    ValveSet(sim.period_ns * PRE_CLOSE_DIV);
+}
+
+void FMX_BATCH_CloseCallback(void)
+{
+    ValveSet(0);
+}
+
+// --- Simulacion ---
+
+static void Pulse(void)
+{
+    sim.count++;
+    LPTIM4->CNT = (uint16_t)sim.count;
+    if ((LPTIM4->CNT == LPTIM4->CCR1) && (LPTIM4->DIER & LPTIM_IT_CC1))
+    {
+        LPTIM4->ISR |= LPTIM_FLAG_CC1;
+        if (sim.isr_at == UINT64_MAX)
+        {
+            sim.isr_at = sim.now + isr_latency_ns;
+        }
+    }
+    sim.pulse_next = (sim.period_ns != 0u) ? (sim.now + sim.period_ns) : UINT64_MAX;
+}
+
+/*
+ * Corre un batch de target pulsos a freq Hz desde el conteo start, con la
+ * primera ventana phase_ns despues del inicio. Devuelve el sobrepaso en pulsos.
+ */
+static uint32_t BatchRun(cut_t cut, uint32_t freq, uint32_t target, uint32_t pre_close, uint32_t start,
+                         uint64_t phase_ns, fmx_batch_status_t *result)
+{
+    uint32_t delta;
+    uint8_t pre_closed = 0;
+    uint8_t closed = 0;
+
+    sim = (sim_t){ .period_ns = (uint32_t)(NS_PER_S / freq), .count = start, .window_count = start,
+                   .isr_at = UINT64_MAX, .valve_at = UINT64_MAX, .window_next = phase_ns };
+    sim.pulse_next = sim.period_ns / 2u;
+    LPTIM4->CNT = (uint16_t)start;
+    LPTIM4->ISR = LPTIM_FLAG_CMP1OK | LPTIM_FLAG_DIEROK;
+    LPTIM4->DIER = 0;
+
+    if (cut == CUT_COMPARE)
+    {
+        FMX_BATCH_Start(target, pre_close);
+    }
+
+    for (;;)
+    {
+        if ((sim.isr_at <= sim.pulse_next) && (sim.isr_at <= sim.window_next) && (sim.isr_at <= sim.valve_at))
+        {
+            sim.now = sim.isr_at;
+            sim.isr_at = UINT64_MAX;
+            LPTIM4->ISR &= ~LPTIM_FLAG_CC1;
+            if (LPTIM4->DIER & LPTIM_IT_CC1)
+            {
+                HAL_LPTIM_CompareMatchCallback(&hlptim4);
+            }
+        }
+        else if ((sim.valve_at <= sim.pulse_next) && (sim.valve_at <= sim.window_next))
+        {
+            sim.now = sim.valve_at;
+            sim.valve_at = UINT64_MAX;
+            sim.period_ns = sim.period_next;
+            sim.pulse_next = (sim.period_ns != 0u) ? (sim.now + sim.period_ns) : UINT64_MAX;
+        }
+        else if (sim.pulse_next <= sim.window_next)
+        {
+            sim.now = sim.pulse_next;
+            Pulse();
+        }
+        else
+        {
+            sim.now = sim.window_next;
+            sim.window_next = sim.now + WINDOW_NS;
+            delta = sim.count - sim.window_count;
+            sim.window_count = sim.count;
+
+            if (cut == CUT_COMPARE)
+            {
+                FMX_BATCH_Update(delta);
+                *result = FMX_BATCH_StatusGet();
+                if (result->state == FMX_BATCH_DONE)
+                {
+                    return result->overshoot;
+                }
+                continue;
+            }
+
+            // Corte anterior: se mira el conteo al cerrar cada ventana.
+            if (closed && (delta == 0u))
+            {
+                return sim.count - (start + target);
+            }
+            if (!pre_closed && (pre_close != 0u) && ((sim.count - start) >= (target - pre_close)))
+            {
+                pre_closed = 1;
+                ValveSet(sim.period_ns * PRE_CLOSE_DIV);
+            }
+            if (!closed && ((sim.count - start) >= target))
+            {
+                closed = 1;
+                ValveSet(0);
+            }
+        }
+
+        if (sim.now > (uint64_t)(target / freq + 100u) * 3u * NS_PER_S)
+        {
+            printf("FAIL %u Hz target %u: batch did not finish\n", freq, target);
+            result->state = FMX_BATCH_IDLE;
+            return UINT32_MAX;
+        }
+    }
+}
+
+/*
+ * Sobrepaso admitido por compare: pulsos durante la latencia de la ISR a
+ * caudal pleno, mas los del cierre de la valvula al caudal de la ultima etapa.
+ */
+static uint32_t Allowed(uint32_t freq, uint32_t pre_close)
+{
+    uint64_t valve_freq = (pre_close != 0u) ? (freq / PRE_CLOSE_DIV) : freq;
+
+    return (uint32_t)(((uint64_t)isr_latency_ns * freq) / NS_PER_S + 1u
+                      + (VALVE_NS * (valve_freq + 1u)) / NS_PER_S + 1u);
+}
+
+int main(void)
+{
+    static const uint32_t freqs[] = { 1, 10, 100, 1000, 1500 };
+    static const uint32_t latencies_ns[] = { 2000, 50000, 700000 };
+    static const uint32_t starts[] = { 0, 0xFFF0u, 0xFFFFFFF0u };
+    static const struct { uint32_t target; uint32_t pre_close; } batches[] =
+        { { 100, 0 }, { 1000, 200 }, { 70000, 0 }, { 140000, 5000 } };
+    fmx_batch_status_t result;
+    uint32_t compare;
+    uint32_t window;
+    uint32_t compare_max;
+    uint64_t window_sum;
+    int errors = 0;
+    int runs = 0;
+
+    if (mmap((void *)(uintptr_t)PERIPH_SIM_BASE, PERIPH_SIM_SIZE, PROT_READ | PROT_WRITE,
+             MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    printf("%6s %7s %6s %8s %12s %12s\n", "Hz", "target", "pre", "ISR us", "compare max", "window mean");
+    for (uint32_t f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++)
+    {
+        for (uint32_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++)
+        {
+            // Batches de mas de una hora a caudal bajo no aportan: el CCR da la vuelta igual a 1000 Hz.
+            if ((batches[b].target / freqs[f]) > 3600u)
+            {
+                continue;
+            }
+            for (uint32_t l = 0; l < sizeof(latencies_ns) / sizeof(latencies_ns[0]); l++)
+            {
+                isr_latency_ns = latencies_ns[l];
+                compare_max = 0;
+                window_sum = 0;
+                for (uint32_t p = 0; p < PHASES; p++)
+                {
+                    uint64_t phase = (WINDOW_NS * p) / PHASES + 12345u;
+                    uint32_t start = starts[p % (sizeof(starts) / sizeof(starts[0]))];
+
+                    log_events = 0;
+                    led_errors = 0;
+                    compare = BatchRun(CUT_COMPARE, freqs[f], batches[b].target, batches[b].pre_close, start,
+                                       phase, &result);
+                    if (result.isr_overshoot > ((uint64_t)isr_latency_ns * freqs[f]) / NS_PER_S + 1u)
+                    {
+                        printf("FAIL %u Hz target %u start %08x: %u pulses read late in the ISR\n", freqs[f],
+                               batches[b].target, start, result.isr_overshoot);
+                        errors++;
+                    }
+                    window = BatchRun(CUT_WINDOW, freqs[f], batches[b].target, batches[b].pre_close, start,
+                                      phase, &result);
+                    runs++;
+
+                    if ((log_events != 1) || (led_errors != 0) || (compare == UINT32_MAX))
+                    {
+                        printf("FAIL %u Hz target %u start %08x: %d log events, %d LED errors\n", freqs[f],
+                               batches[b].target, start, log_events, led_errors);
+                        errors++;
+                    }
+                    if (compare > Allowed(freqs[f], batches[b].pre_close))
+                    {
+                        printf("FAIL %u Hz target %u start %08x: overshoot %u > %u\n", freqs[f],
+                               batches[b].target, start, compare, Allowed(freqs[f], batches[b].pre_close));
+                        errors++;
+                    }
+                    if (compare > window)
+                    {
+                        printf("FAIL %u Hz target %u start %08x: compare %u > window %u\n", freqs[f],
+                               batches[b].target, start, compare, window);
+                        errors++;
+                    }
+                    compare_max = (compare > compare_max) ? compare : compare_max;
+                    window_sum += window;
+                }
+                printf("%6u %7u %6u %8u %12u %12.1f\n", freqs[f], batches[b].target, batches[b].pre_close,
+                       isr_latency_ns / 1000u, compare_max, (double)window_sum / PHASES);
+            }
+        }
+    }
+
+    printf("%d runs, %d failures\n", runs, errors);
+    printf("%s\n", errors ? "FAIL" : "OK");
+    return (errors != 0);
+}
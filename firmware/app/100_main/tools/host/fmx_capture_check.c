@@ -0,0 +1,305 @@
+/**
+ * @file fmx_capture_check.c
+ * @brief Verifica la extension a 32 bits de LPTIM3/LPTIM4 en fmx_capture.c.
+ *
+ * Los registros de LPTIM3, LPTIM4, LPDMA1 y RCC se mapean en sus direcciones
+ * del STM32 y fmx_capture.c corre sin cambios. Cada timer se simula con su
+ * valor verdadero de 64 bits: CNT es la parte baja, ARRM se levanta cuando
+ * CNT llega a ARR (0xFFFF) y la ISR lo atiende con una demora configurable,
+ * incluida la de 0 ticks con CNT todavia en ARR.
+ *
+ * Linea de tiempo: FMX_CAPTURE_TimeGet y FMX_CAPTURE_PulseCountGet se leen
+ * alrededor de cada vuelta, con ARRM pendiente y CNT bajo o alto, y despues
+ * de atenderlo, durante 2^16 vueltas hasta que el valor de 32 bits da la
+ * vuelta. Deben coincidir siempre con el valor verdadero.
+ *
+ * Drenado: flancos con periodo fijo entran al anillo por el LPDMA simulado y
+ * se drenan cada D ticks, con D hasta y desde 2 s (65536 ticks). Con puntos
+ * exactamente equiespaciados la regresion da el periodo exacto; una marca
+ * ubicada en la vuelta equivocada lo cambia. Con D >= 2 s la ventana se debe
+ * reiniciar y la siguiente no devuelve periodos.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "main.h"
+#include "lptim.h"
+#include "fmx_capture.h"
+#include "fm_debug.h"
+
+#define PERIPH_SIM_BASE   (APB3PERIPH_BASE_NS)
+#define PERIPH_SIM_SIZE   (0x00030000u)    // APB3 y AHB3: LPTIM3/4, RCC y LPDMA1.
+#define RING_LENGTH_SIM   (2048u)
+#define SWEEP_WRAPS       (65536u + 3u)
+
+// Demoras de la ISR despues del ARRM; la extension admite hasta 0x7FFF.
+static const uint32_t isr_latency[] = { 0, 1, 2, 37, 1000, 0x7FFEu };
+
+typedef struct {
+    LPTIM_TypeDef       *regs;
+    LPTIM_HandleTypeDef *handle;
+    uint64_t             value;    // Valor verdadero.
+    uint64_t             service;  // Valor en que la ISR atiende el ARRM pendiente.
+    uint32_t             latency;
+    uint8_t              pending;
+} sim_timer_t;
+
+uint32_t cmsis_host_primask;
+LPTIM_HandleTypeDef hlptim3 = { .Instance = LPTIM3 };
+LPTIM_HandleTypeDef hlptim4 = { .Instance = LPTIM4 };
+
+static sim_timer_t lse = { .handle = &hlptim3 };
+static sim_timer_t sensor = { .handle = &hlptim4 };
+static uint16_t *ring;
+static uint32_t ring_write;
+static long reads;
+
+// --- Stubs ---
+void FM_DEBUG_LedError(int status) { (void)status; }
+HAL_StatusTypeDef HAL_LPTIM_IC_Start_DMA(LPTIM_HandleTypeDef *hlptim, uint32_t Channel, uint32_t *pData,
+                                         uint32_t Length)
+{
+    (void)hlptim; (void)Channel; (void)Length;
+    ring = (uint16_t *)pData;
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_DMAEx_List_BuildNode(DMA_NodeConfTypeDef const *const pNodeConfig,
+                                           DMA_NodeTypeDef *const pNode)
+{
+    (void)pNodeConfig; (void)pNode; return HAL_OK;
+}
+HAL_StatusTypeDef HAL_DMAEx_List_InsertNode(DMA_QListTypeDef *const pQList, DMA_NodeTypeDef *const pPrevNode,
+                                            DMA_NodeTypeDef *const pNewNode)
+{
+    (void)pQList; (void)pPrevNode; (void)pNewNode; return HAL_OK;
+}
+HAL_StatusTypeDef HAL_DMAEx_List_SetCircularMode(DMA_QListTypeDef *const pQList) { (void)pQList; return HAL_OK; }
+HAL_StatusTypeDef HAL_DMAEx_List_Init(DMA_HandleTypeDef *const hdma) { (void)hdma; return HAL_OK; }
+HAL_StatusTypeDef HAL_DMAEx_List_LinkQ(DMA_HandleTypeDef *const hdma, DMA_QListTypeDef *const pQList)
+{
+    (void)hdma; (void)pQList; return HAL_OK;
+}
+HAL_StatusTypeDef HAL_DMA_ConfigChannelAttributes(DMA_HandleTypeDef *const hdma, uint32_t ChannelAttributes)
+{
+    (void)hdma; (void)ChannelAttributes; return HAL_OK;
+}
+
+// --- Timers simulados ---
+
+// La ISR de LPTIM: limpia ARRM y llama al callback de fmx_capture.c.
+static void TimerService(sim_timer_t *t)
+{
+    t->regs->ISR &= ~LPTIM_FLAG_ARRM;
+    t->pending = 0;
+    HAL_LPTIM_AutoReloadMatchCallback(t->handle);
+}
+
+/*
+ * Lleva el timer hasta value pasando por cada llegada a ARR y por cada
+ * atencion de la ISR, en orden. La ISR corre antes que las lecturas del
+ * mismo tick.
+ */
+static void TimerSet(sim_timer_t *t, uint64_t value)
+{
+    uint64_t match;
+    uint64_t target;
+
+    while (t->value != value)
+    {
+        match = t->value | 0xFFFFu;
+        if (match == t->value)
+        {
+            match += 0x10000u;
+        }
+        target = value;
+        if (t->pending && (t->service < target))
+        {
+            target = t->service;
+        }
+        if (match < target)
+        {
+            target = match;
+        }
+        t->value = target;
+        if (t->value == match)
+        {
+            t->regs->ISR |= LPTIM_FLAG_ARRM;
+            t->pending = 1;
+            t->service = match + t->latency;
+        }
+        if (t->pending && (t->value == t->service))
+        {
+            TimerService(t);
+        }
+    }
+    t->regs->CNT = (uint16_t)t->value;
+}
+
+// --- Linea de tiempo ---
+
+static int Expect(const char *name, uint32_t read, const sim_timer_t *t)
+{
+    reads++;
+    if (read != (uint32_t)t->value)
+    {
+        printf("FAIL %s: value 0x%llx (CNT 0x%04x, ARRM %u, latency %u) read 0x%08x\n", name,
+               (unsigned long long)t->value, (unsigned)(t->value & 0xFFFFu), t->pending,
+               t->latency, read);
+        return 1;
+    }
+    return 0;
+}
+
+static int Sweep(const char *name, sim_timer_t *t, uint32_t (*read)(void))
+{
+    static const int32_t around[] = { -2, -1, 0, 1, 2 };
+    uint64_t match;
+    int errors = 0;
+
+    reads = 0;
+    for (uint32_t wrap = 0; (wrap < SWEEP_WRAPS) && (errors < 10); wrap++)
+    {
+        match = ((uint64_t)wrap << 16) | 0xFFFFu;
+        t->latency = isr_latency[wrap % (sizeof(isr_latency) / sizeof(isr_latency[0]))];
+
+        TimerSet(t, match - 0x8000u);
+        errors += Expect(name, read(), t);
+        for (uint32_t i = 0; i < sizeof(around) / sizeof(around[0]); i++)
+        {
+            TimerSet(t, match + around[i]);
+            errors += Expect(name, read(), t);
+        }
+        for (uint32_t i = 0; i < sizeof(around) / sizeof(around[0]); i++)
+        {
+            if (((int32_t)t->latency + around[i]) > 2)
+            {
+                TimerSet(t, match + (uint64_t)((int32_t)t->latency + around[i]));
+                errors += Expect(name, read(), t);
+            }
+        }
+    }
+    printf("%s: %u wraps, %ld reads, %d failures\n", name, SWEEP_WRAPS, reads, errors);
+    return errors;
+}
+
+// --- Drenado ---
+
+// Flanco del sensor: LPTIM4 cuenta y el LPDMA guarda CNT de LPTIM3 en el anillo.
+static void Edge(void)
+{
+    TimerSet(&sensor, sensor.value + 1u);
+    ring[ring_write] = (uint16_t)lse.value;
+    ring_write = (ring_write + 1u) % RING_LENGTH_SIM;
+    LPDMA1_Channel0->CBR1 = (RING_LENGTH_SIM - ring_write) * sizeof(uint16_t);
+}
+
+/*
+ * Flancos cada period ticks y drenados cada drain ticks durante unos 20 s.
+ * Cada ventana cerrada debe dar exactamente period ticks por periodo; con
+ * drain >= 2 s, la primera despues del drenado no debe tener periodos.
+ */
+static int DrainRun(uint32_t period, uint32_t drain, uint32_t latency)
+{
+    uint64_t edge_next;
+    uint64_t drain_next;
+    uint64_t end;
+    uint8_t expect_reset = (drain >= 65536u);
+    fmx_capture_window_t window;
+    uint32_t closes = 0;
+    int errors = 0;
+
+    lse.latency = latency;
+    sensor.latency = latency;
+
+    // Arranque: mas de 2 s sin drenar descarta la ventana de la corrida anterior.
+    TimerSet(&lse, lse.value + 3u * 32768u);
+    edge_next = lse.value + period;
+    drain_next = lse.value + drain;
+    end = lse.value + 20u * 32768u;
+    FMX_CAPTURE_Drain();
+    (void)FMX_CAPTURE_WindowClose();
+
+    while (drain_next < end)
+    {
+        while (edge_next <= drain_next)
+        {
+            TimerSet(&lse, edge_next);
+            Edge();
+            edge_next += period;
+        }
+        TimerSet(&lse, drain_next);
+        FMX_CAPTURE_Drain();
+        window = FMX_CAPTURE_WindowClose();
+        drain_next += drain;
+        closes++;
+
+        if (closes < 3u)
+        {
+            continue;
+        }
+        if (expect_reset)
+        {
+            if (window.pulses != 0)
+            {
+                printf("FAIL drain %u: window across %u ticks not reset\n", drain, drain);
+                errors++;
+            }
+        }
+        else if ((window.pulses != 0) && ((uint64_t)window.pulses * period != window.ticks))
+        {
+            printf("FAIL drain %u latency %u: %u periods in %u ticks, period %u\n", drain, latency,
+                   window.pulses, window.ticks, period);
+            errors++;
+        }
+        else if ((window.pulses == 0) && (drain > 2u * period))
+        {
+            printf("FAIL drain %u latency %u: empty window\n", drain, latency);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main(void)
+{
+    static const uint32_t drains[] = { 3000, 32768, 65000, 65535, 65536, 70000 };
+    static const uint32_t periods[] = { 7, 3001, 40000 };
+    int errors = 0;
+    int runs = 0;
+
+    if (mmap((void *)(uintptr_t)PERIPH_SIM_BASE, PERIPH_SIM_SIZE, PROT_READ | PROT_WRITE,
+             MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    lse.regs = LPTIM3;
+    sensor.regs = LPTIM4;
+
+    errors += Sweep("LPTIM3 time", &lse, FMX_CAPTURE_TimeGet);
+    errors += Sweep("LPTIM4 pulses", &sensor, FMX_CAPTURE_PulseCountGet);
+
+    LPDMA1_Channel0->CBR1 = RING_LENGTH_SIM * sizeof(uint16_t);
+    FMX_CAPTURE_Init();
+    for (uint32_t p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+    {
+        for (uint32_t d = 0; d < sizeof(drains) / sizeof(drains[0]); d++)
+        {
+            // A 7 ticks el anillo se llena antes de drenar cada 2 s: fuera de rango.
+            if ((drains[d] / periods[p]) >= (RING_LENGTH_SIM / 2u))
+            {
+                continue;
+            }
+            for (uint32_t l = 0; l < sizeof(isr_latency) / sizeof(isr_latency[0]); l++)
+            {
+                errors += DrainRun(periods[p], drains[d], isr_latency[l]);
+                runs++;
+            }
+        }
+    }
+    printf("drain: %d runs, %d failures\n", runs, errors);
+
+    printf("%s\n", errors ? "FAIL" : "OK");
+    return (errors != 0);
+}
@@ -0,0 +1,417 @@
+/**
+ * @file fmx_gate_check.c
+ * @brief Simula la ventana adaptiva de fmx.c contra el gate fijo de 1 s.
+ *
+ * Incluye fmx.c para llamar a PulseUpdate tal cual la llama el hilo de
+ * medicion. Los flancos del sensor salen de un modelo de frecuencia constante
+ * por tramos, cuantizados a ticks LSE. WindowClose sigue a fmx_capture.c: el
+ * ultimo flanco queda como ancla, una ventana sin flancos nuevos sigue abierta
+ * y el ancla se descarta despues de ANCHOR_AGE_MAX. En lugar de la regresion
+ * devuelve el conteo reciproco entre el ancla y el ultimo flanco, que es el
+ * peor caso que la regresion mejora.
+ *
+ * Para frecuencias entre limit_low y limit_high del sensor de fabrica mide:
+ *   - resolucion: error relativo maximo en regimen de cada medicion,
+ *   - latencia: peor demora desde un escalon de caudal hasta la primera
+ *     medicion dentro del 1 % del valor nuevo.
+ * El gate fijo es el del firmware anterior: pulsos contados en 1 s.
+ * Falla si la ventana adaptiva no cumple GATE_RESOLUTION_PPM o si tarda mas
+ * que el gate fijo donde este tambien llega al 1 %.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "fmx.c"
+#include "fm_factory.h"
+
+#define SETTLE_TOLERANCE    0.01
+#define FREQ_STEPS          24u
+#define STEPS_PER_FREQ      16u
+#define STEADY_SECONDS      60u
+#define LSE_PER_TICK        ((double)LSE_HZ / TICKS_PER_SECOND)
+#define ANCHOR_AGE_MAX      (16u * LSE_HZ)
+
+uint32_t cmsis_host_primask;
+
+// Misma tabla que fm_fmc.c, que no se enlaza.
+static const uint32_t seconds_per_unit[] = { 1, 60, 3600, 86400 };
+
+// --- Modelo del sensor ---
+static ULONG sim_ticks;
+static double sim_lse;
+static double freq;
+static double edge_next;
+static uint32_t edges;
+static uint32_t edge_last;
+static uint32_t window_edges;
+static uint32_t anchor;
+static uint8_t anchor_valid;
+
+// Gate fijo: pulsos contados en cada segundo.
+static double second_next;
+static uint32_t second_edges;
+
+// Medicion publicada por PulseUpdate en la ultima llamada.
+static uint8_t measured;
+static double measured_freq;
+
+// --- Estado de cada corrida ---
+static double step_at;
+static double step_lse;
+static double step_freq;
+static uint8_t step_pending;
+static uint8_t fixed_pending;
+static double latency_adaptive;
+static double latency_fixed;
+static double error_adaptive;
+static double error_fixed;
+static uint8_t steady;
+
+// --- Stubs de fmx_capture.c ---
+void FMX_CAPTURE_Drain(void) {}
+uint32_t FMX_CAPTURE_DrainTimeGet(void) { return MEASURE_WAKE_MAX; }
+uint32_t FMX_CAPTURE_PulseCountGet(void) { return edges; }
+uint32_t FMX_CAPTURE_TimeGet(void) { return (uint32_t)sim_lse; }
+
+fmx_capture_window_t FMX_CAPTURE_WindowClose(void)
+{
+    fmx_capture_window_t window = { 0, 0 };
+
+    if (anchor_valid && (window_edges > 0))
+    {
+        window.pulses = window_edges << FMX_CAPTURE_SCALE_SHIFT;
+        window.ticks = (edge_last - anchor) << FMX_CAPTURE_SCALE_SHIFT;
+        anchor = edge_last;
+        window_edges = 0;
+    }
+    else if (anchor_valid && (((uint32_t)sim_lse - anchor) > ANCHOR_AGE_MAX))
+    {
+        anchor_valid = 0;
+    }
+    return window;
+}
+
+// --- Stubs de fm_fmc.c: el caudal se toma de la ventana ---
+void FM_FMC_CaptureSet(uint32_t pulse, uint32_t time)
+{
+    measured = 1;
+    measured_freq = (time != 0) ? ((double)pulse * LSE_HZ / time) : 0;
+}
+ufp3_t FM_FMC_AcmCalc(void) { return 0; }
+void FM_FMC_PulseAdd(uint32_t pulse_delta) { (void)pulse_delta; }
+ufp3_t FM_FMC_RateCalc(void) { return 0; }
+void FM_FMC_RateFilterReset(void) {}
+void FM_FMC_SnapshotGet(fm_fmc_snapshot_t *snapshot) { (void)snapshot; }
+void FM_FMC_SnapshotPublish(fmx_ack_t status, uint32_t time_unix) { (void)status; (void)time_unix; }
+ufp3_t FM_FMC_TtlCalc(void) { return 0; }
+fm_fmc_totalizer_t FM_FMC_GetEnviroment(void) { fm_fmc_totalizer_t t = { 0 }; return t; }
+
+// --- Stubs del resto del firmware ---
+fmx_batch_status_t FMX_BATCH_StatusGet(void) { fmx_batch_status_t s = { 0 }; return s; }
+void FMX_BATCH_Update(uint32_t pulse_delta) { (void)pulse_delta; }
+void FMX_WAKE_Cancel(fmx_wake_id_t id) { (void)id; }
+UINT FMX_WAKE_Init(void) { return TX_SUCCESS; }
+void FMX_WAKE_Register(fmx_wake_id_t id, fmx_wake_callback_t callback) { (void)id; (void)callback; }
+void FMX_WAKE_Schedule(fmx_wake_id_t id, ULONG ticks, ULONG period, ULONG slack)
+{
+    (void)id; (void)ticks; (void)period; (void)slack;
+}
+void FM_CMD_RtosInit(VOID *memory_ptr) { (void)memory_ptr; }
+void FM_DEBUG_LedError(int status) { (void)status; }
+uint32_t FM_LCD_LL_BlinkWait() { return 0; }
+void FM_LCD_LL_Refresh() {}
+void FM_LCD_LL_SymbolWrite(fm_lcd_ll_sym_t symbol, uint8_t state) { (void)symbol; (void)state; }
+fmx_status_t FM_LOG_NewEvent(fmx_ack_t ack) { (void)ack; return FMX_STATUS_OK; }
+uint32_t FM_LOG_POLICY_Timer(uint32_t seconds) { (void)seconds; return 0; }
+void FM_PCF8553_OwnerSet() {}
+void FM_PCF8553_RtosInit() {}
+uint32_t FM_RTC_GetUnixTime(void) { return 0; }
+uint8_t FM_SETUP_MenuNav(fmx_events_t new_event) { (void)new_event; return 0; }
+void FM_USART_RtosInit(VOID *memory_ptr) { (void)memory_ptr; }
+uint8_t FM_USER_MenuNav(fmx_events_t new_event) { (void)new_event; return 0; }
+void FM_USER_ThreadEntryBluetoothSlave(ULONG input) { (void)input; }
+GPIO_PinState HAL_GPIO_ReadPin(const GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    (void)GPIOx; (void)GPIO_Pin; return GPIO_PIN_RESET;
+}
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    (void)GPIOx; (void)GPIO_Pin; (void)PinState;
+}
+
+// --- Stubs de ThreadX ---
+ULONG _tx_time_get(VOID) { return sim_ticks; }
+UINT _txe_byte_allocate(TX_BYTE_POOL *pool_ptr, VOID **memory_ptr, ULONG memory_size, ULONG wait_option)
+{
+    (void)pool_ptr; (void)memory_ptr; (void)memory_size; (void)wait_option; return TX_SUCCESS;
+}
+UINT _txe_event_flags_create(TX_EVENT_FLAGS_GROUP *group_ptr, CHAR *name_ptr, UINT size)
+{
+    (void)group_ptr; (void)name_ptr; (void)size; return TX_SUCCESS;
+}
+UINT _txe_event_flags_get(TX_EVENT_FLAGS_GROUP *group_ptr, ULONG requested_flags, UINT get_option,
+                          ULONG *actual_flags_ptr, ULONG wait_option)
+{
+    (void)group_ptr; (void)requested_flags; (void)get_option; (void)actual_flags_ptr; (void)wait_option;
+    return TX_NO_EVENTS;
+}
+UINT _txe_event_flags_set(TX_EVENT_FLAGS_GROUP *group_ptr, ULONG flags_to_set, UINT set_option)
+{
+    (void)group_ptr; (void)flags_to_set; (void)set_option; return TX_SUCCESS;
+}
+UINT _txe_mutex_create(TX_MUTEX *mutex_ptr, CHAR *name_ptr, UINT inherit, UINT size)
+{
+    (void)mutex_ptr; (void)name_ptr; (void)inherit; (void)size; return TX_SUCCESS;
+}
+UINT _txe_mutex_get(TX_MUTEX *mutex_ptr, ULONG wait_option) { (void)mutex_ptr; (void)wait_option; return TX_SUCCESS; }
+UINT _txe_mutex_put(TX_MUTEX *mutex_ptr) { (void)mutex_ptr; return TX_SUCCESS; }
+UINT _txe_queue_create(TX_QUEUE *queue_ptr, CHAR *name_ptr, UINT message_size, VOID *queue_start,
+                       ULONG queue_size, UINT size)
+{
+    (void)queue_ptr; (void)name_ptr; (void)message_size; (void)queue_start; (void)queue_size; (void)size;
+    return TX_SUCCESS;
+}
+UINT _txe_queue_receive(TX_QUEUE *queue_ptr, VOID *destination_ptr, ULONG wait_option)
+{
+    (void)queue_ptr; (void)destination_ptr; (void)wait_option; return TX_QUEUE_EMPTY;
+}
+UINT _txe_queue_send(TX_QUEUE *queue_ptr, VOID *source_ptr, ULONG wait_option)
+{
+    (void)queue_ptr; (void)source_ptr; (void)wait_option; return TX_SUCCESS;
+}
+UINT _txe_semaphore_ceiling_put(TX_SEMAPHORE *semaphore_ptr, ULONG ceiling)
+{
+    (void)semaphore_ptr; (void)ceiling; return TX_SUCCESS;
+}
+UINT _txe_semaphore_create(TX_SEMAPHORE *semaphore_ptr, CHAR *name_ptr, ULONG initial_count, UINT size)
+{
+    (void)semaphore_ptr; (void)name_ptr; (void)initial_count; (void)size; return TX_SUCCESS;
+}
+UINT _txe_semaphore_get(TX_SEMAPHORE *semaphore_ptr, ULONG wait_option)
+{
+    (void)semaphore_ptr; (void)wait_option; return TX_SUCCESS;
+}
+UINT _txe_semaphore_put(TX_SEMAPHORE *semaphore_ptr) { (void)semaphore_ptr; return TX_SUCCESS; }
+UINT _txe_thread_create(TX_THREAD *thread_ptr, CHAR *name_ptr, VOID (*entry_function)(ULONG entry_input),
+                        ULONG entry_input, VOID *stack_start, ULONG stack_size, UINT priority,
+                        UINT preempt_threshold, ULONG time_slice, UINT auto_start, UINT size)
+{
+    (void)thread_ptr; (void)name_ptr; (void)entry_function; (void)entry_input; (void)stack_start;
+    (void)stack_size; (void)priority; (void)preempt_threshold; (void)time_slice; (void)auto_start;
+    (void)size;
+    return TX_SUCCESS;
+}
+UINT _txe_timer_activate(TX_TIMER *timer_ptr) { (void)timer_ptr; return TX_SUCCESS; }
+UINT _txe_timer_change(TX_TIMER *timer_ptr, ULONG initial_ticks, ULONG reschedule_ticks)
+{
+    (void)timer_ptr; (void)initial_ticks; (void)reschedule_ticks; return TX_SUCCESS;
+}
+UINT _txe_timer_create(TX_TIMER *timer_ptr, CHAR *name_ptr, VOID (*expiration_function)(ULONG input),
+                       ULONG expiration_input, ULONG initial_ticks, ULONG reschedule_ticks,
+                       UINT auto_activate, UINT size)
+{
+    (void)timer_ptr; (void)name_ptr; (void)expiration_function; (void)expiration_input;
+    (void)initial_ticks; (void)reschedule_ticks; (void)auto_activate; (void)size;
+    return TX_SUCCESS;
+}
+UINT _txe_timer_deactivate(TX_TIMER *timer_ptr) { (void)timer_ptr; return TX_SUCCESS; }
+
+// --- Simulacion ---
+
+static double RelError(double value, double reference)
+{
+    return fabs(value - reference) / reference;
+}
+
+// Cierre de un segundo del gate fijo.
+static void FixedSecond(void)
+{
+    if (steady)
+    {
+        double error = RelError(second_edges, freq);
+        if (error > error_fixed)
+        {
+            error_fixed = error;
+        }
+    }
+    if (fixed_pending && ((second_next - LSE_HZ) >= step_lse) &&
+        (RelError(second_edges, step_freq) <= SETTLE_TOLERANCE))
+    {
+        double latency = (second_next - step_lse) / LSE_HZ;
+        if (latency > latency_fixed)
+        {
+            latency_fixed = latency;
+        }
+        fixed_pending = 0;
+    }
+    second_edges = 0;
+    second_next += LSE_HZ;
+}
+
+/*
+ * El sensor cambia de frecuencia en el instante indicado, conservando la
+ * fraccion de periodo que ya transcurrio.
+ */
+static void FreqSet(double at, double hz)
+{
+    edge_next = at + (edge_next - at) * freq / hz;
+    freq = hz;
+}
+
+// Avanza el sensor, el escalon pendiente y el gate fijo hasta el tick indicado.
+static void Advance(ULONG ticks)
+{
+    double target = ticks * LSE_PER_TICK;
+
+    while ((edge_next <= target) || (second_next <= target) || (step_at <= target))
+    {
+        if ((step_at <= edge_next) && (step_at <= second_next))
+        {
+            step_lse = step_at;
+            step_at = INFINITY;
+            FreqSet(step_lse, step_freq);
+            step_pending = 1;
+            fixed_pending = 1;
+        }
+        else if (edge_next < second_next)
+        {
+            edges++;
+            second_edges++;
+            edge_last = (uint32_t)edge_next;
+            if (anchor_valid)
+            {
+                window_edges++;
+            }
+            else
+            {
+                anchor = edge_last;
+                anchor_valid = 1;
+            }
+            edge_next += LSE_HZ / freq;
+        }
+        else
+        {
+            FixedSecond();
+        }
+    }
+    sim_ticks = ticks;
+    sim_lse = target;
+}
+
+// Una vuelta del hilo de medicion: PulseUpdate y la espera que devuelve.
+static void MeasureStep(void)
+{
+    ULONG wait;
+
+    measured = 0;
+    wait = PulseUpdate(0);
+    if (measured && (measured_freq > 0))
+    {
+        if (steady)
+        {
+            double error = RelError(measured_freq, freq);
+            if (error > error_adaptive)
+            {
+                error_adaptive = error;
+            }
+        }
+        if (step_pending && (RelError(measured_freq, step_freq) <= SETTLE_TOLERANCE))
+        {
+            double latency = (sim_lse - step_lse) / LSE_HZ;
+            if (latency > latency_adaptive)
+            {
+                latency_adaptive = latency;
+            }
+            step_pending = 0;
+        }
+    }
+    if (wait > MEASURE_WAKE_MAX)
+    {
+        wait = MEASURE_WAKE_MAX;
+    }
+    Advance(sim_ticks + wait);
+}
+
+static void RunFor(double seconds)
+{
+    ULONG end = sim_ticks + (ULONG)(seconds * TICKS_PER_SECOND);
+
+    while (sim_ticks < end)
+    {
+        MeasureStep();
+    }
+}
+
+int main(void)
+{
+    fm_fmc_totalizer_t sensor = FM_FACTORY_TotalizerGet(FM_FACTORY_SENSOR_0);
+    double hz_per_rate = sensor.factor_k / seconds_per_unit[sensor.time_unit] / 1000;
+    double low = sensor.rate.limit_low * hz_per_rate;
+    double high = sensor.rate.limit_high * hz_per_rate;
+    int errors = 0;
+
+    freq = low;
+    edge_next = 0.37 * LSE_HZ / freq;
+    second_next = LSE_HZ;
+    step_at = INFINITY;
+
+    printf("sensor 0: %.3f .. %.3f Hz, step x1.5, settle within %.0f %%\n", low, high,
+           SETTLE_TOLERANCE * 100);
+    printf("%12s %8s %12s %12s %12s %12s\n", "Hz", "gate ms", "adapt ppm", "fixed ppm",
+           "adapt s", "fixed s");
+
+    for (uint32_t i = 0; i <= FREQ_STEPS; i++)
+    {
+        double hz = low * pow(high / low, (double)i / FREQ_STEPS);
+
+        FreqSet(sim_lse, hz);
+        RunFor(20);
+
+        steady = 1;
+        error_adaptive = 0;
+        error_fixed = 0;
+        RunFor(STEADY_SECONDS);
+        steady = 0;
+
+        latency_adaptive = 0;
+        latency_fixed = 0;
+        for (uint32_t step = 0; step < STEPS_PER_FREQ; step++)
+        {
+            // Escalones en distintas fases de la ventana y del segundo.
+            step_at = sim_lse + LSE_HZ * (1 + 0.613 * step);
+            step_freq = (step & 1u) ? hz : ((hz * 1.5 <= high) ? hz * 1.5 : hz / 1.5);
+            RunFor(2.0 * GATE_TICKS_MAX / TICKS_PER_SECOND + 4 + 0.613 * step);
+            if (step_pending)
+            {
+                latency_adaptive = INFINITY;
+            }
+            if (fixed_pending)
+            {
+                latency_fixed = INFINITY;
+            }
+            step_pending = 0;
+            fixed_pending = 0;
+        }
+        FreqSet(sim_lse, hz);
+
+        printf("%12.3f %8lu %12.1f %12.1f %12.2f %12.2f\n", hz,
+               (unsigned long)(gate_ticks * 1000u / TICKS_PER_SECOND),
+               error_adaptive * 1e6, error_fixed * 1e6, latency_adaptive, latency_fixed);
+
+        if ((error_adaptive * 1e6) > GATE_RESOLUTION_PPM)
+        {
+            printf("FAIL %.3f Hz: resolution %.1f ppm\n", hz, error_adaptive * 1e6);
+            errors++;
+        }
+        if (isinf(latency_adaptive) ||
+            (!isinf(latency_fixed) && (latency_adaptive > latency_fixed)))
+        {
+            printf("FAIL %.3f Hz: latency %.2f s, fixed gate %.2f s\n", hz, latency_adaptive,
+                   latency_fixed);
+            errors++;
+        }
+    }
+
+    printf("%s\n", errors ? "FAIL" : "OK");
+    return (errors != 0);
+}
@@ -0,0 +1,416 @@
+/**
+ * @file fmx_lp_drift_check.c
+ * @brief Verifica que tx_time_get() sigue al LSE sin deriva con el stop 2 de fmx_lp.c.
+ *
+ * fmx_lp.c y fmx_capture.c corren sin cambios sobre LPTIM1, LPTIM3, SysTick y
+ * NVIC mapeados en sus direcciones del STM32. El tiempo se simula en unidades
+ * de 1/3276800 s: un tick LSE son 100 unidades y un tick de ThreadX 32768.
+ * - LPTIM1 (DIV16) arranca en cada HAL_LPTIM_PWM_Start_IT con el prescaler en
+ *   cero y levanta su interrupcion al llegar al compare.
+ * - LPTIM3 es la linea de tiempo desde FMX_CAPTURE_Init; su ARRM cada 2 s
+ *   despierta al MCU como cualquier interrupcion.
+ * - SysTick cuenta solo en run, conserva su fase a traves del stop y pierde
+ *   los ticks con TICKINT deshabilitado, como en FMX_LP_Enter.
+ * - El despertar tarda WAKE_LATENCY sin SysTick; una tecla (EXTI) llega a
+ *   intervalos al azar.
+ *
+ * Se simula un dia por cada periodo de SysTick (exacto y +-214 ppm). Los
+ * primeros BOOT_TIME segundos, antes de FMX_CAPTURE_Init, usan timers largos
+ * que encadenan tramos del LPTIM1; despues, timers de 10 ms a 100 s y sin
+ * timer. La diferencia entre tx_time_get() y los ticks del LSE no debe salir
+ * nunca de +-DRIFT_MAX_TICKS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "main.h"
+#include "lptim.h"
+#include "fmx_lp.h"
+#include "fmx_capture.h"
+#include "fmx_stats.h"
+#include "fmx_trace.h"
+#include "fm_debug.h"
+
+#define PERIPH_SIM_BASE   (APB3PERIPH_BASE_NS)
+#define PERIPH_SIM_SIZE   (0x00030000u)    // APB3 y AHB3: LPTIM1/3/4, RCC y LPDMA1.
+#define SCS_SIM_SIZE      (0x00001000u)    // SysTick y NVIC.
+
+#define LSE_UNITS         (100u)           // Unidades por tick LSE.
+#define TX_UNITS          (32768u)         // Unidades por tick de ThreadX (100 Hz).
+#define SECOND_UNITS      (3276800ull)
+#define DAY_UNITS         (86400ull * SECOND_UNITS)
+#define BOOT_TIME         (600u)           // Segundos antes de FMX_CAPTURE_Init.
+#define WAKE_LATENCY      (26u)            // ~8 us de salida del stop 2.
+#define WFI_RUN           (7u)             // Run entre PWM_Start y el WFI, y despues.
+#define DRIFT_MAX_TICKS   (1)
+
+#define IRQ_PENDING(irq)  ((NVIC->ISPR[(uint32_t)(irq) >> 5] >> ((uint32_t)(irq) & 0x1Fu)) & 1u)
+
+uint32_t cmsis_host_primask;
+LPTIM_HandleTypeDef hlptim1 = { .Instance = LPTIM1 };
+LPTIM_HandleTypeDef hlptim3 = { .Instance = LPTIM3 };
+LPTIM_HandleTypeDef hlptim4 = { .Instance = LPTIM4 };
+
+static uint64_t now_units;        // Tiempo verdadero.
+static uint64_t lptim1_start;     // Tick LSE del ultimo PWM_Start.
+static uint8_t  lptim1_run;
+static uint8_t  lptim1_fired;
+static uint64_t lptim3_start;     // Tick LSE de FMX_CAPTURE_Init.
+static uint8_t  lptim3_run;
+static uint64_t lptim3_value;
+static uint64_t key_time = UINT64_MAX; // Proxima tecla, desde FMX_CAPTURE_Init.
+static uint32_t systick_period;
+static uint32_t systick_phase;
+static uint8_t  systick_pending;
+static ULONG    tx_clock;
+static uint32_t rng = 0x2545F491u;
+static long     wakes;
+static long     chunks;
+
+// --- Stubs ---
+ULONG tx_time_get(void) { return tx_clock; }
+void FM_DEBUG_LedActive(int status) { (void)status; }
+void FM_DEBUG_LedError(int status) { (void)status; }
+void FMX_STATS_ChunkWake(void) { chunks++; }
+fmx_stats_wake_t FMX_STATS_StopExit(uint32_t lptim_ticks) { (void)lptim_ticks; return FMX_STATS_WAKE_CHUNK; }
+void FMX_TRACE_StopEnter(void) {}
+void FMX_TRACE_Wake(fmx_stats_wake_t reason, uint32_t time) { (void)reason; (void)time; }
+void HAL_NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    NVIC->ISPR[(uint32_t)IRQn >> 5] &= ~(1u << ((uint32_t)IRQn & 0x1Fu));
+}
+
+HAL_StatusTypeDef HAL_LPTIM_OC_ConfigChannel(LPTIM_HandleTypeDef *hlptim, const LPTIM_OC_ConfigTypeDef *sConfig,
+                                             uint32_t Channel)
+{
+    (void)Channel;
+    hlptim->Instance->CCR1 = sConfig->Pulse;
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_LPTIM_PWM_Start_IT(LPTIM_HandleTypeDef *hlptim, uint32_t Channel)
+{
+    (void)hlptim; (void)Channel;
+    lptim1_start = now_units / LSE_UNITS;
+    lptim1_run = 1;
+    lptim1_fired = 0;
+    LPTIM1->CNT = 0;
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_LPTIM_PWM_Stop_IT(LPTIM_HandleTypeDef *hlptim, uint32_t Channel)
+{
+    (void)hlptim; (void)Channel;
+    lptim1_run = 0;
+    LPTIM1->CNT = 0;
+    return HAL_OK;
+}
+
+// Captura: solo la linea de tiempo, sin flancos.
+HAL_StatusTypeDef HAL_LPTIM_IC_Start_DMA(LPTIM_HandleTypeDef *hlptim, uint32_t Channel, uint32_t *pData,
+                                         uint32_t Length)
+{
+    (void)hlptim; (void)Channel; (void)pData; (void)Length;
+    lptim3_start = now_units / LSE_UNITS;
+    lptim3_value = 0;
+    lptim3_run = 1;
+    return HAL_OK;
+}
+HAL_StatusTypeDef HAL_DMAEx_List_BuildNode(DMA_NodeConfTypeDef const *const pNodeConfig,
+                                           DMA_NodeTypeDef *const pNode)
+{
+    (void)pNodeConfig; (void)pNode; return HAL_OK;
+}
+HAL_StatusTypeDef HAL_DMAEx_List_InsertNode(DMA_QListTypeDef *const pQList, DMA_NodeTypeDef *const pPrevNode,
+                                            DMA_NodeTypeDef *const pNewNode)
+{
+    (void)pQList; (void)pPrevNode; (void)pNewNode; return HAL_OK;
+}
+HAL_StatusTypeDef HAL_DMAEx_List_SetCircularMode(DMA_QListTypeDef *const pQList) { (void)pQList; return HAL_OK; }
+HAL_StatusTypeDef HAL_DMAEx_List_Init(DMA_HandleTypeDef *const hdma) { (void)hdma; return HAL_OK; }
+HAL_StatusTypeDef HAL_DMAEx_List_LinkQ(DMA_HandleTypeDef *const hdma, DMA_QListTypeDef *const pQList)
+{
+    (void)hdma; (void)pQList; return HAL_OK;
+}
+HAL_StatusTypeDef HAL_DMA_ConfigChannelAttributes(DMA_HandleTypeDef *const hdma, uint32_t ChannelAttributes)
+{
+    (void)hdma; (void)ChannelAttributes; return HAL_OK;
+}
+
+// --- Simulacion ---
+
+static uint32_t Random(uint32_t range)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng % range;
+}
+
+static void IrqSet(IRQn_Type irq)
+{
+    NVIC->ISPR[(uint32_t)irq >> 5] |= 1u << ((uint32_t)irq & 0x1Fu);
+}
+
+static void IrqEnable(IRQn_Type irq)
+{
+    NVIC->ISER[(uint32_t)irq >> 5] |= 1u << ((uint32_t)irq & 0x1Fu);
+}
+
+static uint8_t WakePending(void)
+{
+    for (uint32_t i = 0; i < (sizeof(NVIC->ISER) / sizeof(NVIC->ISER[0])); i++)
+    {
+        if (NVIC->ISPR[i] & NVIC->ISER[i])
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Corre las ISR pendientes, como al habilitar interrupciones en ThreadX.
+static void IsrService(void)
+{
+    if (systick_pending)
+    {
+        systick_pending = 0;
+        tx_clock++;
+    }
+    if (IRQ_PENDING(LPTIM3_IRQn))
+    {
+        LPTIM3->ISR &= ~LPTIM_FLAG_ARRM;
+        HAL_NVIC_ClearPendingIRQ(LPTIM3_IRQn);
+        HAL_LPTIM_AutoReloadMatchCallback(&hlptim3);
+    }
+    HAL_NVIC_ClearPendingIRQ(LPTIM1_IRQn);
+    HAL_NVIC_ClearPendingIRQ(EXTI13_IRQn);
+}
+
+/*
+ * Avanza el tiempo verdadero dt unidades, evento por evento: ARRM de LPTIM3,
+ * compare del LPTIM1, tecla y, en run, cada vuelta de SysTick. Con wfi se
+ * detiene en la primera interrupcion habilitada pendiente.
+ */
+static void Advance(uint64_t dt, uint8_t stopped, uint8_t wfi)
+{
+    uint64_t end = now_units + dt;
+    uint64_t next;
+    uint64_t event;
+
+    while (now_units < end)
+    {
+        next = end;
+        if (lptim3_run)
+        {
+            event = (lptim3_start + (lptim3_value | 0xFFFFu)) * LSE_UNITS;
+            if ((lptim3_value & 0xFFFFu) == 0xFFFFu)
+            {
+                event += 0x10000u * LSE_UNITS;
+            }
+            next = (event < next) ? event : next;
+        }
+        if (lptim1_run && !lptim1_fired)
+        {
+            event = (lptim1_start + (uint64_t)LPTIM1->CCR1 * 16u) * LSE_UNITS;
+            next = (event < next) ? event : next;
+        }
+        if (key_time > now_units)
+        {
+            next = (key_time < next) ? key_time : next;
+        }
+        if (!stopped && ((now_units + systick_period - systick_phase) < next))
+        {
+            next = now_units + systick_period - systick_phase;
+        }
+
+        if (!stopped)
+        {
+            systick_phase += (uint32_t)(next - now_units);
+            if (systick_phase == systick_period)
+            {
+                systick_phase = 0;
+                systick_pending |= ((SysTick->CTRL & SysTick_CTRL_TICKINT_Msk) != 0u);
+            }
+        }
+        now_units = next;
+
+        if (lptim3_run)
+        {
+            event = lptim3_value;
+            lptim3_value = now_units / LSE_UNITS - lptim3_start;
+            LPTIM3->CNT = (uint16_t)lptim3_value;
+            // ARRM una sola vez, al llegar CNT a 0xFFFF.
+            if (((event + 1u) >> 16) != ((lptim3_value + 1u) >> 16))
+            {
+                LPTIM3->ISR |= LPTIM_FLAG_ARRM;
+                IrqSet(LPTIM3_IRQn);
+            }
+        }
+        if (lptim1_run)
+        {
+            LPTIM1->CNT = (uint16_t)((now_units / LSE_UNITS - lptim1_start) / 16u);
+            if (!lptim1_fired && (LPTIM1->CNT >= LPTIM1->CCR1))
+            {
+                lptim1_fired = 1;
+                IrqSet(LPTIM1_IRQn);
+            }
+        }
+        if (now_units == key_time)
+        {
+            IrqSet(EXTI13_IRQn);
+            key_time += 1u + Random(60u * SECOND_UNITS);
+        }
+        if (!cmsis_host_primask)
+        {
+            IsrService();
+        }
+        if (wfi && WakePending())
+        {
+            break;
+        }
+    }
+}
+
+// WFI en stop 2: SysTick detenido hasta el despertar y durante su latencia.
+void HAL_PWREx_EnterSTOP2Mode(uint8_t STOPEntry)
+{
+    (void)STOPEntry;
+    Advance(WFI_RUN, 0, 0);
+    if (!WakePending())
+    {
+        Advance(2u * DAY_UNITS, 1, 1);
+    }
+    Advance(WAKE_LATENCY + Random(WAKE_LATENCY), 1, 0);
+    Advance(WFI_RUN, 0, 0);
+    wakes++;
+}
+
+void HAL_PWR_EnterSLEEPMode(uint32_t Regulator, uint8_t SLEEPEntry)
+{
+    (void)Regulator; (void)SLEEPEntry;
+    printf("FAIL sleep mode without FMX_LP_StopHold\n");
+    exit(1);
+}
+
+// Proxima expiracion de ThreadX, en ticks desde ahora; 0 sin timer activo.
+static ULONG TimerNext(uint8_t boot)
+{
+    uint32_t kind = Random(100);
+
+    if (boot)
+    {
+        return 3000u + Random(9000u);
+    }
+    if (kind < 70u)
+    {
+        return 1u + Random(50u);
+    }
+    if (kind < 90u)
+    {
+        return 50u + Random(450u);
+    }
+    if (kind < 95u)
+    {
+        return 500u + Random(9500u);
+    }
+    return 0;
+}
+
+static int Day(uint32_t period)
+{
+    ULONG expire;
+    ULONG count;
+    uint8_t armed;
+    int64_t drift;
+    int64_t drift_min = 0;
+    int64_t drift_max = 0;
+    uint8_t boot = 1;
+
+    systick_period = period;
+    count = TimerNext(boot);
+    expire = tx_clock + count;
+    armed = 1;
+
+    while (now_units < DAY_UNITS)
+    {
+        if (boot && (now_units >= BOOT_TIME * SECOND_UNITS))
+        {
+            FMX_CAPTURE_Init();
+            IrqEnable(LPTIM3_IRQn);
+            key_time = now_units + Random(60u * SECOND_UNITS);
+            boot = 0;
+        }
+
+        // Hilos que despiertan por timer o por tecla corren un rato.
+        if ((armed && ((LONG)(tx_clock - expire) >= 0)) || (!armed && (Random(4u) == 0u)))
+        {
+            Advance(Random(2u * TX_UNITS), 0, 0);
+            count = TimerNext(boot);
+            expire = tx_clock + count;
+            armed = (count != 0u);
+        }
+
+        // Idle: el mismo orden que tx_low_power_enter / tx_low_power_exit.
+        cmsis_host_primask = 1;
+        if (armed)
+        {
+            FMX_LP_Setup((ULONG)(((LONG)(expire - tx_clock) > 0) ? (expire - tx_clock) : 1u));
+        }
+        FMX_LP_Enter();
+        FMX_LP_Exit();
+        tx_clock += FMX_LP_Adjust();
+        cmsis_host_primask = 0;
+        IsrService();
+
+        drift = (int64_t)tx_clock - (int64_t)(now_units / TX_UNITS);
+        drift_min = (drift < drift_min) ? drift : drift_min;
+        drift_max = (drift > drift_max) ? drift : drift_max;
+    }
+
+    printf("systick %u: %ld wakes, %ld chunks, drift %lld..%lld ticks, end %lld\n", period, wakes, chunks,
+           (long long)drift_min, (long long)drift_max,
+           (long long)((int64_t)tx_clock - (int64_t)(now_units / TX_UNITS)));
+    return (drift_min < -DRIFT_MAX_TICKS) || (drift_max > DRIFT_MAX_TICKS) || (chunks == 0);
+}
+
+int main(void)
+{
+    static const uint32_t periods[] = { TX_UNITS, TX_UNITS - 7u, TX_UNITS + 7u };
+    int errors = 0;
+
+    if ((mmap((void *)(uintptr_t)PERIPH_SIM_BASE, PERIPH_SIM_SIZE, PROT_READ | PROT_WRITE,
+              MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) == MAP_FAILED) ||
+        (mmap((void *)(uintptr_t)SCS_BASE, SCS_SIM_SIZE, PROT_READ | PROT_WRITE,
+              MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) == MAP_FAILED))
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    SysTick->CTRL = SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_TICKINT_Msk;
+    IrqEnable(LPTIM1_IRQn);
+    IrqEnable(EXTI13_IRQn);
+
+    // Cada dia en un proceso hijo: fmx_lp.c y fmx_capture.c arrancan de cero.
+    for (uint32_t p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+    {
+        pid_t pid;
+        int status;
+
+        fflush(stdout);
+        pid = fork();
+        if (pid == 0)
+        {
+            exit(Day(periods[p]));
+        }
+        if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || WEXITSTATUS(status))
+        {
+            errors++;
+        }
+    }
+
+    printf("%s\n", errors ? "FAIL" : "OK");
+    return (errors != 0);
+}